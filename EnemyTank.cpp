@@ -22,7 +22,12 @@ void EnemyTank::doUpdate(float deltaTime) {
     
     vec3 dir = glm::normalize(glm::vec3(cos(angleInRadians), 0.0, sin(angleInRadians)));
     this->setDirection(dir);
-    PlayerTank* player = dynamic_cast<PlayerTank*>(Scene::getInstance()->getGameObject(GameObjectType::PlayerTank));
+    // Go after the nearest player, since the dedicated server can have several
+    GameObject* player = nullptr;
+    for (GameObject* candidate : Scene::getInstance()->getGameObjects(GameObjectType::PlayerTank)) {
+        if (!player || glm::distance(candidate->getPosition(), pos) < glm::distance(player->getPosition(), pos))
+            player = candidate;
+    }
     if (!player)
         return;
     auto playerPos = player->getPosition();
@@ -41,11 +46,13 @@ void EnemyTank::doUpdate(float deltaTime) {
         this->setPosition(pos);
     }
 
+    sfxManager.setPosition(this->getPosition());
+
     if (spd > 0.0) {
-        sfxManager->playSound(SFXManager::Sounds::EnemyTreads);
+        sfxManager.playSound(SFXManager::Sounds::EnemyTreads);
     }
     else {
-        sfxManager->stopSound(SFXManager::Sounds::EnemyTreads);
+        sfxManager.stopSound(SFXManager::Sounds::EnemyTreads);
     }
 
     shotAccumulator += deltaTime;
@@ -58,13 +65,15 @@ void EnemyTank::doUpdate(float deltaTime) {
  * @brief Plays sounds when the tank is destroyed and creates a game win.
  */
 void EnemyTank::doCollision(GameObject* other) {
-    sfxManager->playSound(SFXManager::Sounds::Collision);
-    sfxManager->playSound(SFXManager::Sounds::Explosion);
-    sfxManager->stopSound(SFXManager::Sounds::EnemyTreads);
+    sfxManager.playSound(SFXManager::Sounds::Collision);
+    sfxManager.playSound(SFXManager::Sounds::Explosion);
+    sfxManager.stopSound(SFXManager::Sounds::EnemyTreads);
     selfDestruct();
     //Show explosion
     //wait a second or two
-    Game::getInstance()->wonGame();
+    if (Game* game = Game::findInstance()) {
+        game->wonGame();
+    }
 }
 
 /**
@@ -87,7 +96,7 @@ void EnemyTank::shoot(glm::vec3 direction) {
     auto bullet = new Projectile(scene->getNextFreeEntityID(), bulletPos, bulletDir, GameObjectType::EnemyProjectile);
 
     scene->addObject(bullet);
-    sfxManager->playSound(SFXManager::Sounds::Firing);
+    sfxManager.playSound(SFXManager::Sounds::Firing);
 }
 
 /**
@@ -101,8 +110,7 @@ void EnemyTank::shoot(glm::vec3 direction) {
 EnemyTank::EnemyTank(uint32_t entityID, const vec3& position, const vec3& direction)
 : Tank(GameObjectType::EnemyTank, entityID, position, direction),
 shotAccumulator(0),
-shotThreshold(10),
-sfxManager(new SFXManager())
+shotThreshold(10)
 {
     this->setSpeed(0.5);
 }
@@ -26,7 +26,7 @@ private:
     void shoot(glm::vec3 direction) override;
     float shotAccumulator;
     float shotThreshold;
-    SFXManager* sfxManager;
+    SFXManager sfxManager;
 
 //TODO: implement collider to detect when an obstacle has been hit. Use this for AI logic
 //TODO: Implement shooting at player
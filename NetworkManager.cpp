@@ -6,14 +6,23 @@
 
 #include "NetworkManager.h"
 
-//Constructor for the NetworkManager class. Initializes the TCP socket and data stream
+//Constructor for the NetworkManager class. Initializes the TCP socket
 NetworkManager::NetworkManager(QObject *parent) :
         QObject(parent), socket(new QTcpSocket(this)) {
 
     setupSocketSignals();
+}
+
+//Constructor for an accepted connection. Takes over the socket, and reads anything that arrived before now
+NetworkManager::NetworkManager(QTcpSocket *socket, QObject *parent) :
+        QObject(parent), socket(socket) {
 
-    in.setDevice(socket);
-    in.setVersion(QDataStream::Qt_5_10);
+    socket->setParent(this);
+    setupSocketSignals();
+
+    if (socket->bytesAvailable() > 0) {
+        onReadyRead();
+    }
 }
 
 //Destructor ensures that the network connection is closed properly
@@ -23,19 +32,37 @@ NetworkManager::~NetworkManager() {
 
 //Attempts to establish a connection to the server at the specified host and port
 void NetworkManager::connectToServer(const QString &host, quint16 port) {
+    parser.reset();
     socket->connectToHost(host, port);
 }
 
-//Disconnects the socket from the server
+//Disconnects the socket from the server, forgetting anything half received
 void NetworkManager::disconnectFromServer() {
     socket->disconnectFromHost();
+    parser.reset();
 }
 
-//Sends the provided data to the server over the established connection
-void NetworkManager::send(const QByteArray &data) {
-    if (socket->state() == QTcpSocket::ConnectedState) {
-        socket->write(data);
+//Sends a message over the established connection, its header then its payload
+void NetworkManager::send(quint8 type, const void *data, size_t size) {
+    if (socket->state() != QTcpSocket::ConnectedState) {
+        return;
     }
+
+    if (size > MessageFrame::maxMessageSize) {
+        emit errorOccurred(QStringLiteral("NetworkManager: Message of %1 bytes is too big to send").arg(size));
+        return;
+    }
+
+    uint8_t header[MessageFrame::maxHeaderSize];
+    size_t headerSize = MessageFrame::writeHeader(header, type, size);
+
+    socket->write((const char *)header, (qint64)headerSize);
+    socket->write((const char *)data, (qint64)size);
+}
+
+//Sends a message held in a QByteArray
+void NetworkManager::send(quint8 type, const QByteArray &data) {
+    send(type, data.constData(), (size_t)data.size());
 }
 
 //Emits the connected signal when the socket connection is successfully established
@@ -48,10 +75,32 @@ void NetworkManager::onDisconnected() {
     emit disconnected();
 }
 
-//Reads all available data from the socket and emits the dataReceived signal
+//Reads the available data straight into the parser's buffer, and emits messageReceived for each complete message
 void NetworkManager::onReadyRead() {
-    QByteArray data = socket->readAll();
-    emit dataReceived(data);
+    qint64 available;
+
+    while ((available = socket->bytesAvailable()) > 0) {
+        uint8_t *space = parser.prepare((size_t)available);
+        qint64 bytesRead = socket->read((char *)space, available);
+
+        if (bytesRead <= 0) {
+            break;
+        }
+
+        parser.commit((size_t)bytesRead);
+
+        MessageView message;
+        while (parser.next(message)) {
+            emit messageReceived(message);
+        }
+
+        //A broken stream can't be resynchronized, so give up on the connection
+        if (parser.failed()) {
+            emit errorOccurred(QStringLiteral("NetworkManager: Received a malformed message"));
+            socket->abort();
+            return;
+        }
+    }
 }
 
 //Emits the errorOccurred signal with the error message when a network error occurs
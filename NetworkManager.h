@@ -10,12 +10,17 @@
 
 #include <QObject>
 #include <QTcpSocket>
-#include <QDataStream>
+
+#include "messageframe.h"
 
 
 /**
  * @brief NetworkManager handles the network communication for the game, managing the connection to the server
  * and handling incoming and outgoing data.
+ *
+ * Data is sent and received as messages, framed as described in MessageFrame, so each messageReceived is
+ * exactly one message the other end sent, however TCP split it up. Received messages are views into the
+ * receive buffer, so they're never copied on the way in.
  * @author Parker Hyde
  * @date SPRING 2024
  */
@@ -31,6 +36,13 @@ public:
      */
     explicit NetworkManager(QObject *parent = nullptr);
 
+    /**
+     * @brief Constructor for the server's end of a connection, taking over a socket that's already connected.
+     * @param socket The socket, e.g. from QTcpServer::nextPendingConnection. The NetworkManager takes ownership of it.
+     * @param parent The QObject parent of this network manager.
+     */
+    NetworkManager(QTcpSocket *socket, QObject *parent);
+
     /**
      * @brief Destructor that ensures the network connection is properly closed.
      * @author Parker Hyde
@@ -55,12 +67,19 @@ public:
     void disconnectFromServer();
 
     /**
-     * @brief Sends data to the server if a connection is established.
-     * @param data The data to send to the server.
-     * @author Parker Hyde
-     * @date SPRING 2024
+     * @brief Sends a message to the other end if a connection is established.
+     * @param type What kind of message it is.
+     * @param data The message's payload.
+     * @param size The payload's size, at most MessageFrame::maxMessageSize.
+     */
+    void send(quint8 type, const void *data, size_t size);
+
+    /**
+     * @brief Sends a message to the other end if a connection is established.
+     * @param type What kind of message it is.
+     * @param data The message's payload.
      */
-    void send(const QByteArray &data);
+    void send(quint8 type, const QByteArray &data);
 
 signals:
     //Signal emitted when a connection to the server is successfully established
@@ -69,8 +88,9 @@ signals:
     //Signal emitted when the connection to the server is lost
     void disconnected();
 
-    //Signal emitted when data is received from the server
-    void dataReceived(const QByteArray &data);
+    //Signal emitted for each complete message received. The message points into the receive buffer, so it's only
+    //valid during the slot: connect directly (from the same thread), and copy out anything needed later
+    void messageReceived(const MessageView &message);
 
     //Signal emitted when a network error occurs
     void errorOccurred(const QString &errorMessage);
@@ -91,8 +111,8 @@ private slots:
 private:
     //The TCP socket for network communication
     QTcpSocket *socket;
-    //The data stream for reading data from the socket
-    QDataStream in;
+    //Splits the received bytes back into messages
+    MessageParser parser;
 
 
     /**
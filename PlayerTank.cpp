@@ -16,40 +16,31 @@
  * @brief The update logic. Moves the position and rotation of the player tank and increments the shotAccumulator.
  */
 void PlayerTank::doUpdate(float deltaTime) {
-    vec3 pos = this->getPosition();
-    float spd = this->getSpeed();
-    
-    
-    vec3 dir = glm::vec3(cos(angleInRadians), 0, sin(angleInRadians));
+    TankMotion motion{this->getPosition(), angleInRadians};
+
+    vec3 dir = TankMotion::facing(angleInRadians);
     this->setDirection(dir);
 
-    if (dirTable[0]) {
-        pos += dir * spd * deltaTime;
-        this->setPosition(pos);
-    }
+    // The same step a client predicts its own tank with, so the two agree
+    TankMotion next = TankMotion::step(motion, input, this->getSpeed(), deltaTime);
 
-    if (dirTable[1]) {
-        pos -= dir * spd * deltaTime;
-        this->setPosition(pos);
+    if (input.forward || input.back) {
+        this->setPosition(next.position);
     }
 
-    if (dirTable[2]) {
-        angleInRadians -= spd * deltaTime;
-    }
+    angleInRadians = next.angle;
 
-    if (dirTable[3]) {
-        angleInRadians += spd * deltaTime;
-    }
+    sfxManager.setPosition(this->getPosition());
 
-    if (wantFire) {
+    if (input.fire) {
         shoot(dir);
     }
 
-    if (std::any_of(std::begin(dirTable), std::end(dirTable), [](bool b){return b; })) {
-        sfxManager->playSound(SFXManager::Sounds::PlayerTreads);
+    if (input.forward || input.back || input.left || input.right) {
+        sfxManager.playSound(SFXManager::Sounds::PlayerTreads);
     }
     else {
-        sfxManager->stopSound(SFXManager::Sounds::PlayerTreads);
+        sfxManager.stopSound(SFXManager::Sounds::PlayerTreads);
     }
 
     shotAccumulator += deltaTime;
@@ -61,13 +52,16 @@ void PlayerTank::doUpdate(float deltaTime) {
  * @brief Game over on collision and plays some collision sounds.
  */
 void PlayerTank::doCollision(GameObject* other) {
-    sfxManager->playSound(SFXManager::Sounds::Collision);
-    sfxManager->playSound(SFXManager::Sounds::Explosion);
-    sfxManager->stopSound(SFXManager::Sounds::PlayerTreads);
+    sfxManager.playSound(SFXManager::Sounds::Collision);
+    sfxManager.playSound(SFXManager::Sounds::Explosion);
+    sfxManager.stopSound(SFXManager::Sounds::PlayerTreads);
     selfDestruct();
     //Show explosion
     //wait a second or two
-    Game::getInstance()->gameOver();
+    // The dedicated server has no Game, and respawns players itself
+    if (Game* game = Game::findInstance()) {
+        game->gameOver();
+    }
 }
 
 /**
@@ -90,7 +84,7 @@ void PlayerTank::shoot(glm::vec3 direction) {
     auto bullet = new Projectile(scene->getNextFreeEntityID(), bulletPos, bulletDir, GameObjectType::PlayerProjectile);
 
     scene->addObject(bullet);
-    sfxManager->playSound(SFXManager::Sounds::Firing);
+    sfxManager.playSound(SFXManager::Sounds::Firing);
 }
 
 /**
@@ -104,15 +98,17 @@ void PlayerTank::shoot(glm::vec3 direction) {
 PlayerTank::PlayerTank(uint32_t entityID, const vec3& position, const vec3& direction)
 : Tank(GameObjectType::PlayerTank, entityID, position, direction),
 shotAccumulator(0),
-shotThreshold(10),
-wantFire(false),
-sfxManager(new SFXManager())
+shotThreshold(10)
 {
-    for(auto& val : dirTable) {
-        val = false;
-    }
+    this->setSpeed(driveSpeed);
+}
+
+void PlayerTank::setInput(const TankInput& newInput) {
+    input = newInput;
+}
 
-    this->setSpeed(0.8);
+const TankInput& PlayerTank::getInput() const {
+    return input;
 }
 
 /**
@@ -126,22 +122,22 @@ bool PlayerTank::handleKeyEvent(QKeyEvent* event) {
         switch (event->key()) {
             case Qt::Key_W:
             case Qt::Key_Up:
-                dirTable[0] = true;
+                input.forward = true;
                 return true;
             case Qt::Key_S:
             case Qt::Key_Down:
-                dirTable[1] = true;
+                input.back = true;
                 return true;
             case Qt::Key_A:
             case Qt::Key_Left:
-                dirTable[2] = true;
+                input.left = true;
                 return true;
             case Qt::Key_D:
             case Qt::Key_Right:
-                dirTable[3] = true;
+                input.right = true;
                 return true;
             case Qt::Key_Space:
-                wantFire = true;
+                input.fire = true;
                 return true;
             default:
                 return false;
@@ -151,22 +147,22 @@ bool PlayerTank::handleKeyEvent(QKeyEvent* event) {
         switch (event->key()) {
             case Qt::Key_W:
             case Qt::Key_Up:
-                dirTable[0] = false;
+                input.forward = false;
                 return true;
             case Qt::Key_S:
             case Qt::Key_Down:
-                dirTable[1] = false;
+                input.back = false;
                 return true;
             case Qt::Key_A:
             case Qt::Key_Left:
-                dirTable[2] = false;
+                input.left = false;
                 return true;
             case Qt::Key_D:
             case Qt::Key_Right:
-                dirTable[3] = false;
+                input.right = false;
                 return true;
             case Qt::Key_Space:
-                wantFire = false;
+                input.fire = false;
                 return true;
             default:
                 return false;
@@ -6,6 +6,7 @@
 #include <QKeyEvent>
 #include "Tank.h"
 #include "sfxmanager.h"
+#include "tankmotion.h"
 
 class PlayerTank : public Tank {
 
@@ -19,12 +20,23 @@ public:
     void doUpdate(float deltaTime) override;
     void doCollision(GameObject* other) override;
     bool handleKeyEvent(QKeyEvent* event);
+
+    /**
+     * Replace what the tank is asked to do, for tanks driven by something other than the keyboard
+     * @param newInput The controls held down
+     */
+    void setInput(const TankInput& newInput);
+
+    /** @return the controls currently held down */
+    const TankInput& getInput() const;
+
+    // How fast every player's tank drives and turns
+    static const float constexpr driveSpeed = 0.8f;
 private:
-    bool dirTable[4];
-    bool wantFire;
+    TankInput input;
     float shotAccumulator;
     float shotThreshold;
-    SFXManager* sfxManager;
+    SFXManager sfxManager;
     void shoot(glm::vec3 direction) override;
 
 };
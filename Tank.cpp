@@ -3,7 +3,7 @@
 //
 
 #include "Tank.h"
-#include <glm/geometric.hpp>
+#include "tankmotion.h"
 
 const float COLLIDER_RADIUS = 0.5f;
 
@@ -17,11 +17,7 @@ angleInRadians(0.0)
 {
     this->collider = CircleCollider(COLLIDER_RADIUS); //Second arg is collider radius, set to something appropriate
 
-    // Make tanks actually spawn respecting direction vector
-    glm::vec3 xaxis(1, 0, 0);
-    float costheta = glm::dot(xaxis, direction);
-    float theta = acos(costheta);
-
-    angleInRadians = theta;
+    // Make tanks actually spawn respecting direction vector, on either side of the x axis
+    angleInRadians = TankMotion::headingOf(direction);
 }
 
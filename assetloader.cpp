@@ -0,0 +1,114 @@
+#include "assetloader.h"
+
+#include "profiler.h"
+#include "texture.h"
+
+#include <QRunnable>
+#include <QThread>
+
+#include <stdexcept>
+
+/** Adapts a std::function to the QRunnable the pool wants. The pool deletes it once it has run */
+class AssetJob : public QRunnable {
+    std::function<void()> work;
+public:
+    explicit AssetJob(std::function<void()> work) : work(std::move(work)) {}
+
+    void run() override { work(); }
+};
+
+AssetLoader::AssetLoader() {
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+AssetLoader::~AssetLoader() {
+    pool.waitForDone();
+}
+
+void AssetLoader::submit(std::function<Result()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++;
+    }
+
+    pool.start(new AssetJob([this, job = std::move(job)] {
+        Result result;
+
+        // Anything thrown on a worker is handed back to the GL thread to rethrow there
+        try {
+            result = job();
+        }
+        catch (std::exception& ex) {
+            result.error = ex.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.push_back(std::move(result));
+        }
+
+        ready.notify_one();
+    }));
+}
+
+void AssetLoader::loadMesh(const std::string& name, const std::filesystem::path& path, uint32_t levels) {
+    submit([name, path, levels] {
+        Profiler::Scope scope("load mesh " + name, "startup");
+
+        Result result;
+        result.kind = Result::Kind::Mesh;
+        result.name = name;
+        result.meshes = MeshCache::openLevels(path, levels);
+        return result;
+    });
+}
+
+void AssetLoader::loadTexture(const std::string& name, const std::filesystem::path& path) {
+    submit([name, path] {
+        Profiler::Scope scope("decode texture " + name, "startup");
+
+        Result result;
+        result.kind = Result::Kind::Texture;
+        result.name = name;
+        result.image = Texture::decodeImage(path);
+        return result;
+    });
+}
+
+void AssetLoader::loadCubemapFace(const std::string& name, int face, const std::filesystem::path& path, bool flipHorizontal, bool flipVertical) {
+    submit([name, face, path, flipHorizontal, flipVertical] {
+        Profiler::Scope scope("decode cubemap face " + name + "/" + path.stem().string(), "startup");
+
+        Result result;
+        result.kind = Result::Kind::CubemapFace;
+        result.name = name;
+        result.face = face;
+        result.image = Texture::decodeImage(path, flipHorizontal, flipVertical);
+        return result;
+    });
+}
+
+bool AssetLoader::hasPending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending > 0;
+}
+
+AssetLoader::Result AssetLoader::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (pending == 0) {
+        throw std::logic_error("AssetLoader: next() called with nothing pending");
+    }
+
+    ready.wait(lock, [this] { return !completed.empty(); });
+
+    Result result = std::move(completed.front());
+    completed.pop_front();
+    pending--;
+
+    return result;
+}
+
+int AssetLoader::threadCount() const {
+    return pool.maxThreadCount();
+}
@@ -0,0 +1,119 @@
+#ifndef TANKS_ASSETLOADER_H
+#define TANKS_ASSETLOADER_H
+
+#include <QImage>
+#include <QThreadPool>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "meshcache.h"
+
+/**
+ * Does the CPU side of asset loading (reading files, decoding images, converting them into GL's
+ * format, importing or mapping meshes) on a pool of worker threads. Finished work lands in a
+ * completion queue, which the thread owning the GL context drains with next(), doing only the
+ * GPU uploads itself.
+ *
+ * Typical use:
+ *
+ *  AssetLoader loader;
+ *  loader.loadMesh("tank", "assets/models/tank.obj");
+ *  while (loader.hasPending()) {
+ *      auto result = loader.next();
+ *      ... upload result ...
+ *  }
+ */
+class AssetLoader {
+public:
+    /** A finished piece of loading work */
+    struct Result {
+        enum class Kind {
+            Mesh,
+            Texture,
+            CubemapFace
+        };
+
+        Kind kind = Kind::Mesh;
+        // The name the renderer stores the asset under
+        std::string name;
+        // For cubemap faces, which face (in GL order) this is
+        int face = 0;
+        // Filled for meshes, with each level of detail loaded, from full detail down
+        std::vector<std::unique_ptr<MeshCache::Entry>> meshes;
+        // Filled for textures and cubemap faces, already converted for upload
+        QImage image;
+        // If not empty, loading failed and this is why
+        std::string error;
+    };
+
+    AssetLoader();
+
+    /** Waits for any work still running, so workers never outlive the queue they write to */
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader& other) = delete;
+    AssetLoader& operator=(const AssetLoader& other) = delete;
+
+    /**
+     * Queue a mesh to load through the MeshCache, as one job for all its levels of detail, so a model
+     * that isn't cached yet is only imported once
+     * @param name The name to store it under
+     * @param path The model file
+     * @param levels How many levels of detail to load, from full detail down
+     */
+    void loadMesh(const std::string& name, const std::filesystem::path& path, uint32_t levels = 1);
+
+    /**
+     * Queue an image to decode as a regular texture
+     * @param name The name to store it under
+     * @param path The image file
+     */
+    void loadTexture(const std::string& name, const std::filesystem::path& path);
+
+    /**
+     * Queue one face of a cubemap to decode
+     * @param name The name of the cubemap
+     * @param face The index of the face, in GL order
+     * @param path The image file
+     * @param flipHorizontal Whether to mirror it left to right
+     * @param flipVertical Whether to mirror it top to bottom
+     */
+    void loadCubemapFace(const std::string& name, int face, const std::filesystem::path& path, bool flipHorizontal, bool flipVertical);
+
+    /** @return whether there is work queued, running, or waiting to be collected */
+    bool hasPending() const;
+
+    /**
+     * Wait for the next piece of work to finish, and take it
+     * @return the finished work
+     * @throws std::logic_error if nothing is pending
+     */
+    Result next();
+
+    /** @return how many worker threads the loader uses */
+    int threadCount() const;
+
+private:
+    /**
+     * Run a job on the pool, and queue its result
+     * @param job The work to do
+     */
+    void submit(std::function<Result()> job);
+
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Result> completed;
+    size_t pending = 0;
+
+    // Declared last, so it is destroyed (which waits for its threads) before the queue above
+    QThreadPool pool;
+};
+
+#endif //TANKS_ASSETLOADER_H
@@ -0,0 +1,167 @@
+#include "audiobank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// The format tags a wav file's fmt chunk can have that are supported
+static const uint16_t WAVE_FORMAT_PCM = 1;
+static const uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+static const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+/** @return the little endian 16 bit value at a pointer */
+static uint16_t readU16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/** @return the little endian 32 bit value at a pointer */
+static uint32_t readU32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Read one sample from a wav's data chunk, as a float from -1 to 1
+ * @param p The sample
+ * @param bits How many bits it has
+ * @param isFloat Whether it's a float rather than an integer
+ * @return its value
+ */
+static float readSample(const unsigned char* p, int bits, bool isFloat) {
+    if (isFloat) {
+        float value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    switch (bits) {
+        case 8: return ((int)p[0] - 128) / 128.0f; // 8 bit wav samples alone are unsigned
+        case 16: return (int16_t)readU16(p) / 32768.0f;
+        case 24: return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.0f;
+        default: return (int32_t)readU32(p) / 2147483648.0f;
+    }
+}
+
+AudioSample AudioBank::decodeWav(const std::filesystem::path& path, int sampleRate) {
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path.string());
+    }
+
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < 12 || std::memcmp(data.data(), "RIFF", 4) != 0 || std::memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        throw std::runtime_error(path.string() + " is not a wav file");
+    }
+
+    uint16_t format = 0;
+    int channels = 0;
+    int rate = 0;
+    int bits = 0;
+    const unsigned char* samples = nullptr;
+    size_t sampleBytes = 0;
+
+    // Walk the chunks for the format and the data. Anything else (lists, cue points) is skipped
+    size_t offset = 12;
+
+    while (offset + 8 <= data.size()) {
+        const unsigned char* chunk = data.data() + offset;
+        size_t size = readU32(chunk + 4);
+        size_t available = std::min(size, data.size() - offset - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = readU16(chunk + 8);
+            channels = readU16(chunk + 10);
+            rate = (int)readU32(chunk + 12);
+            bits = readU16(chunk + 22);
+
+            // The real format of an extensible file is the first two bytes of its sub format GUID
+            if (format == WAVE_FORMAT_EXTENSIBLE && available >= 26) {
+                format = readU16(chunk + 32);
+            }
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0) {
+            samples = chunk + 8;
+            sampleBytes = available;
+        }
+
+        // Chunks are padded to an even length
+        offset += 8 + size + (size & 1);
+    }
+
+    bool isFloat = format == WAVE_FORMAT_IEEE_FLOAT;
+
+    if ((format != WAVE_FORMAT_PCM && !isFloat) || (isFloat && bits != 32) ||
+        (!isFloat && bits != 8 && bits != 16 && bits != 24 && bits != 32)) {
+        throw std::runtime_error(path.string() + " isn't in a supported format (PCM or 32 bit float)");
+    }
+
+    if (channels < 1 || rate < 1 || !samples) {
+        throw std::runtime_error(path.string() + " has no format or no data");
+    }
+
+    size_t frameBytes = (size_t)channels * (bits / 8);
+    size_t sourceFrames = sampleBytes / frameBytes;
+
+    // Mono plays in both ears. Beyond stereo, only the front left and right are kept
+    auto readFrame = [&](size_t frame, int channel) {
+        return readSample(samples + frame * frameBytes + (size_t)std::min(channel, channels - 1) * (bits / 8), bits, isFloat);
+    };
+
+    AudioSample sample;
+    sample.name = path.stem().string();
+
+    // Linear interpolation is plenty for short effects, which in practice are already at the right rate
+    double step = (double)rate / sampleRate;
+    size_t frames = sourceFrames == 0 ? 0 : (size_t)std::ceil(sourceFrames / step);
+    sample.pcm.resize(frames * 2);
+
+    for(size_t i = 0; i < frames; i++) {
+        double position = i * step;
+        size_t a = std::min((size_t)position, sourceFrames - 1);
+        size_t b = std::min(a + 1, sourceFrames - 1);
+        float t = (float)(position - a);
+
+        for(int channel = 0; channel < 2; channel++) {
+            float value = readFrame(a, channel) * (1.0f - t) + readFrame(b, channel) * t;
+            sample.pcm[i * 2 + channel] = (int16_t)std::clamp(std::lround(value * 32767.0f), -32768L, 32767L);
+        }
+    }
+
+    return sample;
+}
+
+AudioBank AudioBank::load(const std::filesystem::path& folder, int sampleRate) {
+    AudioBank bank;
+
+    if (!std::filesystem::is_directory(folder)) {
+        std::cerr << "AudioBank: No " << folder << " directory, so there are no sounds\n";
+        return bank;
+    }
+
+    for(const auto& entry : std::filesystem::directory_iterator(folder)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+            try {
+                bank.samples.push_back(decodeWav(entry.path(), sampleRate));
+            }
+            catch (std::exception& ex) {
+                std::cerr << "AudioBank: " << ex.what() << "\n";
+            }
+        }
+    }
+
+    return bank;
+}
+
+AudioBank::SampleId AudioBank::find(const std::string& name) const {
+    for(size_t i = 0; i < samples.size(); i++) {
+        if (samples[i].name == name) {
+            return (SampleId)i;
+        }
+    }
+
+    return invalidSample;
+}
@@ -0,0 +1,67 @@
+#ifndef TANKS_AUDIOBANK_H
+#define TANKS_AUDIOBANK_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/** One decoded sound, ready to mix: interleaved stereo 16 bit PCM at the mixer's sample rate */
+struct AudioSample {
+    std::string name;
+    std::vector<int16_t> pcm;
+
+    /** @return how many stereo frames long the sample is */
+    size_t frameCount() const { return pcm.size() / 2; }
+};
+
+/**
+ * Every sound effect, decoded once at startup and shared by everything that plays them. However
+ * many tanks there are, each sound exists in memory exactly once.
+ *
+ * Samples are converted to the mixer's format as they're loaded (stereo, 16 bit, at its sample
+ * rate), so mixing is only ever adding samples together.
+ */
+class AudioBank {
+public:
+    /** The index of a sample in the bank */
+    using SampleId = int;
+    static const SampleId constexpr invalidSample = -1;
+
+    /**
+     * Decode every .wav file in a folder. Files that can't be decoded are warned about and skipped
+     * @param folder The folder, e.g. assets/sfx
+     * @param sampleRate The mixer's sample rate, which every sample is resampled to
+     * @return the bank
+     */
+    static AudioBank load(const std::filesystem::path& folder, int sampleRate);
+
+    /**
+     * Decode a PCM .wav file (8, 16, 24 or 32 bit integer, or 32 bit float, of any channel count)
+     * @param path The file
+     * @param sampleRate The rate to resample it to
+     * @return the sample, named after the file's stem
+     * @throws std::runtime_error if the file can't be read or isn't a format that's supported
+     */
+    static AudioSample decodeWav(const std::filesystem::path& path, int sampleRate);
+
+    /**
+     * @param name A sample's name, which is its file's name without the extension, e.g. "tankFire"
+     * @return its id, or invalidSample if there's no such sample
+     */
+    SampleId find(const std::string& name) const;
+
+    /**
+     * @param id The sample's id, which must be valid
+     * @return the sample
+     */
+    const AudioSample& get(SampleId id) const { return samples[id]; }
+
+    /** @return how many samples there are */
+    size_t size() const { return samples.size(); }
+
+private:
+    std::vector<AudioSample> samples;
+};
+
+#endif //TANKS_AUDIOBANK_H
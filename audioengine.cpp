@@ -0,0 +1,418 @@
+#include "audioengine.h"
+
+#include <QCoreApplication>
+#include <QIODevice>
+#include <QThread>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QAudioSink>
+#include <QMediaDevices>
+using AudioDevice = QAudioDevice;
+using AudioSink = QAudioSink;
+#else
+#include <QAudioOutput>
+#include <QAudioDeviceInfo>
+using AudioDevice = QAudioDeviceInfo;
+using AudioSink = QAudioOutput;
+#endif
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+static const char* SFX_FOLDER = "assets/sfx";
+
+/**
+ * The device the audio output pulls from. Each read mixes exactly as much as was asked for, so the
+ * output's own buffer is the only latency
+ */
+class MixerDevice : public QIODevice {
+    AudioEngine& engine;
+public:
+    explicit MixerDevice(AudioEngine& engine) : engine(engine) {}
+
+    bool isSequential() const override { return true; }
+
+    // The mix never runs out
+    qint64 bytesAvailable() const override { return std::numeric_limits<int>::max() + QIODevice::bytesAvailable(); }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override {
+        size_t frames = (size_t)maxSize / (sizeof(int16_t) * AudioEngine::channels);
+        engine.render(reinterpret_cast<int16_t*>(data), frames);
+        return (qint64)(frames * sizeof(int16_t) * AudioEngine::channels);
+    }
+
+    qint64 writeData(const char* data, qint64 maxSize) override { return -1; }
+};
+
+/**
+ * The audio thread. Qt's audio output pulls from its device on the thread it was created on, so the
+ * output is created in here, and this thread's event loop is what runs the mixer
+ */
+class AudioThread : public QThread {
+    AudioEngine& engine;
+    AudioDevice device;
+    QAudioFormat format;
+    int bufferBytes;
+public:
+    AudioThread(AudioEngine& engine, AudioDevice device, QAudioFormat format, int bufferBytes) :
+        engine(engine), device(std::move(device)), format(std::move(format)), bufferBytes(bufferBytes) {}
+
+protected:
+    void run() override {
+        MixerDevice mixer(engine);
+        mixer.open(QIODevice::ReadOnly);
+
+        AudioSink sink(device, format);
+        sink.setBufferSize(bufferBytes);
+        sink.start(&mixer);
+
+        exec();
+
+        sink.stop();
+    }
+};
+
+struct AudioEngine::Output {
+    AudioThread thread;
+
+    Output(AudioEngine& engine, AudioDevice device, QAudioFormat format, int bufferBytes) :
+        thread(engine, std::move(device), std::move(format), bufferBytes) {}
+
+    ~Output() {
+        thread.quit();
+        thread.wait();
+    }
+};
+
+bool AudioEngine::outputDisabled = false;
+
+void AudioEngine::disableOutput() {
+    outputDisabled = true;
+}
+
+AudioEngine* AudioEngine::getInstance() {
+    // Never deleted. The Qt output is closed when the application quits, and the rest can go with the process
+    static AudioEngine* instance = new AudioEngine();
+    return instance;
+}
+
+// With output disabled nothing will ever be mixed, so the bank stays empty rather than decoding every sound
+AudioEngine::AudioEngine() : bank(outputDisabled ? AudioBank() : AudioBank::load(SFX_FOLDER, sampleRate)) {
+    // Room for a busy battle's sounds, so neither thread allocates while it plays
+    playing.reserve(AudioMixer::defaultVoiceCount * 4);
+    unsentEnded.reserve(AudioMixer::defaultVoiceCount * 4);
+    tickPlays.reserve(AudioMixer::defaultVoiceCount);
+
+    openOutput();
+}
+
+AudioEngine::~AudioEngine() = default;
+
+void AudioEngine::openOutput() {
+    QCoreApplication* app = QCoreApplication::instance();
+
+    if (!app || outputDisabled) {
+        return;
+    }
+
+    QAudioFormat format;
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(channels);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    format.setSampleFormat(QAudioFormat::Int16);
+    AudioDevice device = QMediaDevices::defaultAudioOutput();
+#else
+    format.setSampleSize(16);
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setCodec("audio/pcm");
+    AudioDevice device = QAudioDeviceInfo::defaultOutputDevice();
+#endif
+
+    if (device.isNull() || !device.isFormatSupported(format)) {
+        std::cerr << "AudioEngine: No audio output that plays 16 bit stereo at " << sampleRate << " Hz, sounds are muted\n";
+        return;
+    }
+
+    int bufferBytes = sampleRate * channels * (int)sizeof(int16_t) * bufferMilliseconds / 1000;
+    output = std::make_unique<Output>(*this, device, format, bufferBytes);
+
+    // Mixing late means a click, so the audio thread goes ahead of everything else
+    output->thread.start(QThread::TimeCriticalPriority);
+    running = true;
+
+    // Qt's audio objects have to go before the application does
+    QObject::connect(app, &QCoreApplication::aboutToQuit, [this] {
+        running = false;
+        output.reset();
+    });
+}
+
+AudioBank::SampleId AudioEngine::findSample(const std::string& name) const {
+    return bank.find(name);
+}
+
+AudioMixer::VoiceId AudioEngine::play(AudioBank::SampleId sample, float gain, bool loop, int priority, const glm::vec3& position) {
+    if (!running || sample < 0 || (size_t)sample >= bank.size()) {
+        return AudioMixer::invalidVoice;
+    }
+
+    // The same sound from nearly the same place this tick would only be heard as one louder sound,
+    // so it's played once, as loud as the loudest
+    if (!loop) {
+        for(TickPlay& earlier : tickPlays) {
+            if (earlier.sample == sample && glm::distance(earlier.position, position) < mergeDistance) {
+                if (gain > earlier.gain) {
+                    earlier.gain = gain;
+                    setGain(earlier.voice, gain);
+                }
+
+                return earlier.voice;
+            }
+        }
+    }
+
+    // Ids are never reused, and 0 means no voice
+    AudioMixer::VoiceId voice = nextVoice++;
+    if (nextVoice == AudioMixer::invalidVoice) { nextVoice++; }
+
+    if (!send({Command::Type::Play, loop, sample, voice, gain, priority, position, glm::vec3(0.0f)})) {
+        return AudioMixer::invalidVoice;
+    }
+
+    playing.push_back(voice);
+
+    if (!loop) {
+        tickPlays.push_back({sample, voice, gain, position});
+    }
+
+    return voice;
+}
+
+void AudioEngine::stop(AudioMixer::VoiceId voice) {
+    auto it = std::find(playing.begin(), playing.end(), voice);
+
+    if (it == playing.end()) {
+        return;
+    }
+
+    *it = playing.back();
+    playing.pop_back();
+
+    send({Command::Type::Stop, false, AudioBank::invalidSample, voice, 0.0f, 0, glm::vec3(0.0f), glm::vec3(0.0f)});
+}
+
+void AudioEngine::setGain(AudioMixer::VoiceId voice, float gain) {
+    if (voice != AudioMixer::invalidVoice) {
+        send({Command::Type::SetGain, false, AudioBank::invalidSample, voice, gain, 0, glm::vec3(0.0f), glm::vec3(0.0f)});
+    }
+}
+
+void AudioEngine::setPosition(AudioMixer::VoiceId voice, const glm::vec3& position) {
+    if (voice != AudioMixer::invalidVoice) {
+        send({Command::Type::SetPosition, false, AudioBank::invalidSample, voice, 0.0f, 0, position, glm::vec3(0.0f)});
+    }
+}
+
+void AudioEngine::setListener(const glm::vec3& position, const glm::vec3& forward) {
+    listenerPosition = position;
+
+    if (running) {
+        send({Command::Type::SetListener, false, AudioBank::invalidSample, AudioMixer::invalidVoice, 0.0f, 0, position, forward});
+    }
+}
+
+bool AudioEngine::isPlaying(AudioMixer::VoiceId voice) {
+    if (voice == AudioMixer::invalidVoice) {
+        return false;
+    }
+
+    collectEnded();
+    return std::find(playing.begin(), playing.end(), voice) != playing.end();
+}
+
+AudioEngine::EmitterId AudioEngine::startEmitter(AudioBank::SampleId sample, float gain, int priority, const glm::vec3& position) {
+    if (sample < 0 || (size_t)sample >= bank.size()) {
+        return invalidEmitter;
+    }
+
+    auto group = std::find_if(emitterGroups.begin(), emitterGroups.end(), [sample](const EmitterGroup& g) {
+        return g.sample == sample;
+    });
+
+    if (group == emitterGroups.end()) {
+        EmitterGroup newGroup;
+        newGroup.sample = sample;
+        newGroup.priority = priority;
+        emitterGroups.push_back(newGroup);
+    }
+
+    EmitterId id;
+
+    if (!freeEmitters.empty()) {
+        id = freeEmitters.back();
+        freeEmitters.pop_back();
+    }
+    else {
+        emitters.emplace_back();
+        id = (EmitterId)emitters.size();
+    }
+
+    emitters[id - 1] = {sample, gain, position};
+    return id;
+}
+
+void AudioEngine::moveEmitter(AudioEngine::EmitterId emitter, const glm::vec3& position) {
+    if (emitter != invalidEmitter) {
+        emitters[emitter - 1].position = position;
+    }
+}
+
+void AudioEngine::stopEmitter(AudioEngine::EmitterId emitter) {
+    if (emitter != invalidEmitter && emitters[emitter - 1].sample != AudioBank::invalidSample) {
+        emitters[emitter - 1].sample = AudioBank::invalidSample;
+        freeEmitters.push_back(emitter);
+    }
+}
+
+void AudioEngine::update() {
+    tickPlays.clear();
+    collectEnded();
+
+    for(EmitterGroup& group : emitterGroups) {
+        group.count = 0;
+        group.power = 0.0f;
+        group.weightedPosition = glm::vec3(0.0f);
+    }
+
+    // Uncorrelated copies of a sound add up by their power, the square of their amplitude. Weighting
+    // the position by it too puts the group's voice nearest the emitters that are loudest
+    for(const Emitter& emitter : emitters) {
+        if (emitter.sample == AudioBank::invalidSample) {
+            continue;
+        }
+
+        for(EmitterGroup& group : emitterGroups) {
+            if (group.sample == emitter.sample) {
+                float amplitude = emitter.gain * AudioMixer::attenuation(emitter.position, listenerPosition);
+
+                group.count++;
+                group.power += amplitude * amplitude;
+                group.weightedPosition += emitter.position * amplitude * amplitude;
+                break;
+            }
+        }
+    }
+
+    for(EmitterGroup& group : emitterGroups) {
+        if (group.count == 0) {
+            stop(group.voice);
+            group.voice = AudioMixer::invalidVoice;
+            continue;
+        }
+
+        // Every emitter out of earshot. Keep the voice, silently, for when they come back
+        glm::vec3 position = group.sentPosition;
+        float gain = 0.0f;
+
+        if (group.power > 0.0f) {
+            // The voice is attenuated again by the mixer from where it's put, so divide that back out.
+            // The average is inside the emitters' hull, so it's never further than the furthest of them
+            position = group.weightedPosition / group.power;
+            float loudness = std::min(std::sqrt(group.power), maxEmitterLoudness);
+            gain = std::min(loudness / std::max(AudioMixer::attenuation(position, listenerPosition), 0.0001f), maxEmitterGain);
+        }
+
+        if (!isPlaying(group.voice)) {
+            group.voice = play(group.sample, gain, true, group.priority, position);
+            group.sentGain = gain;
+            group.sentPosition = position;
+            continue;
+        }
+
+        if (std::abs(gain - group.sentGain) > emitterGainTolerance) {
+            setGain(group.voice, gain);
+            group.sentGain = gain;
+        }
+
+        if (glm::distance(position, group.sentPosition) > emitterPositionTolerance) {
+            setPosition(group.voice, position);
+            group.sentPosition = position;
+        }
+    }
+}
+
+bool AudioEngine::send(const AudioEngine::Command& command) {
+    // Anything held back from before goes first, to keep the order
+    while (!unsentCommands.empty() && commands.push(unsentCommands.front())) {
+        unsentCommands.erase(unsentCommands.begin());
+    }
+
+    if (unsentCommands.empty() && commands.push(command)) {
+        return true;
+    }
+
+    // A lost stop would leave a loop playing forever, so those wait, and so do moves, which are small.
+    // A lost play is just a missed sound
+    if (command.type != Command::Type::Play && running) {
+        unsentCommands.push_back(command);
+    }
+
+    return false;
+}
+
+void AudioEngine::collectEnded() {
+    AudioMixer::VoiceId voice;
+
+    while (endedVoices.pop(voice)) {
+        auto it = std::find(playing.begin(), playing.end(), voice);
+
+        if (it != playing.end()) {
+            *it = playing.back();
+            playing.pop_back();
+        }
+    }
+}
+
+void AudioEngine::render(int16_t* out, size_t frames) {
+    Command command;
+
+    while (commands.pop(command)) {
+        switch (command.type) {
+            case Command::Type::Play:
+                mixer.play(command.voice, bank.get(command.sample), command.gain, command.loop, command.priority, command.position);
+                break;
+            case Command::Type::Stop:
+                mixer.stop(command.voice);
+                break;
+            case Command::Type::SetGain:
+                mixer.setGain(command.voice, command.gain);
+                break;
+            case Command::Type::SetPosition:
+                mixer.setPosition(command.voice, command.position);
+                break;
+            case Command::Type::SetListener:
+                mixer.setListener(command.position, command.forward);
+                break;
+        }
+    }
+
+    mixer.mix(out, frames);
+
+    // Tell the game which sounds have ended. Whatever doesn't fit goes next time
+    unsentEnded.insert(unsentEnded.end(), mixer.getEnded().begin(), mixer.getEnded().end());
+    mixer.clearEnded();
+
+    size_t sent = 0;
+    while (sent < unsentEnded.size() && endedVoices.push(unsentEnded[sent])) {
+        sent++;
+    }
+
+    unsentEnded.erase(unsentEnded.begin(), unsentEnded.begin() + sent);
+}
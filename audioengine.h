@@ -0,0 +1,272 @@
+#ifndef TANKS_AUDIOENGINE_H
+#define TANKS_AUDIOENGINE_H
+
+#include "audiobank.h"
+#include "audiomixer.h"
+#include "spscqueue.h"
+
+#include <glm/vec3.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * The game's one audio engine. It decodes every sound in assets/sfx into an AudioBank the first
+ * time it's used, and plays them through an AudioMixer's voice pool, into a single Qt audio output.
+ * Everything that makes a sound (through an SFXManager) shares it, so a sound costs the same to
+ * load whether one tank uses it or two hundred.
+ *
+ * The mixer and the audio output run on a thread of their own. The game never waits on it: play,
+ * stop and setGain only push a small Command onto a lock-free queue, which the audio thread applies
+ * before mixing each block. Commands carry the sound's position, which the mixer uses to attenuate,
+ * pan and cull it (see AudioMixer). Voice ids are handed out by play straight away, and the audio
+ * thread sends back the ids of sounds that end by themselves on a second queue, which is how
+ * isPlaying answers without asking it. So a sound starts, and isPlaying notices it has finished, up
+ * to one output buffer late.
+ *
+ * Two things keep the cost the same however many tanks there are:
+ *
+ * - Emitters: identical loops from many objects (every enemy's treads) are one voice. Each object
+ *   starts, moves and stops an emitter, which only changes numbers on the game thread. Once a tick,
+ *   update works out each sample's emitters' combined loudness and where they are on average
+ *   (weighted towards the nearest), and moves that one voice to match.
+ * - One-shots of the same sound started close together in the same tick (several collisions at
+ *   once) are played once, as the loudest of them.
+ *
+ * If there's no audio device, or no QCoreApplication (as in the command line tools), nothing plays
+ * and play returns AudioMixer::invalidVoice.
+ *
+ * This is a singleton, like the Scene. It's created on first use, which must be on the GUI thread,
+ * and lives until the process exits. Everything but render must be called from the same thread, the
+ * one running the game.
+ */
+class AudioEngine {
+public:
+    /** Get the instance of the AudioEngine, creating it if needed */
+    static AudioEngine* getInstance();
+
+    /**
+     * Never open an audio output or decode the sounds, for a process nobody listens to, like the dedicated
+     * server. Sounds are still accepted, and silently dropped. Call before the engine is first used
+     */
+    static void disableOutput();
+
+    /**
+     * @param name A sound's file name, without the extension, e.g. "tankFire"
+     * @return its id, or AudioBank::invalidSample if there's no such sound
+     */
+    AudioBank::SampleId findSample(const std::string& name) const;
+
+    /**
+     * Start a sound
+     * @param sample The sound, from findSample
+     * @param gain Its volume, 1 being as loud as it was recorded
+     * @param loop Whether to play it until it's stopped, rather than once
+     * @param priority How important it is when there are more sounds than voices. Higher is more important
+     * @param position Where it is in the world
+     * @return the voice playing it, or AudioMixer::invalidVoice if it couldn't be played
+     */
+    AudioMixer::VoiceId play(AudioBank::SampleId sample, float gain, bool loop, int priority, const glm::vec3& position);
+
+    /**
+     * Stop a sound. Does nothing if it has already finished
+     * @param voice The voice playing it
+     */
+    void stop(AudioMixer::VoiceId voice);
+
+    /**
+     * @param voice A voice returned by play
+     * @return whether it's still playing
+     */
+    bool isPlaying(AudioMixer::VoiceId voice);
+
+    /**
+     * Change a sound's volume
+     * @param voice The voice playing it
+     * @param gain Its new volume
+     */
+    void setGain(AudioMixer::VoiceId voice, float gain);
+
+    /**
+     * Move a sound
+     * @param voice The voice playing it
+     * @param position Where it is now
+     */
+    void setPosition(AudioMixer::VoiceId voice, const glm::vec3& position);
+
+    /**
+     * Set where sounds are heard from. The game sets this to the player tank every tick
+     * @param position The listener's position
+     * @param forward Which way they're facing
+     */
+    void setListener(const glm::vec3& position, const glm::vec3& forward);
+
+    /** An emitter, an index into emitters plus one. Reused once stopped */
+    using EmitterId = uint32_t;
+    static const EmitterId constexpr invalidEmitter = 0;
+
+    /**
+     * Start a looping emitter. All the emitters of a sample share one voice, set up by update
+     * @param sample The sound to loop
+     * @param gain The volume of one emitter, 1 being as loud as it was recorded
+     * @param priority How important the shared voice is. The first emitter of a sample sets it
+     * @param position Where the emitter is
+     * @return the emitter, or invalidEmitter if there's no such sample
+     */
+    EmitterId startEmitter(AudioBank::SampleId sample, float gain, int priority, const glm::vec3& position);
+
+    /**
+     * Move an emitter. This costs nothing until the next update
+     * @param emitter The emitter
+     * @param position Where it is now
+     */
+    void moveEmitter(EmitterId emitter, const glm::vec3& position);
+
+    /**
+     * Stop an emitter. Its id may be handed out again afterwards, so forget it
+     * @param emitter The emitter
+     */
+    void stopEmitter(EmitterId emitter);
+
+    /**
+     * Bring the emitters' voices up to date, and start a new tick for merging one-shots. Call once a
+     * tick, after the objects have updated
+     */
+    void update();
+
+    /**
+     * Apply the queued commands, and mix the next frames of audio. Called on the audio thread by
+     * the audio output whenever it needs more
+     * @param out Where to write them, as interleaved stereo 16 bit samples
+     * @param frames How many frames to write
+     */
+    void render(int16_t* out, size_t frames);
+
+    // The format everything is mixed in, and sent to the device in
+    static const int constexpr sampleRate = 44100;
+    static const int constexpr channels = 2;
+
+private:
+    AudioEngine();
+    ~AudioEngine();
+
+    /** What the game asks the audio thread to do */
+    struct Command {
+        enum class Type : uint8_t {
+            Play,
+            Stop,
+            SetGain,
+            SetPosition,
+            SetListener,
+        };
+
+        Type type;
+        bool loop;
+        AudioBank::SampleId sample;
+        AudioMixer::VoiceId voice;
+        float gain;
+        int priority;
+        glm::vec3 position;
+        // Only for SetListener, which way the listener faces
+        glm::vec3 forward;
+    };
+
+    /** Open the default audio device and start the audio thread, if there is one */
+    void openOutput();
+
+    /**
+     * Queue a command for the audio thread
+     * @param command The command
+     * @return false if the queue is full. Stops and volume changes are kept and sent later instead
+     */
+    bool send(const Command& command);
+
+    /** Forget the sounds the audio thread says have ended */
+    void collectEnded();
+
+    /** An object's share of a looping sound */
+    struct Emitter {
+        AudioBank::SampleId sample = AudioBank::invalidSample;
+        float gain = 0.0f;
+        glm::vec3 position = glm::vec3(0.0f);
+    };
+
+    /** The emitters of one sample, and the one voice they all play through */
+    struct EmitterGroup {
+        AudioBank::SampleId sample;
+        int priority;
+        AudioMixer::VoiceId voice = AudioMixer::invalidVoice;
+        // Worked out by update
+        size_t count = 0;
+        float power = 0.0f;
+        glm::vec3 weightedPosition = glm::vec3(0.0f);
+        // What the voice was last sent, to only send changes
+        float sentGain = 0.0f;
+        glm::vec3 sentPosition = glm::vec3(0.0f);
+    };
+
+    /** A one-shot started this tick, for merging the ones after it */
+    struct TickPlay {
+        AudioBank::SampleId sample;
+        AudioMixer::VoiceId voice;
+        float gain;
+        glm::vec3 position;
+    };
+
+    // Never changes once loaded, so both threads read it freely
+    AudioBank bank;
+
+    // Game thread to audio thread, and back
+    SpscQueue<Command, 1024> commands;
+    SpscQueue<AudioMixer::VoiceId, 1024> endedVoices;
+
+    // Only touched by the audio thread. The ends that didn't fit in endedVoices wait here for room
+    AudioMixer mixer;
+    std::vector<AudioMixer::VoiceId> unsentEnded;
+
+    // Only touched by the game thread: the sounds it thinks are playing, the commands that didn't
+    // fit in the queue, and the next id to hand out
+    std::vector<AudioMixer::VoiceId> playing;
+    std::vector<Command> unsentCommands;
+    AudioMixer::VoiceId nextVoice = 1;
+
+    // Also only for the game thread: where the listener is, every emitter (with the stopped ones'
+    // indices in freeEmitters), their groups, and this tick's one-shots
+    glm::vec3 listenerPosition = glm::vec3(0.0f);
+    std::vector<Emitter> emitters;
+    std::vector<EmitterId> freeEmitters;
+    std::vector<EmitterGroup> emitterGroups;
+    std::vector<TickPlay> tickPlays;
+
+    // Whether the audio thread is running, so there's anyone to send commands to
+    std::atomic<bool> running{false};
+
+    // Set by disableOutput
+    static bool outputDisabled;
+
+    // The Qt audio output, which differs between Qt 5 and 6, so it's only defined in the .cpp
+    struct Output;
+    std::unique_ptr<Output> output;
+
+    // How much audio the device buffers, in milliseconds. Sounds start at most this late
+    static const int constexpr bufferMilliseconds = 50;
+
+    // How much louder a crowd of emitters can get than one of them on its own. Uncorrelated loops add
+    // up as the square root of their count, so this is reached at about six close by
+    static const float constexpr maxEmitterLoudness = 2.5f;
+
+    // The most an emitter group's voice is turned up to make up for the mixer attenuating it. Only a
+    // group whose loudest emitters are all far away gets near it, and those are quiet anyway
+    static const float constexpr maxEmitterGain = 8.0f;
+
+    // How much an emitter group's voice has to change before it's sent, to keep the queue quiet
+    static const float constexpr emitterGainTolerance = 0.02f;
+    static const float constexpr emitterPositionTolerance = 0.25f;
+
+    // One-shots of the same sound in the same tick are merged if they're closer together than this
+    static const float constexpr mergeDistance = 2.0f;
+};
+
+#endif //TANKS_AUDIOENGINE_H
@@ -0,0 +1,257 @@
+#include "audiomixer.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+AudioMixer::AudioMixer(size_t voiceCount) : voices(std::max<size_t>(voiceCount, 1)) {
+    ended.reserve(voices.size() * 4);
+    audible.reserve(voices.size());
+}
+
+bool AudioMixer::play(AudioMixer::VoiceId id, const AudioSample& sample, float gain, bool loop, int priority, const glm::vec3& position) {
+    // A one-shot that can't be heard would only take a voice until it finished silently
+    bool inEarshot = loop || attenuation(position, listenerPosition) > 0.0f;
+    int index = sample.frameCount() == 0 || !inEarshot ? -1 : pickVoice(priority);
+
+    if (index < 0) {
+        ended.push_back(id);
+        return false;
+    }
+
+    Voice& voice = voices[index];
+
+    // Stolen
+    if (voice.id != invalidVoice) {
+        ended.push_back(voice.id);
+    }
+
+    voice.sample = &sample;
+    voice.frame = 0;
+    voice.gain = gain;
+    voice.loop = loop;
+    voice.priority = priority;
+    voice.position = position;
+    voice.mixed = false;
+    voice.id = id;
+
+    return true;
+}
+
+void AudioMixer::stop(AudioMixer::VoiceId id) {
+    if (Voice* voice = find(id)) {
+        voice->id = invalidVoice;
+    }
+}
+
+void AudioMixer::setGain(AudioMixer::VoiceId id, float gain) {
+    if (Voice* voice = find(id)) {
+        voice->gain = gain;
+    }
+}
+
+void AudioMixer::setPosition(AudioMixer::VoiceId id, const glm::vec3& position) {
+    if (Voice* voice = find(id)) {
+        voice->position = position;
+    }
+}
+
+void AudioMixer::setListener(const glm::vec3& position, const glm::vec3& forward) {
+    listenerPosition = position;
+
+    // Right of forward, seen from above. If there's no horizontal direction, keep the last one
+    glm::vec3 right(-forward.z, 0.0f, forward.x);
+    float length = glm::length(right);
+
+    if (length > 0.0001f) {
+        listenerRight = right / length;
+    }
+}
+
+float AudioMixer::attenuation(const glm::vec3& position, const glm::vec3& listener) {
+    float distance = glm::distance(position, listener);
+
+    if (distance >= maxDistance) {
+        return 0.0f;
+    }
+
+    float falloff = distance <= refDistance ? 1.0f : refDistance / distance;
+    float fade = std::min(1.0f, (maxDistance - distance) / fadeDistance);
+
+    return falloff * fade;
+}
+
+bool AudioMixer::isPlaying(AudioMixer::VoiceId id) const {
+    return find(id) != nullptr;
+}
+
+size_t AudioMixer::activeVoices() const {
+    return (size_t)std::count_if(voices.begin(), voices.end(), [](const Voice& voice) { return voice.id != invalidVoice; });
+}
+
+int AudioMixer::pickVoice(int priority) const {
+    int best = -1;
+
+    for(size_t i = 0; i < voices.size(); i++) {
+        const Voice& voice = voices[i];
+
+        if (voice.id == invalidVoice) {
+            return (int)i;
+        }
+
+        if (voice.priority > priority) {
+            continue;
+        }
+
+        if (best < 0) {
+            best = (int)i;
+            continue;
+        }
+
+        const Voice& other = voices[best];
+
+        // Lowest priority first, then one-shots before loops, then whichever one-shot has least left
+        if (voice.priority != other.priority) {
+            if (voice.priority < other.priority) { best = (int)i; }
+        }
+        else if (voice.loop != other.loop) {
+            if (!voice.loop) { best = (int)i; }
+        }
+        else if (!voice.loop && voice.sample->frameCount() - voice.frame < other.sample->frameCount() - other.frame) {
+            best = (int)i;
+        }
+    }
+
+    return best;
+}
+
+AudioMixer::Voice* AudioMixer::find(AudioMixer::VoiceId id) {
+    return const_cast<Voice*>(static_cast<const AudioMixer*>(this)->find(id));
+}
+
+const AudioMixer::Voice* AudioMixer::find(AudioMixer::VoiceId id) const {
+    if (id == invalidVoice) {
+        return nullptr;
+    }
+
+    // The pool is small, and this is only for stops and volume changes, which are rare
+    for(const Voice& voice : voices) {
+        if (voice.id == id) {
+            return &voice;
+        }
+    }
+
+    return nullptr;
+}
+
+void AudioMixer::mix(int16_t* out, size_t frames) {
+    accumulator.assign(frames * 2, 0.0f);
+    audible.clear();
+
+    // Work out what each voice sounds like at the listener, culling anything out of earshot
+    for(size_t i = 0; i < voices.size(); i++) {
+        Voice& voice = voices[i];
+
+        if (voice.id == invalidVoice) {
+            continue;
+        }
+
+        float volume = voice.gain * attenuation(voice.position, listenerPosition);
+
+        if (volume <= 0.0f) {
+            skip(voice, frames);
+            continue;
+        }
+
+        // Equal power panning, scaled so a sound straight ahead is as loud in each ear as it was recorded
+        glm::vec3 toSound = voice.position - listenerPosition;
+        float distance = glm::length(toSound);
+        float pan = distance > 0.0001f ? glm::dot(toSound / distance, listenerRight) : 0.0f;
+        float angle = (pan + 1.0f) * glm::quarter_pi<float>();
+
+        float left = volume * std::cos(angle) * glm::root_two<float>();
+        float right = volume * std::sin(angle) * glm::root_two<float>();
+
+        audible.push_back({i, volume * (1.0f + (float)std::max(voice.priority, 0)), left, right});
+    }
+
+    // Only mix the most audible, and move the others on silently
+    if (audible.size() > maxMixedVoices) {
+        std::nth_element(audible.begin(), audible.begin() + maxMixedVoices, audible.end(), [](const Audible& a, const Audible& b) {
+            return a.score > b.score;
+        });
+
+        for(size_t i = maxMixedVoices; i < audible.size(); i++) {
+            skip(voices[audible[i].voice], frames);
+        }
+
+        audible.resize(maxMixedVoices);
+    }
+
+    mixedCount = audible.size();
+
+    for(const Audible& a : audible) {
+        mixVoice(voices[a.voice], frames, a.left, a.right);
+    }
+
+    for(size_t i = 0; i < frames * 2; i++) {
+        out[i] = (int16_t)std::clamp(accumulator[i], -32768.0f, 32767.0f);
+    }
+}
+
+void AudioMixer::skip(AudioMixer::Voice& voice, size_t frames) {
+    size_t length = voice.sample->frameCount();
+    voice.frame += frames;
+    voice.mixed = false;
+
+    if (voice.frame >= length) {
+        if (voice.loop) {
+            voice.frame %= length;
+        }
+        else {
+            ended.push_back(voice.id);
+            voice.id = invalidVoice;
+        }
+    }
+}
+
+void AudioMixer::mixVoice(AudioMixer::Voice& voice, size_t frames, float left, float right) {
+    const int16_t* pcm = voice.sample->pcm.data();
+    size_t length = voice.sample->frameCount();
+
+    // A voice that wasn't heard last block starts at its new gains rather than sweeping up to them
+    if (!voice.mixed) {
+        voice.left = left;
+        voice.right = right;
+    }
+
+    float leftStep = (left - voice.left) / (float)std::max<size_t>(frames, 1);
+    float rightStep = (right - voice.right) / (float)std::max<size_t>(frames, 1);
+    float leftGain = voice.left;
+    float rightGain = voice.right;
+
+    voice.left = left;
+    voice.right = right;
+    voice.mixed = true;
+
+    for(size_t i = 0; i < frames; i++) {
+        if (voice.frame >= length) {
+            if (!voice.loop) {
+                ended.push_back(voice.id);
+                voice.id = invalidVoice;
+                return;
+            }
+
+            voice.frame = 0;
+        }
+
+        leftGain += leftStep;
+        rightGain += rightStep;
+
+        accumulator[i * 2] += pcm[voice.frame * 2] * leftGain;
+        accumulator[i * 2 + 1] += pcm[voice.frame * 2 + 1] * rightGain;
+        voice.frame++;
+    }
+}
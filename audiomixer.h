@@ -0,0 +1,205 @@
+#ifndef TANKS_AUDIOMIXER_H
+#define TANKS_AUDIOMIXER_H
+
+#include "audiobank.h"
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Mixes the playing sounds into one stereo stream, through a fixed pool of voices.
+ *
+ * The pool never grows, so however many sounds are asked for, mixing costs at most the pool's size
+ * in voices. When every voice is busy, a new sound takes over (steals) the least important one:
+ *
+ * 1. The voice with the lowest priority goes first. A sound never steals from a voice with a higher
+ *    priority than its own; if every voice is more important, the new sound just isn't played.
+ * 2. Among voices of the same priority, a one-shot closest to its end goes first, since cutting it
+ *    loses the least. Loops never end, so they're taken last.
+ *
+ * Every sound has a position in the world, and is heard from a listener's. It gets quieter with
+ * distance, and is panned between the ears by which side of the listener it's on. Each block:
+ *
+ * 1. Voices out of earshot are culled before any mixing. Their playback position still moves on,
+ *    so a loop coming back into range picks up where it would have been, and one-shots that start
+ *    out of earshot aren't given a voice at all.
+ * 2. Of what's left, only the maxMixedVoices most audible are mixed, judged by their volume at the
+ *    listener scaled up by their priority. The rest move on silently, like the culled ones.
+ *
+ * So the cost of a block is bounded by maxMixedVoices, however big the battle is.
+ *
+ * Sounds are known by a VoiceId, which whoever starts them picks, and which mustn't be reused.
+ * Stopping a sound that was stolen or has finished does nothing instead of stopping whatever
+ * replaced it. The ids of sounds that end by themselves (finishing, being stolen, or not getting a
+ * voice at all) are collected in getEnded, so the caller can keep track without asking.
+ *
+ * Not thread safe. The AudioEngine only uses it from its audio thread.
+ */
+class AudioMixer {
+public:
+    using VoiceId = uint32_t;
+    static const VoiceId constexpr invalidVoice = 0;
+
+    /**
+     * @param voiceCount The size of the voice pool, which is the most sounds that can play at once
+     */
+    explicit AudioMixer(size_t voiceCount = defaultVoiceCount);
+
+    /**
+     * Start a sound
+     * @param id The id to know it by, which mustn't be invalidVoice or one used before
+     * @param sample What to play. It must outlive the voice, which samples in an AudioBank do
+     * @param gain Its volume, 1 being as loud as it was recorded
+     * @param loop Whether to play it until it's stopped, rather than once
+     * @param priority How important it is, for voice stealing and the mixing budget. Higher is more important
+     * @param position Where it is in the world
+     * @return false if every voice is busy with something more important, or it's a one-shot out of
+     * earshot, so it isn't played
+     */
+    bool play(VoiceId id, const AudioSample& sample, float gain, bool loop, int priority, const glm::vec3& position);
+
+    /**
+     * Stop a sound. Does nothing if it has already finished
+     * @param voice The voice playing it
+     */
+    void stop(VoiceId voice);
+
+    /**
+     * Change a sound's volume. Does nothing if it has already finished
+     * @param voice The voice playing it
+     * @param gain Its new volume
+     */
+    void setGain(VoiceId voice, float gain);
+
+    /**
+     * Move a sound. Does nothing if it has already finished
+     * @param voice The voice playing it
+     * @param position Where it is now
+     */
+    void setPosition(VoiceId voice, const glm::vec3& position);
+
+    /**
+     * Set where the sounds are heard from
+     * @param position The listener's position
+     * @param forward Which way they're facing. Only its horizontal direction matters
+     */
+    void setListener(const glm::vec3& position, const glm::vec3& forward);
+
+    /**
+     * @param voice A voice passed to play
+     * @return whether it's still playing (it hasn't finished, been stopped or been stolen)
+     */
+    bool isPlaying(VoiceId voice) const;
+
+    /**
+     * @return the sounds that have ended by themselves since the last clearEnded, by finishing,
+     * being stolen or not being played. Sounds ended by stop aren't included
+     */
+    const std::vector<VoiceId>& getEnded() const { return ended; }
+
+    /** Forget the sounds that have ended so far */
+    void clearEnded() { ended.clear(); }
+
+    /**
+     * Mix the next frames of every playing voice, and move them on
+     * @param out Where to write the frames, as interleaved stereo 16 bit samples
+     * @param frames How many frames to write
+     */
+    void mix(int16_t* out, size_t frames);
+
+    /** @return how many voices are playing */
+    size_t activeVoices() const;
+
+    /**
+     * @param position A sound's position
+     * @param listener Where it's heard from
+     * @return how much quieter it is at the listener than at its source, 0 if it's out of earshot
+     */
+    static float attenuation(const glm::vec3& position, const glm::vec3& listener);
+
+    /** @return how many voices the last mix actually mixed */
+    size_t mixedVoices() const { return mixedCount; }
+
+    // Enough for every effect a busy battle plays at once
+    static const size_t constexpr defaultVoiceCount = 32;
+
+    // The most voices mixed in one block. Past this, the quietest (for their priority) go silent
+    static const size_t constexpr maxMixedVoices = 12;
+
+    // Sounds are at full volume up to refDistance away, then fall off with the inverse of the distance,
+    // fading out entirely over the last fadeDistance before maxDistance. The levels are 30 units across
+    static const float constexpr refDistance = 3.0f;
+    static const float constexpr maxDistance = 35.0f;
+    static const float constexpr fadeDistance = 5.0f;
+
+private:
+    struct Voice {
+        const AudioSample* sample = nullptr;
+        // The next frame to play
+        size_t frame = 0;
+        float gain = 1.0f;
+        bool loop = false;
+        int priority = 0;
+        glm::vec3 position = glm::vec3(0.0f);
+        // The gain of each ear as of the end of the last block it was mixed in, and whether it was
+        // mixed in the last block at all. Gains ramp from one block's to the next's, so moving sounds
+        // don't crackle
+        float left = 0.0f;
+        float right = 0.0f;
+        bool mixed = false;
+        // 0 while the voice is free
+        VoiceId id = invalidVoice;
+    };
+
+    /** @return the index of the voice a new sound at a priority should use, or -1 if there's none */
+    int pickVoice(int priority) const;
+
+    /**
+     * Move a voice on without mixing it, ending it if it's a one-shot that runs out
+     * @param voice The voice
+     * @param frames How many frames to skip
+     */
+    void skip(Voice& voice, size_t frames);
+
+    /**
+     * Add a voice into the accumulator, ramping its ears' gains to new ones over the block
+     * @param voice The voice
+     * @param frames How many frames to mix
+     * @param left The left ear's gain at the end of the block
+     * @param right The right ear's gain at the end of the block
+     */
+    void mixVoice(Voice& voice, size_t frames, float left, float right);
+
+    /**
+     * @param id A voice id
+     * @return the voice playing it, or nullptr if it has ended
+     */
+    Voice* find(VoiceId id);
+    const Voice* find(VoiceId id) const;
+
+    std::vector<Voice> voices;
+
+    glm::vec3 listenerPosition = glm::vec3(0.0f);
+    glm::vec3 listenerRight = glm::vec3(1.0f, 0.0f, 0.0f);
+
+    // The voices that are in earshot this block, by index, with how audible each is. Reserved up front
+    struct Audible {
+        size_t voice;
+        float score;
+        float left;
+        float right;
+    };
+    std::vector<Audible> audible;
+    size_t mixedCount = 0;
+
+    // The sounds that ended by themselves, for getEnded. Reserved up front, so the audio thread doesn't
+    // allocate in the usual case
+    std::vector<VoiceId> ended;
+
+    // The mix is summed in floats, so loud moments clip once at the end rather than wrapping
+    std::vector<float> accumulator;
+};
+
+#endif //TANKS_AUDIOMIXER_H
@@ -0,0 +1,112 @@
+#include "bitstream.h"
+
+#include <cstring>
+
+BitWriter::BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+void BitWriter::writeBits(uint32_t value, int count) {
+    if (count <= 0) {
+        return;
+    }
+
+    uint64_t mask = count >= 32 ? 0xffffffffull : (1ull << count) - 1;
+    pending |= ((uint64_t)value & mask) << pendingBits;
+    pendingBits += count;
+
+    // At most 7 bits are ever held back, so 32 more always fit
+    while (pendingBits >= 8) {
+        out.push_back((uint8_t)pending);
+        pending >>= 8;
+        pendingBits -= 8;
+    }
+}
+
+void BitWriter::writeVarint(uint32_t value) {
+    const uint32_t groupMask = (1u << varintGroupBits) - 1;
+
+    while (value > groupMask) {
+        writeBits(value & groupMask, varintGroupBits);
+        writeBool(true);
+        value >>= varintGroupBits;
+    }
+
+    writeBits(value, varintGroupBits);
+    writeBool(false);
+}
+
+void BitWriter::writeF32(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeBits(bits, 32);
+}
+
+void BitWriter::finish() {
+    if (pendingBits > 0) {
+        out.push_back((uint8_t)pending);
+    }
+
+    pending = 0;
+    pendingBits = 0;
+}
+
+BitReader::BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+uint32_t BitReader::readBits(int count) {
+    if (count <= 0 || failed) {
+        return 0;
+    }
+
+    if (position + count > size * 8) {
+        failed = true;
+        return 0;
+    }
+
+    uint32_t value = 0;
+    int read = 0;
+
+    // A byte, or what's left of one, at a time
+    while (read < count) {
+        size_t byte = position / 8;
+        int offset = (int)(position % 8);
+        int take = count - read < 8 - offset ? count - read : 8 - offset;
+
+        uint32_t bits = (data[byte] >> offset) & ((1u << take) - 1);
+        value |= bits << read;
+        read += take;
+        position += take;
+    }
+
+    return value;
+}
+
+uint32_t BitReader::readVarint() {
+    uint32_t value = 0;
+
+    for(int shift = 0; shift < 32; shift += BitWriter::varintGroupBits) {
+        value |= readBits(BitWriter::varintGroupBits) << shift;
+
+        if (!readBool()) {
+            return failed ? 0 : value;
+        }
+    }
+
+    failed = true;
+    return 0;
+}
+
+float BitReader::readF32() {
+    uint32_t bits = readBits(32);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool BitReader::isAtEnd() const {
+    if (failed || (position + 7) / 8 != size) {
+        return false;
+    }
+
+    // Whatever's left of the last byte is padding
+    int offset = (int)(position % 8);
+    return offset == 0 || (data[size - 1] >> offset) == 0;
+}
@@ -0,0 +1,90 @@
+#ifndef TANKS_BITSTREAM_H
+#define TANKS_BITSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Writes values of any number of bits, one after another with no padding between them, onto the end of a
+ * byte buffer. Bits fill each byte from the lowest up, so a value's low bits come first. Call finish once
+ * everything is written, to pad the last byte with zeros.
+ */
+class BitWriter {
+public:
+    /**
+     * @param out The buffer to append to. Its memory is reused, so it should outlive the writer
+     */
+    explicit BitWriter(std::vector<uint8_t>& out);
+
+    /**
+     * @param value The value. Only its low count bits are written
+     * @param count How many bits, from 0 to 32
+     */
+    void writeBits(uint32_t value, int count);
+
+    void writeBool(bool value) { writeBits(value ? 1 : 0, 1); }
+
+    /**
+     * Write a number that's usually small, in groups of varintGroupBits, each followed by a bit saying
+     * whether another follows. Below 16 takes 5 bits
+     * @param value The number
+     */
+    void writeVarint(uint32_t value);
+
+    /**
+     * @param value A float, written as its 32 bits
+     */
+    void writeF32(float value);
+
+    /** Write out the bits still held back, padding the last byte with zeros */
+    void finish();
+
+    // The bits in each group of a varint, before its continuation bit
+    static const int constexpr varintGroupBits = 4;
+
+private:
+    std::vector<uint8_t>& out;
+    // The bits not yet written out, lowest first, and how many there are
+    uint64_t pending = 0;
+    int pendingBits = 0;
+};
+
+/** Reads what a BitWriter wrote, failing (and staying failed) instead of reading past the end */
+class BitReader {
+public:
+    /**
+     * @param data The bytes
+     * @param size How many there are
+     */
+    BitReader(const uint8_t* data, size_t size);
+
+    /**
+     * @param count How many bits, from 0 to 32
+     * @return them, or 0 if there aren't enough
+     */
+    uint32_t readBits(int count);
+
+    bool readBool() { return readBits(1) != 0; }
+
+    /** @return a number written by BitWriter::writeVarint, or 0 if it's malformed */
+    uint32_t readVarint();
+
+    /** @return a float written by BitWriter::writeF32 */
+    float readF32();
+
+    /** @return whether anything has been read past the end, or was malformed */
+    bool hasFailed() const { return failed; }
+
+    /** @return whether everything was read, up to the padding in the last byte, which has to be zeros */
+    bool isAtEnd() const;
+
+private:
+    const uint8_t* data;
+    size_t size;
+    // How many bits have been read
+    size_t position = 0;
+    bool failed = false;
+};
+
+#endif //TANKS_BITSTREAM_H
@@ -0,0 +1,76 @@
+#include "diskcache.h"
+
+#include <QStandardPaths>
+#include <QString>
+
+#include <fstream>
+#include <vector>
+
+static const char DISK_CACHE_FOLDER[] = "tanks";
+
+std::filesystem::path DiskCache::directory(const std::string& name) {
+    // Use the generic location with a fixed folder rather than the per-application one, so that the game
+    // and the tools (which are separate executables) share one cache
+    std::filesystem::path base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation).toStdString();
+
+    if (!base.empty()) {
+        base /= DISK_CACHE_FOLDER;
+    }
+
+    // Some platforms (or odd environments, like a build farm with no home directory) have no cache
+    // location, so fall back to a folder next to the working directory
+    if (base.empty()) {
+        base = std::filesystem::current_path() / "cache";
+    }
+
+    std::filesystem::path dir = base / name;
+
+    std::error_code err;
+    std::filesystem::create_directories(dir, err);
+
+    return dir;
+}
+
+uint64_t DiskCache::hash(const void* data, size_t size, uint64_t seed) {
+    const uint64_t prime = 1099511628211ull;
+    const auto* bytes = static_cast<const unsigned char*>(data);
+
+    uint64_t h = seed;
+    for(size_t i = 0; i < size; i++) {
+        h ^= bytes[i];
+        h *= prime;
+    }
+
+    return h;
+}
+
+uint64_t DiskCache::hashFile(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+
+    if (!stream) {
+        std::string msg = "DiskCache: Failed to open file for hashing: ";
+        msg += path.string();
+        throw std::runtime_error(msg);
+    }
+
+    std::vector<char> chunk(64 * 1024);
+    uint64_t h = hashSeed;
+
+    while (stream) {
+        stream.read(chunk.data(), (std::streamsize)chunk.size());
+        h = hash(chunk.data(), (size_t)stream.gcount(), h);
+    }
+
+    return h;
+}
+
+int64_t DiskCache::modifiedTime(const std::filesystem::path& path) {
+    std::error_code err;
+    auto time = std::filesystem::last_write_time(path, err);
+
+    if (err) {
+        return 0;
+    }
+
+    return (int64_t)time.time_since_epoch().count();
+}
@@ -0,0 +1,54 @@
+#ifndef TANKS_DISKCACHE_H
+#define TANKS_DISKCACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+/**
+ * Small helpers shared by anything that bakes data to disk so it can skip work on the next launch
+ * (converted meshes, linked shader programs, etc). The cache lives in a "tanks" folder in the per-user
+ * cache directory, with one subfolder per kind of data.
+ *
+ * Nothing stored here is precious: every cache entry can be regenerated from the assets, so any entry
+ * that fails to validate is simply rebuilt.
+ */
+class DiskCache {
+public:
+    /**
+     * Get (and create, if needed) the cache folder for a kind of data
+     * @param name The name of the subfolder, e.g. "meshes"
+     * @return The absolute path of the folder
+     */
+    static std::filesystem::path directory(const std::string& name);
+
+    /**
+     * A fast, non-cryptographic 64 bit hash (FNV-1a), used to key and validate cache entries
+     * @param data The bytes to hash
+     * @param size How many bytes to hash
+     * @param seed The previous hash, to continue hashing across several buffers
+     * @return the hash value
+     */
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = hashSeed);
+
+    /**
+     * Hash the entire contents of a file
+     * @param path The file to hash
+     * @return the hash value
+     * @throws std::runtime_error if the file can't be read
+     */
+    static uint64_t hashFile(const std::filesystem::path& path);
+
+    /**
+     * The last modification time of a file, as a plain integer suitable for storing in a cache header
+     * @param path The file to check
+     * @return the modification time, in the filesystem clock's ticks
+     */
+    static int64_t modifiedTime(const std::filesystem::path& path);
+
+    // The FNV-1a 64 bit offset basis
+    static const uint64_t constexpr hashSeed = 14695981039346656037ull;
+};
+
+#endif //TANKS_DISKCACHE_H
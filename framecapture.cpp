@@ -0,0 +1,246 @@
+#include "framecapture.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+// How many destroyed captures' writers are still writing, for waitForWriters
+static std::mutex writersMutex;
+static std::condition_variable writersDone;
+static size_t writersRunning = 0;
+
+FrameCapture::FrameCapture(std::filesystem::path folder, FrameCapture::Format format) : folder(std::move(folder)) {
+    QOpenGLExtraFunctions::initializeOpenGLFunctions();
+
+    std::error_code err;
+    std::filesystem::create_directories(this->folder, err);
+
+    if (err) {
+        std::cerr << "FrameCapture: Failed to create " << this->folder << ": " << err.message() << "\n";
+    }
+
+    slots.resize(ringSize);
+
+    for(auto& slot : slots) {
+        glGenBuffers(1, &slot.buffer);
+    }
+
+    writer = std::make_shared<Writer>();
+    writer->folder = this->folder;
+    writer->format = format;
+
+    // Nothing joins it. Once the capture is destroyed it writes what's left, and counts itself out
+    std::thread(&FrameCapture::writeFrames, writer).detach();
+}
+
+FrameCapture::~FrameCapture() {
+    // Collect whatever is still on the GPU, oldest first, so the recording doesn't end short
+    for(size_t i = 0; i < slots.size(); i++) {
+        Slot& slot = slots[(next + i) % slots.size()];
+
+        if (slot.fence) {
+            collect(slot, true);
+        }
+    }
+
+    // Joining the writer here would stall the frame until the disk caught up, so it's left to finish
+    // on its own
+    {
+        std::lock_guard<std::mutex> lock(writersMutex);
+        writersRunning++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        writer->stopping = true;
+        writer->captured = captured;
+        writer->dropped = dropped;
+    }
+
+    writer->ready.notify_one();
+
+    for(auto& slot : slots) {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+void FrameCapture::waitForWriters() {
+    std::unique_lock<std::mutex> lock(writersMutex);
+    writersDone.wait(lock, [] { return writersRunning == 0; });
+}
+
+void FrameCapture::captureFrame() {
+    // Pass on the finished frames, oldest first, stopping at the first the GPU is still working on
+    for(size_t i = 0; i < slots.size(); i++) {
+        Slot& slot = slots[(next + i) % slots.size()];
+
+        if (slot.fence && !collect(slot)) {
+            break;
+        }
+    }
+
+    Slot& slot = slots[next];
+
+    // The GPU is so far behind that every buffer is still waiting on it. Waiting would stall the
+    // frame, which is exactly what this is meant to avoid
+    if (slot.fence) {
+        dropped++;
+        return;
+    }
+
+    // The viewport is the size of what was just drawn, in real pixels
+    GLint viewport[4] = {};
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+
+    if (slot.width != viewport[2] || slot.height != viewport[3]) {
+        slot.width = viewport[2];
+        slot.height = viewport[3];
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)slot.width * slot.height * 4, nullptr, GL_STREAM_READ);
+    }
+
+    // With a pack buffer bound, this only queues the copy; the pointer is an offset into the buffer
+    glReadPixels(viewport[0], viewport[1], slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next = (next + 1) % slots.size();
+}
+
+bool FrameCapture::collect(FrameCapture::Slot& slot, bool wait) {
+    GLenum status = wait ? glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED)
+                         : glClientWaitSync(slot.fence, 0, 0);
+
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    if (status == GL_WAIT_FAILED) {
+        dropped++;
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+
+        if (writer->queue.size() >= maxQueuedFrames) {
+            dropped++;
+            return true;
+        }
+    }
+
+    size_t bytes = (size_t)slot.width * slot.height * 4;
+    QImage image(slot.width, slot.height, QImage::Format_RGBA8888);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)bytes, GL_MAP_READ_BIT);
+
+    // Rows of a 32 bit QImage are never padded, so the whole frame copies at once
+    if (pixels) {
+        std::memcpy(image.bits(), pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!pixels) {
+        dropped++;
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        writer->queue.push_back(std::move(image));
+    }
+
+    writer->ready.notify_one();
+    captured++;
+
+    return true;
+}
+
+void FrameCapture::writeFrames(std::shared_ptr<Writer> writer) {
+    std::ofstream raw;
+    // The size of the frames in the raw file, which each start a new one when it changes
+    QSize rawSize;
+    size_t rawPart = 0;
+
+    for(size_t index = 0;; index++) {
+        QImage image;
+
+        {
+            std::unique_lock<std::mutex> lock(writer->mutex);
+            writer->ready.wait(lock, [&writer] { return writer->stopping || !writer->queue.empty(); });
+
+            // Only stop once everything queued has been written
+            if (writer->queue.empty()) {
+                break;
+            }
+
+            image = std::move(writer->queue.front());
+            writer->queue.pop_front();
+        }
+
+        // GL's rows start at the bottom of the frame, image files' at the top
+        image = image.mirrored(false, true);
+
+        if (writer->format == Format::PngSequence) {
+            QString name = QString("frame_%1.png").arg(index, 6, 10, QChar('0'));
+            auto path = writer->folder / name.toStdString();
+
+            if (!image.save(QString::fromStdString(path.string()), "PNG")) {
+                std::cerr << "FrameCapture: Failed to write " << path << "\n";
+            }
+
+            continue;
+        }
+
+        if (image.size() != rawSize) {
+            // The first frame opens frames.rgba, and every change of size after that the next part
+            if (rawSize.isValid()) {
+                raw.close();
+                rawPart++;
+            }
+
+            rawSize = image.size();
+            auto path = rawVideoPath(writer->folder, rawPart);
+            raw.open(path, std::ios::binary | std::ios::trunc);
+
+            if (!raw) {
+                std::cerr << "FrameCapture: Failed to open " << path << "\n";
+            }
+            else if (rawPart > 0) {
+                std::cerr << "FrameCapture: The frame size changed to " << rawSize.width() << "x" << rawSize.height()
+                          << ", continuing in " << path << "\n";
+            }
+        }
+
+        if (raw) {
+            raw.write(reinterpret_cast<const char*>(image.constBits()), (std::streamsize)image.sizeInBytes());
+        }
+    }
+
+    raw.close();
+
+    std::cerr << "FrameCapture: Wrote " << writer->captured << " frames to " << writer->folder << ", dropped "
+              << writer->dropped << "\n";
+
+    // Let go before counting out, so once waitForWriters returns nothing of this capture is left
+    writer.reset();
+
+    {
+        std::lock_guard<std::mutex> lock(writersMutex);
+        writersRunning--;
+    }
+
+    writersDone.notify_all();
+}
+
+std::filesystem::path FrameCapture::rawVideoPath(const std::filesystem::path& folder, size_t part) {
+    return folder / (part == 0 ? std::string("frames.rgba") : "frames_" + std::to_string(part) + ".rgba");
+}
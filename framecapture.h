@@ -0,0 +1,138 @@
+#ifndef TANKS_FRAMECAPTURE_H
+#define TANKS_FRAMECAPTURE_H
+
+#include <QOpenGLExtraFunctions>
+#include <QImage>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Records every frame drawn to a folder, for reviewing matches afterwards, without stalling the
+ * renderer to do it.
+ *
+ * glReadPixels into client memory waits for the GPU to finish the frame, so instead each frame is
+ * read into one of a ring of pixel buffer objects, with a fence behind it. A few frames later, once
+ * the fence has passed, the buffer is mapped and copied out (which by then doesn't wait), and the
+ * image handed to a writer thread, which does the flipping, PNG encoding and disk writes. If the GPU
+ * or the disk falls too far behind, frames are dropped rather than waited for, and counted.
+ *
+ * Frames are written either as a numbered PNG sequence (frame_000000.png, ...), or as one raw
+ * RGBA file (frames.rgba, top row first), which ffmpeg reads with
+ *
+ *  ffmpeg -f rawvideo -pix_fmt rgba -s WxH -r 60 -i frames.rgba match.mp4
+ *
+ * A raw file has no room for a frame size, so if the window is resized mid capture, the frames from
+ * then on go into a new file, frames_1.rgba, then frames_2.rgba, and so on, each needing its own -s.
+ *
+ * Like the other GL classes, it must be created and destroyed with the context current. Destroying
+ * it doesn't wait for the writer: the writer finishes the frames still queued on its own, and
+ * waitForWriters waits for that, before the process exits.
+ */
+class FrameCapture : private QOpenGLExtraFunctions {
+public:
+    enum class Format {
+        PngSequence,
+        RawVideo,
+    };
+
+    /**
+     * Start a capture
+     * @param folder Where to write the frames. It's created if needed
+     * @param format How to write them
+     */
+    FrameCapture(std::filesystem::path folder, Format format);
+
+    /** Finishes reading back the frames still on the GPU, and tells the writer to stop once it has written them */
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture& other) = delete;
+    FrameCapture& operator=(const FrameCapture& other) = delete;
+
+    /**
+     * Queue a readback of the bound framebuffer's color buffer, and pass on any earlier frames
+     * whose readback has finished. Call once the frame is drawn
+     */
+    void captureFrame();
+
+    /** @return how many frames have been handed to the writer so far */
+    size_t capturedFrames() const { return captured; }
+
+    /** @return how many frames were skipped because the GPU or the writer fell behind */
+    size_t droppedFrames() const { return dropped; }
+
+    /** @return the folder the frames are written to */
+    const std::filesystem::path& getFolder() const { return folder; }
+
+    /** Wait for every destroyed capture's writer to finish writing its frames, e.g. before exiting */
+    static void waitForWriters();
+
+private:
+    /** A pixel buffer and the fence marking when the readback into it is done */
+    struct Slot {
+        unsigned int buffer = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+
+    /**
+     * Copy a slot's frame out and hand it to the writer, if the GPU has finished with it
+     * @param slot The slot
+     * @param wait Whether to wait for the GPU instead of giving up if it isn't done
+     * @return false if the readback isn't done yet
+     */
+    bool collect(Slot& slot, bool wait = false);
+
+    /** What a capture shares with its writer thread, which keeps it until everything is written */
+    struct Writer {
+        std::filesystem::path folder;
+        Format format;
+
+        // The frames waiting to be written
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<QImage> queue;
+        bool stopping = false;
+
+        // The capture's totals, handed over when it stops, for the writer to report once it's done
+        size_t captured = 0;
+        size_t dropped = 0;
+    };
+
+    /**
+     * The writer thread's loop
+     * @param writer What it writes from
+     */
+    static void writeFrames(std::shared_ptr<Writer> writer);
+
+    /**
+     * @param folder The capture's folder
+     * @param part How many times the frame size has changed
+     * @return the raw video file the frames are written to from then on
+     */
+    static std::filesystem::path rawVideoPath(const std::filesystem::path& folder, size_t part);
+
+    std::filesystem::path folder;
+
+    std::vector<Slot> slots;
+    // The next slot to read into. Slots are used in order, so this is also the oldest one
+    size_t next = 0;
+
+    size_t captured = 0;
+    size_t dropped = 0;
+
+    std::shared_ptr<Writer> writer;
+
+    // Enough frames for the GPU to run a few behind without the ring filling up
+    static const size_t constexpr ringSize = 4;
+
+    // Frames waiting on the writer are full size images, so limit how much memory a slow disk can use
+    static const size_t constexpr maxQueuedFrames = 60;
+};
+
+#endif //TANKS_FRAMECAPTURE_H
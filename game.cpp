@@ -2,6 +2,11 @@
 
 #include "game.h"
 #include "PlayerTank.h"
+#include "audioengine.h"
+
+#include <QDateTime>
+
+#include <filesystem>
 
 
 /**
@@ -122,7 +127,7 @@ void Game::end() {
 
 /**
  * @brief Game::beginNewScene: Begin a new scene
- * @details Begin a new scene by resetting the scene, loading the state, starting the scene, setting inGame to true, starting the timer, and changing the active widget to the game.
+ * @details Begin a new scene by resetting the scene, loading the state, starting the scene, building the renderer's static batch, setting inGame to true, starting the timer, and changing the active widget to the game.
  * @param stateFilename The filename of the state to load
  * @author Koda Koziol (mostly refactoring Luna's code though)
  * @date Spring 2024
@@ -133,6 +138,11 @@ void Game::beginNewScene(std::string stateFilename) {
     sc->getInstance()->load(stateFilename);
     sc->getInstance()->start();
     sc->getInstance()->setPaused(false);
+
+    // Obstacles don't move, so the renderer collects them once here instead of every tick
+    auto* rend = dynamic_cast<Renderer*>(gw->getWidget(GAME_KEY));
+    rend->buildStaticBatch(sc);
+
     isAlive = true;
     inGame = true;
     timer.start();
@@ -152,6 +162,15 @@ void Game::tick() {
     Scene* sc = Scene::getInstance();
     sc->update(60.0f/1000);
 
+    // Sounds are heard from the player tank, where it is after this tick's update
+    AudioEngine* audio = AudioEngine::getInstance();
+
+    if (GameObject* player = sc->getGameObject(GameObjectType::PlayerTank)) {
+        audio->setListener(player->getPosition(), player->getDirection());
+    }
+
+    audio->update();
+
     QWidget* widg = gw->getWidget(GAME_KEY);
     auto* rend = dynamic_cast<Renderer*>(widg);
 
@@ -241,6 +260,31 @@ bool Game::filterKeyEvent(QKeyEvent* event) {
                     rend->setCameraMode(Renderer::CameraMode::Orbiting);
                 }
                 return true;
+            case Qt::Key_F3: // Frame timing overlay
+                if (inGame) {
+                    auto* rend = dynamic_cast<Renderer*>(gw->getWidget(GAME_KEY));
+                    rend->toggleStatsOverlay();
+                }
+                return true;
+            case Qt::Key_F4: // Step through the quality tiers, then back to picking one automatically
+                if (inGame) {
+                    auto* rend = dynamic_cast<Renderer*>(gw->getWidget(GAME_KEY));
+                    rend->cycleQualityTier();
+                }
+                return true;
+            case Qt::Key_F9: // Start or stop recording the match, into captures/<date and time>
+                if (inGame) {
+                    auto* rend = dynamic_cast<Renderer*>(gw->getWidget(GAME_KEY));
+
+                    if (rend->isCapturing()) {
+                        rend->stopCapture();
+                    }
+                    else {
+                        QString stamp = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+                        rend->startCapture(std::filesystem::path("captures") / stamp.toStdString());
+                    }
+                }
+                return true;
             default:
                 return false;
         }
@@ -298,6 +342,10 @@ Game* Game::getInstance(int argc, char** argv) {
     }
 }
 
+Game* Game::findInstance() {
+    return Game::instance;
+}
+
 void Game::destroyInstance() {
     delete instance;
     instance = nullptr;
@@ -51,6 +51,12 @@ public:
      */
     static Game* getInstance(int argc = 0, char** argv = nullptr);
 
+    /**
+     * @return the game's instance if there is one, or nullptr, as in the dedicated server, which runs the Scene
+     * without a Game
+     */
+    static Game* findInstance();
+
     /** Should only be called when the game is exiting entirely, just before main's return */
     static void destroyInstance();
 
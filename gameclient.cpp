@@ -0,0 +1,203 @@
+#include "gameclient.h"
+#include "gameserver.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <iostream>
+
+GameClient::GameClient(QObject *parent) :
+        QObject(parent), predictor(PlayerTank::driveSpeed, GameServer::tickDelta) {
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &GameClient::onTimer);
+
+    connect(&transport, &UdpTransport::connected, this, [this](UdpTransport::PeerId) { emit connected(); });
+
+    connect(&transport, &UdpTransport::disconnected, this, [this](UdpTransport::PeerId) {
+        server = UdpTransport::noPeer;
+        emit disconnected();
+    });
+
+    connect(&transport, &UdpTransport::messageReceived, this, [this](UdpTransport::PeerId, const MessageView &message, bool) {
+        onMessage(message);
+    });
+
+    reconcileTiming = Profiler::getInstance()->registerTiming("client reconcile");
+}
+
+void GameClient::connectToServer(const QString &host, quint16 port) {
+    disconnectFromServer();
+
+    QHostAddress address;
+    if (!address.setAddress(host)) {
+        std::cerr << "GameClient: " << host.toStdString() << " isn't an IP address\n";
+        return;
+    }
+
+    server = transport.connectTo(address, port);
+}
+
+void GameClient::disconnectFromServer() {
+    timer.stop();
+    transport.close();
+    server = UdpTransport::noPeer;
+    history.clear();
+    tankId = UINT32_MAX;
+    tickRate = 0;
+    clientId = 0;
+    predictor.stop();
+    nextInput = 1;
+}
+
+void GameClient::setInput(const TankInput &newInput) {
+    input = newInput;
+}
+
+const Snapshot *GameClient::getSnapshot() const {
+    return history.latest();
+}
+
+uint32_t GameClient::getTankId() const {
+    return tankId;
+}
+
+uint32_t GameClient::getClientId() const {
+    return clientId;
+}
+
+int GameClient::getTickRate() const {
+    return tickRate;
+}
+
+const UdpConnection *GameClient::getConnection() const {
+    return transport.getConnection(server);
+}
+
+const TankPredictor &GameClient::getPredictor() const {
+    return predictor;
+}
+
+const GameClient::PredictionStats &GameClient::getPredictionStats() const {
+    return predictionStats;
+}
+
+quint64 GameClient::getSnapshotBytesReceived() const {
+    return snapshotBytesReceived;
+}
+
+quint64 GameClient::getSnapshotsReceived() const {
+    return snapshotsReceived;
+}
+
+void GameClient::onMessage(const MessageView &message) {
+    switch ((NetProtocol::Message)message.type) {
+        case NetProtocol::Message::Welcome: {
+            uint16_t rate;
+            if (NetProtocol::readWelcome(message, rate, clientId)) {
+                tickRate = rate;
+
+                // Start ticking along with the server
+                timer.setInterval(1000 / tickRate);
+                clock.start();
+                nextTickNanoseconds = 0;
+                timer.start();
+            }
+            break;
+        }
+        case NetProtocol::Message::Spawned:
+            // A new tank starts wherever the server put it
+            NetProtocol::readSpawned(message, tankId);
+            predictor.stop();
+            break;
+        case NetProtocol::Message::Snapshot: {
+            snapshotBytesReceived += MessageFrame::headerSize(message.size) + message.size;
+            snapshotsReceived++;
+
+            uint32_t lastApplied;
+            if (!NetProtocol::readSnapshotHeader(message, lastApplied)) {
+                std::cerr << "GameClient: Received a malformed snapshot\n";
+                return;
+            }
+
+            const uint8_t *delta = message.data + NetProtocol::snapshotHeaderSize;
+            size_t deltaSize = message.size - NetProtocol::snapshotHeaderSize;
+
+            // The server only builds on snapshots we've acknowledged, which we still have
+            uint32_t baselineTick = Snapshot::readBaselineTick(delta, deltaSize);
+            const Snapshot *baseline = history.find(baselineTick);
+
+            if (baselineTick != 0 && !baseline) {
+                std::cerr << "GameClient: Snapshot built on tick " << baselineTick << ", which we don't have\n";
+                return;
+            }
+
+            // Decode into the spare first, since the new snapshot may take the baseline's place in the history
+            if (!Snapshot::readDelta(baseline, delta, deltaSize, decoded)) {
+                std::cerr << "GameClient: Received a malformed snapshot\n";
+                return;
+            }
+
+            const Snapshot *newest = history.latest();
+            if (newest && decoded.tick <= newest->tick) {
+                return;
+            }
+
+            Snapshot &stored = history.add(decoded.tick);
+            std::swap(stored.entities, decoded.entities);
+            stored.quantization = decoded.quantization;
+
+            if (const EntityState *tank = stored.find(tankId)) {
+                auto start = std::chrono::steady_clock::now();
+                int replays = predictor.reconcile(*tank, lastApplied);
+                auto end = std::chrono::steady_clock::now();
+
+                Profiler::getInstance()->addTiming(reconcileTiming, std::chrono::duration<double, std::milli>(end - start).count());
+
+                predictionStats.reconciles++;
+                predictionStats.replayed += replays;
+                predictionStats.mispredictions += replays > 0 ? 1 : 0;
+                predictionStats.correction += predictor.getLastCorrection();
+            } else {
+                predictor.stop();
+            }
+
+            emit snapshotReceived(stored);
+            break;
+        }
+        case NetProtocol::Message::Event:
+            if (NetProtocol::readEvent(message, decodedEvent)) {
+                emit eventReceived(decodedEvent);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void GameClient::onTimer() {
+    const qint64 tickNanoseconds = 1000000000ll / tickRate;
+    int ticks = 0;
+
+    while (clock.nsecsElapsed() >= nextTickNanoseconds && ticks < GameServer::maxCatchUpTicks) {
+        tick();
+        nextTickNanoseconds += tickNanoseconds;
+        ticks++;
+    }
+
+    // Too far behind to catch up, so let the missed ticks go, as the server does
+    if (clock.nsecsElapsed() >= nextTickNanoseconds) {
+        nextTickNanoseconds = clock.nsecsElapsed() + tickNanoseconds;
+    }
+}
+
+void GameClient::tick() {
+    uint32_t sequence = nextInput++;
+    const Snapshot *newest = history.latest();
+
+    uint8_t message[NetProtocol::inputSize];
+    NetProtocol::writeInput(message, newest ? newest->tick : 0, sequence, input);
+    transport.sendReliable(server, (quint8)NetProtocol::Message::Input, message, sizeof(message));
+    transport.flush();
+
+    predictor.predict(sequence, input);
+    predictor.smooth(1.0f / (float)tickRate);
+}
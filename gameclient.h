@@ -0,0 +1,141 @@
+#ifndef TANKS_GAMECLIENT_H
+#define TANKS_GAMECLIENT_H
+
+#include "PlayerTank.h"
+#include "netprotocol.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "tankpredictor.h"
+#include "udptransport.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+/**
+ * The client end of a game on a dedicated server (GameServer). It turns the server's snapshot deltas
+ * back into whole Snapshots, keeping the last few so later deltas can build on them.
+ *
+ * Once the server says its tick rate, the client ticks at the same rate. Every tick it sends the
+ * player's controls as a numbered input, which also acknowledges the newest snapshot, and predicts where
+ * they put the player's own tank (TankPredictor), so it answers the keys straight away. Each snapshot
+ * then corrects the prediction, replaying whatever inputs the server hadn't applied yet.
+ *
+ * Snapshots arrive unreliably, so some never do, and the next one simply builds on an older baseline.
+ * The inputs, and the server's events, go on the reliable channel.
+ *
+ * Everything but the player's own tank is drawn as the server decided it.
+ */
+class GameClient : public QObject {
+    Q_OBJECT
+public:
+    explicit GameClient(QObject *parent = nullptr);
+
+    /**
+     * Connect to a server
+     * @param host Its address, as an IP address
+     * @param port Its port
+     */
+    void connectToServer(const QString &host, quint16 port);
+
+    /** Disconnect, and forget everything the server said */
+    void disconnectFromServer();
+
+    /**
+     * Set the controls the player is holding, sent and predicted from the next tick on
+     * @param newInput The controls
+     */
+    void setInput(const TankInput &newInput);
+
+    /** @return the newest snapshot, or nullptr if none has arrived yet */
+    const Snapshot *getSnapshot() const;
+
+    /** @return the player's tank, or UINT32_MAX if they don't have one yet */
+    uint32_t getTankId() const;
+
+    /** @return who the server says this client is, or 0 before it has said */
+    uint32_t getClientId() const;
+
+    /** @return how many ticks a second the server runs, or 0 before it has said */
+    int getTickRate() const;
+
+    /** @return the connection to the server, for its statistics, or nullptr if there isn't one */
+    const UdpConnection *getConnection() const;
+
+    /** @return the player's own tank, predicted ahead of the snapshots */
+    const TankPredictor &getPredictor() const;
+
+    /** How the prediction has gone, for benchmarks */
+    struct PredictionStats {
+        // Snapshots with the player's tank in
+        quint64 reconciles = 0;
+        // Those that disagreed with the prediction, and how many inputs were replayed for them
+        quint64 mispredictions = 0;
+        quint64 replayed = 0;
+        // How far the prediction was moved, all told
+        double correction = 0.0;
+    };
+
+    const PredictionStats &getPredictionStats() const;
+
+    /** @return how many snapshot bytes have arrived, message headers included */
+    quint64 getSnapshotBytesReceived() const;
+
+    /** @return how many snapshots have arrived */
+    quint64 getSnapshotsReceived() const;
+
+signals:
+    //Emitted when the connection is made
+    void connected();
+
+    //Emitted when the server goes away, or stops answering
+    void disconnected();
+
+    //Emitted after each snapshot is applied
+    void snapshotReceived(const Snapshot &snapshot);
+
+    //Emitted for each thing that happened on the server, in order
+    void eventReceived(const GameEvent &event);
+
+private slots:
+    /** Run however many ticks are due */
+    void onTimer();
+
+private:
+    /**
+     * Handle one message from the server
+     * @param message The message
+     */
+    void onMessage(const MessageView &message);
+
+    /** Send the next input, and predict it */
+    void tick();
+
+    UdpTransport transport;
+    UdpTransport::PeerId server = UdpTransport::noPeer;
+    // Where events are decoded, kept to reuse its memory
+    GameEvent decodedEvent;
+    SnapshotHistory history;
+    // Where snapshots are decoded before going into the history, kept to reuse its memory
+    Snapshot decoded;
+    TankInput input;
+    uint32_t tankId = UINT32_MAX;
+    int tickRate = 0;
+    uint32_t clientId = 0;
+
+    // The same fixed step clock as the server's
+    QTimer timer;
+    QElapsedTimer clock;
+    qint64 nextTickNanoseconds = 0;
+
+    TankPredictor predictor;
+    uint32_t nextInput = 1;
+    PredictionStats predictionStats;
+    // The Profiler slot each reconcile's time is recorded in
+    Profiler::TimingSlot reconcileTiming;
+
+    quint64 snapshotBytesReceived = 0;
+    quint64 snapshotsReceived = 0;
+};
+
+#endif //TANKS_GAMECLIENT_H
@@ -0,0 +1,387 @@
+#include "gameserver.h"
+#include "audioengine.h"
+#include "profiler.h"
+#include "scene.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+GameServer::GameServer(QObject *parent) : QObject(parent) {
+    // The tanks still play their sounds, but there's nobody to hear them
+    AudioEngine::disableOutput();
+
+    // The timer only wakes the server up; the elapsed clock decides how many ticks are due, so a late
+    // wake up doesn't slow the game down
+    timer.setTimerType(Qt::PreciseTimer);
+    timer.setInterval(1000 / tickRate);
+
+    connect(&timer, &QTimer::timeout, this, &GameServer::onTimer);
+    connect(&transport, &UdpTransport::connected, this, &GameServer::onConnected);
+    connect(&transport, &UdpTransport::disconnected, this, &GameServer::removeClient);
+    connect(&transport, &UdpTransport::messageReceived, this, [this](UdpTransport::PeerId peer, const MessageView &message, bool) {
+        onMessage(peer, message);
+    });
+
+    tickTiming = Profiler::getInstance()->registerTiming("server tick");
+}
+
+GameServer::~GameServer() {
+    stop();
+}
+
+bool GameServer::start(const std::string& level, quint16 port) {
+    stop();
+
+    if (!transport.listen(port)) {
+        std::cerr << "GameServer: Failed to listen on port " << port << "\n";
+        return false;
+    }
+
+    currentTick = 0;
+    snapshotBytesSent = 0;
+    changeLevel(level);
+
+    clock.start();
+    nextTickNanoseconds = 0;
+    timer.start();
+    return true;
+}
+
+void GameServer::changeLevel(const std::string& level) {
+    Scene *scene = Scene::getInstance();
+    scene->reset();
+    scene->load(level);
+
+    // The level's player is for a local game. Here every client brings their own
+    for (GameObject *player : scene->getGameObjects(GameObjectType::PlayerTank)) {
+        scene->removeObject(player->getEntityID());
+    }
+
+    scene->start();
+    scene->setPaused(false);
+
+    // Entity ids start again, so no old snapshot can be a baseline for a new one
+    history.clear();
+    currentLevel = level;
+    quantization = Quantization::forMap(Scene::getXLength(), Scene::getZLength());
+
+    GameEvent event;
+    event.kind = GameEvent::Kind::LevelChange;
+    event.level = level;
+
+    for (auto &client : clients) {
+        client->ackedTick = 0;
+        client->interest.clear();
+        client->views.clear();
+        sendEvent(*client, event);
+        spawn(*client);
+    }
+}
+
+void GameServer::stop() {
+    timer.stop();
+    transport.close();
+    clients.clear();
+    dropped.clear();
+}
+
+quint16 GameServer::getPort() const {
+    return transport.getPort();
+}
+
+size_t GameServer::getClientCount() const {
+    return clients.size();
+}
+
+const SnapshotHistory& GameServer::getHistory() const {
+    return history;
+}
+
+const Snapshot* GameServer::findView(uint32_t client, uint32_t tick) const {
+    for (const auto &other : clients) {
+        if (other->peer == client) {
+            return other->views.find(tick);
+        }
+    }
+
+    return nullptr;
+}
+
+const UdpTransport& GameServer::getTransport() const {
+    return transport;
+}
+
+quint64 GameServer::getSnapshotBytesSent() const {
+    return snapshotBytesSent;
+}
+
+void GameServer::onConnected(UdpTransport::PeerId peer) {
+    if (clients.size() >= maxClients) {
+        std::cerr << "GameServer: Turned away a client, the server is full\n";
+        transport.disconnectPeer(peer);
+        return;
+    }
+
+    auto client = std::make_unique<Client>();
+    client->peer = peer;
+    client->tank = noEntity;
+    client->respawnCountdown = 0;
+    client->lastApplied = 0;
+    client->ackedTick = 0;
+    client->focus = vec3(0.0f);
+
+    // The lowest spawn point nobody has
+    client->slot = 0;
+    while (std::any_of(clients.begin(), clients.end(), [&](const auto &other) { return other->slot == client->slot; })) {
+        client->slot++;
+    }
+
+    clients.push_back(std::move(client));
+    Client &added = *clients.back();
+
+    uint8_t welcome[NetProtocol::welcomeSize];
+    NetProtocol::writeWelcome(welcome, tickRate, added.peer);
+    sendReliable(added, NetProtocol::Message::Welcome, welcome, sizeof(welcome));
+
+    GameEvent event;
+    event.kind = GameEvent::Kind::LevelChange;
+    event.level = currentLevel;
+    sendEvent(added, event);
+
+    spawn(added);
+}
+
+void GameServer::onMessage(UdpTransport::PeerId peer, const MessageView &message) {
+    Client *client = findClient(peer);
+
+    if (client && message.type == (uint8_t)NetProtocol::Message::Input) {
+        uint32_t ackedTick;
+        uint32_t sequence;
+        TankInput input;
+
+        if (NetProtocol::readInput(message, ackedTick, sequence, input)) {
+            // Inputs arrive in order, but only ever move the baseline forward
+            client->ackedTick = std::max(client->ackedTick, ackedTick);
+
+            if (client->inputs.size() >= maxQueuedInputs) {
+                client->inputs.erase(client->inputs.begin());
+            }
+
+            client->inputs.emplace_back(sequence, input);
+        }
+    }
+}
+
+void GameServer::onTimer() {
+    const qint64 tickNanoseconds = 1000000000ll / tickRate;
+    int ticks = 0;
+
+    while (clock.nsecsElapsed() >= nextTickNanoseconds && ticks < maxCatchUpTicks) {
+        tick();
+        nextTickNanoseconds += tickNanoseconds;
+        ticks++;
+    }
+
+    // Too far behind to catch up, so let the missed ticks go
+    if (clock.nsecsElapsed() >= nextTickNanoseconds) {
+        nextTickNanoseconds = clock.nsecsElapsed() + tickNanoseconds;
+    }
+}
+
+void GameServer::tick() {
+    auto start = std::chrono::steady_clock::now();
+    Scene *scene = Scene::getInstance();
+
+    // Drive every tank by its client's next input, and bring back the destroyed ones
+    for (auto &client : clients) {
+        if (!client->inputs.empty()) {
+            client->lastApplied = client->inputs.front().first;
+            client->input = client->inputs.front().second;
+            client->inputs.erase(client->inputs.begin());
+        }
+
+        auto *tank = dynamic_cast<PlayerTank *>(client->tank != noEntity ? scene->getGameObject(client->tank) : nullptr);
+
+        if (tank && !tank->isQueuedForDestruction()) {
+            tank->setInput(client->input);
+            continue;
+        }
+
+        if (client->tank != noEntity) {
+            client->tank = noEntity;
+            client->respawnCountdown = respawnTicks;
+        }
+
+        if (--client->respawnCountdown <= 0) {
+            spawn(*client);
+        }
+    }
+
+    scene->update(tickDelta);
+
+    currentTick++;
+    Snapshot &snapshot = history.add(currentTick);
+    Snapshot::capture(*scene, currentTick, quantization, snapshot);
+    sendEvents(history.find(currentTick - 1), snapshot);
+    grid.build((float)Scene::getXLength(), (float)Scene::getZLength(), InterestSet::cellSize, snapshot.entities);
+
+    for (auto &client : clients) {
+        // A destroyed tank's client keeps watching from where it was, until they respawn
+        if (const EntityState *tank = snapshot.find(client->tank)) {
+            client->focus = tank->position;
+        }
+
+        Snapshot &view = client->views.add(currentTick);
+        view.quantization = snapshot.quantization;
+        client->interest.update(snapshot, grid, client->focus, client->tank, view);
+
+        // A baseline their views no longer have means a whole snapshot instead
+        Snapshot::writeDelta(client->views.find(client->ackedTick), view, deltaBuffer);
+
+        uint8_t header[NetProtocol::snapshotHeaderSize];
+        NetProtocol::writeSnapshotHeader(header, client->lastApplied);
+        deltaBuffer.insert(deltaBuffer.begin(), header, header + sizeof(header));
+
+        transport.sendUnreliable(client->peer, (quint8)NetProtocol::Message::Snapshot, deltaBuffer.data(), deltaBuffer.size());
+        snapshotBytesSent += MessageFrame::headerSize(deltaBuffer.size()) + deltaBuffer.size();
+    }
+
+    transport.flush();
+
+    for (UdpTransport::PeerId peer : dropped) {
+        transport.disconnectPeer(peer);
+        removeClient(peer);
+    }
+
+    dropped.clear();
+
+    auto end = std::chrono::steady_clock::now();
+    double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+    Profiler::getInstance()->addTiming(tickTiming, milliseconds);
+    emit ticked(currentTick, milliseconds);
+}
+
+void GameServer::spawn(GameServer::Client &client) {
+    Scene *scene = Scene::getInstance();
+    vec3 position = spawnPoint(client.slot);
+
+    // Face the middle of the map
+    vec3 direction = position == vec3(0.0f) ? vec3(1.0f, 0.0f, 0.0f) : glm::normalize(-position);
+
+    auto *tank = new PlayerTank(scene->getNextFreeEntityID(), position, direction);
+    tank->start();
+    scene->addObject(tank);
+
+    client.tank = tank->getEntityID();
+    client.respawnCountdown = 0;
+    client.focus = position;
+
+    uint8_t spawned[NetProtocol::spawnedSize];
+    NetProtocol::writeSpawned(spawned, client.tank);
+    sendReliable(client, NetProtocol::Message::Spawned, spawned, sizeof(spawned));
+}
+
+vec3 GameServer::spawnPoint(size_t slot) {
+    // Far enough in from the edge to not start out of the map, and far enough apart to not start touching
+    float radius = 0.4f * (float)std::min(Scene::getXLength(), Scene::getZLength());
+    float angle = glm::two_pi<float>() * (float)slot / (float)maxClients;
+
+    return vec3(radius * std::cos(angle), 0.0f, radius * std::sin(angle));
+}
+
+void GameServer::sendReliable(GameServer::Client &client, NetProtocol::Message type, const void *data, size_t size) {
+    if (!transport.sendReliable(client.peer, (quint8)type, data, size)) {
+        if (std::find(dropped.begin(), dropped.end(), client.peer) == dropped.end()) {
+            std::cerr << "GameServer: Dropped a client that stopped acknowledging messages\n";
+            dropped.push_back(client.peer);
+        }
+    }
+}
+
+void GameServer::sendEvents(const Snapshot *previous, const Snapshot &current) {
+    if (!previous || clients.empty()) {
+        return;
+    }
+
+    auto isTank = [](GameObjectType type) { return type == GameObjectType::PlayerTank || type == GameObjectType::EnemyTank; };
+    auto isProjectile = [](GameObjectType type) {
+        return type == GameObjectType::PlayerProjectile || type == GameObjectType::EnemyProjectile;
+    };
+
+    // Both are sorted by id, so walk them together
+    auto before = previous->entities.begin();
+    auto after = current.entities.begin();
+    GameEvent event;
+
+    while (before != previous->entities.end() || after != current.entities.end()) {
+        bool gone = after == current.entities.end() || (before != previous->entities.end() && before->id < after->id);
+        bool added = !gone && (before == previous->entities.end() || after->id < before->id);
+
+        if (gone) {
+            if (isTank(before->type)) {
+                event.kind = GameEvent::Kind::Death;
+                event.entity = before->id;
+                sendNearbyEvent(event, before->position);
+            }
+            ++before;
+        } else if (added) {
+            if (isProjectile(after->type)) {
+                event.kind = GameEvent::Kind::Shot;
+                event.entity = after->id;
+                sendNearbyEvent(event, after->position);
+            }
+            ++after;
+        } else {
+            ++before;
+            ++after;
+        }
+    }
+}
+
+void GameServer::sendEvent(GameServer::Client &client, const GameEvent &event) {
+    NetProtocol::writeEvent(eventBuffer, event);
+    sendReliable(client, NetProtocol::Message::Event, eventBuffer.data(), eventBuffer.size());
+}
+
+void GameServer::sendNearbyEvent(const GameEvent &event, const vec3 &position) {
+    for (auto &client : clients) {
+        // A client always hears about their own tank, wherever they're watching from
+        if (event.entity == client->tank || glm::distance(client->focus, position) <= InterestSet::viewDistance) {
+            sendEvent(*client, event);
+        }
+    }
+}
+
+void GameServer::removeClient(UdpTransport::PeerId peer) {
+    auto it = std::find_if(clients.begin(), clients.end(), [peer](const auto &client) {
+        return client->peer == peer;
+    });
+
+    if (it == clients.end()) {
+        return;
+    }
+
+    if ((*it)->tank != noEntity) {
+        if (GameObject *tank = Scene::getInstance()->getGameObject((*it)->tank)) {
+            tank->selfDestruct();
+        }
+    }
+
+    clients.erase(it);
+}
+
+GameServer::Client *GameServer::findClient(UdpTransport::PeerId peer) {
+    for (auto &client : clients) {
+        if (client->peer == peer) {
+            return client.get();
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,240 @@
+#ifndef TANKS_GAMESERVER_H
+#define TANKS_GAMESERVER_H
+
+#include "PlayerTank.h"
+#include "interestset.h"
+#include "netprotocol.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "spatialgrid.h"
+#include "udptransport.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * The dedicated server: it runs the Scene on its own, headless, and is the only one that decides what
+ * happens in it. Clients (GameClient) only send their controls, and draw what the server tells them.
+ *
+ * The Scene is updated at a fixed rate, tickRate times a second, with the same step Game::tick uses, so
+ * everything moves at the same speed as in a local game. If the server falls behind it runs the ticks
+ * it missed back to back, up to maxCatchUpTicks, and skips the rest rather than spiralling.
+ *
+ * Every client gets a PlayerTank of its own, and respawned a couple of seconds after it's destroyed. Its
+ * numbered inputs are queued as they arrive and applied one per tick, so the tank moves exactly as the
+ * client predicted (see TankPredictor), and each snapshot a client gets says the last one applied. If
+ * none is waiting the last is held, and if too many are the oldest are skipped. After each tick the
+ * server takes a Snapshot of the Scene, and sends each client the delta from the last snapshot that
+ * client acknowledged (see NetProtocol), so a client only receives what changed since it last heard.
+ *
+ * A client isn't sent the whole Scene, only what's near their tank, and the most pressing of that first
+ * (see InterestSet). The Scene's snapshot is sorted into a SpatialGrid once a tick, and each client's view
+ * is picked from that, and kept, since it's what their deltas are against. Events are only sent to
+ * clients close enough to see them.
+ *
+ * Everything goes over UDP (UdpTransport). Snapshots go unreliably, so a lost one doesn't hold up the
+ * next. Everything a client mustn't miss goes reliably: its tank's id, and the events the snapshots only
+ * show indirectly (shots, deaths and level changes, found by comparing each snapshot to the one before).
+ *
+ * How long each tick takes is recorded in the Profiler as "server tick", in milliseconds, and sent out
+ * with the ticked signal.
+ */
+class GameServer : public QObject {
+    Q_OBJECT
+public:
+    explicit GameServer(QObject *parent = nullptr);
+    ~GameServer() override;
+
+    /**
+     * Load a level into the Scene, start listening for clients, and start ticking
+     * @param level The level's name, as for Scene::load
+     * @param port The port to listen on, or 0 for any free one
+     * @return false if it couldn't listen on the port
+     */
+    bool start(const std::string& level, quint16 port);
+
+    /**
+     * Switch to another level. Every client is told, and respawned in it
+     * @param level The level's name, as for Scene::load
+     */
+    void changeLevel(const std::string& level);
+
+    /** Disconnect every client, and stop ticking */
+    void stop();
+
+    /** @return the port being listened on */
+    quint16 getPort() const;
+
+    /** @return how many clients are connected */
+    size_t getClientCount() const;
+
+    /** @return the Scene's recent snapshots, by tick */
+    const SnapshotHistory& getHistory() const;
+
+    /**
+     * @param client A client, by the id their Welcome gave them
+     * @param tick A recent tick
+     * @return what of the Scene was sent to them then, or nullptr if that's too long ago or there's no such client
+     */
+    const Snapshot* findView(uint32_t client, uint32_t tick) const;
+
+    /** @return the transport, for its per client statistics */
+    const UdpTransport& getTransport() const;
+
+    /** @return every byte of snapshot sent to every client so far, message headers included */
+    quint64 getSnapshotBytesSent() const;
+
+    /**
+     * @param slot A spawn point's number
+     * @return where it is, spread around a circle inside the map
+     */
+    static vec3 spawnPoint(size_t slot);
+
+    // Ticks per second
+    static const int constexpr tickRate = 60;
+
+    // How far a tick moves the Scene on, the same as a local game (see Game::tick)
+    static const float constexpr tickDelta = 60.0f / 1000;
+
+    // The most missed ticks run at once when the server falls behind
+    static const int constexpr maxCatchUpTicks = 5;
+
+    // How long a destroyed tank waits to respawn, in ticks
+    static const int constexpr respawnTicks = 2 * tickRate;
+
+    // The most clients at once, and so the number of spawn points
+    static const size_t constexpr maxClients = 64;
+
+    // The most inputs queued for a client. More means the client's clock runs fast, and skipping the oldest
+    // keeps them from lagging further and further behind
+    static const size_t constexpr maxQueuedInputs = 8;
+
+signals:
+    //Emitted after each tick, with how long it took in milliseconds, sending snapshots included
+    void ticked(quint32 tick, double milliseconds);
+
+private slots:
+    /**
+     * Take on a new client
+     * @param peer Who they are to the transport
+     */
+    void onConnected(UdpTransport::PeerId peer);
+
+    /**
+     * Handle a message from a client
+     * @param peer Who sent it
+     * @param message The message
+     */
+    void onMessage(UdpTransport::PeerId peer, const MessageView &message);
+
+    /** Run however many ticks are due */
+    void onTimer();
+
+private:
+    /** One connected client */
+    struct Client {
+        UdpTransport::PeerId peer;
+        // Which spawn point is theirs
+        size_t slot;
+        // Their tank, or noEntity while they wait to respawn
+        uint32_t tank;
+        int respawnCountdown;
+        // The inputs waiting to be applied, oldest first, and the last one applied
+        std::vector<std::pair<uint32_t, TankInput>> inputs;
+        TankInput input;
+        uint32_t lastApplied;
+        // The newest snapshot they have
+        uint32_t ackedTick;
+        // What they're sent, where they see it from, and what they were sent recently, for their baselines
+        InterestSet interest;
+        vec3 focus;
+        SnapshotHistory views;
+    };
+
+    /** Update the Scene one step, and send everyone the result */
+    void tick();
+
+    /**
+     * Give a client a new tank at their spawn point, and tell them which it is
+     * @param client The client
+     */
+    void spawn(Client &client);
+
+    /**
+     * Send a client something they mustn't miss. One with too much unacknowledged is dropped at the end of the
+     * tick, since they'd otherwise miss it
+     * @param client The client
+     * @param type The message's type
+     * @param data Its payload
+     * @param size Its size
+     */
+    void sendReliable(Client &client, NetProtocol::Message type, const void *data, size_t size);
+
+    /**
+     * Tell the clients what happened between two snapshots: what fired, and which tanks were destroyed
+     * @param previous The snapshot before, or nullptr if there isn't one
+     * @param current The new snapshot
+     */
+    void sendEvents(const Snapshot *previous, const Snapshot &current);
+
+    /**
+     * Tell a client about an event
+     * @param client The client
+     * @param event The event
+     */
+    void sendEvent(Client &client, const GameEvent &event);
+
+    /**
+     * Tell every client close enough to see it about an event
+     * @param event The event
+     * @param position Where it happened
+     */
+    void sendNearbyEvent(const GameEvent &event, const vec3 &position);
+
+    /**
+     * Forget a client, and destroy their tank
+     * @param peer Who they are to the transport
+     */
+    void removeClient(UdpTransport::PeerId peer);
+
+    /**
+     * @param peer Who someone is to the transport
+     * @return the client, or nullptr if they aren't one
+     */
+    Client *findClient(UdpTransport::PeerId peer);
+
+    UdpTransport transport;
+    std::vector<std::unique_ptr<Client>> clients;
+    // Clients to drop once nothing is looping over them
+    std::vector<UdpTransport::PeerId> dropped;
+    std::string currentLevel;
+
+    // The fixed step clock: the timer wakes the server up, and the elapsed timer says how many ticks are due
+    QTimer timer;
+    QElapsedTimer clock;
+    qint64 nextTickNanoseconds = 0;
+    uint32_t currentTick = 0;
+
+    SnapshotHistory history;
+    // How precisely snapshots are sent, for the current level's map
+    Quantization quantization;
+    // The newest snapshot's entities, by where they are on the map
+    SpatialGrid grid;
+    // Reused for every client's delta and every event, so sending allocates nothing once they've grown
+    std::vector<uint8_t> deltaBuffer;
+    std::vector<uint8_t> eventBuffer;
+    quint64 snapshotBytesSent = 0;
+
+    // The Profiler slot each tick's time is recorded in
+    Profiler::TimingSlot tickTiming;
+
+    static const uint32_t constexpr noEntity = UINT32_MAX;
+};
+
+#endif //TANKS_GAMESERVER_H
@@ -9,6 +9,7 @@
  * @time Spring 2024
  * @brief GameWindow: Constructor
  * @details Constructor for the GameWindow class. Initializes the MenuManager, QWindow, Renderer, and widgetCache.
+ * Every widget is added to a QStackedWidget once, which stays the central widget from then on.
  */
 GameWindow::GameWindow(QObject *parent, int startKey)
 {
@@ -27,9 +28,15 @@ GameWindow::GameWindow(QObject *parent, int startKey)
             {LEVEL_MENU_KEY, levelMenu}
     };
 
+    stack = new QStackedWidget(this);
+    for (auto& pair : widgets) {
+        stack->addWidget(pair.second);
+    }
+    this->setCentralWidget(stack);
+
     activeKey = startKey;
 
-    changeWidget(activeKey);
+    displayWidget();
 
     this->create();
 }
@@ -38,22 +45,16 @@ GameWindow::GameWindow(QObject *parent, int startKey)
  * @author Luna Steed
  * @time Spring 2024
  * @brief changeWidget: Changes the active QWidget
- * @details This method changes the active QWidget. It hides the current widget and displays the new widget.
+ * @details This method changes the active QWidget. It brings the new widget to the front of the stack; the old
+ * one stays alive (and keeps any GPU resources) behind it.
  * @return QWidget* The active widget
  * @param key
  */
 QWidget* GameWindow::changeWidget(int key)
 {
-    if (key == activeKey) { // Don't change if already active
-        displayWidget();
-        return widgets.at(activeKey);
-    }
-    else {
-        hideWidget(); // Hide current widget
-        activeKey = key;
-        displayWidget(); // Display new widget
-        return widgets.at(activeKey);
-    }
+    activeKey = key;
+    displayWidget();
+    return widgets.at(activeKey);
 }
 
 /**
@@ -65,26 +66,7 @@ void GameWindow::displayWidget()
 {
     try {
         QWidget* wpoint = widgets.at(activeKey);
-        this->setCentralWidget(wpoint);
-        wpoint->setParent(this);
-    }
-    catch(std::exception& e) {
-        std::cerr << "Error encountered in GameWindow: " << e.what() << std::endl;
-        throw e;
-    }
-}
-
-/**
- * @author Luna Steed
- * @time Spring 2024
- * @brief hideWidget: Hide the active widget
- */
-void GameWindow::hideWidget()
-{
-    try {
-        QWidget *wpoint = widgets.at(activeKey);
-        wpoint->setParent(nullptr);
-        this->setCentralWidget(nullptr);
+        stack->setCurrentWidget(wpoint);
     }
     catch(std::exception& e) {
         std::cerr << "Error encountered in GameWindow: " << e.what() << std::endl;
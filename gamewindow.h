@@ -8,6 +8,7 @@
 #include "levelmenu.h"
 
 #include <QMainWindow>
+#include <QStackedWidget>
 #include <unordered_map>
 #include <iostream>
 
@@ -31,6 +32,11 @@ private:
     GameOver *gameOver;
     LevelMenu* levelMenu;
 
+    // Every widget lives in this stack for the window's whole lifetime, and switching just changes
+    // which one is visible. The renderer is never reparented, so its GL context (and every shader,
+    // mesh and texture in it) survives pausing, resuming and going back to the menus
+    QStackedWidget* stack;
+
     std::unordered_map<int, QWidget *> widgets;
     int activeKey;
 
@@ -40,7 +46,6 @@ public:
     QWidget* changeWidget(int key);
     QWidget* getWidget(int key);
     void displayWidget();
-    void hideWidget();
 
 public slots:
     void keyPressEvent(QKeyEvent *event) override;
@@ -0,0 +1,131 @@
+#include "gputimer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+GpuTimer::GpuTimer(std::vector<std::string> passNames) {
+    QOpenGLExtraFunctions::initializeOpenGLFunctions();
+
+    for(const auto& name : passNames) {
+        timingSlots.push_back(Profiler::getInstance()->registerTiming("gpu " + name));
+    }
+
+    frameSlot = Profiler::getInstance()->registerTiming("gpu frame");
+
+    slots.resize(ringSize);
+
+    for(auto& slot : slots) {
+        slot.queries.resize(passNames.size());
+        slot.used.resize(passNames.size());
+        glGenQueries((int)slot.queries.size(), slot.queries.data());
+    }
+}
+
+GpuTimer::~GpuTimer() {
+    for(auto& slot : slots) {
+        glDeleteQueries((int)slot.queries.size(), slot.queries.data());
+    }
+}
+
+bool GpuTimer::collect(GpuTimer::Slot& slot, bool wait) {
+    // Queries finish in the order they were issued, so once the last one is ready they all are
+    for(size_t i = slot.queries.size(); !wait && i-- > 0;) {
+        if (!slot.used[i]) { continue; }
+
+        unsigned int available = 0;
+        glGetQueryObjectuiv(slot.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available) {
+            return false;
+        }
+
+        break;
+    }
+
+    double frameMilliseconds = 0.0;
+
+    for(size_t i = 0; i < slot.queries.size(); i++) {
+        if (!slot.used[i]) { continue; }
+
+        unsigned int nanoseconds = 0;
+        glGetQueryObjectuiv(slot.queries[i], GL_QUERY_RESULT, &nanoseconds);
+
+        double milliseconds = nanoseconds / 1.0e6;
+        frameMilliseconds += milliseconds;
+        Profiler::getInstance()->addTiming(timingSlots[i], milliseconds);
+    }
+
+    Profiler::getInstance()->addTiming(frameSlot, frameMilliseconds);
+
+    slot.pending = false;
+    return true;
+}
+
+void GpuTimer::beginFrame() {
+    if (timing) {
+        std::cerr << "GpuTimer: beginFrame called during a pass\n";
+        end();
+    }
+
+    // Collect the finished frames, oldest first, stopping at the first the GPU is still working on
+    for(size_t i = 0; i < slots.size(); i++) {
+        Slot& slot = slots[(next + i) % slots.size()];
+
+        if (slot.pending && !collect(slot)) {
+            break;
+        }
+    }
+
+    // If the oldest slot still hasn't come back, the ring is full, and this frame goes untimed
+    if (slots[next].pending) {
+        current = -1;
+        return;
+    }
+
+    current = (int)next;
+    next = (next + 1) % slots.size();
+
+    std::fill(slots[current].used.begin(), slots[current].used.end(), false);
+}
+
+void GpuTimer::flush() {
+    end();
+
+    for(size_t i = 0; i < slots.size(); i++) {
+        Slot& slot = slots[(next + i) % slots.size()];
+
+        if (slot.pending) {
+            collect(slot, true);
+        }
+    }
+}
+
+void GpuTimer::begin(size_t pass) {
+    if (current < 0 || pass >= timingSlots.size()) {
+        return;
+    }
+
+    if (timing) {
+        end();
+    }
+
+    Slot& slot = slots[current];
+
+    glBeginQuery(GL_TIME_ELAPSED, slot.queries[pass]);
+    slot.used[pass] = true;
+    slot.pending = true;
+    timing = true;
+}
+
+void GpuTimer::end() {
+    if (!timing) {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+    timing = false;
+}
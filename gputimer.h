@@ -0,0 +1,89 @@
+#ifndef TANKS_GPUTIMER_H
+#define TANKS_GPUTIMER_H
+
+#include <QOpenGLExtraFunctions>
+
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+/**
+ * Measures how long the GPU spends on each pass of a frame, with GL_TIME_ELAPSED queries.
+ *
+ * Query results only arrive once the GPU catches up, which is usually a frame or two after the
+ * draw calls were made. Waiting for them would stall the CPU until the GPU finishes, so each frame
+ * gets its own set of queries from a small ring, and beginFrame collects whichever earlier frames
+ * have finished without waiting on any. If the GPU falls so far behind that the ring is full, that
+ * frame simply isn't timed.
+ *
+ * Finished timings go to the Profiler as "gpu <pass>", plus "gpu frame" for the sum of the passes.
+ *
+ * Like the other GL classes, it must be created and destroyed with the context current.
+ *
+ *  GpuTimer timer({"ground", "skybox"});
+ *  timer.beginFrame();
+ *  timer.begin(0); drawGround(); timer.end();
+ *  timer.begin(1); drawSkybox(); timer.end();
+ */
+class GpuTimer : private QOpenGLExtraFunctions {
+public:
+    /**
+     * Create the query objects
+     * @param passNames The name of each pass, in the order of their indices
+     */
+    explicit GpuTimer(std::vector<std::string> passNames);
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer& other) = delete;
+    GpuTimer& operator=(const GpuTimer& other) = delete;
+
+    /** Collect any finished frames, and pick the queries for this one. Call before the first pass */
+    void beginFrame();
+
+    /**
+     * Start timing a pass. Passes can't overlap
+     * @param pass The index of the pass
+     */
+    void begin(size_t pass);
+
+    /** Stop timing the current pass */
+    void end();
+
+    /** Wait for every frame still on the GPU and record its timings. This stalls, so it's only for tools */
+    void flush();
+
+private:
+    /** The queries for one frame */
+    struct Slot {
+        std::vector<unsigned int> queries;
+        // Which passes were timed in the frame using this slot
+        std::vector<bool> used;
+        // Whether the slot has queries the GPU hasn't answered yet
+        bool pending = false;
+    };
+
+    /**
+     * Read a slot's results, if the GPU has finished them
+     * @param slot The slot to check
+     * @param wait Whether to wait for the results instead of giving up if they're not ready
+     * @return false if the results aren't ready yet
+     */
+    bool collect(Slot& slot, bool wait = false);
+
+    // The Profiler slots the results are recorded in, e.g. "gpu ground", and "gpu frame" for their sum
+    std::vector<Profiler::TimingSlot> timingSlots;
+    Profiler::TimingSlot frameSlot;
+    std::vector<Slot> slots;
+    // The slot for the current frame, or -1 if this frame isn't being timed
+    int current = -1;
+    // The next slot to use. Slots are used in order, so this is also the oldest one
+    size_t next = 0;
+    // Whether a query is running
+    bool timing = false;
+
+    // Enough frames for the GPU to run a few behind without the ring filling up
+    static const size_t constexpr ringSize = 4;
+};
+
+#endif //TANKS_GPUTIMER_H
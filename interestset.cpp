@@ -0,0 +1,93 @@
+#include "interestset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void InterestSet::update(const Snapshot& world, const SpatialGrid& grid, const glm::vec3& focus, uint32_t ownTank, Snapshot& view) {
+    grid.query(focus, viewDistance + dropMargin, nearby);
+    next.clear();
+    candidates.clear();
+
+    // Both are in id order, so walk them together. Anything tracked that the grid didn't find has gone
+    // out of range, or out of the world
+    auto old = tracked.begin();
+
+    for(uint32_t index : nearby) {
+        const EntityState& current = world.entities[index];
+
+        while (old != tracked.end() && old->state.id < current.id) {
+            ++old;
+        }
+
+        bool known = old != tracked.end() && old->state.id == current.id;
+        float distance = std::hypot(current.position.x - focus.x, current.position.z - focus.z);
+
+        // The margin only keeps what's already tracked
+        if (!known && distance > viewDistance && current.id != ownTank) {
+            continue;
+        }
+
+        Tracked entry = known ? *old : Tracked{current, 0.0f, false, 0};
+        entry.index = index;
+
+        // Priority only builds up while there's something waiting to be sent
+        if (entry.sent && entry.state == current) {
+            entry.priority = 0.0f;
+        } else {
+            if (current.id == ownTank) {
+                entry.priority = std::numeric_limits<float>::max();
+            } else {
+                entry.priority += importance(current.type) * std::max(edgeFalloff, 1.0f - distance / viewDistance);
+            }
+
+            candidates.push_back((uint32_t)next.size());
+        }
+
+        next.push_back(entry);
+    }
+
+    if (candidates.size() > updateBudget) {
+        std::nth_element(candidates.begin(), candidates.begin() + updateBudget, candidates.end(), [this](uint32_t a, uint32_t b) {
+            return next[a].priority > next[b].priority;
+        });
+
+        candidates.resize(updateBudget);
+    }
+
+    for(uint32_t candidate : candidates) {
+        Tracked& entry = next[candidate];
+        entry.state = world.entities[entry.index];
+        entry.sent = true;
+        entry.priority = 0.0f;
+    }
+
+    view.entities.clear();
+
+    for(const Tracked& entry : next) {
+        if (entry.sent) {
+            view.entities.push_back(entry.state);
+        }
+    }
+
+    std::swap(tracked, next);
+}
+
+void InterestSet::clear() {
+    tracked.clear();
+}
+
+float InterestSet::importance(GameObjectType type) {
+    switch (type) {
+        // Fast, short lived, and what the player has to dodge
+        case GameObjectType::PlayerProjectile:
+        case GameObjectType::EnemyProjectile:
+            return 3.0f;
+        case GameObjectType::PlayerTank:
+        case GameObjectType::EnemyTank:
+            return 2.0f;
+        // They never move, so this only decides how soon a new one shows up
+        default:
+            return 0.5f;
+    }
+}
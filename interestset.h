@@ -0,0 +1,88 @@
+#ifndef TANKS_INTERESTSET_H
+#define TANKS_INTERESTSET_H
+
+#include "snapshot.h"
+#include "spatialgrid.h"
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * What one client is sent of the world, so the server's snapshot bandwidth per client depends on what's
+ * around them rather than on the size of the map or the number of players.
+ *
+ * Only entities within viewDistance of the client (usually their tank) are relevant, found with a
+ * SpatialGrid. Each one relevant keeps a priority, which grows every tick by its type's importance, and
+ * more the closer it is. Of the relevant entities that have changed since the client was last sent them,
+ * only the updateBudget with the highest priority are sent each tick, and theirs goes back to 0. The rest
+ * keep their last sent state, and climb the queue, so something far away or unimportant still gets
+ * through, just less often. The client's own tank goes first every tick, since prediction needs it.
+ *
+ * Something already being sent is only dropped once it's dropMargin past the view distance, so an entity
+ * on the edge doesn't flicker in and out. Dropped entities simply aren't in the view any more, so the
+ * snapshot delta removes them from the client.
+ *
+ * The view is a Snapshot like any other, and the server deltas each client's views against the one they
+ * acknowledged, the same way it would the whole world.
+ */
+class InterestSet {
+public:
+    /**
+     * Choose what a client is sent this tick
+     * @param world Every entity, this tick
+     * @param grid A grid built from world's entities
+     * @param focus Where the client sees from
+     * @param ownTank The client's tank, or UINT32_MAX if they don't have one
+     * @param view Set to what the client should have after this tick: each entity of interest to them, as
+     *             it was last sent. Its tick is left alone, and its memory is reused
+     */
+    void update(const Snapshot& world, const SpatialGrid& grid, const glm::vec3& focus, uint32_t ownTank, Snapshot& view);
+
+    /** Forget everything, for when entity ids start again */
+    void clear();
+
+    /**
+     * @param type An entity's type
+     * @return how much its priority grows each tick, at the closest
+     */
+    static float importance(GameObjectType type);
+
+    // How far a client can see, in units. A level is 30 across
+    static const float constexpr viewDistance = 12.0f;
+
+    // How far past viewDistance something already being sent is dropped
+    static const float constexpr dropMargin = 2.0f;
+
+    // The side of a SpatialGrid cell the server builds, so a query covers about 5 by 5 of them
+    static const float constexpr cellSize = 6.0f;
+
+    // The most entities updated for a client each tick, own tank included
+    static const size_t constexpr updateBudget = 24;
+
+    // The share of its importance something at the edge of the view still gains each tick
+    static const float constexpr edgeFalloff = 0.25f;
+
+private:
+    /** One entity of interest */
+    struct Tracked {
+        // As the client was last sent it
+        EntityState state;
+        float priority;
+        // Whether it's been sent at all
+        bool sent;
+        // Where it is in this tick's world
+        uint32_t index;
+    };
+
+    // Sorted by id
+    std::vector<Tracked> tracked;
+    // Reused each tick: the next tracked, the grid's answer, and which of next have changed
+    std::vector<Tracked> next;
+    std::vector<uint32_t> nearby;
+    std::vector<uint32_t> candidates;
+};
+
+#endif //TANKS_INTERESTSET_H
@@ -1,6 +1,10 @@
 #include "game.h"
+#include "profiler.h"
 
 int main(int argc, char** argv) {
+    // Create the profiler first, so startup timings are measured from here
+    Profiler::getInstance();
+
     Game* game = Game::getInstance(argc, argv);
     int code = game->start();
     Game::destroyInstance();
@@ -0,0 +1,412 @@
+#include "mesharena.h"
+
+#include <QOpenGLContext>
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// How many instances the instance buffer holds before it first has to grow
+static const size_t INITIAL_INSTANCE_CAPACITY = 256;
+
+RangeAllocator::RangeAllocator(uint32_t capacity) : capacity(0) {
+    grow(capacity);
+}
+
+bool RangeAllocator::allocate(uint32_t size, uint32_t& offset) {
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+
+    for(auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second < size) { continue; }
+
+        offset = it->first;
+        uint32_t remaining = it->second - size;
+        freeRanges.erase(it);
+
+        if (remaining > 0) {
+            freeRanges[offset + size] = remaining;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void RangeAllocator::release(uint32_t offset, uint32_t size) {
+    if (size == 0) { return; }
+
+    auto it = freeRanges.emplace(offset, size).first;
+
+    // Merge with the following range, then the preceding one
+    auto next = std::next(it);
+    if (next != freeRanges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        freeRanges.erase(next);
+    }
+
+    if (it != freeRanges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            freeRanges.erase(it);
+        }
+    }
+}
+
+void RangeAllocator::grow(uint32_t newCapacity) {
+    if (newCapacity <= capacity) { return; }
+
+    uint32_t oldCapacity = capacity;
+    capacity = newCapacity;
+    release(oldCapacity, newCapacity - oldCapacity);
+}
+
+MeshArena::MeshArena(uint32_t vertexCapacity, uint32_t indexCapacity) :
+    vertexSpace(vertexCapacity), indexSpace(indexCapacity) {
+    QOpenGLExtraFunctions::initializeOpenGLFunctions();
+
+    multiDrawElementsIndirect = reinterpret_cast<MultiDrawElementsIndirect>(
+        QOpenGLContext::currentContext()->getProcAddress("glMultiDrawElementsIndirect"));
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &indirectBuffer);
+
+    // The copy targets are used for everything outside of drawing, since binding the element array
+    // buffer directly would change whatever vertex array happens to be bound
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * stride, nullptr, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * sizeof(uint16_t), nullptr, GL_STATIC_DRAW);
+
+    instanceBufferBytes = INITIAL_INSTANCE_CAPACITY * sizeof(MeshInstance);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, instanceBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)instanceBufferBytes, nullptr, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    setupVertexArray();
+}
+
+MeshArena::~MeshArena() {
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &indirectBuffer);
+    glDeleteVertexArrays(1, &vao);
+}
+
+void MeshArena::setupVertexArray() {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+    // The packed layout: position, then half float texture coordinates, then the 10:10:10:2 normal,
+    // which is normalized so the shader still sees a vec3 in -1 to 1
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(3 * sizeof(float) + 2 * sizeof(uint16_t)));
+    glEnableVertexAttribArray(2);
+
+    // The instance data advances once per instance rather than per vertex. The position and yaw are
+    // read together as one vec4
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (void*)offsetof(MeshInstance, position));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (void*)offsetof(MeshInstance, scale));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
+    // The type is an integer, so it goes through the I variant to reach the shader unconverted
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(MeshInstance), (void*)offsetof(MeshInstance, type));
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshArena::growBuffer(unsigned int& buffer, size_t oldBytes, size_t newBytes) {
+    unsigned int grown = 0;
+    glGenBuffers(1, &grown);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newBytes, nullptr, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)oldBytes);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &buffer);
+    buffer = grown;
+}
+
+/**
+ * Write one vertex of a mesh in the arena's layout
+ * @param view The mesh, in any layout
+ * @param vertex Which vertex
+ * @param dst Where to write it, MeshArena::stride bytes
+ */
+static void convertVertex(const MeshView& view, uint32_t vertex, unsigned char* dst) {
+    const auto* src = static_cast<const unsigned char*>(view.vertices) + (size_t)vertex * view.stride;
+
+    std::memcpy(dst, src, 3 * sizeof(float));
+    dst += 3 * sizeof(float);
+    src += 3 * sizeof(float);
+
+    uint16_t uv[2] = {0, 0};
+
+    if ((view.attributes & MeshHasTexCoords) && (view.attributes & MeshHalfTexCoords)) {
+        std::memcpy(uv, src, sizeof(uv));
+        src += sizeof(uv);
+    }
+    else if (view.attributes & MeshHasTexCoords) {
+        float full[2];
+        std::memcpy(full, src, sizeof(full));
+        uv[0] = glm::packHalf1x16(full[0]);
+        uv[1] = glm::packHalf1x16(full[1]);
+        src += sizeof(full);
+    }
+
+    std::memcpy(dst, uv, sizeof(uv));
+    dst += sizeof(uv);
+
+    uint32_t normal = 0;
+
+    if ((view.attributes & MeshHasNormals) && (view.attributes & MeshPackedNormals)) {
+        std::memcpy(&normal, src, sizeof(normal));
+    }
+    else if (view.attributes & MeshHasNormals) {
+        glm::vec3 n;
+        std::memcpy(&n, src, sizeof(n));
+
+        if (glm::length(n) > 0.0f) {
+            n = glm::normalize(n);
+        }
+
+        normal = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+    }
+
+    std::memcpy(dst, &normal, sizeof(normal));
+}
+
+void MeshArena::convert(const MeshView& view, std::vector<unsigned char>& vertices, std::vector<uint16_t>& indices, std::vector<MeshArena::Part>& parts) {
+    const uint32_t maxPartVertices = std::numeric_limits<uint16_t>::max() + 1u;
+
+    auto index = [&view](uint32_t i) -> uint32_t {
+        if (view.indexSize == sizeof(uint16_t)) { return static_cast<const uint16_t*>(view.indices)[i]; }
+        return static_cast<const uint32_t*>(view.indices)[i];
+    };
+
+    vertices.clear();
+    indices.clear();
+    parts.clear();
+
+    vertices.reserve((size_t)view.vertexCount * stride);
+    indices.reserve(view.indexCount);
+
+    // Each part numbers its vertices from 0 in the order they're first used. For a mesh that fits in
+    // one part, that's the order the optimizer already put them in, so nothing moves. A larger mesh
+    // is cut between triangles whenever the next one would need a vertex past what 16 bits can
+    // address, and vertices shared across a cut are duplicated
+    std::vector<uint32_t> partOf(view.vertexCount, std::numeric_limits<uint32_t>::max());
+    std::vector<uint16_t> local(view.vertexCount, 0);
+
+    uint32_t part = 0;
+    uint32_t partVertices = 0;
+    parts.push_back({0, 0, 0});
+
+    for(uint32_t t = 0; t + 2 < view.indexCount; t += 3) {
+        uint32_t corners[3] = {index(t), index(t + 1), index(t + 2)};
+
+        uint32_t added = 0;
+        for(uint32_t c = 0; c < 3; c++) {
+            if (corners[c] >= view.vertexCount) {
+                throw std::runtime_error("MeshArena: Mesh has an index past its last vertex");
+            }
+
+            bool repeated = (c > 0 && corners[c] == corners[0]) || (c > 1 && corners[c] == corners[1]);
+            if (partOf[corners[c]] != part && !repeated) { added++; }
+        }
+
+        if (partVertices + added > maxPartVertices) {
+            part++;
+            partVertices = 0;
+            parts.push_back({0, (uint32_t)indices.size(), (int32_t)(vertices.size() / stride)});
+        }
+
+        for(uint32_t vertex : corners) {
+            if (partOf[vertex] != part) {
+                partOf[vertex] = part;
+                local[vertex] = (uint16_t)partVertices++;
+
+                vertices.resize(vertices.size() + stride);
+                convertVertex(view, vertex, &vertices[vertices.size() - stride]);
+            }
+
+            indices.push_back(local[vertex]);
+            parts.back().indexCount++;
+        }
+    }
+}
+
+MeshArena::MeshId MeshArena::add(const MeshView& view) {
+    std::vector<unsigned char> vertices;
+    std::vector<uint16_t> indices;
+    Record record;
+
+    convert(view, vertices, indices, record.parts);
+
+    record.vertexCount = (uint32_t)(vertices.size() / stride);
+    record.indexCount = (uint32_t)indices.size();
+    record.boundsMin = view.boundsMin;
+    record.boundsMax = view.boundsMax;
+
+    // Grow (at least doubling, so adding many meshes stays linear) until the space fits
+    while (!vertexSpace.allocate(record.vertexCount, record.vertexOffset)) {
+        uint32_t capacity = vertexSpace.getCapacity();
+        uint32_t grown = std::max(capacity * 2, capacity + record.vertexCount);
+
+        growBuffer(vbo, (size_t)capacity * stride, (size_t)grown * stride);
+        vertexSpace.grow(grown);
+        setupVertexArray();
+    }
+
+    while (!indexSpace.allocate(record.indexCount, record.indexOffset)) {
+        uint32_t capacity = indexSpace.getCapacity();
+        uint32_t grown = std::max(capacity * 2, capacity + record.indexCount);
+
+        growBuffer(ebo, (size_t)capacity * sizeof(uint16_t), (size_t)grown * sizeof(uint16_t));
+        indexSpace.grow(grown);
+        setupVertexArray();
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)record.vertexOffset * stride, (GLsizeiptr)vertices.size(), vertices.data());
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)record.indexOffset * sizeof(uint16_t), (GLsizeiptr)(indices.size() * sizeof(uint16_t)), indices.data());
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    for(auto& part : record.parts) {
+        part.firstIndex += record.indexOffset;
+        part.baseVertex += (int32_t)record.vertexOffset;
+    }
+
+    MeshId id;
+
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        records[id] = std::move(record);
+    }
+    else {
+        id = (MeshId)records.size();
+        records.push_back(std::move(record));
+    }
+
+    return id;
+}
+
+void MeshArena::remove(MeshArena::MeshId id) {
+    if (id >= records.size() || records[id].parts.empty()) {
+        return;
+    }
+
+    Record& record = records[id];
+    vertexSpace.release(record.vertexOffset, record.vertexCount);
+    indexSpace.release(record.indexOffset, record.indexCount);
+
+    record = Record();
+    freeIds.push_back(id);
+}
+
+const MeshArena::Record* MeshArena::get(MeshArena::MeshId id) const {
+    if (id >= records.size() || records[id].parts.empty()) {
+        return nullptr;
+    }
+
+    return &records[id];
+}
+
+void MeshArena::bind() {
+    glBindVertexArray(vao);
+}
+
+void MeshArena::draw(MeshArena::MeshId id) {
+    const Record* record = get(id);
+    if (!record) { return; }
+
+    for(const auto& part : record->parts) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)part.indexCount, GL_UNSIGNED_SHORT,
+                                 (void*)((size_t)part.firstIndex * sizeof(uint16_t)), part.baseVertex);
+    }
+}
+
+size_t MeshArena::appendCommands(MeshArena::MeshId id, uint32_t instance, std::vector<DrawElementsIndirectCommand>& commands) const {
+    const Record* record = get(id);
+    if (!record) { return 0; }
+
+    for(const auto& part : record->parts) {
+        commands.push_back({part.indexCount, 1, part.firstIndex, part.baseVertex, instance});
+    }
+
+    return record->parts.size();
+}
+
+void MeshArena::upload(const std::vector<MeshInstance>& instances, const std::vector<DrawElementsIndirectCommand>& commands) {
+    size_t instanceBytes = instances.size() * sizeof(MeshInstance);
+    size_t commandBytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+
+    // Growing keeps the same buffer names, so the vertex array doesn't need setting up again.
+    // Respecifying the storage each frame also orphans last frame's, so the GPU can keep reading
+    // it while this frame's is written
+    instanceBufferBytes = std::max(instanceBufferBytes, instanceBytes);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, instanceBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)instanceBufferBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)instanceBytes, instances.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    indirectBufferBytes = std::max(indirectBufferBytes, commandBytes);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)indirectBufferBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, (GLsizeiptr)commandBytes, commands.data());
+}
+
+void MeshArena::multiDraw(size_t first, size_t count) {
+    if (count == 0) { return; }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+
+    size_t offset = first * sizeof(DrawElementsIndirectCommand);
+
+    if (multiDrawElementsIndirect) {
+        multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (const void*)offset, (GLsizei)count, sizeof(DrawElementsIndirectCommand));
+        return;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (const void*)(offset + i * sizeof(DrawElementsIndirectCommand)));
+    }
+}
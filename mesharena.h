@@ -0,0 +1,225 @@
+#ifndef TANKS_MESHARENA_H
+#define TANKS_MESHARENA_H
+
+#include <QOpenGLExtraFunctions>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "meshdata.h"
+
+/**
+ * Hands out ranges of a fixed size space (in elements, not bytes), first fit, merging ranges back
+ * together as they're released. Used for the arena's vertex and index buffers.
+ */
+class RangeAllocator {
+    // Free ranges, by offset, with their sizes
+    std::map<uint32_t, uint32_t> freeRanges;
+    uint32_t capacity = 0;
+public:
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    /**
+     * Take a range
+     * @param size How many elements it needs
+     * @param offset Set to where the range starts
+     * @return false if there's no free range large enough
+     */
+    bool allocate(uint32_t size, uint32_t& offset);
+
+    /**
+     * Give a range back
+     * @param offset Where the range starts
+     * @param size How many elements it has
+     */
+    void release(uint32_t offset, uint32_t size);
+
+    /**
+     * Extend the space. The new elements start out free
+     * @param newCapacity The new size, larger than the current one
+     */
+    void grow(uint32_t newCapacity);
+
+    /** @return the size of the space */
+    uint32_t getCapacity() const { return capacity; }
+};
+
+/**
+ * One large vertex buffer and index buffer that every mesh is sub-allocated from, all described by a
+ * single vertex array. Drawing anything only needs the arena bound once, and many meshes can be drawn
+ * with one glMultiDrawElementsIndirect call, each command picking its mesh by offsets into the buffers.
+ *
+ * Everything in the arena shares one vertex layout, the MeshOptimizer's packed one (float position,
+ * half float texture coordinates, 10:10:10:2 normal), and 16 bit indices relative to each mesh's
+ * base vertex. Meshes in other layouts are converted when added, and meshes too large for 16 bit
+ * indices are split into several parts.
+ *
+ * The arena also owns the per-instance buffer: each indirect command's baseInstance selects the
+ * MeshInstance (placement and type) that command draws with.
+ *
+ * Like the other GL classes, it must be created and destroyed with the context current.
+ */
+class MeshArena : private QOpenGLExtraFunctions {
+public:
+    using MeshId = uint32_t;
+
+    // An id no mesh ever has, for meshes that failed to load. Drawing it draws nothing
+    static const MeshId constexpr invalidMesh = ~0u;
+
+    /** The layout glMultiDrawElementsIndirect reads its commands in */
+    struct DrawElementsIndirectCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    /**
+     * The per-instance data, read by the vertex shader through attributes 3 to 5. Everything in the game
+     * stands upright, so a position, a rotation about the up axis and a scale place it, and the shader
+     * builds the rotation from the yaw. 24 bytes, where a model matrix alone would be 64
+     */
+    struct MeshInstance {
+        glm::vec3 position;
+        // Radians about the up axis, where 0 faces +Z
+        float yaw;
+        float scale;
+        // What kind of object it is, which the shader looks its color and texture up by
+        uint32_t type;
+    };
+
+    /** A piece of a mesh that can be drawn with one command */
+    struct Part {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+    };
+
+    /** Where a mesh lives in the arena */
+    struct Record {
+        std::vector<Part> parts;
+        uint32_t vertexOffset = 0;
+        uint32_t vertexCount = 0;
+        uint32_t indexOffset = 0;
+        uint32_t indexCount = 0;
+        glm::vec3 boundsMin = glm::vec3(0.0f);
+        glm::vec3 boundsMax = glm::vec3(0.0f);
+
+        /** @return how many triangles drawing the whole mesh submits */
+        uint32_t triangleCount() const { return indexCount / 3; }
+    };
+
+    /**
+     * Create the buffers, with room for some geometry to start with. They grow as needed
+     * @param vertexCapacity How many vertices fit before the vertex buffer grows
+     * @param indexCapacity How many indices fit before the index buffer grows
+     */
+    explicit MeshArena(uint32_t vertexCapacity = 1 << 16, uint32_t indexCapacity = 1 << 18);
+    ~MeshArena();
+
+    MeshArena(const MeshArena& other) = delete;
+    MeshArena& operator=(const MeshArena& other) = delete;
+
+    /**
+     * Copy a mesh into the arena
+     * @param view The geometry, in any layout
+     * @return the id to draw it by
+     */
+    MeshId add(const MeshView& view);
+
+    /**
+     * Free a mesh's space in the arena. Its id must not be used again
+     * @param id The mesh to remove
+     */
+    void remove(MeshId id);
+
+    /**
+     * @param id A mesh in the arena
+     * @return where the mesh lives, or nullptr if there's no such mesh
+     */
+    const Record* get(MeshId id) const;
+
+    /** Bind the arena's vertex array, which every draw below needs */
+    void bind();
+
+    /**
+     * Draw a whole mesh, with instance 0 of the instance buffer. For the odd draw that isn't batched
+     * (the ground shells, the skybox), which use their own uniforms instead of the instance data
+     * @param id The mesh to draw
+     */
+    void draw(MeshId id);
+
+    /**
+     * Append the commands that draw a mesh with one instance
+     * @param id The mesh to draw
+     * @param instance The index of its MeshInstance in the instance buffer
+     * @param commands Where to append the commands
+     * @return how many commands were appended
+     */
+    size_t appendCommands(MeshId id, uint32_t instance, std::vector<DrawElementsIndirectCommand>& commands) const;
+
+    /**
+     * Replace the contents of the instance and indirect command buffers for this frame
+     * @param instances Every instance drawn this frame
+     * @param commands Every command drawn this frame
+     */
+    void upload(const std::vector<MeshInstance>& instances, const std::vector<DrawElementsIndirectCommand>& commands);
+
+    /**
+     * Draw a range of the uploaded commands in a single call
+     * @param first The first command to draw
+     * @param count How many commands to draw
+     */
+    void multiDraw(size_t first, size_t count);
+
+    // The one vertex layout in the arena
+    static const uint32_t constexpr attributes = MeshHasTexCoords | MeshHasNormals | MeshHalfTexCoords | MeshPackedNormals;
+    static const uint32_t constexpr stride = 3 * sizeof(float) + 2 * sizeof(uint16_t) + sizeof(uint32_t);
+
+private:
+    /**
+     * Convert a mesh into the arena's vertex layout and 16 bit indices, splitting it into parts if
+     * it has too many vertices for them
+     * @param view The mesh
+     * @param vertices Filled with the converted vertices
+     * @param indices Filled with the indices, each part's relative to its own base vertex
+     * @param parts Filled with each part's index count, and its offsets within the two outputs
+     */
+    static void convert(const MeshView& view, std::vector<unsigned char>& vertices, std::vector<uint16_t>& indices, std::vector<Part>& parts);
+
+    /**
+     * Grow a buffer, keeping its contents
+     * @param buffer The buffer to replace
+     * @param oldBytes Its current size
+     * @param newBytes Its new size
+     */
+    void growBuffer(unsigned int& buffer, size_t oldBytes, size_t newBytes);
+
+    /** Point the vertex array at the current buffers */
+    void setupVertexArray();
+
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+    unsigned int ebo = 0;
+    unsigned int instanceBuffer = 0;
+    unsigned int indirectBuffer = 0;
+    size_t instanceBufferBytes = 0;
+    size_t indirectBufferBytes = 0;
+
+    RangeAllocator vertexSpace;
+    RangeAllocator indexSpace;
+
+    std::vector<Record> records;
+    std::vector<MeshId> freeIds;
+
+    // glMultiDrawElementsIndirect is desktop GL 4.3, so it isn't part of QOpenGLExtraFunctions. If the
+    // driver lacks it, the commands are drawn one at a time with glDrawElementsIndirect instead
+    using MultiDrawElementsIndirect = void (QOPENGLF_APIENTRYP)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+    MultiDrawElementsIndirect multiDrawElementsIndirect = nullptr;
+};
+
+#endif //TANKS_MESHARENA_H
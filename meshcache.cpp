@@ -0,0 +1,227 @@
+#include "meshcache.h"
+
+#include "diskcache.h"
+
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+static const char MESH_CACHE_FOLDER[] = "meshes";
+static const char MESH_CACHE_MAGIC[4] = {'T', 'M', 'S', 'H'};
+
+// Buffers inside the blob start on this alignment, so the mapped pointers are suitably aligned for floats
+static const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+MeshCache::Entry::~Entry() {
+    if (mapped) {
+        file.unmap(mapped);
+    }
+}
+
+std::filesystem::path MeshCache::blobPath(const std::filesystem::path& source, uint32_t lod) {
+    // Key the blob's name by the full source path too, so two models with the same name in different
+    // folders don't evict each other
+    std::string absolute = std::filesystem::absolute(source).string();
+    uint64_t pathHash = DiskCache::hash(absolute.data(), absolute.size());
+
+    std::string name = source.stem().string() + "-" + std::to_string(pathHash);
+
+    if (lod > 0) {
+        name += "-lod" + std::to_string(lod);
+    }
+
+    name += ".tmesh";
+    return DiskCache::directory(MESH_CACHE_FOLDER) / name;
+}
+
+PackedMesh MeshCache::bake(const std::filesystem::path& source, uint32_t lod, MeshOptimizationReport* report) {
+    return bake(MeshData::fromFile(source), lod, report);
+}
+
+PackedMesh MeshCache::bake(const MeshData& mesh, uint32_t lod, MeshOptimizationReport* report) {
+    return MeshOptimizer::optimize(MeshOptimizer::levelOfDetail(mesh, lod), report);
+}
+
+void MeshCache::bakeEntry(Entry& entry, const MeshData& mesh, const std::filesystem::path& source, uint32_t lod) {
+    entry.baked = bake(mesh, lod);
+    entry.meshView = entry.baked.view();
+
+    if (!write(entry.meshView, source, blobPath(source, lod))) {
+        std::cerr << "MeshCache: Failed to write cache entry for " << source << "\n";
+    }
+}
+
+std::unique_ptr<MeshCache::Entry> MeshCache::open(const std::filesystem::path& source, uint32_t lod) {
+    auto entry = std::make_unique<Entry>();
+
+    if (tryMap(*entry, source, blobPath(source, lod))) {
+        return entry;
+    }
+
+    // Cold (or stale) cache, so do the expensive import and optimization, and bake it for next time
+    bakeEntry(*entry, MeshData::fromFile(source), source, lod);
+    return entry;
+}
+
+std::vector<std::unique_ptr<MeshCache::Entry>> MeshCache::openLevels(const std::filesystem::path& source, uint32_t levels) {
+    std::vector<std::unique_ptr<Entry>> entries(std::clamp<uint32_t>(levels, 1, MeshOptimizer::lodCount));
+
+    // Only imported once a level turns out to be missing, and then shared by the rest
+    std::optional<MeshData> imported;
+
+    for(uint32_t lod = 0; lod < entries.size(); lod++) {
+        entries[lod] = std::make_unique<Entry>();
+
+        if (tryMap(*entries[lod], source, blobPath(source, lod))) {
+            continue;
+        }
+
+        if (!imported) {
+            imported = MeshData::fromFile(source);
+        }
+
+        bakeEntry(*entries[lod], *imported, source, lod);
+    }
+
+    return entries;
+}
+
+bool MeshCache::tryMap(Entry& entry, const std::filesystem::path& source, const std::filesystem::path& blob) {
+    std::error_code err;
+    if (!std::filesystem::exists(blob, err)) {
+        return false;
+    }
+
+    entry.file.setFileName(QString::fromStdString(blob.string()));
+
+    if (!entry.file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 size = entry.file.size();
+    if (size < (qint64)sizeof(Header)) {
+        return false;
+    }
+
+    uchar* mapped = entry.file.map(0, size);
+    if (!mapped) {
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(&header, mapped, sizeof(Header));
+
+    bool valid =
+        std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == version &&
+        (header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t)) &&
+        header.vertexOffset + (uint64_t)header.vertexCount * header.stride <= (uint64_t)size &&
+        header.indexOffset + (uint64_t)header.indexCount * header.indexSize <= (uint64_t)size;
+
+    // The cheap check is the size and modification time. If those changed (e.g. the assets were copied
+    // fresh by the build), fall back to hashing the file, which is still far cheaper than importing it
+    if (valid) {
+        uint64_t sourceSize = std::filesystem::file_size(source, err);
+
+        if (err || sourceSize != header.sourceSize) {
+            valid = false;
+        }
+        else {
+            int64_t modifiedTime = DiskCache::modifiedTime(source);
+
+            // Same contents, just touched, so note the new time and the next launch skips hashing again
+            if (modifiedTime != header.sourceModifiedTime) {
+                valid = DiskCache::hashFile(source) == header.sourceHash;
+
+                if (valid && !updateModifiedTime(blob, modifiedTime)) {
+                    std::cerr << "MeshCache: Failed to update the cache entry for " << source << "\n";
+                }
+            }
+        }
+    }
+
+    if (!valid) {
+        entry.file.unmap(mapped);
+        entry.file.close();
+        return false;
+    }
+
+    entry.mapped = mapped;
+
+    MeshView& view = entry.meshView;
+    view.attributes = header.attributes;
+    view.stride = header.stride;
+    view.vertexCount = header.vertexCount;
+    view.indexCount = header.indexCount;
+    view.indexSize = header.indexSize;
+    view.vertices = mapped + header.vertexOffset;
+    view.indices = mapped + header.indexOffset;
+    view.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    view.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+    return true;
+}
+
+bool MeshCache::updateModifiedTime(const std::filesystem::path& blob, int64_t modifiedTime) {
+    // Only the one field changes, so it's written in place, rather than rewriting the blob that's mapped
+    QFile file(QString::fromStdString(blob.string()));
+
+    if (!file.open(QIODevice::ReadWrite) || !file.seek(offsetof(Header, sourceModifiedTime))) {
+        return false;
+    }
+
+    return file.write((const char*)&modifiedTime, sizeof(modifiedTime)) == sizeof(modifiedTime);
+}
+
+bool MeshCache::write(const MeshView& view, const std::filesystem::path& source, const std::filesystem::path& blob) {
+    Header header{};
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = version;
+
+    std::error_code err;
+    header.sourceSize = std::filesystem::file_size(source, err);
+    header.sourceModifiedTime = DiskCache::modifiedTime(source);
+    header.sourceHash = DiskCache::hashFile(source);
+
+    header.attributes = view.attributes;
+    header.stride = view.stride;
+    header.vertexCount = view.vertexCount;
+    header.indexCount = view.indexCount;
+    header.indexSize = view.indexSize;
+
+    for(int i = 0; i < 3; i++) {
+        header.boundsMin[i] = view.boundsMin[i];
+        header.boundsMax[i] = view.boundsMax[i];
+    }
+
+    header.vertexOffset = alignUp(sizeof(Header));
+    header.indexOffset = alignUp(header.vertexOffset + view.vertexBytes());
+
+    // Build the whole blob in memory, then write it in one go. QSaveFile writes to a temporary and
+    // renames it over the target on commit, so a crash mid-write never leaves a torn entry behind
+    QByteArray bytes((qsizetype)(header.indexOffset + view.indexBytes()), '\0');
+    std::memcpy(bytes.data(), &header, sizeof(Header));
+    std::memcpy(bytes.data() + header.vertexOffset, view.vertices, view.vertexBytes());
+    std::memcpy(bytes.data() + header.indexOffset, view.indices, view.indexBytes());
+
+    QSaveFile file(QString::fromStdString(blob.string()));
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    if (file.write(bytes) != bytes.size()) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
@@ -0,0 +1,156 @@
+#ifndef TANKS_MESHCACHE_H
+#define TANKS_MESHCACHE_H
+
+#include <QFile>
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "meshdata.h"
+#include "meshoptimizer.h"
+
+/**
+ * Converts model files into compact binary blobs the first time they're seen, so that later launches
+ * don't have to run Assimp at all. A blob is laid out as:
+ *
+ * 1. A fixed size header (see MeshCache::Header) describing the source file it came from, the vertex layout and bounds
+ * 2. The interleaved vertex buffer, exactly as it gets uploaded
+ * 3. The index buffer, exactly as it gets uploaded
+ *
+ * Geometry is run through the MeshOptimizer before it is baked, so the blob holds the compact packed layout.
+ *
+ * Warm entries are memory mapped and their buffers handed directly to glBufferData, so no parsing or
+ * copying happens on the CPU side.
+ */
+class MeshCache {
+public:
+    /**
+     * The on-disk header for a cache blob. Only plain fixed-size fields, so it can be read straight
+     * out of the mapped file.
+     */
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceModifiedTime;
+        uint64_t sourceHash;
+        uint32_t attributes;
+        uint32_t stride;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexSize;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+
+    /**
+     * A loaded mesh, either mapped from the cache or freshly baked. Keep it alive until
+     * the geometry has been uploaded, since the view points into it.
+     */
+    class Entry {
+        friend class MeshCache;
+
+        QFile file;
+        uchar* mapped = nullptr;
+        PackedMesh baked;
+        MeshView meshView;
+    public:
+        ~Entry();
+
+        /** The geometry, ready for upload */
+        const MeshView& view() const { return meshView; }
+
+        /** Whether this entry came from the cache (true), or had to be imported (false) */
+        bool fromCache() const { return mapped != nullptr; }
+    };
+
+    /**
+     * Load a mesh, going through the cache. If a valid blob exists it is mapped, otherwise the model
+     * is imported with Assimp, simplified (for levels of detail past 0), optimized, and a new blob is
+     * written for next time. Each level of detail has a blob of its own.
+     * @param source The model file
+     * @param lod Which level of detail, less than MeshOptimizer::lodCount
+     * @return the loaded mesh
+     * @throws std::runtime_error if the model can't be imported
+     */
+    static std::unique_ptr<Entry> open(const std::filesystem::path& source, uint32_t lod = 0);
+
+    /**
+     * Load several levels of detail of a mesh, going through the cache as open does. However many of the
+     * levels' blobs are missing, the model is imported at most once, and each missing level is made from
+     * that one import
+     * @param source The model file
+     * @param levels How many levels of detail, from full detail down, at most MeshOptimizer::lodCount
+     * @return the loaded meshes, one per level of detail
+     * @throws std::runtime_error if the model can't be imported
+     */
+    static std::vector<std::unique_ptr<Entry>> openLevels(const std::filesystem::path& source, uint32_t levels);
+
+    /**
+     * Import a model and process it the way its blob is baked
+     * @param source The model file
+     * @param lod Which level of detail
+     * @param report If not null, filled in with the optimizer's before/after numbers
+     * @return the packed geometry
+     * @throws std::runtime_error if the model can't be imported
+     */
+    static PackedMesh bake(const std::filesystem::path& source, uint32_t lod = 0, MeshOptimizationReport* report = nullptr);
+
+    /**
+     * Process an already imported model the way its blob is baked, so one import can make every level
+     * @param mesh The imported model
+     * @param lod Which level of detail
+     * @param report If not null, filled in with the optimizer's before/after numbers
+     * @return the packed geometry
+     */
+    static PackedMesh bake(const MeshData& mesh, uint32_t lod = 0, MeshOptimizationReport* report = nullptr);
+
+    /**
+     * Write a blob for some geometry
+     * @param view The geometry
+     * @param source The model file it came from
+     * @param blob Where to write the blob
+     * @return whether the blob was written
+     */
+    static bool write(const MeshView& view, const std::filesystem::path& source, const std::filesystem::path& blob);
+
+    /**
+     * Where the blob for a model file lives
+     * @param source The model file
+     * @param lod Which level of detail
+     * @return The path to the blob, which may or may not exist
+     */
+    static std::filesystem::path blobPath(const std::filesystem::path& source, uint32_t lod = 0);
+
+    // Bump this whenever the blob layout, or the way geometry is processed before baking, changes
+    static const uint32_t constexpr version = 3;
+
+private:
+    /**
+     * Map a blob and check that it is well formed and still matches its source file
+     * @return whether the entry is usable
+     */
+    static bool tryMap(Entry& entry, const std::filesystem::path& source, const std::filesystem::path& blob);
+
+    /**
+     * Record a new modification time for a blob's source, once hashing has shown its contents are the same
+     * @param blob The blob
+     * @param modifiedTime The source's modification time, as DiskCache::modifiedTime
+     * @return whether it was written
+     */
+    static bool updateModifiedTime(const std::filesystem::path& blob, int64_t modifiedTime);
+
+    /**
+     * Fill an entry with freshly baked geometry, and write its blob for next time
+     * @param entry The entry to fill
+     * @param mesh The imported model
+     * @param source The model file it came from
+     * @param lod Which level of detail
+     */
+    static void bakeEntry(Entry& entry, const MeshData& mesh, const std::filesystem::path& source, uint32_t lod);
+};
+
+#endif //TANKS_MESHCACHE_H
@@ -0,0 +1,146 @@
+#include "meshdata.h"
+
+#include <stdexcept>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+/**
+ * Append one Assimp mesh to the interleaved data, transformed into the model's space
+ * @param data The data to append to, whose attributes and stride are already set
+ * @param mesh The mesh to append
+ * @param transform The accumulated transform of the node the mesh hangs off
+ */
+static void appendMesh(MeshData& data, const aiMesh* mesh, const aiMatrix4x4& transform) {
+    bool hasTexCoords = data.attributes & MeshHasTexCoords;
+    bool hasNormals = data.attributes & MeshHasNormals;
+
+    // Normals transform by the inverse transpose, so non-uniform scales don't skew them
+    aiMatrix3x3 normalTransform = aiMatrix3x3(transform);
+    normalTransform.Inverse().Transpose();
+
+    uint32_t firstVertex = data.vertexCount;
+
+    for(size_t i = 0; i < mesh->mNumVertices; i++) {
+        aiVector3D p = transform * mesh->mVertices[i];
+        glm::vec3 pos(p.x, p.y, p.z);
+
+        data.vertices.push_back(pos.x);
+        data.vertices.push_back(pos.y);
+        data.vertices.push_back(pos.z);
+
+        if (data.vertexCount == 0 && i == 0) {
+            data.boundsMin = pos;
+            data.boundsMax = pos;
+        }
+
+        data.boundsMin = glm::min(data.boundsMin, pos);
+        data.boundsMax = glm::max(data.boundsMax, pos);
+
+        // A submesh missing an attribute the others have gets zeros for it
+        if (hasTexCoords) {
+            bool present = mesh->HasTextureCoords(0); // Assuming the first set of texture coordinates
+            data.vertices.push_back(present ? mesh->mTextureCoords[0][i].x : 0.0f);
+            data.vertices.push_back(present ? mesh->mTextureCoords[0][i].y : 0.0f);
+        }
+        if (hasNormals) {
+            aiVector3D n = mesh->HasNormals() ? normalTransform * mesh->mNormals[i] : aiVector3D(0.0f);
+            if (n.SquareLength() > 0.0f) { n.Normalize(); }
+
+            data.vertices.push_back(n.x);
+            data.vertices.push_back(n.y);
+            data.vertices.push_back(n.z);
+        }
+    }
+
+    data.vertexCount += mesh->mNumVertices;
+
+    // Triangulation means every face is three indices. Anything else (points and lines) is skipped
+    for(size_t i = 0; i < mesh->mNumFaces; i++) {
+        const auto& face = mesh->mFaces[i];
+
+        if (face.mNumIndices != 3) { continue; }
+
+        for(size_t j = 0; j < face.mNumIndices; j++) {
+            data.indices.push_back(firstVertex + face.mIndices[j]);
+        }
+    }
+}
+
+/**
+ * Walk the node hierarchy, appending every mesh each node references
+ * @param data The data to append to
+ * @param scene The imported scene
+ * @param node The node to start at
+ * @param parentTransform The accumulated transform of the node's parents
+ */
+static void appendNode(MeshData& data, const aiScene* scene, const aiNode* node, const aiMatrix4x4& parentTransform) {
+    aiMatrix4x4 transform = parentTransform * node->mTransformation;
+
+    for(size_t i = 0; i < node->mNumMeshes; i++) {
+        appendMesh(data, scene->mMeshes[node->mMeshes[i]], transform);
+    }
+
+    for(size_t i = 0; i < node->mNumChildren; i++) {
+        appendNode(data, scene, node->mChildren[i], transform);
+    }
+}
+
+MeshData MeshData::fromFile(const std::filesystem::path& path) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path.string(), aiProcess_Triangulate);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode || scene->mNumMeshes == 0) {
+        std::string msg = "Failed to load mesh: ";
+        msg += path.string();
+        throw std::runtime_error(msg);
+    }
+
+    MeshData data;
+
+    // Every submesh is merged into one, since a model is drawn with a single texture anyway. The
+    // vertex layout is the union of what the submeshes have
+    size_t totalVertices = 0;
+    size_t totalFaces = 0;
+
+    for(size_t i = 0; i < scene->mNumMeshes; i++) {
+        const aiMesh* mesh = scene->mMeshes[i];
+
+        if (mesh->HasTextureCoords(0)) { data.attributes |= MeshHasTexCoords; }
+        if (mesh->HasNormals()) { data.attributes |= MeshHasNormals; }
+
+        totalVertices += mesh->mNumVertices;
+        totalFaces += mesh->mNumFaces;
+    }
+
+    // Stride is the total size of a vertex in bytes
+    uint32_t floatsPerVertex = 3;
+    if (data.attributes & MeshHasTexCoords) { floatsPerVertex += 2; }
+    if (data.attributes & MeshHasNormals) { floatsPerVertex += 3; }
+
+    data.stride = floatsPerVertex * sizeof(float);
+
+    // OpenGL now needs all that data in one big buffer. Easier to interleave it now,
+    // then deal with the math of storing them separately. We know the final size up front,
+    // so reserve it rather than letting the vectors grow one element at a time
+    data.vertices.reserve(totalVertices * floatsPerVertex);
+    data.indices.reserve(totalFaces * 3);
+
+    appendNode(data, scene, scene->mRootNode, aiMatrix4x4());
+
+    return data;
+}
+
+MeshView MeshData::view() const {
+    MeshView v;
+    v.attributes = attributes;
+    v.stride = stride;
+    v.vertexCount = vertexCount;
+    v.indexCount = (uint32_t)indices.size();
+    v.vertices = vertices.data();
+    v.indices = indices.data();
+    v.boundsMin = boundsMin;
+    v.boundsMax = boundsMax;
+    return v;
+}
@@ -0,0 +1,72 @@
+#ifndef TANKS_MESHDATA_H
+#define TANKS_MESHDATA_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/**
+ * Bit flags for which vertex attributes are present in a mesh's interleaved vertex buffer, and how
+ * they're encoded. Position is always present as three floats, and attributes are always stored in
+ * this order. Without the encoding flags, texture coordinates and normals are plain floats.
+ */
+enum MeshAttributes : uint32_t {
+    MeshHasTexCoords = 1 << 0,
+    MeshHasNormals = 1 << 1,
+    MeshHalfTexCoords = 1 << 2,     // Texture coordinates are two half floats
+    MeshPackedNormals = 1 << 3,     // Normals are a single signed normalized 10:10:10:2 integer
+};
+
+/**
+ * A non-owning view of mesh geometry that is laid out exactly how the GPU wants it, so it can be
+ * handed straight to glBufferData. The pointers may point into a MeshData, or into a memory mapped
+ * cache file.
+ */
+struct MeshView {
+    uint32_t attributes = 0;
+    uint32_t stride = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t indexSize = sizeof(uint32_t);
+    const void* vertices = nullptr;
+    const void* indices = nullptr;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    /** The size of the vertex buffer, in bytes */
+    size_t vertexBytes() const { return (size_t)vertexCount * stride; }
+
+    /** The size of the index buffer, in bytes */
+    size_t indexBytes() const { return (size_t)indexCount * indexSize; }
+};
+
+/**
+ * Owns the CPU-side copy of a mesh's geometry as imported: interleaved, but every attribute is a plain
+ * float and indices are 32 bit. The MeshOptimizer turns this into the compact layout that actually gets
+ * baked into the mesh cache.
+ */
+struct MeshData {
+    uint32_t attributes = 0;
+    uint32_t stride = 0;
+    uint32_t vertexCount = 0;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    /**
+     * Use Assimp to import a model file, and interleave every mesh in it into one, with the node
+     * transforms applied
+     * @param path The model file to load
+     * @return the imported geometry
+     * @throws std::runtime_error if the file can't be imported
+     */
+    static MeshData fromFile(const std::filesystem::path& path);
+
+    /** Get a view of this data, only valid for as long as this object is alive and unmodified */
+    MeshView view() const;
+};
+
+#endif //TANKS_MESHDATA_H
@@ -0,0 +1,589 @@
+#include "meshoptimizer.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <unordered_map>
+
+// Meshes too simple, or too large, to be worth simplifying
+static const char* NO_LOD_MESHES[] = {"ground", "skybox", "bullet"};
+
+MeshView PackedMesh::view() const {
+    MeshView v;
+    v.attributes = attributes;
+    v.stride = stride;
+    v.vertexCount = vertexCount;
+    v.indexCount = indexCount;
+    v.indexSize = indexSize;
+    v.vertices = vertices.data();
+    v.indices = indices.data();
+    v.boundsMin = boundsMin;
+    v.boundsMax = boundsMax;
+    return v;
+}
+
+PackedMesh MeshOptimizer::optimize(const MeshData& mesh, MeshOptimizationReport* report) {
+    MeshData work = mesh;
+
+    if (report) {
+        report->verticesBefore = mesh.vertexCount;
+        report->triangles = (uint32_t)(mesh.indices.size() / 3);
+        report->bytesBefore = mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t);
+        report->invocationsBefore = simulateVertexCache(mesh.indices);
+    }
+
+    deduplicateVertices(work);
+    optimizeVertexCache(work.indices, work.vertexCount);
+    optimizeOverdraw(work.indices, work);
+    optimizeVertexFetch(work);
+
+    PackedMesh packed = pack(work);
+
+    if (report) {
+        report->verticesAfter = work.vertexCount;
+        report->bytesAfter = packed.vertices.size() + packed.indices.size();
+        report->invocationsAfter = simulateVertexCache(work.indices);
+    }
+
+    return packed;
+}
+
+void MeshOptimizer::deduplicateVertices(MeshData& mesh) {
+    if (mesh.vertexCount == 0) { return; }
+
+    const size_t floatsPerVertex = mesh.stride / sizeof(float);
+    const size_t vertexBytes = floatsPerVertex * sizeof(float);
+
+    // Bucket vertices by a hash of their bytes, then compare within the bucket, so that vertices that
+    // merely hash the same never get merged
+    std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+    buckets.reserve(mesh.vertexCount);
+
+    std::vector<uint32_t> remap(mesh.vertexCount);
+    std::vector<float> unique;
+    unique.reserve(mesh.vertices.size());
+    uint32_t uniqueCount = 0;
+
+    for(uint32_t i = 0; i < mesh.vertexCount; i++) {
+        const float* vertex = &mesh.vertices[i * floatsPerVertex];
+
+        // FNV-1a over the vertex's bytes
+        uint64_t h = 14695981039346656037ull;
+        const auto* bytes = reinterpret_cast<const unsigned char*>(vertex);
+        for(size_t b = 0; b < vertexBytes; b++) {
+            h ^= bytes[b];
+            h *= 1099511628211ull;
+        }
+
+        auto& bucket = buckets[h];
+        uint32_t found = std::numeric_limits<uint32_t>::max();
+
+        for(uint32_t candidate : bucket) {
+            if (std::memcmp(&unique[candidate * floatsPerVertex], vertex, vertexBytes) == 0) {
+                found = candidate;
+                break;
+            }
+        }
+
+        if (found == std::numeric_limits<uint32_t>::max()) {
+            found = uniqueCount++;
+            unique.insert(unique.end(), vertex, vertex + floatsPerVertex);
+            bucket.push_back(found);
+        }
+
+        remap[i] = found;
+    }
+
+    for(auto& index : mesh.indices) {
+        index = remap[index];
+    }
+
+    mesh.vertices = std::move(unique);
+    mesh.vertexCount = uniqueCount;
+}
+
+/**
+ * The vertex scoring function from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation". Vertices that are
+ * recently used score highly (except the last triangle's, which are slightly penalized, since they'll be
+ * hit regardless), and vertices with few remaining triangles get a boost so they're finished off
+ * and don't leave lonely triangles behind to be drawn with a cold cache later
+ * @param cachePosition The vertex's position in the simulated LRU cache, or -1 if not in it
+ * @param remainingTriangles How many not-yet-emitted triangles use the vertex
+ * @param cacheSize The size of the simulated cache
+ * @return the score
+ */
+static float forsythVertexScore(int cachePosition, uint32_t remainingTriangles, uint32_t cacheSize) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    const float lastTriangleScore = 0.75f;
+    const float cacheDecayPower = 1.5f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+
+    float score = 0.0f;
+
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = lastTriangleScore;
+        }
+        else {
+            float scaler = 1.0f / (float)(cacheSize - 3);
+            score = std::pow(1.0f - (float)(cachePosition - 3) * scaler, cacheDecayPower);
+        }
+    }
+
+    score += valenceBoostScale * std::pow((float)remainingTriangles, -valenceBoostPower);
+
+    return score;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+    const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+    const uint32_t cacheSize = optimizerCacheSize;
+
+    if (triangleCount == 0) { return; }
+
+    // Build vertex -> triangle adjacency, as a flat array with per-vertex offsets
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for(uint32_t index : indices) {
+        remaining[index]++;
+    }
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for(uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for(uint32_t t = 0; t < triangleCount; t++) {
+        for(int k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for(uint32_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = forsythVertexScore(-1, remaining[v], cacheSize);
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    // The LRU cache, with room for the three vertices of the triangle being pushed in on top
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(cacheSize + 3);
+    newCache.reserve(cacheSize + 3);
+
+    // Used when the cache has no candidates left (e.g. a disconnected piece of the mesh), keeps the
+    // fallback search linear overall
+    uint32_t fallbackCursor = 0;
+    uint32_t bestTriangle = 0;
+
+    for(uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        emitted[bestTriangle] = true;
+
+        uint32_t tri[3] = {indices[bestTriangle * 3], indices[bestTriangle * 3 + 1], indices[bestTriangle * 3 + 2]};
+
+        // Emit the triangle, and remove it from its vertices' remaining counts
+        for(uint32_t v : tri) {
+            output.push_back(v);
+
+            auto begin = adjacency.begin() + offsets[v];
+            auto end = begin + remaining[v];
+            auto it = std::find(begin, end, bestTriangle);
+            if (it != end) {
+                std::iter_swap(it, end - 1);
+                remaining[v]--;
+            }
+        }
+
+        // Push the triangle's vertices to the front of the cache
+        newCache.clear();
+        for(uint32_t v : tri) { newCache.push_back(v); }
+        for(uint32_t v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newCache.push_back(v);
+            }
+        }
+        std::swap(cache, newCache);
+
+        // Re-score everything in the cache (and anything that just fell out of it), then the triangles they touch
+        for(size_t i = 0; i < cache.size(); i++) {
+            uint32_t v = cache[i];
+            cachePosition[v] = i < cacheSize ? (int)i : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v], cacheSize);
+        }
+
+        float bestScore = -1.0f;
+        bool found = false;
+
+        for(uint32_t v : cache) {
+            for(uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                uint32_t t = adjacency[a];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = t;
+                    found = true;
+                }
+            }
+        }
+
+        if (cache.size() > cacheSize) {
+            cache.resize(cacheSize);
+        }
+
+        if (!found) {
+            while (fallbackCursor < triangleCount && emitted[fallbackCursor]) {
+                fallbackCursor++;
+            }
+            bestTriangle = fallbackCursor;
+        }
+    }
+
+    indices = std::move(output);
+}
+
+uint32_t MeshOptimizer::simulateVertexCache(const std::vector<uint32_t>& indices, uint32_t cacheSize) {
+    // A FIFO cache, like real post-transform caches - a hit doesn't move the vertex back to the front
+    std::vector<uint32_t> fifo(cacheSize, std::numeric_limits<uint32_t>::max());
+    size_t head = 0;
+    uint32_t misses = 0;
+
+    for(uint32_t index : indices) {
+        if (std::find(fifo.begin(), fifo.end(), index) == fifo.end()) {
+            fifo[head] = index;
+            head = (head + 1) % cacheSize;
+            misses++;
+        }
+    }
+
+    return misses;
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const MeshData& mesh) {
+    const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+    const size_t floatsPerVertex = mesh.stride / sizeof(float);
+
+    if (triangleCount < 2) { return; }
+
+    auto position = [&](uint32_t v) {
+        const float* p = &mesh.vertices[v * floatsPerVertex];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Split the cache-ordered triangles into clusters, starting a new one whenever a triangle misses
+    // on all three of its vertices. That's where the cache is cold anyway, so moving the clusters
+    // around afterwards costs (almost) no extra vertex shader invocations
+    std::vector<uint32_t> clusterStarts;
+    {
+        std::vector<uint32_t> fifo(simulatedCacheSize, std::numeric_limits<uint32_t>::max());
+        size_t head = 0;
+
+        for(uint32_t t = 0; t < triangleCount; t++) {
+            int misses = 0;
+
+            for(int k = 0; k < 3; k++) {
+                uint32_t index = indices[t * 3 + k];
+                if (std::find(fifo.begin(), fifo.end(), index) == fifo.end()) {
+                    fifo[head] = index;
+                    head = (head + 1) % simulatedCacheSize;
+                    misses++;
+                }
+            }
+
+            if (t == 0 || misses == 3) {
+                clusterStarts.push_back(t);
+            }
+        }
+    }
+
+    if (clusterStarts.size() < 2) { return; }
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    struct Cluster {
+        uint32_t begin;
+        uint32_t end;
+        glm::vec3 centroid;
+        glm::vec3 normal;
+        float area;
+        float sortKey;
+    };
+
+    std::vector<Cluster> clusters;
+    clusters.reserve(clusterStarts.size());
+
+    for(size_t c = 0; c < clusterStarts.size(); c++) {
+        Cluster cluster{};
+        cluster.begin = clusterStarts[c];
+        cluster.end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+
+        for(uint32_t t = cluster.begin; t < cluster.end; t++) {
+            glm::vec3 a = position(indices[t * 3]);
+            glm::vec3 b = position(indices[t * 3 + 1]);
+            glm::vec3 cc = position(indices[t * 3 + 2]);
+
+            // The cross product's length is twice the triangle's area, so summing it area weights the normal
+            glm::vec3 cross = glm::cross(b - a, cc - a);
+            float area = glm::length(cross) * 0.5f;
+
+            cluster.normal += cross;
+            cluster.centroid += (a + b + cc) / 3.0f * area;
+            cluster.area += area;
+        }
+
+        if (cluster.area > 0.0f) {
+            cluster.centroid /= cluster.area;
+        }
+
+        if (glm::length(cluster.normal) > 0.0f) {
+            cluster.normal = glm::normalize(cluster.normal);
+        }
+
+        meshCentroid += cluster.centroid * cluster.area;
+        meshArea += cluster.area;
+
+        clusters.push_back(cluster);
+    }
+
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+
+    // Clusters that face away from the middle of the mesh are on its outside, so are the most likely to
+    // occlude other parts of it. Drawing them first lets early depth testing reject the rest
+    for(auto& cluster : clusters) {
+        cluster.sortKey = glm::dot(cluster.centroid - meshCentroid, cluster.normal);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    for(const auto& cluster : clusters) {
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(MeshData& mesh) {
+    const size_t floatsPerVertex = mesh.stride / sizeof(float);
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> remap(mesh.vertexCount, unused);
+    std::vector<float> reordered;
+    reordered.reserve(mesh.vertices.size());
+    uint32_t next = 0;
+
+    for(auto& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+
+            const float* vertex = &mesh.vertices[index * floatsPerVertex];
+            reordered.insert(reordered.end(), vertex, vertex + floatsPerVertex);
+        }
+
+        index = remap[index];
+    }
+
+    // Any vertices never referenced by a triangle are dropped here too
+    mesh.vertices = std::move(reordered);
+    mesh.vertexCount = next;
+}
+
+MeshData MeshOptimizer::simplify(const MeshData& mesh, float cellSize) {
+    if (mesh.vertexCount == 0 || cellSize <= 0.0f) {
+        return mesh;
+    }
+
+    const size_t floatsPerVertex = mesh.stride / sizeof(float);
+    const size_t normalOffset = 3 + ((mesh.attributes & MeshHasTexCoords) ? 2 : 0);
+    const bool hasNormals = mesh.attributes & MeshHasNormals;
+
+    // Which cluster each vertex falls in, numbering clusters in the order they're first seen
+    std::unordered_map<uint64_t, uint32_t> cells;
+    std::vector<uint32_t> cluster(mesh.vertexCount);
+    std::vector<uint32_t> clusterSizes;
+
+    for(uint32_t v = 0; v < mesh.vertexCount; v++) {
+        const float* position = &mesh.vertices[v * floatsPerVertex];
+
+        // 21 bits per axis is far more cells than any mesh here spans
+        uint64_t key = 0;
+        for(int axis = 0; axis < 3; axis++) {
+            auto cell = (uint64_t)std::floor((position[axis] - mesh.boundsMin[axis]) / cellSize);
+            key |= (cell & 0x1fffff) << (21 * axis);
+        }
+
+        auto [it, inserted] = cells.emplace(key, (uint32_t)clusterSizes.size());
+        if (inserted) {
+            clusterSizes.push_back(0);
+        }
+
+        cluster[v] = it->second;
+        clusterSizes[it->second]++;
+    }
+
+    // Each cluster's vertex is the average of everything in it
+    MeshData simplified;
+    simplified.attributes = mesh.attributes;
+    simplified.stride = mesh.stride;
+    simplified.vertexCount = (uint32_t)clusterSizes.size();
+    simplified.vertices.assign(clusterSizes.size() * floatsPerVertex, 0.0f);
+
+    for(uint32_t v = 0; v < mesh.vertexCount; v++) {
+        const float* src = &mesh.vertices[v * floatsPerVertex];
+        float* dst = &simplified.vertices[cluster[v] * floatsPerVertex];
+        float weight = 1.0f / (float)clusterSizes[cluster[v]];
+
+        for(size_t f = 0; f < floatsPerVertex; f++) {
+            dst[f] += src[f] * weight;
+        }
+    }
+
+    simplified.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    simplified.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+    for(uint32_t c = 0; c < simplified.vertexCount; c++) {
+        float* vertex = &simplified.vertices[c * floatsPerVertex];
+        glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+
+        simplified.boundsMin = glm::min(simplified.boundsMin, position);
+        simplified.boundsMax = glm::max(simplified.boundsMax, position);
+
+        // Opposite sides of something thinner than a cell cancel out, so give those a normal that
+        // at least lights sensibly
+        if (hasNormals) {
+            glm::vec3 normal(vertex[normalOffset], vertex[normalOffset + 1], vertex[normalOffset + 2]);
+            normal = glm::length(normal) > 0.001f ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+            vertex[normalOffset] = normal.x;
+            vertex[normalOffset + 1] = normal.y;
+            vertex[normalOffset + 2] = normal.z;
+        }
+    }
+
+    // Keep the triangles whose corners all landed in different clusters, once each (regardless of
+    // which corner they start from), in their original winding
+    std::set<std::array<uint32_t, 3>> seen;
+    simplified.indices.reserve(mesh.indices.size());
+
+    for(size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        std::array<uint32_t, 3> triangle = {cluster[mesh.indices[t]], cluster[mesh.indices[t + 1]], cluster[mesh.indices[t + 2]]};
+
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) {
+            continue;
+        }
+
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+
+        if (seen.insert(triangle).second) {
+            simplified.indices.insert(simplified.indices.end(), triangle.begin(), triangle.end());
+        }
+    }
+
+    return simplified;
+}
+
+MeshData MeshOptimizer::levelOfDetail(const MeshData& mesh, uint32_t lod) {
+    if (lod == 0 || lod >= lodCount) {
+        return mesh;
+    }
+
+    float diagonal = glm::length(mesh.boundsMax - mesh.boundsMin);
+    return simplify(mesh, diagonal * lodCellFractions[lod]);
+}
+
+uint32_t MeshOptimizer::levelCountFor(const std::string& name) {
+    bool simplified = std::find(std::begin(NO_LOD_MESHES), std::end(NO_LOD_MESHES), name) == std::end(NO_LOD_MESHES);
+    return simplified ? lodCount : 1;
+}
+
+PackedMesh MeshOptimizer::pack(const MeshData& mesh) {
+    const size_t floatsPerVertex = mesh.stride / sizeof(float);
+    const bool hasTexCoords = mesh.attributes & MeshHasTexCoords;
+    const bool hasNormals = mesh.attributes & MeshHasNormals;
+
+    PackedMesh packed;
+    packed.attributes = mesh.attributes;
+    packed.vertexCount = mesh.vertexCount;
+    packed.indexCount = (uint32_t)mesh.indices.size();
+    packed.boundsMin = mesh.boundsMin;
+    packed.boundsMax = mesh.boundsMax;
+
+    packed.stride = 3 * sizeof(float);
+
+    if (hasTexCoords) {
+        packed.attributes |= MeshHalfTexCoords;
+        packed.stride += 2 * sizeof(uint16_t);
+    }
+    if (hasNormals) {
+        packed.attributes |= MeshPackedNormals;
+        packed.stride += sizeof(uint32_t);
+    }
+
+    packed.vertices.resize((size_t)packed.vertexCount * packed.stride);
+
+    for(uint32_t v = 0; v < mesh.vertexCount; v++) {
+        const float* src = &mesh.vertices[v * floatsPerVertex];
+        unsigned char* dst = &packed.vertices[(size_t)v * packed.stride];
+
+        std::memcpy(dst, src, 3 * sizeof(float));
+        dst += 3 * sizeof(float);
+        src += 3;
+
+        if (hasTexCoords) {
+            uint16_t uv[2] = {glm::packHalf1x16(src[0]), glm::packHalf1x16(src[1])};
+            std::memcpy(dst, uv, sizeof(uv));
+            dst += sizeof(uv);
+            src += 2;
+        }
+
+        if (hasNormals) {
+            glm::vec3 n(src[0], src[1], src[2]);
+            if (glm::length(n) > 0.0f) {
+                n = glm::normalize(n);
+            }
+
+            // x lands in the lowest 10 bits, which is the layout GL_INT_2_10_10_10_REV expects
+            uint32_t normal = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+            std::memcpy(dst, &normal, sizeof(normal));
+        }
+    }
+
+    // 16 bit indices whenever every vertex can be addressed by one
+    if (mesh.vertexCount <= std::numeric_limits<uint16_t>::max() + 1u) {
+        packed.indexSize = sizeof(uint16_t);
+        packed.indices.resize(mesh.indices.size() * sizeof(uint16_t));
+
+        auto* dst = reinterpret_cast<uint16_t*>(packed.indices.data());
+        for(size_t i = 0; i < mesh.indices.size(); i++) {
+            dst[i] = (uint16_t)mesh.indices[i];
+        }
+    }
+    else {
+        packed.indexSize = sizeof(uint32_t);
+        packed.indices.resize(mesh.indices.size() * sizeof(uint32_t));
+        std::memcpy(packed.indices.data(), mesh.indices.data(), packed.indices.size());
+    }
+
+    return packed;
+}
@@ -0,0 +1,153 @@
+#ifndef TANKS_MESHOPTIMIZER_H
+#define TANKS_MESHOPTIMIZER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "meshdata.h"
+
+/**
+ * Geometry in its final, compact GPU layout. Positions stay as 32 bit floats, but texture coordinates
+ * are stored as half floats, normals are packed into a single 10:10:10:2 integer, and indices are
+ * 16 bit whenever the mesh is small enough. A fully featured vertex is 20 bytes instead of 32.
+ */
+struct PackedMesh {
+    uint32_t attributes = 0;
+    uint32_t stride = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t indexSize = 0;
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    /** Get a view of this data, only valid for as long as this object is alive and unmodified */
+    MeshView view() const;
+};
+
+/**
+ * The before/after numbers for one run of the optimizer. Vertex shader invocations are estimated by
+ * replaying the index buffer through a simulated FIFO post-transform cache.
+ */
+struct MeshOptimizationReport {
+    uint32_t verticesBefore = 0;
+    uint32_t verticesAfter = 0;
+    uint32_t triangles = 0;
+    size_t bytesBefore = 0;
+    size_t bytesAfter = 0;
+    uint32_t invocationsBefore = 0;
+    uint32_t invocationsAfter = 0;
+
+    /** Average cache miss ratio - vertex shader invocations per triangle. 0.5 is ideal, 3.0 is the worst case */
+    float acmrBefore() const { return triangles ? (float)invocationsBefore / (float)triangles : 0.0f; }
+    float acmrAfter() const { return triangles ? (float)invocationsAfter / (float)triangles : 0.0f; }
+};
+
+/**
+ * The mesh optimization pipeline. Meshes run through it when they're baked into the MeshCache, and the
+ * tanks_meshopt tool runs the same pipeline offline to report how much each model benefits.
+ *
+ * The stages, in order, are:
+ * 1. Deduplicate bit-identical vertices (OBJ import produces a lot of them)
+ * 2. Reorder triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+ * 3. Reorder clusters of those triangles to reduce overdraw, outward facing clusters first (Sander et al.)
+ * 4. Reorder vertices into first-use order, for vertex fetch locality
+ * 5. Quantize the attributes and pick the smallest index type
+ */
+class MeshOptimizer {
+public:
+    /**
+     * Run the full pipeline on some imported geometry
+     * @param mesh The imported geometry, in the plain float layout
+     * @param report If not null, filled in with the before/after numbers
+     * @return the optimized, packed geometry
+     */
+    static PackedMesh optimize(const MeshData& mesh, MeshOptimizationReport* report = nullptr);
+
+    /**
+     * Merge vertices that are bit-for-bit identical, and rewrite the indices to match
+     * @param mesh The mesh to modify
+     */
+    static void deduplicateVertices(MeshData& mesh);
+
+    /**
+     * Reorder triangles so that vertices are reused while they're still in the post-transform cache
+     * @param indices The triangle list to reorder, in place
+     * @param vertexCount How many vertices the indices refer to
+     */
+    static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+    /**
+     * Reorder clusters of triangles so that the ones most likely to occlude the rest are drawn first.
+     * Clusters are split only where the vertex cache would already have been cold, so this
+     * keeps the cache efficiency from optimizeVertexCache
+     * @param indices The triangle list to reorder, in place
+     * @param mesh The mesh the indices belong to (for the positions)
+     */
+    static void optimizeOverdraw(std::vector<uint32_t>& indices, const MeshData& mesh);
+
+    /**
+     * Reorder the vertices themselves into the order they are first used in, so fetches walk memory linearly
+     * @param mesh The mesh to modify
+     */
+    static void optimizeVertexFetch(MeshData& mesh);
+
+    /**
+     * Simplify a mesh by vertex clustering: space is divided into a grid of cubes, every vertex in a cube
+     * is merged into one at their average, and triangles that collapse (or become duplicates) are
+     * dropped. It's crude next to edge collapse, and it ignores texture seams, but it's fast and
+     * predictable, and from far enough away to use a simplified mesh, neither shows
+     * @param mesh The mesh to simplify, in the plain float layout
+     * @param cellSize The size of the grid's cubes. Detail smaller than this is lost
+     * @return the simplified mesh, in the same layout
+     */
+    static MeshData simplify(const MeshData& mesh, float cellSize);
+
+    /**
+     * Make one level of detail of a mesh, for the MeshCache. Level 0 is the mesh itself, and each level
+     * after that is simplified more coarsely, relative to the mesh's size
+     * @param mesh The full detail mesh
+     * @param lod Which level, less than lodCount
+     * @return the mesh for that level
+     */
+    static MeshData levelOfDetail(const MeshData& mesh, uint32_t lod);
+
+    /**
+     * @param name A model's name, its file name without the extension, e.g. "tank"
+     * @return how many levels of detail to make of it: lodCount, or 1 for the models too simple, or too
+     * large, to be worth simplifying
+     */
+    static uint32_t levelCountFor(const std::string& name);
+
+    /**
+     * Convert to the compact GPU layout
+     * @param mesh The mesh to convert
+     * @return the packed mesh
+     */
+    static PackedMesh pack(const MeshData& mesh);
+
+    /**
+     * Estimate how many times the vertex shader runs for a triangle list
+     * @param indices The triangle list
+     * @param cacheSize The size of the simulated FIFO cache
+     * @return the number of cache misses, i.e. vertex shader invocations
+     */
+    static uint32_t simulateVertexCache(const std::vector<uint32_t>& indices, uint32_t cacheSize = simulatedCacheSize);
+
+    // Roughly what most desktop GPUs behave like. The exact value matters little for the ordering
+    static const uint32_t constexpr simulatedCacheSize = 16;
+
+    // The cache size the reordering targets
+    static const uint32_t constexpr optimizerCacheSize = 32;
+
+    // How many levels of detail levelOfDetail makes, counting the full detail mesh
+    static const uint32_t constexpr lodCount = 3;
+
+    // The grid cell size for each level of detail, as a fraction of the length of the mesh's bounding
+    // box's diagonal. Level 0 isn't simplified at all
+    static const float constexpr lodCellFractions[lodCount] = {0.0f, 1.0f / 32.0f, 1.0f / 12.0f};
+};
+
+#endif //TANKS_MESHOPTIMIZER_H
@@ -0,0 +1,121 @@
+#include "messageframe.h"
+
+#include <cstring>
+
+size_t MessageFrame::writeHeader(uint8_t* out, uint8_t type, size_t size) {
+    size_t length = 0;
+
+    while (size >= 0x80) {
+        out[length++] = (uint8_t)(size | 0x80);
+        size >>= 7;
+    }
+
+    out[length++] = (uint8_t)size;
+    out[length++] = type;
+    return length;
+}
+
+size_t MessageFrame::headerSize(size_t size) {
+    size_t length = 2;
+
+    while (size >= 0x80) {
+        length++;
+        size >>= 7;
+    }
+
+    return length;
+}
+
+void MessageFrame::append(std::vector<uint8_t>& out, uint8_t type, const void* data, size_t size) {
+    uint8_t header[maxHeaderSize];
+    size_t headerSize = writeHeader(header, type, size);
+
+    out.insert(out.end(), header, header + headerSize);
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+MessageParser::MessageParser(size_t capacity) : buffer(capacity) {}
+
+uint8_t* MessageParser::prepare(size_t bytes) {
+    if (buffer.size() - writePosition < bytes) {
+        // Everything before readPosition has been handed out already, so the rest can move to the front
+        size_t unread = writePosition - readPosition;
+        std::memmove(buffer.data(), buffer.data() + readPosition, unread);
+        readPosition = 0;
+        writePosition = unread;
+
+        if (buffer.size() - writePosition < bytes) {
+            size_t capacity = buffer.size();
+            while (capacity - writePosition < bytes) { capacity *= 2; }
+            buffer.resize(capacity);
+        }
+    }
+
+    return buffer.data() + writePosition;
+}
+
+void MessageParser::commit(size_t bytes) {
+    writePosition += bytes;
+}
+
+bool MessageParser::next(MessageView& message) {
+    if (broken) {
+        return false;
+    }
+
+    const uint8_t* start = buffer.data() + readPosition;
+    size_t available = writePosition - readPosition;
+
+    // The size varint, which may not have all arrived yet
+    size_t size = 0;
+    size_t position = 0;
+
+    for(int shift = 0; ; shift += 7) {
+        if (position == available) {
+            return false;
+        }
+
+        // Any more bytes than maxMessageSize needs, and the stream is garbage
+        if (position == MessageFrame::maxHeaderSize - 1) {
+            broken = true;
+            return false;
+        }
+
+        uint8_t byte = start[position++];
+        size |= (size_t)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+
+    if (size > MessageFrame::maxMessageSize) {
+        broken = true;
+        return false;
+    }
+
+    // The type, then the payload
+    if (available - position < 1 + size) {
+        return false;
+    }
+
+    message.type = start[position];
+    message.data = start + position + 1;
+    message.size = size;
+
+    readPosition += position + 1 + size;
+
+    // Nothing left to keep, so the next message starts at the front without moving anything
+    if (readPosition == writePosition) {
+        readPosition = 0;
+        writePosition = 0;
+    }
+
+    return true;
+}
+
+void MessageParser::reset() {
+    readPosition = 0;
+    writePosition = 0;
+    broken = false;
+}
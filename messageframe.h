@@ -0,0 +1,133 @@
+#ifndef TANKS_MESSAGEFRAME_H
+#define TANKS_MESSAGEFRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A message received over the network, pointing into the buffer it arrived in rather than owning a
+ * copy. It's only valid until the MessageParser it came from is given more data, so read it (or copy
+ * what you need out of it) straight away.
+ */
+struct MessageView {
+    uint8_t type;
+    const uint8_t* data;
+    size_t size;
+};
+
+/**
+ * How messages are framed on a stream connection like TCP, which delivers bytes in arbitrary pieces
+ * with no idea where one message ends and the next begins. Each message is:
+ *
+ *  [payload size, varint] [type, 1 byte] [payload, size bytes]
+ *
+ * The size is an unsigned LEB128 varint: 7 bits per byte, least significant first, with the top bit
+ * set on every byte but the last. So small messages (the usual case) only pay two bytes of header.
+ * What the types mean is up to whoever sends them.
+ */
+class MessageFrame {
+public:
+    /**
+     * Write a message's header
+     * @param out Where to write it, which must have room for maxHeaderSize bytes
+     * @param type The message's type
+     * @param size The size of its payload, at most maxMessageSize
+     * @return how many bytes were written
+     */
+    static size_t writeHeader(uint8_t* out, uint8_t type, size_t size);
+
+    /**
+     * @param size The size of a message's payload
+     * @return how many bytes its header takes
+     */
+    static size_t headerSize(size_t size);
+
+    /**
+     * Add a whole message to the end of a buffer, to send several at once
+     * @param out The buffer
+     * @param type The message's type
+     * @param data Its payload
+     * @param size The size of its payload, at most maxMessageSize
+     */
+    static void append(std::vector<uint8_t>& out, uint8_t type, const void* data, size_t size);
+
+    // The largest payload allowed. Anything claiming to be bigger is treated as a broken stream, so a
+    // bad length can't make the receiver buffer forever
+    static const size_t constexpr maxMessageSize = 1 << 20;
+
+    // The most bytes a header takes: the size of maxMessageSize as a varint, and the type
+    static const size_t constexpr maxHeaderSize = 4;
+};
+
+/**
+ * Splits a stream of received bytes back into messages, however they were broken up on the way.
+ *
+ * The bytes go into a receive buffer that's reused for the whole connection. Write straight into it
+ * (prepare, then commit), and take the complete messages out with next, which hands back views of
+ * them in place, with no copying. Parsing picks up where it left off, so a message split across
+ * several reads is only looked at once it has all arrived.
+ *
+ * Instead of wrapping around like a ring, which would split messages across the end, the buffer
+ * moves the unread bytes back to the front when it runs out of room at the end. By then everything
+ * complete has been read, so that's at most one partial message. It only grows if one message needs
+ * more room than it has, and never past maxMessageSize and a header, plus what's being written.
+ *
+ *  uint8_t* space = parser.prepare(available);
+ *  parser.commit(socket->read((char*)space, available));
+ *  MessageView message;
+ *  while (parser.next(message)) { ... }
+ *
+ * Not thread safe.
+ */
+class MessageParser {
+public:
+    /**
+     * @param capacity How big the receive buffer starts
+     */
+    explicit MessageParser(size_t capacity = defaultCapacity);
+
+    /**
+     * Make room to receive into. Invalidates any views handed out so far
+     * @param bytes How many bytes are about to be written
+     * @return where to write them
+     */
+    uint8_t* prepare(size_t bytes);
+
+    /**
+     * Say how many bytes were written at the last prepare
+     * @param bytes How many, at most what was prepared
+     */
+    void commit(size_t bytes);
+
+    /**
+     * Take the next complete message
+     * @param message Set to a view of it, valid until the next prepare
+     * @return false if there isn't a complete message yet, or the stream is broken
+     */
+    bool next(MessageView& message);
+
+    /**
+     * @return whether the stream is broken, by a message too big or a malformed size. Nothing more
+     * can be parsed from it, so the connection should be dropped
+     */
+    bool failed() const { return broken; }
+
+    /** @return how many received bytes haven't been taken as messages yet */
+    size_t buffered() const { return writePosition - readPosition; }
+
+    /** Forget everything received, for a new connection */
+    void reset();
+
+    // Enough for a few full TCP segments
+    static const size_t constexpr defaultCapacity = 64 * 1024;
+
+private:
+    std::vector<uint8_t> buffer;
+    // The next byte to parse, and the end of what's been received
+    size_t readPosition = 0;
+    size_t writePosition = 0;
+    bool broken = false;
+};
+
+#endif //TANKS_MESSAGEFRAME_H
@@ -0,0 +1,115 @@
+#include "netprotocol.h"
+
+// The bits of an Input message's controls
+enum InputBits : uint8_t {
+    FORWARD_BIT = 1 << 0,
+    BACK_BIT = 1 << 1,
+    LEFT_BIT = 1 << 2,
+    RIGHT_BIT = 1 << 3,
+    FIRE_BIT = 1 << 4,
+};
+
+static void writeU32(uint8_t* out, uint32_t value) {
+    for(int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static uint32_t readU32(const uint8_t* data) {
+    uint32_t value = 0;
+    for(int i = 0; i < 4; i++) {
+        value |= (uint32_t)data[i] << (i * 8);
+    }
+    return value;
+}
+
+void NetProtocol::writeWelcome(uint8_t* out, uint16_t tickRate, uint32_t clientId) {
+    out[0] = (uint8_t)tickRate;
+    out[1] = (uint8_t)(tickRate >> 8);
+    writeU32(out + 2, clientId);
+}
+
+bool NetProtocol::readWelcome(const MessageView& message, uint16_t& tickRate, uint32_t& clientId) {
+    if (message.size != welcomeSize) {
+        return false;
+    }
+
+    tickRate = (uint16_t)(message.data[0] | (message.data[1] << 8));
+    clientId = readU32(message.data + 2);
+    return tickRate > 0;
+}
+
+void NetProtocol::writeSpawned(uint8_t* out, uint32_t entityId) {
+    writeU32(out, entityId);
+}
+
+bool NetProtocol::readSpawned(const MessageView& message, uint32_t& entityId) {
+    if (message.size != spawnedSize) {
+        return false;
+    }
+
+    entityId = readU32(message.data);
+    return true;
+}
+
+void NetProtocol::writeSnapshotHeader(uint8_t* out, uint32_t lastApplied) {
+    writeU32(out, lastApplied);
+}
+
+bool NetProtocol::readSnapshotHeader(const MessageView& message, uint32_t& lastApplied) {
+    if (message.size < snapshotHeaderSize) {
+        return false;
+    }
+
+    lastApplied = readU32(message.data);
+    return true;
+}
+
+void NetProtocol::writeInput(uint8_t* out, uint32_t ackedTick, uint32_t sequence, const TankInput& input) {
+    writeU32(out, ackedTick);
+    writeU32(out + 4, sequence);
+    out[8] = (input.forward ? FORWARD_BIT : 0) |
+             (input.back ? BACK_BIT : 0) |
+             (input.left ? LEFT_BIT : 0) |
+             (input.right ? RIGHT_BIT : 0) |
+             (input.fire ? FIRE_BIT : 0);
+}
+
+bool NetProtocol::readInput(const MessageView& message, uint32_t& ackedTick, uint32_t& sequence, TankInput& input) {
+    if (message.size != inputSize) {
+        return false;
+    }
+
+    ackedTick = readU32(message.data);
+    sequence = readU32(message.data + 4);
+
+    uint8_t bits = message.data[8];
+    input.forward = bits & FORWARD_BIT;
+    input.back = bits & BACK_BIT;
+    input.left = bits & LEFT_BIT;
+    input.right = bits & RIGHT_BIT;
+    input.fire = bits & FIRE_BIT;
+    return true;
+}
+
+void NetProtocol::writeEvent(std::vector<uint8_t>& out, const GameEvent& event) {
+    out.resize(5);
+    out[0] = (uint8_t)event.kind;
+    writeU32(out.data() + 1, event.entity);
+
+    if (event.kind == GameEvent::Kind::LevelChange) {
+        out.insert(out.end(), event.level.begin(), event.level.end());
+    }
+}
+
+bool NetProtocol::readEvent(const MessageView& message, GameEvent& event) {
+    if (message.size < 5 || message.data[0] < (uint8_t)GameEvent::Kind::Shot ||
+        message.data[0] > (uint8_t)GameEvent::Kind::LevelChange) {
+        return false;
+    }
+
+    event.kind = (GameEvent::Kind)message.data[0];
+    event.entity = readU32(message.data + 1);
+    event.level.assign((const char*)message.data + 5, message.size - 5);
+    return true;
+}
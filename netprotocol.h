@@ -0,0 +1,138 @@
+#ifndef TANKS_NETPROTOCOL_H
+#define TANKS_NETPROTOCOL_H
+
+#include "PlayerTank.h"
+#include "messageframe.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Something that happened on the server, which a client may want to play a sound or effect for */
+struct GameEvent {
+    enum class Kind : uint8_t {
+        // Something fired. The entity is the new projectile
+        Shot = 1,
+        // A tank was destroyed. The entity is the tank
+        Death,
+        // A new level started, named by level
+        LevelChange,
+    };
+
+    Kind kind = Kind::Shot;
+    uint32_t entity = 0;
+    std::string level;
+};
+
+/**
+ * The messages between the dedicated server (GameServer) and its clients (GameClient), each sent as one
+ * UdpTransport message of the matching type, reliably unless it says otherwise. Numbers are little endian.
+ *
+ * Server to client:
+ * - Welcome: [tick rate, u16] [client id, u32]. Sent once, on connecting. The id only means anything to the
+ *   server, and to tools looking at it
+ * - Spawned: [entity id, u32]. The client's tank, sent whenever it (re)spawns
+ * - Snapshot: [last input applied, u32] then a Snapshot delta, every tick. Unreliable, since the next one
+ *   replaces it. The input number tells the client which of its inputs the snapshot already includes
+ * - Event: [kind, u8] [entity id, u32] [level name, the rest, for LevelChange]. See GameEvent
+ *
+ * Client to server:
+ * - Input: [last snapshot tick received, u32] [input number, u32] [controls held, u8]. Sent every client
+ *   tick, numbered from 1, and applied by the server one per tick in that order. The tick acknowledges the
+ *   snapshot as the baseline for the next delta
+ */
+class NetProtocol {
+public:
+    enum class Message : uint8_t {
+        Welcome = 1,
+        Spawned,
+        Snapshot,
+        Input,
+        Event,
+    };
+
+    // The sizes of the fixed size messages
+    static const size_t constexpr welcomeSize = 6;
+    static const size_t constexpr spawnedSize = 4;
+    static const size_t constexpr inputSize = 9;
+
+    // What comes before the delta in a Snapshot message
+    static const size_t constexpr snapshotHeaderSize = 4;
+
+    /**
+     * @param out Where to write the message, welcomeSize bytes
+     * @param tickRate How many ticks a second the server runs
+     * @param clientId Who the client is to the server
+     */
+    static void writeWelcome(uint8_t* out, uint16_t tickRate, uint32_t clientId);
+
+    /**
+     * @param message A Welcome message
+     * @param tickRate Set to the server's tick rate
+     * @param clientId Set to who the client is to the server
+     * @return false if it's malformed
+     */
+    static bool readWelcome(const MessageView& message, uint16_t& tickRate, uint32_t& clientId);
+
+    /**
+     * @param out Where to write the message, spawnedSize bytes
+     * @param entityId The client's tank
+     */
+    static void writeSpawned(uint8_t* out, uint32_t entityId);
+
+    /**
+     * @param message A Spawned message
+     * @param entityId Set to the client's tank
+     * @return false if it's malformed
+     */
+    static bool readSpawned(const MessageView& message, uint32_t& entityId);
+
+    /**
+     * @param out Where to write the header, snapshotHeaderSize bytes
+     * @param lastApplied The number of the last of the client's inputs the server applied, or 0 for none
+     */
+    static void writeSnapshotHeader(uint8_t* out, uint32_t lastApplied);
+
+    /**
+     * @param message A Snapshot message
+     * @param lastApplied Set to the number of the last input the server applied
+     * @return false if it's too short. If not, the delta follows the header
+     */
+    static bool readSnapshotHeader(const MessageView& message, uint32_t& lastApplied);
+
+    /**
+     * @param out Where to write the message, inputSize bytes
+     * @param ackedTick The newest snapshot the client has
+     * @param sequence The input's number
+     * @param input The controls held down
+     */
+    static void writeInput(uint8_t* out, uint32_t ackedTick, uint32_t sequence, const TankInput& input);
+
+    /**
+     * @param message An Input message
+     * @param ackedTick Set to the newest snapshot the client has
+     * @param sequence Set to the input's number
+     * @param input Set to the controls held down
+     * @return false if it's malformed
+     */
+    static bool readInput(const MessageView& message, uint32_t& ackedTick, uint32_t& sequence, TankInput& input);
+
+    /**
+     * @param out Where to write the message. It's cleared first
+     * @param event The event
+     */
+    static void writeEvent(std::vector<uint8_t>& out, const GameEvent& event);
+
+    /**
+     * @param message An Event message
+     * @param event Set to the event
+     * @return false if it's malformed
+     */
+    static bool readEvent(const MessageView& message, GameEvent& event);
+
+    // The port the server listens on unless told otherwise
+    static const uint16_t constexpr defaultPort = 47474;
+};
+
+#endif //TANKS_NETPROTOCOL_H
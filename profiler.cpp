@@ -0,0 +1,156 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+Profiler::Profiler() : epoch(Clock::now()) {}
+
+Profiler* Profiler::getInstance() {
+    // Function-local static, so creation is thread-safe even if the first call comes from a worker thread
+    static Profiler profiler;
+    return &profiler;
+}
+
+Profiler::Scope::Scope(std::string name, const char* category) :
+    name(std::move(name)), category(category), start(Clock::now()) {}
+
+Profiler::Scope::~Scope() {
+    Profiler::getInstance()->addTraceEvent(name, category, start, Clock::now());
+}
+
+void Profiler::addTraceEvent(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    trace.push_back({name, category, start, end, std::this_thread::get_id()});
+}
+
+/**
+ * Escape a string so it can be embedded in JSON
+ * @param str The string to escape
+ * @return the escaped string, without surrounding quotes
+ */
+static std::string jsonEscape(const std::string& str) {
+    std::string result;
+
+    for(char c : str) {
+        if (c == '"' || c == '\\') { result += '\\'; }
+        result += c;
+    }
+
+    return result;
+}
+
+void Profiler::writeTrace(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Thread ids aren't printable as numbers portably, so hash them into something stable for the viewer
+    std::hash<std::thread::id> threadHash;
+
+    out << "{\"traceEvents\":[\n";
+
+    for(size_t i = 0; i < trace.size(); i++) {
+        const auto& event = trace[i];
+
+        auto ts = std::chrono::duration_cast<std::chrono::microseconds>(event.start - epoch).count();
+        auto dur = std::chrono::duration_cast<std::chrono::microseconds>(event.end - event.start).count();
+
+        out << "{\"name\":\"" << jsonEscape(event.name) << "\","
+            << "\"cat\":\"" << jsonEscape(event.category) << "\","
+            << "\"ph\":\"X\",\"pid\":1,"
+            << "\"tid\":" << (threadHash(event.thread) % 100000) << ","
+            << "\"ts\":" << ts << ",\"dur\":" << dur << "}";
+
+        out << (i + 1 < trace.size() ? ",\n" : "\n");
+    }
+
+    out << "]}\n";
+}
+
+bool Profiler::writeTraceIfRequested() const {
+    const char* path = std::getenv("TANKS_TRACE");
+
+    if (!path || !*path) {
+        return false;
+    }
+
+    std::ofstream out(path);
+
+    if (!out) {
+        std::cerr << "Profiler: Failed to open trace file " << path << "\n";
+        return false;
+    }
+
+    writeTrace(out);
+    return true;
+}
+
+Profiler::TimingSlot Profiler::findSlot(const std::string& name) {
+    auto it = timingSlots.find(name);
+
+    if (it != timingSlots.end()) {
+        return it->second;
+    }
+
+    timings.emplace_back();
+    timingNames.push_back(name);
+    return timingSlots[name] = timings.size() - 1;
+}
+
+Profiler::TimingSlot Profiler::registerTiming(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return findSlot(name);
+}
+
+void Profiler::addTiming(Profiler::TimingSlot slot, double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (slot >= timings.size()) {
+        return;
+    }
+
+    Timing& timing = timings[slot];
+
+    timing.recent = timing.samples == 0 ? milliseconds : timing.recent + (milliseconds - timing.recent) * recentWeight;
+    timing.last = milliseconds;
+    timing.total += milliseconds;
+    timing.samples++;
+}
+
+void Profiler::addTiming(const std::string& name, double milliseconds) {
+    addTiming(registerTiming(name), milliseconds);
+}
+
+Profiler::Timing Profiler::getTiming(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = timingSlots.find(name);
+    return it != timingSlots.end() ? timings[it->second] : Timing();
+}
+
+Profiler::Timing Profiler::getTiming(Profiler::TimingSlot slot) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slot < timings.size() ? timings[slot] : Timing();
+}
+
+std::map<std::string, Profiler::Timing> Profiler::getTimings() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, Timing> result;
+
+    for(size_t i = 0; i < timings.size(); i++) {
+        if (timings[i].samples > 0) {
+            result[timingNames[i]] = timings[i];
+        }
+    }
+
+    return result;
+}
+
+void Profiler::resetTimings() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fill(timings.begin(), timings.end(), Timing());
+}
+
+double Profiler::millisecondsSinceStart() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - epoch).count();
+}
@@ -0,0 +1,161 @@
+#ifndef TANKS_PROFILER_H
+#define TANKS_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Collects timing information from across the game. There are two kinds:
+ *
+ * The startup trace: a list of named spans (loading a mesh, compiling a shader, ...) with the thread
+ * they ran on, which can be written out in the Chrome trace event format and opened in chrome://tracing
+ * or Perfetto.
+ *
+ * Per-frame timings: named values recorded every frame, like "cpu frame" or "gpu skybox", each kept as
+ * a running summary. The renderer's stats overlay and tanks_render_bench both read these.
+ *
+ * Set the TANKS_TRACE environment variable to a file path to have the renderer write the startup
+ * trace there once it finishes loading.
+ *
+ * This is a singleton, like the Scene, and it is safe to record into from any thread.
+ */
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Where a per-frame timing is kept, from registerTiming
+    using TimingSlot = size_t;
+
+    /** One named span of time on one thread */
+    struct TraceEvent {
+        std::string name;
+        std::string category;
+        Clock::time_point start;
+        Clock::time_point end;
+        std::thread::id thread;
+    };
+
+    /** The running summary of one per-frame timing */
+    struct Timing {
+        // The most recent sample
+        double last = 0.0;
+        // An exponential moving average, which follows changes over roughly the last second of frames
+        double recent = 0.0;
+        // Every sample since the timings were last reset, for an exact mean
+        double total = 0.0;
+        size_t samples = 0;
+
+        double mean() const { return samples > 0 ? total / samples : 0.0; }
+    };
+
+    /**
+     * Records a trace event covering its own lifetime. Create one at the top of a block to time it:
+     *
+     *  Profiler::Scope scope("compile shaders", "startup");
+     */
+    class Scope {
+        std::string name;
+        const char* category;
+        Clock::time_point start;
+    public:
+        Scope(std::string name, const char* category);
+        ~Scope();
+
+        Scope(const Scope& other) = delete;
+        Scope& operator=(const Scope& other) = delete;
+    };
+
+    /** Get the instance of the Profiler, creating it if needed */
+    static Profiler* getInstance();
+
+    /**
+     * Add a span to the trace
+     * @param name What happened
+     * @param category A grouping for the event, e.g. "startup"
+     * @param start When it started
+     * @param end When it finished
+     */
+    void addTraceEvent(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end);
+
+    /**
+     * Write the trace in the Chrome trace event JSON format
+     * @param out Where to write it
+     */
+    void writeTrace(std::ostream& out) const;
+
+    /**
+     * Write the trace to the file named by the TANKS_TRACE environment variable, if it is set
+     * @return whether a trace was written
+     */
+    bool writeTraceIfRequested() const;
+
+    /**
+     * Find a timing's slot, adding it if it's new. Look slots up once, up front, and record with them each
+     * frame, so recording never looks a name up or allocates
+     * @param name What will be timed, e.g. "gpu ground"
+     * @return its slot, which stays the same for the profiler's lifetime
+     */
+    TimingSlot registerTiming(const std::string& name);
+
+    /**
+     * Record one frame's sample of a timing
+     * @param slot The timing's slot, from registerTiming
+     * @param milliseconds How long it took
+     */
+    void addTiming(TimingSlot slot, double milliseconds);
+
+    /**
+     * Record one sample of a timing by name, for things timed too rarely to be worth registering
+     * @param name What was timed, e.g. "server tick"
+     * @param milliseconds How long it took
+     */
+    void addTiming(const std::string& name, double milliseconds);
+
+    /**
+     * @param name The timing's name
+     * @return a copy of one per-frame timing, which is all zeros if it has never been recorded
+     */
+    Timing getTiming(const std::string& name) const;
+
+    /**
+     * @param slot The timing's slot, from registerTiming
+     * @return a copy of one per-frame timing
+     */
+    Timing getTiming(TimingSlot slot) const;
+
+    /** @return a copy of every per-frame timing that has been recorded, by name */
+    std::map<std::string, Timing> getTimings() const;
+
+    /** Forget every per-frame timing's samples, e.g. between benchmark runs. Slots stay registered */
+    void resetTimings();
+
+    /**
+     * @return how long it has been since the profiler was created (which happens early in startup), in milliseconds
+     */
+    double millisecondsSinceStart() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<TraceEvent> trace;
+    // Every timing, in the order they were registered, and each one's slot by name
+    std::vector<Timing> timings;
+    std::vector<std::string> timingNames;
+    std::map<std::string, TimingSlot> timingSlots;
+    Clock::time_point epoch;
+
+    // How much each new sample moves a timing's moving average
+    static const double constexpr recentWeight = 0.05;
+
+    Profiler();
+
+    /** registerTiming, with the mutex already held */
+    TimingSlot findSlot(const std::string& name);
+};
+
+#endif //TANKS_PROFILER_H
@@ -0,0 +1,137 @@
+#include "quality.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <cstdlib>
+#include <iostream>
+
+// The value of "tier" that turns the governor on
+static const char* AUTOMATIC_TIER = "auto";
+static const char* DEFAULT_TIER = "high";
+
+/**
+ * Read a number from a json object into a setting, if it's there
+ * @param object The object
+ * @param key The setting's key
+ * @param value The setting, left alone if the key is missing or not a number
+ */
+template<typename T>
+static void readNumber(const QJsonObject& object, const char* key, T& value) {
+    if (const QJsonValue v = object[key]; v.isDouble()) {
+        value = (T)v.toDouble();
+    }
+    else if (!v.isUndefined()) {
+        std::cerr << "QualitySettings: Expected a number for \"" << key << "\"\n";
+    }
+}
+
+QualitySettings QualitySettings::defaults() {
+    QualitySettings settings;
+
+    // name, grass shells, shell height step, shell density step, grass scale, skybox size, fov, lod scale.
+    // Each keeps the grass the same height and density as "high" with its number of shells
+    settings.tiers = {
+        {"low",     4, 0.16f, 0.6f,   200.0f, 200.0f, 45.0f, 2.0f},
+        {"medium",  8, 0.08f, 0.3f,   300.0f, 200.0f, 45.0f, 1.5f},
+        {"high",   16, 0.04f, 0.15f,  400.0f, 200.0f, 45.0f, 1.0f},
+        {"ultra",  32, 0.02f, 0.075f, 600.0f, 200.0f, 45.0f, 0.75f},
+    };
+
+    settings.startTier = settings.findTier(DEFAULT_TIER);
+    return settings;
+}
+
+QualitySettings QualitySettings::load(const std::filesystem::path& path) {
+    QualitySettings builtin = defaults();
+    QualitySettings settings = builtin;
+    QString tierName = AUTOMATIC_TIER;
+    QString startName = DEFAULT_TIER;
+
+    QFile file(QString::fromStdString(path.string()));
+
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+
+        if (doc.isObject()) {
+            QJsonObject root = doc.object();
+
+            if (const QJsonValue v = root["tier"]; v.isString()) { tierName = v.toString(); }
+            if (const QJsonValue v = root["startTier"]; v.isString()) { startName = v.toString(); }
+            readNumber(root, "targetFrameRate", settings.targetFrameRate);
+
+            if (const QJsonValue v = root["tiers"]; v.isArray() && !v.toArray().isEmpty()) {
+                settings.tiers.clear();
+
+                for(const QJsonValue tierValue : v.toArray()) {
+                    QJsonObject object = tierValue.toObject();
+                    std::string name = object["name"].toString().toStdString();
+
+                    if (name.empty()) {
+                        std::cerr << "QualitySettings: Skipping a tier with no name in " << path << "\n";
+                        continue;
+                    }
+
+                    int base = builtin.findTier(name);
+                    QualityTier tier = builtin.tiers[base >= 0 ? base : builtin.findTier(DEFAULT_TIER)];
+                    tier.name = name;
+
+                    readNumber(object, "grassShells", tier.grassShells);
+                    readNumber(object, "grassShellHeightStep", tier.grassShellHeightStep);
+                    readNumber(object, "grassShellDensityStep", tier.grassShellDensityStep);
+                    readNumber(object, "grassScale", tier.grassScale);
+                    readNumber(object, "skyboxSize", tier.skyboxSize);
+                    readNumber(object, "cameraFOVDegrees", tier.cameraFOVDegrees);
+                    readNumber(object, "lodScale", tier.lodScale);
+
+                    settings.tiers.push_back(tier);
+                }
+
+                if (settings.tiers.empty()) {
+                    settings.tiers = builtin.tiers;
+                }
+            }
+        }
+        else {
+            std::cerr << "QualitySettings: Failed to parse " << path << ": " << error.errorString().toStdString() << "\n";
+        }
+    }
+
+    if (const char* env = std::getenv("TANKS_QUALITY"); env && *env) {
+        tierName = env;
+    }
+
+    settings.automatic = tierName == AUTOMATIC_TIER;
+
+    if (!settings.automatic) {
+        startName = tierName;
+    }
+
+    int start = settings.findTier(startName.toStdString());
+
+    if (start < 0) {
+        std::cerr << "QualitySettings: No tier named \"" << startName.toStdString() << "\", using the middle one\n";
+        start = (int)settings.tiers.size() / 2;
+    }
+
+    settings.startTier = (size_t)start;
+
+    if (settings.targetFrameRate <= 0.0) {
+        settings.targetFrameRate = builtin.targetFrameRate;
+    }
+
+    return settings;
+}
+
+int QualitySettings::findTier(const std::string& name) const {
+    for(size_t i = 0; i < tiers.size(); i++) {
+        if (tiers[i].name == name) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
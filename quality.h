@@ -0,0 +1,72 @@
+#ifndef TANKS_QUALITY_H
+#define TANKS_QUALITY_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * The renderer settings that trade looks for speed. Each quality tier (low, medium, high, ultra) is
+ * one of these, cheapest first
+ */
+struct QualityTier {
+    std::string name;
+
+    // How many shells the grass is drawn with, how far apart they are, how much sparser each is
+    // than the one below, and how fine the grass noise is. Fewer shells further apart keep the
+    // grass the same height for less fill
+    int grassShells = 16;
+    float grassShellHeightStep = 0.04f;
+    float grassShellDensityStep = 0.15f;
+    float grassScale = 400.0f;
+
+    // How large the skybox mesh is
+    float skyboxSize = 200.0f;
+
+    // The field of view of the camera, in degrees
+    float cameraFOVDegrees = 45.0f;
+
+    // Multiplies the on-screen sizes at which meshes drop to simpler levels of detail. Above 1,
+    // they drop sooner
+    float lodScale = 1.0f;
+};
+
+/**
+ * The quality tiers, and which one to start on, read from assets/quality.json:
+ *
+ *  {
+ *      "tier": "auto",             // a tier's name, or "auto" to let the QualityGovernor pick
+ *      "startTier": "high",        // where "auto" starts
+ *      "targetFrameRate": 60,      // what "auto" aims to hold
+ *      "tiers": [ { "name": "low", "grassShells": 4, ... }, ... ]
+ *  }
+ *
+ * Every key is optional. "tiers" replaces the built in list, in order, and a tier's missing
+ * settings are taken from the built in tier of the same name, or "high" if there's none. The
+ * TANKS_QUALITY environment variable overrides "tier".
+ */
+struct QualitySettings {
+    std::vector<QualityTier> tiers;
+    size_t startTier = 0;
+    bool automatic = true;
+    double targetFrameRate = 60.0;
+
+    /** @return the built in tiers, starting on "high" with the governor on */
+    static QualitySettings defaults();
+
+    /**
+     * Read the settings from a file. Anything that can't be read is warned about, and left as
+     * the default
+     * @param path The json file. It's fine for it not to exist
+     * @return the settings
+     */
+    static QualitySettings load(const std::filesystem::path& path);
+
+    /**
+     * @param name A tier's name
+     * @return its index, or -1 if there's no such tier
+     */
+    int findTier(const std::string& name) const;
+};
+
+#endif //TANKS_QUALITY_H
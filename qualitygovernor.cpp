@@ -0,0 +1,63 @@
+#include "qualitygovernor.h"
+
+#include <algorithm>
+
+QualityGovernor::QualityGovernor(size_t tierCount, size_t startTier, double budgetMilliseconds)
+    : tierCount(std::max<size_t>(tierCount, 1)), tier(std::min(startTier, this->tierCount - 1)), budget(budgetMilliseconds) {
+    window.reserve(windowSize);
+}
+
+size_t QualityGovernor::addFrame(double milliseconds) {
+    if (milliseconds >= pauseMilliseconds) {
+        return tier;
+    }
+
+    window.push_back(milliseconds);
+
+    if (window.size() < windowSize) {
+        return tier;
+    }
+
+    auto index = (size_t)(windowPercentile * (window.size() - 1));
+    std::nth_element(window.begin(), window.begin() + index, window.end());
+    lastPercentile = window[index];
+    window.clear();
+
+    if (lastPercentile > budget * downgradeAbove) {
+        if (tier > 0) {
+            // The step up didn't fit after all, so be slower to try it again
+            if (justUpgraded) {
+                windowsNeeded = std::min(windowsNeeded * 2, maxUpgradeWindows);
+            }
+
+            changeTier(tier - 1);
+        }
+
+        windowsWithHeadroom = 0;
+    }
+    else if (lastPercentile < budget * upgradeBelow && tier + 1 < tierCount) {
+        if (++windowsWithHeadroom >= windowsNeeded) {
+            changeTier(tier + 1);
+            justUpgraded = true;
+            return tier;
+        }
+    }
+    else {
+        windowsWithHeadroom = 0;
+    }
+
+    justUpgraded = false;
+    return tier;
+}
+
+void QualityGovernor::setTier(size_t newTier) {
+    changeTier(std::min(newTier, tierCount - 1));
+    windowsNeeded = upgradeWindows;
+    justUpgraded = false;
+}
+
+void QualityGovernor::changeTier(size_t newTier) {
+    tier = newTier;
+    window.clear();
+    windowsWithHeadroom = 0;
+}
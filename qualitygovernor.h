@@ -0,0 +1,95 @@
+#ifndef TANKS_QUALITYGOVERNOR_H
+#define TANKS_QUALITYGOVERNOR_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Picks the quality tier automatically, to hold a target frame rate.
+ *
+ * It's fed how long each frame took to draw, and every window of frames it looks at the 95th
+ * percentile, so one hitch doesn't count but regular slow frames do. If that's over the frame
+ * budget, it steps down a tier right away. Stepping up needs a lot more headroom, for several
+ * windows in a row, so the tier doesn't bounce between two that are both near the budget. If a
+ * step up has to be undone straight away, the next attempt waits twice as long.
+ *
+ * Tiers are indices, 0 being the cheapest. The governor doesn't know anything else about them.
+ *
+ *  QualityGovernor governor(tiers.size(), startTier, 1000.0 / 60.0);
+ *  size_t tier = governor.addFrame(frameMilliseconds);
+ */
+class QualityGovernor {
+public:
+    /**
+     * @param tierCount How many tiers there are
+     * @param startTier Which to start on
+     * @param budgetMilliseconds How long a frame may take, e.g. 1000 / 60 to hold 60 frames per second
+     */
+    QualityGovernor(size_t tierCount, size_t startTier, double budgetMilliseconds);
+
+    /**
+     * Record one frame's time
+     * @param milliseconds How long the frame took. Time spent waiting for vsync shouldn't count,
+     * or the governor can never see how much headroom there is
+     * @return the tier to draw the next frame at
+     */
+    size_t addFrame(double milliseconds);
+
+    /**
+     * Switch to a tier, e.g. when the player picks one. Starts collecting afresh
+     * @param tier The tier
+     */
+    void setTier(size_t tier);
+
+    /** @return the tier to draw at */
+    size_t getTier() const { return tier; }
+
+    /** @return the 95th percentile of the last full window, in milliseconds, or 0 before the first */
+    double getLastPercentile() const { return lastPercentile; }
+
+private:
+    /**
+     * Move to a tier and forget the frames drawn at the old one
+     * @param newTier The tier
+     */
+    void changeTier(size_t newTier);
+
+    size_t tierCount;
+    size_t tier;
+    double budget;
+
+    // The frames of the current window
+    std::vector<double> window;
+    double lastPercentile = 0.0;
+
+    // How many windows in a row have had room for the next tier up, and how many are needed
+    size_t windowsWithHeadroom = 0;
+    size_t windowsNeeded = upgradeWindows;
+
+    // Whether the last change was a step up, and no full window has passed since, so a step down
+    // now means the step up was a mistake
+    bool justUpgraded = false;
+
+    // How many frames are judged together, about two seconds at 60 frames per second
+    static const size_t constexpr windowSize = 120;
+
+    // Which percentile of a window is compared against the budget
+    static const double constexpr windowPercentile = 0.95;
+
+    // Step down when the percentile goes over this much of the budget
+    static const double constexpr downgradeAbove = 1.0;
+
+    // Step up when the percentile stays under this much of the budget. Tiers are roughly 1.5 to 2
+    // times as expensive as the one below, so this leaves room for the next one
+    static const double constexpr upgradeBelow = 0.55;
+
+    // How many windows in a row need headroom before stepping up, and the most that can grow to
+    static const size_t constexpr upgradeWindows = 3;
+    static const size_t constexpr maxUpgradeWindows = 48;
+
+    // Frames longer than this were a pause (a dragged window, a breakpoint, loading), not the
+    // renderer being slow, so they're left out
+    static const double constexpr pauseMilliseconds = 1000.0;
+};
+
+#endif //TANKS_QUALITYGOVERNOR_H
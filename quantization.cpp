@@ -0,0 +1,81 @@
+#include "quantization.h"
+#include "snapshot.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// How far from 1 a direction's length can be and still count as a unit vector. GameObject::setDirection
+// normalises, which lands within a few float steps of it
+static const float constexpr UNIT_TOLERANCE = 1e-4f;
+
+Quantization Quantization::forMap(double xLength, double zLength) {
+    Quantization quantization;
+    quantization.xLength = (float)xLength;
+    quantization.zLength = (float)zLength;
+    return quantization;
+}
+
+bool Quantization::isValid() const {
+    return std::isfinite(xLength) && xLength > 0.0f && std::isfinite(zLength) && zLength > 0.0f &&
+           positionBits >= 1 && positionBits <= maxBits && yawBits >= 1 && yawBits <= maxBits;
+}
+
+bool Quantization::fitsGrid(const glm::vec3& position) const {
+    return position.y == 0.0f && std::abs(position.x) <= 0.5f * xLength && std::abs(position.z) <= 0.5f * zLength;
+}
+
+bool Quantization::isFlat(const glm::vec3& direction) {
+    return direction.y == 0.0f && std::abs(glm::length(direction) - 1.0f) <= UNIT_TOLERANCE;
+}
+
+uint32_t Quantization::quantizeYaw(const glm::vec3& direction) const {
+    uint32_t steps = 1u << yawBits;
+    double turns = (std::atan2((double)direction.z, (double)direction.x) + glm::pi<double>()) / glm::two_pi<double>();
+
+    // Exactly backwards rounds up to a whole turn, which is the same as none
+    return (uint32_t)std::llround(turns * steps) % steps;
+}
+
+glm::vec3 Quantization::dequantizeYaw(uint32_t value) const {
+    double angle = value * glm::two_pi<double>() / (1u << yawBits) - glm::pi<double>();
+    return glm::vec3((float)std::cos(angle), 0.0f, (float)std::sin(angle));
+}
+
+void Quantization::round(EntityState& state) const {
+    if (fitsGrid(state.position)) {
+        state.position.x = dequantizeX(quantizeX(state.position.x));
+        state.position.z = dequantizeZ(quantizeZ(state.position.z));
+    }
+
+    if (isFlat(state.direction)) {
+        state.direction = dequantizeYaw(quantizeYaw(state.direction));
+    }
+}
+
+float Quantization::getPositionError() const {
+    return 0.5f * std::max(xLength, zLength) / (float)((1u << positionBits) - 1);
+}
+
+float Quantization::getYawError() const {
+    return glm::pi<float>() / (float)(1u << yawBits);
+}
+
+// Both ways are worked out in doubles, so the only rounding that matters is to the float at the end
+
+uint32_t Quantization::quantize(float value, float length, int bits) {
+    uint32_t steps = (1u << bits) - 1;
+    double scaled = ((double)value / length + 0.5) * steps;
+    return (uint32_t)std::llround(std::clamp(scaled, 0.0, (double)steps));
+}
+
+float Quantization::dequantize(uint32_t value, float length, int bits) {
+    uint32_t steps = (1u << bits) - 1;
+    return (float)(((double)value / steps - 0.5) * length);
+}
+
+bool operator==(const Quantization& a, const Quantization& b) {
+    return a.xLength == b.xLength && a.zLength == b.zLength && a.positionBits == b.positionBits && a.yawBits == b.yawBits;
+}
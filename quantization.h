@@ -0,0 +1,110 @@
+#ifndef TANKS_QUANTIZATION_H
+#define TANKS_QUANTIZATION_H
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+
+struct EntityState;
+
+/**
+ * How precisely snapshots send where things are and which way they face.
+ *
+ * Everything lives on the map's XZ plane, centred on the origin, so a position on the map is sent as x and z
+ * in fixed point across the map's length, positionBits each, and its y (always 0) not at all. A direction
+ * flat on the plane is sent as its yaw, the angle from +x towards +z, in yawBits. Anything else, like a
+ * projectile that's flown off the map, is sent exactly, as floats.
+ *
+ * The server rounds every state it captures to what can be sent (round), so what it keeps is exactly what
+ * clients decode, and a tank that hasn't moved still compares equal.
+ */
+struct Quantization {
+    // The map's size along x and z, as in mapProperties
+    float xLength = 30.0f;
+    float zLength = 30.0f;
+
+    // The bits for each of a position's x and z, and for a yaw. At the defaults on a 30 unit map, a position
+    // is within a quarter of a thousandth of a unit, and a direction within a twentieth of a thousandth of a
+    // radian, which the client's prediction can't tell from exact
+    uint8_t positionBits = 16;
+    uint8_t yawBits = 16;
+
+    /**
+     * @param xLength The map's size along x, as Scene::getXLength
+     * @param zLength The map's size along z, as Scene::getZLength
+     * @return the default precision for that map
+     */
+    static Quantization forMap(double xLength, double zLength);
+
+    /** @return whether the lengths are positive and the bit counts from 1 to maxBits */
+    bool isValid() const;
+
+    /**
+     * @param position A position
+     * @return whether it's on the map and the plane, so fixed point can hold it
+     */
+    bool fitsGrid(const glm::vec3& position) const;
+
+    /**
+     * @param direction A direction
+     * @return whether it's flat on the plane and unit length, so a yaw can hold it
+     */
+    static bool isFlat(const glm::vec3& direction);
+
+    /**
+     * @param value An x on the map
+     * @return it in fixed point
+     */
+    uint32_t quantizeX(float value) const { return quantize(value, xLength, positionBits); }
+    uint32_t quantizeZ(float value) const { return quantize(value, zLength, positionBits); }
+
+    /**
+     * @param value An x in fixed point
+     * @return the x on the map it stands for
+     */
+    float dequantizeX(uint32_t value) const { return dequantize(value, xLength, positionBits); }
+    float dequantizeZ(uint32_t value) const { return dequantize(value, zLength, positionBits); }
+
+    /**
+     * @param direction A flat direction
+     * @return its yaw in yawBits
+     */
+    uint32_t quantizeYaw(const glm::vec3& direction) const;
+
+    /**
+     * @param value A yaw in yawBits
+     * @return the flat direction it stands for
+     */
+    glm::vec3 dequantizeYaw(uint32_t value) const;
+
+    /**
+     * Round a state to what a snapshot can send of it
+     * @param state The state
+     */
+    void round(EntityState& state) const;
+
+    /** @return the most a position on the map moves when it's rounded, along x or z */
+    float getPositionError() const;
+
+    /** @return the most a direction's yaw moves when it's rounded, in radians */
+    float getYawError() const;
+
+    // The most bits for any field. A float only has 24 to give, and rounding a value it's decoded to has to
+    // land back on the same step, which needs a couple to spare
+    static const int constexpr maxBits = 22;
+
+private:
+    /**
+     * @param value A coordinate, from -length / 2 to length / 2
+     * @param length The map's length along it
+     * @param bits How many bits to fit it in
+     * @return the nearest of the evenly spaced values those bits can say, clamped to the map
+     */
+    static uint32_t quantize(float value, float length, int bits);
+
+    static float dequantize(uint32_t value, float length, int bits);
+};
+
+bool operator==(const Quantization& a, const Quantization& b);
+
+#endif //TANKS_QUANTIZATION_H
@@ -1,12 +1,20 @@
 #include "renderer.h"
 
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <QPainter>
+#include <QThread>
+
+#include <cmath>
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
 
+#include "assetloader.h"
 #include "gameobject.h"
+#include "profiler.h"
+#include "scene.h"
 
 // These are the magic names that the renderer looks for when loading assets
 
@@ -21,37 +29,57 @@ static const char* GROUND_TEXTURE_FILE = "ground";
 
 static const char* SKY_CUBEMAP_FOLDER = "bluecloud";
 
+static const char* QUALITY_FILE = "assets/quality.json";
+static const char* AUTOMATIC_QUALITY = "auto";
+
+static const ObstacleType OBSTACLE_TYPES[] = {ObstacleType::Tree, ObstacleType::Boulder, ObstacleType::House};
+
+// The names of the render passes, as they appear in the Profiler's timings
+static const char* PASS_NAMES[] = {"ground", "opaque", "skybox"};
 
+
+// Each instance is placed by a position, yaw and scale from the arena's instance buffer, one per
+// indirect draw command, and the rotation is rebuilt here rather than uploading a matrix. Its color and
+// texture layer are looked up by its type. Types without a texture (layer -1) are drawn in their flat
+// color instead, so every object shares this one program and the whole opaque pass can be a single
+// multi-draw
 static const char* texturedVertexSource = R"(
 #version 450
 
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec2 tex;
 layout (location = 2) in vec3 norm;
+layout (location = 3) in vec4 placement;
+layout (location = 4) in float scale;
+layout (location = 5) in uint type;
 
 out vec2 texCoord;
 out vec3 normal;
+out vec3 color;
+flat out int layer;
+flat out int impostor;
 
-uniform mat4 mvp;
-uniform mat4 mv;
-
-void main() {
-    gl_Position = mvp * vec4(pos, 1.0f);
-    texCoord = tex;
-    normal = mat3(mv) * norm;
-})";
-
-static const char* coloredFragmentSource = R"(
-#version 450
+uniform mat4 vp;
+uniform mat4 view;
 
-in vec2 texCoord;
+// Per instance type: the flat color in rgb, and the texture array layer in w
+uniform vec4 typeMaterials[16];
+uniform uint firstImpostorType;
 
-out vec4 fragColor;
+void main() {
+    // A rotation about the up axis, by columns: right is (c, 0, -s), up is (0, 1, 0), forward is (s, 0, c)
+    float s = sin(placement.w);
+    float c = cos(placement.w);
+    mat3 rotation = mat3(c, 0.0f, -s, 0.0f, 1.0f, 0.0f, s, 0.0f, c);
 
-uniform vec3 color;
+    gl_Position = vp * vec4(rotation * (pos * scale) + placement.xyz, 1.0f);
+    texCoord = tex;
+    normal = mat3(view) * (rotation * norm);
 
-void main() {
-    fragColor = vec4(color, 1.0f);
+    vec4 material = typeMaterials[type];
+    color = material.rgb;
+    layer = int(material.w);
+    impostor = type >= firstImpostorType ? 1 : 0;
 })";
 
 static const char* texturedFragmentSource = R"(
@@ -59,22 +87,42 @@ static const char* texturedFragmentSource = R"(
 
 in vec2 texCoord;
 in vec3 normal;
+in vec3 color;
+flat in int layer;
+flat in int impostor;
 
 out vec4 fragColor;
 
-uniform sampler2D albedo;
+uniform sampler2DArray albedo;
 uniform vec3 lightPos;
 uniform float ambient;
 
 void main() {
+    if (layer < 0) {
+        fragColor = vec4(color, 1.0f);
+        return;
+    }
+
+    // Impostors are pictures of an already lit mesh, with transparency around it
+    if (impostor != 0) {
+        vec4 texel = texture(albedo, vec3(texCoord, layer));
+
+        if (texel.a < 0.5f) {
+            discard;
+        }
+
+        fragColor = vec4(texel.rgb, 1.0f);
+        return;
+    }
+
     float surfaceAlignment = clamp(dot(normalize(normal), normalize(lightPos)), 0.0f, 1.0f);
-    vec4 color = texture(albedo, texCoord) * (surfaceAlignment + ambient);
-    color += vec4(ambient, ambient, ambient, 0.0f);
+    vec4 lit = texture(albedo, vec3(texCoord, layer)) * (surfaceAlignment + ambient);
+    lit += vec4(ambient, ambient, ambient, 0.0f);
 
     fragColor = vec4(
-        color[0],
-        color[1],
-        color[2],
+        lit[0],
+        lit[1],
+        lit[2],
         1.0f
     );
 })";
@@ -173,10 +221,47 @@ void main() {
 
 
 
+Renderer::Renderer() {
+    // Give every per-frame list room for a busy level up front, so drawing never allocates. They only
+    // ever grow past this, never shrink
+    frames.forEach([](std::vector<DrawCommand>& frame) { frame.reserve(initialDrawCapacity); });
+    queuedDraws.reserve(initialDrawCapacity);
+    instances.reserve(initialDrawCapacity);
+    indirectCommands.reserve(initialDrawCapacity);
+
+    // Likewise the timings, so recording them is just an index
+    Profiler* profiler = Profiler::getInstance();
+
+    for(size_t pass = 0; pass < RenderPassCount; pass++) {
+        cpuPassTimings[pass] = profiler->registerTiming(std::string("cpu ") + PASS_NAMES[pass]);
+    }
+
+    cpuFrameTiming = profiler->registerTiming("cpu frame");
+    cpuCaptureTiming = profiler->registerTiming("cpu capture");
+    gpuFrameTiming = profiler->registerTiming("gpu frame");
+
+    // Nothing in the tiers needs the context, so they're ready before initializeGL, for tools to pick one
+    qualitySettings = QualitySettings::load(QUALITY_FILE);
+    applyQualityTier(qualitySettings.startTier);
+
+    if (qualitySettings.automatic) {
+        governor = std::make_unique<QualityGovernor>(qualitySettings.tiers.size(), qualityTier, 1000.0 / qualitySettings.targetFrameRate);
+    }
+}
+
 void Renderer::doneWithFrame() {
-    lastFrame = curFrame;
-    curFrame.clear();
-    update();
+    // Hand the finished frame to paintGL, and start the next one in whichever buffer comes back
+    frames.publish();
+    frames.write().clear();
+
+    // update() has to be called from the GUI thread, so if the frame was built on another thread, ask
+    // the GUI thread to do it
+    if (QThread::currentThread() == thread()) {
+        update();
+    }
+    else {
+        QMetaObject::invokeMethod(this, [this] { update(); }, Qt::QueuedConnection);
+    }
 }
 
 void Renderer::drawObject(const GameObject* object) {
@@ -185,8 +270,19 @@ void Renderer::drawObject(const GameObject* object) {
         return;
     }
 
+    // Obstacles are drawn from the static batch, built once when the level started
+    if (object->getType() == GameObjectType::Obstacle) {
+        return;
+    }
+
     DrawCommand cmd{};
 
+    if (buildCommand(object, cmd)) {
+        frames.write().push_back(cmd);
+    }
+}
+
+bool Renderer::buildCommand(const GameObject* object, Renderer::DrawCommand& cmd) {
     switch(object->getType()) {
         case GameObjectType::PlayerTank:
             cmd.type = DrawCommandType::Player;
@@ -205,54 +301,122 @@ void Renderer::drawObject(const GameObject* object) {
             break;
         case GameObjectType::None:
             std::cerr << "Renderer: Can't draw none-type object\n";
-            return;
+            return false;
     }
 
-    // Compute the basis vectors of the object's rotation using the cross product
-    // of its forward direction, and the world's up vector
-    glm::vec3 pos = object->getPosition();
+    // Everything stands upright, so only the heading about the up axis matters
     glm::vec3 objectForward = object->getDirection();
 
-    if (glm::length(objectForward) < 0.001f) {
-        objectForward = glm::vec3(0, 0, -1);
+    cmd.position = object->getPosition();
+    cmd.yaw = glm::length(objectForward) < 0.001f ? glm::pi<float>() : std::atan2(objectForward.x, objectForward.z);
+
+    if (cmd.type == DrawCommandType::Obstacle) {
+        cmd.obstacleType = dynamic_cast<const Obstacle*>(object)->getObstacleType();
     }
-    else {
-        objectForward = glm::normalize(objectForward);
+
+    specialCaseAdjusment(cmd);
+
+    return true;
+}
+
+void Renderer::buildStaticBatch(const Scene* scene) {
+    staticCommands.clear();
+    staticBatch.clear();
+
+    for(const GameObject* object : *scene) {
+        if (!object || object->getType() != GameObjectType::Obstacle) {
+            continue;
+        }
+
+        DrawCommand cmd{};
+
+        if (buildCommand(object, cmd)) {
+            staticCommands.emplace_back(cmd);
+        }
     }
 
-    glm::vec3 worldUp = glm::vec3(0, 1, 0);
-    glm::vec3 objectRight = glm::normalize(glm::cross(worldUp, objectForward));
+    // The meshes and textures may not be loaded yet (the first level starts before the renderer is
+    // ever shown), so resolving them waits for the next paint
+    staticBatchDirty = true;
+    update();
+}
 
-    cmd.transform[0] = glm::vec4(objectRight, 0.0f);
-    cmd.transform[1] = glm::vec4(worldUp, 0.0f);
-    cmd.transform[2] = glm::vec4(objectForward, 0.0f);
-    cmd.transform[3] = glm::vec4(pos, 1.0f);
+void Renderer::resolveStaticBatch() {
+    staticBatch.clear();
+    staticBatch.reserve(staticCommands.size());
 
-    cmd.forwardPoint = pos + glm::normalize(objectForward);
+    for(const auto& cmd : staticCommands) {
+        std::string obstacleTypeName = Obstacle::convertObstacleTypeToName(cmd.obstacleType);
 
-    if (cmd.type == DrawCommandType::Obstacle) {
-        cmd.obstacleType = dynamic_cast<const Obstacle*>(object)->getObstacleType();
+        MeshArena::MeshId mesh = meshId(obstacleTypeName);
+
+        if (obstacleTypeName.empty() || mesh == MeshArena::invalidMesh) {
+            std::string errorName = obstacleTypeName.empty() ? "(empty)" : obstacleTypeName;
+            std::cerr << "Renderer: No obstacle by type " << errorName << "\n";
+            continue;
+        }
+
+        staticBatch.push_back({mesh, instanceFor(cmd)});
     }
 
-    specialCaseAdjusment(cmd);
+    // Sort so that everything sharing a mesh is queued together
+    std::sort(staticBatch.begin(), staticBatch.end(), [](const StaticDraw& a, const StaticDraw& b) {
+        return a.mesh < b.mesh;
+    });
 
-    curFrame.emplace_back(cmd);
+    staticBatchDirty = false;
 }
 
 void Renderer::paintGL() {
     QOpenGLWidget::paintGL();
 
+    // The startup trace ends at the first frame, since that's when the player can actually see anything
+    if (!drawnFirstFrame) {
+        drawnFirstFrame = true;
+
+        auto now = Profiler::Clock::now();
+        Profiler::getInstance()->addTraceEvent("first frame", "startup", now, now);
+        Profiler::getInstance()->writeTraceIfRequested();
+    }
+
+    auto frameStart = std::chrono::steady_clock::now();
+    frameStats = {};
+
+    updateCapture();
+
+    // Pick up the newest finished frame, if there is one. Otherwise the last one is drawn again
+    frames.acquire();
+
+    if (gpuTimer) {
+        gpuTimer->beginFrame();
+    }
+
+    // Every mesh is in the arena, so its vertex array is the only one a frame needs
+    arena->bind();
+
     // Clear both the color buffer and depth buffer, preparing to draw an entirely fresh frame
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Handle setting any camera properties needed for this frame
     frameSetCamera();
+    cameraPosition = glm::vec3(glm::inverse(view)[3]);
 
     // Always draw the ground
+    beginPass(GroundPass);
     drawGround();
+    endPass(GroundPass);
+
+    beginPass(OpaquePass);
+
+    // Draw the level's static objects
+    if (staticBatchDirty) {
+        resolveStaticBatch();
+    }
+
+    drawStaticBatch();
 
     // Loop through the commands, and draw each object at its appropriate location/type/etc
-    for(auto& cmd : lastFrame) {
+    for(const auto& cmd : frames.read()) {
 
         switch(cmd.type) {
             case DrawCommandType::Player:
@@ -261,46 +425,63 @@ void Renderer::paintGL() {
             case DrawCommandType::Enemy:
                 drawEnemyTank(cmd);
                 break;
-            case DrawCommandType::Obstacle:
-                drawObstacle(cmd);
-                break;
             case DrawCommandType::Bullet:
                 drawProjectile(cmd);
                 break;
         }
     }
 
+    flushQueuedDraws();
+
+    endPass(OpaquePass);
+
     // Always draw the skybox
+    beginPass(SkyboxPass);
     drawSkybox();
-}
+    endPass(SkyboxPass);
 
-void Renderer::resizeGL(int w, int h) {
-    QOpenGLWidget::resizeGL(w, h);
+    lastFrameStats = frameStats;
 
-    // If the window size changes, we have to recreate the projection. See initializeGL for details
-    projection = glm::perspective(
-        glm::radians(cameraFOVDegrees),
-        (float)w / float(h),
-        0.1f,
-        100.0f
-    );
-}
+    // Captured before the overlay, so recordings show just the game
+    if (capture) {
+        auto captureStart = std::chrono::steady_clock::now();
+        capture->captureFrame();
+        auto captureEnd = std::chrono::steady_clock::now();
 
-void Renderer::initializeGL() {
-    QOpenGLWidget::initializeGL();
-    QOpenGLExtraFunctions::initializeOpenGLFunctions();
+        Profiler::getInstance()->addTiming(cpuCaptureTiming, std::chrono::duration<double, std::milli>(captureEnd - captureStart).count());
+    }
 
-    // Enable depth buffering/testing (so that objects behind others aren't drawn over top of them)
-    glEnable(GL_DEPTH_TEST);
+    auto frameEnd = std::chrono::steady_clock::now();
+    double cpuMilliseconds = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+    Profiler::getInstance()->addTiming(cpuFrameTiming, cpuMilliseconds);
 
-    // Enable backface culling, so that the GPU only draws the faces the camera can see
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glFrontFace(GL_CCW);
+    // Whichever of the CPU and GPU took longer is what limits the frame rate. The GPU time is from a
+    // frame or two ago, which is near enough. Neither includes waiting for vsync, so the governor can
+    // tell how much room is left
+    if (governor) {
+        double gpuMilliseconds = Profiler::getInstance()->getTiming(gpuFrameTiming).last;
+        size_t tier = governor->addFrame(std::max(cpuMilliseconds, gpuMilliseconds));
 
-    // Set the background color of the window when nothing is on it
-    glClearColor(backgroundRed, backgroundBlue, backgroundGreen, 1.0f);
+        if (tier != qualityTier) {
+            applyQualityTier(tier);
+        }
+    }
+
+    if (showStatsOverlay) {
+        drawStatsOverlay();
+    }
+}
+
+void Renderer::resizeGL(int w, int h) {
+    QOpenGLWidget::resizeGL(w, h);
+
+    // If the window size changes, we have to recreate the projection
+    viewportWidth = w;
+    viewportHeight = h;
+    updateProjection();
+}
 
+void Renderer::updateProjection() {
     // This produces the perspective projection matrix for doing a standard 3D scene
     // The arguments to this are:
     // 1. The field of view of the camera, in radians
@@ -308,31 +489,47 @@ void Renderer::initializeGL() {
     // 3. The "near plane", or basically if something gets closer than this, it's invisible
     // 4. The "far plane", or if something gets farther than this, it's invisible
     projection = glm::perspective(
-        glm::radians(cameraFOVDegrees),
-        (float)this->width() / (float)this->height(),
+        glm::radians(quality().cameraFOVDegrees),
+        (float)viewportWidth / (float)viewportHeight,
         0.1f,
         100.0f
     );
 
+    pixelsPerUnit = (float)viewportHeight / (2.0f * std::tan(glm::radians(quality().cameraFOVDegrees) / 2.0f));
+}
+
+void Renderer::initializeGL() {
+    QOpenGLWidget::initializeGL();
+    QOpenGLExtraFunctions::initializeOpenGLFunctions();
+
+    setGLState();
+
+    gpuTimer = std::make_unique<GpuTimer>(std::vector<std::string>(std::begin(PASS_NAMES), std::end(PASS_NAMES)));
+
+    viewportWidth = this->width();
+    viewportHeight = this->height();
+    updateProjection();
+
     setCameraMode(CameraMode::Static);
 
     try {
-        shaders["textured"] = Shader::fromSource(texturedVertexSource, texturedFragmentSource);
-        shaders["colored"] = Shader::fromSource(texturedVertexSource, coloredFragmentSource);
-        shaders["skybox"] = Shader::fromSource(skyboxVertexSource, skyboxFragmentSource);
-        shaders["ground"] = Shader::fromSource(groundVertexSource, groundFragmentSource);
+        Profiler::Scope initScope("initialize renderer", "startup");
 
-        // Ensure the data exists as an empty mesh, so at worst, if the meshes aren't on disk, we just
-        // don't draw them instead of crashing or something
-        meshes[TANK_MESH_FILE] = {};
-        meshes[BULLET_MESH_FILE] = {};
-        meshes[SKY_MESH_FILE] = {};
+        // Meshes that aren't on disk are looked up as MeshArena::invalidMesh, so at worst we just don't
+        // draw them instead of crashing or something
+        arena = std::make_unique<MeshArena>();
+
+        // All the file reading and decoding happens on the loader's worker threads. This thread only
+        // does the GL uploads, as each piece of work finishes
+        AssetLoader loader;
 
         if (std::filesystem::exists("assets/models")) {
             for(const auto& entry : std::filesystem::directory_iterator("assets/models")) {
                 if (entry.is_regular_file()) {
                     const auto& path = entry.path();
-                    meshes[path.stem().string()] = Mesh(path);
+                    std::string name = path.stem().string();
+
+                    loader.loadMesh(name, path, MeshOptimizer::levelCountFor(name));
                 }
             }
         }
@@ -344,7 +541,7 @@ void Renderer::initializeGL() {
             for(const auto& entry : std::filesystem::directory_iterator("assets/textures")) {
                 if (entry.is_regular_file()) {
                     const auto& path = entry.path();
-                    textures[path.stem().string()] = Texture::fromFile(path);
+                    loader.loadTexture(path.stem().string(), path);
                 }
             }
         }
@@ -352,15 +549,127 @@ void Renderer::initializeGL() {
             std::cerr << "Renderer: No textures available, using coloring instead\n";
         }
 
+        // The textures of the objects drawn in the opaque pass are collected, and packed into one texture
+        // array once they've all arrived. The ground has a shader of its own, so it stays a regular texture
+        std::vector<std::pair<std::string, QImage>> materialImages;
+
+        // The simplified meshes, collected until everything's loaded and the chains can be put together
+        std::unordered_map<std::string, std::array<MeshArena::MeshId, MeshOptimizer::lodCount>> lodMeshes;
+
+        // Cubemaps are collected face by face, and uploaded once all six have arrived
+        std::unordered_map<std::string, std::vector<QImage>> cubemapFaces;
+        std::unordered_map<std::string, size_t> cubemapFacesRemaining;
+
         if (std::filesystem::exists("assets/cubemaps")) {
             for(const auto& entry : std::filesystem::directory_iterator("assets/cubemaps")) {
                 if (entry.is_directory()) {
                     const auto& path = entry.path();
-                    textures[path.stem().string()] = Texture::cubemapFromFolder(path);
+                    std::string name = path.stem().string();
+
+                    auto faces = Texture::cubemapFaces(path);
+                    cubemapFaces[name].resize(faces.size());
+                    cubemapFacesRemaining[name] = faces.size();
+
+                    for(size_t i = 0; i < faces.size(); i++) {
+                        loader.loadCubemapFace(name, (int)i, faces[i].path, faces[i].flipHorizontal, faces[i].flipVertical);
+                    }
                 }
             }
         }
 
+        // Compiling the shaders (or loading them from the program binary cache) needs the context, so it
+        // happens here while the workers decode
+        {
+            Profiler::Scope scope("build shaders", "startup");
+
+            shaders["textured"] = Shader::fromSource(texturedVertexSource, texturedFragmentSource, "textured");
+            shaders["skybox"] = Shader::fromSource(skyboxVertexSource, skyboxFragmentSource, "skybox");
+            shaders["ground"] = Shader::fromSource(groundVertexSource, groundFragmentSource, "ground");
+
+            const Shader& textured = shaders.at("textured");
+            texturedUniforms.vp = textured.findLocation("vp");
+            texturedUniforms.view = textured.findLocation("view");
+            texturedUniforms.lightPos = textured.findLocation("lightPos");
+            texturedUniforms.ambient = textured.findLocation("ambient");
+            texturedUniforms.typeMaterials = textured.findLocation("typeMaterials[0]");
+            texturedUniforms.firstImpostorType = textured.findLocation("firstImpostorType");
+
+            const Shader& ground = shaders.at("ground");
+            groundUniforms.grassDensity = ground.findLocation("grassDensity");
+            groundUniforms.grassScale = ground.findLocation("grassScale");
+            groundUniforms.mvp = ground.findLocation("mvp");
+            groundUniforms.model = ground.findLocation("model");
+            groundUniforms.view = ground.findLocation("view");
+            groundUniforms.projection = ground.findLocation("projection");
+            groundUniforms.color = ground.findLocation("color");
+
+            skyboxVp = shaders.at("skybox").findLocation("vp");
+        }
+
+        while (loader.hasPending()) {
+            AssetLoader::Result result = loader.next();
+
+            if (!result.error.empty()) {
+                throw std::runtime_error(result.error);
+            }
+
+            Profiler::Scope scope("upload " + result.name, "startup");
+
+            switch (result.kind) {
+                case AssetLoader::Result::Kind::Mesh:
+                    meshes[result.name] = arena->add(result.meshes[0]->view());
+
+                    if (result.meshes.size() > 1) {
+                        auto& levels = lodMeshes[result.name];
+                        levels.fill(MeshArena::invalidMesh);
+
+                        for(size_t lod = 1; lod < result.meshes.size(); lod++) {
+                            levels[lod] = arena->add(result.meshes[lod]->view());
+                        }
+                    }
+                    break;
+                case AssetLoader::Result::Kind::Texture:
+                    if (result.name == GROUND_TEXTURE_FILE) {
+                        textures[result.name] = Texture::fromImage(result.image);
+                    }
+                    else {
+                        materialImages.emplace_back(result.name, std::move(result.image));
+                    }
+                    break;
+                case AssetLoader::Result::Kind::CubemapFace:
+                    cubemapFaces[result.name][result.face] = std::move(result.image);
+
+                    if (--cubemapFacesRemaining[result.name] == 0) {
+                        textures[result.name] = Texture::cubemapFromImages(cubemapFaces[result.name]);
+                        cubemapFaces.erase(result.name);
+                    }
+                    break;
+            }
+        }
+
+        // Impostors are rendered into layers after the textures', so without textures there are none
+        int32_t impostorLayers = buildLodChains(lodMeshes, materialImages.empty() ? -1 : (int32_t)materialImages.size());
+
+        if (!materialImages.empty()) {
+            Profiler::Scope scope("upload texture array", "startup");
+
+            // The loader finishes in whatever order it likes, so sort to keep the layers the same every run
+            std::sort(materialImages.begin(), materialImages.end(), [](const auto& a, const auto& b) {
+                return a.first < b.first;
+            });
+
+            std::vector<QImage> layers;
+
+            for(auto& [name, image] : materialImages) {
+                materialLayers[name] = (int32_t)layers.size();
+                layers.push_back(std::move(image));
+            }
+
+            materials = std::make_unique<Texture>(Texture::arrayFromImages(layers, impostorLayers));
+        }
+
+        buildTypeMaterials();
+        buildImpostors();
     }
     catch (std::exception& ex) {
         std::string msg = "The following error occurred while initializing the renderer:\n\n";
@@ -371,10 +680,187 @@ void Renderer::initializeGL() {
 }
 
 Renderer::~Renderer() {
-    // These classes' destructors handle the cleanup
+    // These classes' destructors handle the cleanup, but they need our context to be current to do it
+    makeCurrent();
+    capture.reset();
+    gpuTimer.reset();
+    staticBatch.clear();
+    lodChains.clear();
     meshes.clear();
+    arena.reset();
     shaders.clear();
     textures.clear();
+    materials.reset();
+    doneCurrent();
+
+    // A capture that just stopped may still be writing its last frames
+    FrameCapture::waitForWriters();
+}
+
+void Renderer::setGLState() {
+    // Enable depth buffering/testing (so that objects behind others aren't drawn over top of them)
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+
+    // Enable backface culling, so that the GPU only draws the faces the camera can see
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CCW);
+
+    // Nothing the renderer draws is transparent
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+
+    // Set the background color of the window when nothing is on it
+    glClearColor(backgroundRed, backgroundBlue, backgroundGreen, 1.0f);
+}
+
+void Renderer::beginPass(Renderer::RenderPass pass) {
+    passStart = std::chrono::steady_clock::now();
+
+    if (gpuTimer) {
+        gpuTimer->begin(pass);
+    }
+}
+
+void Renderer::endPass(Renderer::RenderPass pass) {
+    if (gpuTimer) {
+        gpuTimer->end();
+    }
+
+    auto passEnd = std::chrono::steady_clock::now();
+    Profiler::getInstance()->addTiming(cpuPassTimings[pass], std::chrono::duration<double, std::milli>(passEnd - passStart).count());
+}
+
+void Renderer::drawStatsOverlay() {
+    auto timings = Profiler::getInstance()->getTimings();
+
+    // CPU time is how long it took to submit the pass, GPU time how long the GPU took to draw it.
+    // Whichever frame total is larger is what's limiting the frame rate
+    QStringList lines;
+    lines << QString("%1 %2 %3").arg(QString(), -8).arg(QString("cpu ms"), 8).arg(QString("gpu ms"), 8);
+
+    for(const char* name : PASS_NAMES) {
+        std::string pass = name;
+        lines << QString("%1 %2 %3").arg(QString(name), -8)
+                                    .arg(timings["cpu " + pass].recent, 8, 'f', 3)
+                                    .arg(timings["gpu " + pass].recent, 8, 'f', 3);
+    }
+
+    lines << QString("%1 %2 %3").arg(QString("frame"), -8)
+                                .arg(timings["cpu frame"].recent, 8, 'f', 3)
+                                .arg(timings["gpu frame"].recent, 8, 'f', 3);
+    lines << QString("%1 draws, %2 triangles").arg(lastFrameStats.drawCalls).arg(lastFrameStats.triangles);
+    lines << QString("quality %1%2").arg(QString::fromStdString(getQualityTierName()))
+                                    .arg(governor ? QString(" (auto, p95 %1 ms)").arg(governor->getLastPercentile(), 0, 'f', 1) : QString());
+
+    QPainter painter(this);
+    QFont font("monospace");
+    font.setStyleHint(QFont::Monospace);
+    painter.setFont(font);
+
+    int lineHeight = painter.fontMetrics().height();
+    painter.fillRect(0, 0, painter.fontMetrics().averageCharWidth() * 30, lineHeight * (lines.size() + 1), QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+
+    for(int i = 0; i < lines.size(); i++) {
+        painter.drawText(lineHeight / 2, lineHeight * (i + 1), lines[i]);
+    }
+
+    painter.end();
+
+    // QPainter leaves its own GL state behind
+    setGLState();
+}
+
+void Renderer::toggleStatsOverlay() {
+    showStatsOverlay = !showStatsOverlay;
+}
+
+bool Renderer::setQualityTier(const std::string& name) {
+    if (name == AUTOMATIC_QUALITY) {
+        governor = std::make_unique<QualityGovernor>(qualitySettings.tiers.size(), qualityTier, 1000.0 / qualitySettings.targetFrameRate);
+        return true;
+    }
+
+    int tier = qualitySettings.findTier(name);
+
+    if (tier < 0) {
+        return false;
+    }
+
+    governor.reset();
+    applyQualityTier((size_t)tier);
+    return true;
+}
+
+void Renderer::cycleQualityTier() {
+    if (governor) {
+        governor.reset();
+        applyQualityTier(0);
+    }
+    else if (qualityTier + 1 < qualitySettings.tiers.size()) {
+        applyQualityTier(qualityTier + 1);
+    }
+    else {
+        setQualityTier(AUTOMATIC_QUALITY);
+    }
+}
+
+const std::string& Renderer::getQualityTierName() const {
+    return quality().name;
+}
+
+bool Renderer::isQualityAutomatic() const {
+    return governor != nullptr;
+}
+
+void Renderer::applyQualityTier(size_t tier) {
+    qualityTier = tier;
+
+    // The field of view is part of the projection. Before there's a viewport, initializeGL builds it
+    if (viewportWidth > 0 && viewportHeight > 0) {
+        updateProjection();
+    }
+
+    update();
+}
+
+const QualityTier& Renderer::quality() const {
+    return qualitySettings.tiers[qualityTier];
+}
+
+void Renderer::startCapture(const std::filesystem::path& folder, FrameCapture::Format format) {
+    captureRequested = true;
+    captureFolder = folder;
+    captureFormat = format;
+    update();
+}
+
+void Renderer::stopCapture() {
+    captureRequested = false;
+    update();
+}
+
+bool Renderer::isCapturing() const {
+    return captureRequested;
+}
+
+void Renderer::updateCapture() {
+    if (capture && (!captureRequested || capture->getFolder() != captureFolder)) {
+        capture.reset();
+    }
+
+    if (captureRequested && !capture) {
+        capture = std::make_unique<FrameCapture>(captureFolder, captureFormat);
+    }
+}
+
+void Renderer::flushGpuTimings() {
+    if (gpuTimer) {
+        gpuTimer->flush();
+    }
 }
 
 bool Renderer::textureExists(const char* name) {
@@ -385,6 +871,250 @@ bool Renderer::textureExists(const std::string& name) {
     return textures.find(name) != textures.end();
 }
 
+int32_t Renderer::materialLayer(const std::string& name) const {
+    auto it = materialLayers.find(name);
+    return it != materialLayers.end() ? it->second : noMaterial;
+}
+
+void Renderer::buildTypeMaterials() {
+    typeMaterials.assign(maxInstanceTypes, glm::vec4(1.0f, 1.0f, 1.0f, (float)noMaterial));
+
+    typeMaterials[PlayerInstance] = glm::vec4(0.0f, 1.0f, 0.0f, (float)materialLayer(PLAYER_TEXTURE_FILE)); // green
+    typeMaterials[EnemyInstance] = glm::vec4(1.0f, 0.0f, 0.0f, (float)materialLayer(ENEMY_TEXTURE_FILE)); // red
+    typeMaterials[BulletInstance] = glm::vec4(1.0f, 1.0f, 0.0f, (float)noMaterial); // yellow
+
+    for(ObstacleType obstacleType : OBSTACLE_TYPES) {
+        std::string name = Obstacle::convertObstacleTypeToName(obstacleType);
+        typeMaterials[FirstObstacleInstance + (uint32_t)obstacleType] = glm::vec4(0.58f, 0.29f, 0.0f, (float)materialLayer(name)); // brown
+    }
+
+    for(const auto& [mesh, chain] : lodChains) {
+        if (chain.impostorMesh != MeshArena::invalidMesh) {
+            typeMaterials[chain.impostorType] = glm::vec4(0.58f, 0.29f, 0.0f, (float)chain.impostorLayer);
+        }
+    }
+}
+
+int32_t Renderer::buildLodChains(const std::unordered_map<std::string, std::array<MeshArena::MeshId, MeshOptimizer::lodCount>>& levels, int32_t firstImpostorLayer) {
+    lodChains.clear();
+    int32_t impostors = 0;
+
+    for(const auto& [name, ids] : levels) {
+        MeshArena::MeshId full = meshId(name);
+        const auto* record = arena->get(full);
+
+        if (!record) { continue; }
+
+        LodChain chain;
+        chain.radius = glm::length(record->boundsMax - record->boundsMin) / 2.0f;
+
+        // A level that failed to load falls back to the one before it
+        chain.levels[0] = full;
+        for(uint32_t lod = 1; lod < MeshOptimizer::lodCount; lod++) {
+            chain.levels[lod] = ids[lod] != MeshArena::invalidMesh ? ids[lod] : chain.levels[lod - 1];
+        }
+
+        lodChains[full] = chain;
+    }
+
+    if (firstImpostorLayer < 0) {
+        return 0;
+    }
+
+    // Only obstacles get impostors. They never move, and there are lots of them far away
+    for(ObstacleType obstacleType : OBSTACLE_TYPES) {
+        auto it = lodChains.find(meshId(Obstacle::convertObstacleTypeToName(obstacleType)));
+
+        if (it == lodChains.end()) { continue; }
+
+        LodChain& chain = it->second;
+        const auto* record = arena->get(chain.levels[0]);
+
+        // The impostor is a quad covering the mesh as seen from the front (+Z), facing +Z, with the
+        // picture of the mesh mapped across it. It's turned to face the camera when drawn
+        MeshData quad;
+        quad.attributes = MeshHasTexCoords | MeshHasNormals;
+        quad.stride = 8 * sizeof(float);
+        quad.vertexCount = 4;
+        quad.vertices = {
+            record->boundsMin.x, record->boundsMin.y, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+            record->boundsMax.x, record->boundsMin.y, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+            record->boundsMax.x, record->boundsMax.y, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+            record->boundsMin.x, record->boundsMax.y, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+        };
+        quad.indices = {0, 1, 2, 0, 2, 3};
+        quad.boundsMin = glm::vec3(record->boundsMin.x, record->boundsMin.y, 0.0f);
+        quad.boundsMax = glm::vec3(record->boundsMax.x, record->boundsMax.y, 0.0f);
+
+        chain.impostorMesh = arena->add(quad.view());
+        chain.impostorType = FirstImpostorInstance + (uint32_t)obstacleType;
+        chain.impostorLayer = firstImpostorLayer + impostors;
+        chain.impostorSourceType = FirstObstacleInstance + (uint32_t)obstacleType;
+
+        impostors++;
+    }
+
+    return impostors;
+}
+
+void Renderer::buildImpostors() {
+    if (!materials) { return; }
+
+    Profiler::Scope scope("render impostors", "startup");
+
+    // Every layer of the array is the same size, so that's the size the pictures are rendered at
+    GLint width = 0;
+    GLint height = 0;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, materials->handle());
+    glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_HEIGHT, &height);
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    // The pictures are rendered into renderbuffers and copied into the array afterwards, since the
+    // shader samples the array, and a texture can't be drawn into while it's being sampled
+    unsigned int framebuffer = 0;
+    unsigned int renderbuffers[2] = {};
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        arena->bind();
+
+        auto& shader = shaders.at("textured");
+        shader.use();
+        shader.setUniformIf("lightPos", lightPos);
+        shader.setUniformIf("ambient", ambientLightIntensity);
+        shader.setUniformIf("typeMaterials[0]", typeMaterials);
+        shader.setUniformIf("firstImpostorType", (unsigned int)FirstImpostorInstance);
+
+        for(const auto& [mesh, chain] : lodChains) {
+            if (chain.impostorMesh == MeshArena::invalidMesh) { continue; }
+
+            const auto* record = arena->get(chain.levels[0]);
+
+            // Look at the mesh from the front, with the bounds filling the picture exactly, so it lines
+            // up with the impostor's quad
+            float depth = record->boundsMax.z - record->boundsMin.z;
+            glm::mat4 impostorView = glm::lookAt(glm::vec3(0.0f, 0.0f, record->boundsMax.z + 1.0f),
+                                                 glm::vec3(0.0f, 0.0f, record->boundsMin.z),
+                                                 glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::mat4 impostorProjection = glm::ortho(record->boundsMin.x, record->boundsMax.x,
+                                                      record->boundsMin.y, record->boundsMax.y,
+                                                      0.5f, depth + 1.5f);
+
+            shader.setUniformIf("vp", impostorProjection * impostorView);
+            shader.setUniformIf("view", impostorView);
+            shader.bindTexture("albedo", 0, materials.get());
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            instances.clear();
+            indirectCommands.clear();
+            instances.push_back({glm::vec3(0.0f), 0.0f, 1.0f, chain.impostorSourceType});
+            arena->appendCommands(chain.levels[0], 0, indirectCommands);
+            arena->upload(instances, indirectCommands);
+            arena->multiDraw(0, indirectCommands.size());
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, materials->handle());
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, chain.impostorLayer, 0, 0, width, height);
+        }
+
+        instances.clear();
+        indirectCommands.clear();
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, materials->handle());
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    else {
+        std::cerr << "Renderer: Couldn't create a framebuffer for the impostors, distant obstacles will be drawn as meshes\n";
+
+        for(auto& [mesh, chain] : lodChains) {
+            chain.impostorMesh = MeshArena::invalidMesh;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, renderbuffers);
+
+    setGLState();
+}
+
+MeshArena::MeshId Renderer::selectLod(MeshArena::MeshId mesh, MeshArena::MeshInstance& instance) const {
+    auto it = lodChains.find(mesh);
+
+    if (it == lodChains.end()) {
+        return mesh;
+    }
+
+    const LodChain& chain = it->second;
+
+    glm::vec3 toCamera = cameraPosition - instance.position;
+    float distance = glm::length(toCamera);
+
+    // How many pixels tall the bounding sphere is on screen
+    float pixels = distance > 0.001f ? 2.0f * chain.radius * instance.scale * pixelsPerUnit / distance : lodPixelThresholds[0];
+
+    // Scaling the thresholds rather than the size, so the same fraction of the screen counts the same
+    // whatever the tier
+    float lodScale = quality().lodScale;
+
+    for(uint32_t lod = 0; lod < MeshOptimizer::lodCount; lod++) {
+        if (pixels >= lodPixelThresholds[lod] * lodScale) {
+            return chain.levels[lod];
+        }
+    }
+
+    if (chain.impostorMesh != MeshArena::invalidMesh && toCamera.y < impostorMaxElevation * distance) {
+        instance.yaw = std::atan2(toCamera.x, toCamera.z);
+        instance.type = chain.impostorType;
+        return chain.impostorMesh;
+    }
+
+    return chain.levels.back();
+}
+
+uint32_t Renderer::instanceType(const Renderer::DrawCommand& cmd) {
+    switch(cmd.type) {
+        case DrawCommandType::Player: return PlayerInstance;
+        case DrawCommandType::Enemy: return EnemyInstance;
+        case DrawCommandType::Bullet: return BulletInstance;
+        case DrawCommandType::Obstacle: return FirstObstacleInstance + (uint32_t)cmd.obstacleType;
+    }
+
+    return PlayerInstance;
+}
+
+MeshArena::MeshInstance Renderer::instanceFor(const Renderer::DrawCommand& cmd) {
+    return {cmd.position, cmd.yaw, 1.0f, instanceType(cmd)};
+}
+
+glm::vec3 Renderer::forward(const Renderer::DrawCommand& cmd) {
+    return glm::vec3(std::sin(cmd.yaw), 0.0f, std::cos(cmd.yaw));
+}
+
+MeshArena::MeshId Renderer::meshId(const std::string& name) const {
+    auto it = meshes.find(name);
+    return it != meshes.end() ? it->second : MeshArena::invalidMesh;
+}
+
 
 
 void Renderer::advanceCamera() {
@@ -404,32 +1134,69 @@ void Renderer::setCameraMode(Renderer::CameraMode mode) {
     }
 }
 
-void Renderer::drawMesh(Mesh& mesh, const glm::mat4& meshTransform, Texture* texture, float* passedColor) {
-    glm::vec3 color(1.0f, 1.0f, 1.0f);
+void Renderer::drawMesh(MeshArena::MeshId mesh, const MeshArena::MeshInstance& instance) {
+    MeshArena::MeshInstance placed = instance;
+    MeshArena::MeshId level = selectLod(mesh, placed);
 
-    if (passedColor != nullptr) {
-        color[0] = passedColor[0];
-        color[1] = passedColor[1];
-        color[2] = passedColor[2];
-    }
+    // Nothing is drawn yet, the mesh just gets an instance and joins the queue for flushQueuedDraws
+    queuedDraws.push_back({level, (uint32_t)instances.size()});
+    instances.push_back(placed);
+}
 
-    bool hasTexture = texture != nullptr;
+void Renderer::flushQueuedDraws() {
+    if (queuedDraws.empty()) { return; }
 
-    Shader& shader = hasTexture ? shaders.at("textured") : shaders.at("colored");
+    // Every texture is a layer of the one array, picked by instance type, so nothing changes between draws
+    // and the whole queue is one multi-draw. Sorting by mesh keeps the commands for each together
+    std::sort(queuedDraws.begin(), queuedDraws.end(), [](const QueuedDraw& a, const QueuedDraw& b) {
+        return a.mesh < b.mesh;
+    });
 
+    indirectCommands.clear();
+
+    for(const auto& draw : queuedDraws) {
+        arena->appendCommands(draw.mesh, draw.instance, indirectCommands);
+
+        if (const auto* record = arena->get(draw.mesh)) {
+            frameStats.triangles += record->triangleCount();
+        }
+    }
+
+    arena->upload(instances, indirectCommands);
+
+    auto& shader = shaders.at("textured");
     shader.use();
+    shader.setUniform(texturedUniforms.vp, projection * view);
+    shader.setUniform(texturedUniforms.view, view);
+    shader.setUniform(texturedUniforms.lightPos, lightPos);
+    shader.setUniform(texturedUniforms.ambient, ambientLightIntensity);
+    shader.setUniform(texturedUniforms.typeMaterials, typeMaterials);
+    shader.setUniform(texturedUniforms.firstImpostorType, (unsigned int)FirstImpostorInstance);
+    shader.bindTexture("albedo", 0, materials.get());
+
+    arena->multiDraw(0, indirectCommands.size());
+
+    if (!indirectCommands.empty()) {
+        frameStats.drawCalls++;
+        frameStats.commands += indirectCommands.size();
+    }
 
-    glm::mat4 mvp = projection * view * meshTransform;
-    glm::mat4 mv = view * meshTransform;
+    queuedDraws.clear();
+    instances.clear();
+}
+
+void Renderer::submitDraw(MeshArena::MeshId mesh) {
+    if (const auto* record = arena->get(mesh)) {
+        frameStats.drawCalls++;
+        frameStats.commands += record->parts.size();
+        frameStats.triangles += record->triangleCount();
+    }
 
-    shader.setUniformIf("mvp", mvp);
-    shader.setUniformIf("mv", mv);
-    shader.setUniformIf("color", color);
-    shader.setUniformIf("lightPos", lightPos);
-    shader.setUniformIf("ambient", ambientLightIntensity);
-    shader.bindTexture("albedo", 0, texture);
+    arena->draw(mesh);
+}
 
-    mesh.draw();
+const Renderer::FrameStats& Renderer::getFrameStats() const {
+    return lastFrameStats;
 }
 
 void Renderer::specialCaseAdjusment(Renderer::DrawCommand& cmd) {
@@ -441,7 +1208,7 @@ void Renderer::specialCaseAdjusment(Renderer::DrawCommand& cmd) {
     // if at some point, some enterprising individual fixes the alignment in the mesh itself,
     // this is no longer required
     if (cmd.obstacleType == ObstacleType::Tree) {
-        cmd.transform = glm::translate(cmd.transform, glm::vec3(0.0f, -0.5f, 0.0f));
+        cmd.position.y -= 0.5f;
     }
 }
 
@@ -452,63 +1219,28 @@ void Renderer::drawPlayerTank(const Renderer::DrawCommand& cmd) {
         return;
     }
 
-    Mesh& m = meshes[TANK_MESH_FILE];
-
-    float color[] = {0.0f, 1.0f, 0.0f}; // green
-    Texture* texture = nullptr;
-
-    if (textureExists(PLAYER_TEXTURE_FILE)) {
-        texture = &textures[PLAYER_TEXTURE_FILE];
-    }
-
-    drawMesh(m, cmd.transform, texture, color);
+    drawMesh(meshId(TANK_MESH_FILE), instanceFor(cmd));
 }
 
 void Renderer::drawEnemyTank(const Renderer::DrawCommand& cmd) {
-    Mesh& m = meshes[TANK_MESH_FILE];
-
-    float color[] = {1.0f, 0.0f, 0.0f}; // red
-    Texture* texture = nullptr;
-
-    if (textureExists(ENEMY_TEXTURE_FILE)) {
-        texture = &textures[ENEMY_TEXTURE_FILE];
-    }
-
-    drawMesh(m, cmd.transform, texture, color);
+    drawMesh(meshId(TANK_MESH_FILE), instanceFor(cmd));
 }
 
 void Renderer::drawProjectile(const Renderer::DrawCommand& cmd) {
-    Mesh& m = meshes[BULLET_MESH_FILE];
-
-    float color[] = {1.0f, 1.0f, 0.0f}; // yellow
-
-    drawMesh(m, cmd.transform, 0, color);
+    drawMesh(meshId(BULLET_MESH_FILE), instanceFor(cmd));
 }
 
-void Renderer::drawObstacle(const Renderer::DrawCommand& cmd) {
-    std::string obstacleTypeName = Obstacle::convertObstacleTypeToName(cmd.obstacleType);
-
-    float color[] {0.58, 0.29f, 0.0f}; // brown
-    Texture* texture = nullptr;
-
-    if (obstacleTypeName.empty() || meshes.find(obstacleTypeName) == meshes.end()) {
-        std::string errorName = obstacleTypeName.empty() ? "(empty)" : obstacleTypeName;
-        std::cerr << "Renderer: No obstacle by type " << errorName << "\n";
-        return;
-    }
-    else {
-        if (textureExists(obstacleTypeName)) {
-            texture = &textures[obstacleTypeName];
-        }
-
-        drawMesh(meshes[obstacleTypeName], cmd.transform, texture, color);
+void Renderer::drawStaticBatch() {
+    // The instances and meshes were all worked out when the batch was built, so this is just
+    // copying them into the frame's instance data
+    for(const auto& draw : staticBatch) {
+        drawMesh(draw.mesh, draw.instance);
     }
-
 }
 
 void Renderer::drawGround() {
     if (meshes.find(GROUND_MESH_FILE) != meshes.end()) {
-        auto& mesh = meshes[GROUND_MESH_FILE];
+        MeshArena::MeshId mesh = meshes.at(GROUND_MESH_FILE);
 
         mat4 groundTransform = mat4(1.0f);
         groundTransform = glm::scale(groundTransform, glm::vec3(groundScale, 1.0f, groundScale));
@@ -522,25 +1254,27 @@ void Renderer::drawGround() {
 
         float grassDensitySum = 0.0f;
         float grassHeightSum = 0.0f;
-        for(size_t i = 0; i < grassShells; i++) {
+        const QualityTier& tier = quality();
+
+        for(int i = 0; i < tier.grassShells; i++) {
 
             glm::mat4 model = glm::translate(groundTransform, glm::vec3(0, grassHeightSum, 0));
             glm::mat4 mvp = projection * view * model;
 
-            shader.setUniformIf("grassDensity", grassDensitySum);
-            shader.setUniformIf("grassScale", grassScale);
-            shader.setUniformIf("mvp", mvp);
-            shader.setUniformIf("model", model);
-            shader.setUniformIf("view", view);
-            shader.setUniformIf("projection", projection);
-            shader.setUniformIf("color", groundColor);
+            shader.setUniform(groundUniforms.grassDensity, grassDensitySum);
+            shader.setUniform(groundUniforms.grassScale, tier.grassScale);
+            shader.setUniform(groundUniforms.mvp, mvp);
+            shader.setUniform(groundUniforms.model, model);
+            shader.setUniform(groundUniforms.view, view);
+            shader.setUniform(groundUniforms.projection, projection);
+            shader.setUniform(groundUniforms.color, groundColor);
 
             shader.bindTexture("albedo", 0, groundTex);
 
-            mesh.draw();
+            submitDraw(mesh);
 
-            grassDensitySum += grassShellDensityStep;
-            grassHeightSum += grassShellHeightStep;
+            grassDensitySum += tier.grassShellDensityStep;
+            grassHeightSum += tier.grassShellHeightStep;
         }
     }
 }
@@ -549,12 +1283,12 @@ void Renderer::frameSetCamera() {
     switch (camMode) {
         case CameraMode::Static: break; // No changes needed for a static camera
         case CameraMode::Periscope:     // In periscope mode, set our camera inside the player tank
-            for(auto& cmd : lastFrame) {
+            for(const auto& cmd : frames.read()) {
                 if (cmd.type == DrawCommandType::Player) {
-                    glm::vec3 camPos = glm::vec3(cmd.transform[3][0], cmd.transform[3][1] + periscopeHeight, cmd.transform[3][2]);
+                    glm::vec3 camPos = cmd.position + glm::vec3(0, periscopeHeight, 0);
                     glm::vec3 up = glm::vec3(0, 1, 0);
 
-                    glm::vec3 lookPoint = cmd.forwardPoint + glm::vec3(0, periscopeHeight, 0);
+                    glm::vec3 lookPoint = camPos + forward(cmd);
 
                     view = glm::lookAt(camPos, lookPoint, up);
 
@@ -563,14 +1297,14 @@ void Renderer::frameSetCamera() {
             }
             break;
         case CameraMode::Chasing:   // For chasing mode, set our camera above the player tank
-            for(auto& cmd : lastFrame) {
+            for(const auto& cmd : frames.read()) {
                 if (cmd.type == DrawCommandType::Player) {
-                    glm::vec3 camPos = glm::vec3(cmd.transform[3][0], cmd.transform[3][1], cmd.transform[3][2]);
+                    glm::vec3 camPos = cmd.position;
                     glm::vec3 up = glm::vec3(0, 1, 0);
 
                     glm::vec3 lookPoint = camPos;
 
-                    glm::vec3 forwardDir = cmd.forwardPoint - camPos;
+                    glm::vec3 forwardDir = forward(cmd);
 
                     camPos += glm::vec3(0.0f, cameraChaseHeight, 0.0f);
                     camPos -= forwardDir * cameraChaseDistance;
@@ -600,9 +1334,9 @@ void Renderer::drawSkybox() {
 
     auto& shader = shaders.at("skybox");
     Texture& skybox = textures.at(SKY_CUBEMAP_FOLDER);
-    auto& mesh = meshes.at(SKY_MESH_FILE);
+    MeshArena::MeshId mesh = meshes.at(SKY_MESH_FILE);
 
-    if (!shader.hasUniform("vp")) {
+    if (skyboxVp < 0) {
         std::cerr << "Renderer: Invalid skybox shader, has no vp uniform\n";
     }
 
@@ -611,13 +1345,14 @@ void Renderer::drawSkybox() {
     }
 
     glm::mat4 vp = projection * view;
+    float skyboxSize = quality().skyboxSize;
     vp = glm::scale(vp, glm::vec3(skyboxSize, skyboxSize, skyboxSize));
 
     shader.use();
     shader.bindTexture("skybox", 0, skybox);
-    shader.setUniformIf("vp", vp);
+    shader.setUniform(skyboxVp, vp);
 
-    mesh.draw();
+    submitDraw(mesh);
 
     glDepthFunc(GL_LESS);
     glDepthMask(GL_TRUE);
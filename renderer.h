@@ -6,16 +6,27 @@
 
 #include <glm/glm.hpp>
 
+#include <array>
+#include <chrono>
 #include <vector>
 #include <filesystem>
+#include <memory>
 
-// Forward declared so that this header doesn't need to include the game object header
+// Forward declared so that this header doesn't need to include the game object or scene headers
 class GameObject;
+class Scene;
 
 #include "Obstacle.h"
+#include "meshoptimizer.h"
 #include "shader.h"
-#include "mesh.h"
+#include "mesharena.h"
 #include "texture.h"
+#include "framecapture.h"
+#include "gputimer.h"
+#include "profiler.h"
+#include "quality.h"
+#include "qualitygovernor.h"
+#include "triplebuffer.h"
 
 /**
  * @brief The renderer is a QWidget responsible for drawing 3D graphics to the window
@@ -32,6 +43,15 @@ public:
         Periscope,
         Orbiting,
     };
+
+    /** Counters for the work one frame submitted to the GPU */
+    struct FrameStats {
+        // API calls that draw, where one multi-draw counts once
+        size_t drawCalls = 0;
+        // Individual draws, counting each command of a multi-draw
+        size_t commands = 0;
+        size_t triangles = 0;
+    };
 protected:
     enum class DrawCommandType {
         Player,
@@ -40,22 +60,157 @@ protected:
         Bullet
     };
 
+    // Everything stands upright on the ground, so a position and a heading are all it takes to place an
+    // object. The model's rotation is rebuilt from the yaw in the vertex shader
     struct DrawCommand {
         DrawCommandType type;
         ObstacleType obstacleType;
-        glm::mat4 transform;
-        glm::vec3 forwardPoint;
+        glm::vec3 position;
+        // Radians about the up axis, where 0 faces +Z
+        float yaw;
+    };
+
+    // What the shader looks each instance's color and texture layer up by. Each obstacle type has its
+    // own, counting up from FirstObstacleInstance in ObstacleType order, and so does each obstacle
+    // type's impostor, from FirstImpostorInstance. The shader draws impostors unlit, with alpha testing
+    enum InstanceType : uint32_t {
+        PlayerInstance,
+        EnemyInstance,
+        BulletInstance,
+        FirstObstacleInstance,
+        // Three ObstacleTypes: Tree, Boulder and House
+        FirstImpostorInstance = FirstObstacleInstance + 3,
+    };
+
+    // The simplified versions of a mesh, and the camera-facing billboard that stands in for it when
+    // it's too small on screen for even the simplest one to matter
+    struct LodChain {
+        std::array<MeshArena::MeshId, MeshOptimizer::lodCount> levels;
+        // The radius of the full detail mesh's bounding sphere, which its size on screen is judged by
+        float radius = 0.0f;
+        // The impostor's quad, or invalidMesh if the mesh has none
+        MeshArena::MeshId impostorMesh = MeshArena::invalidMesh;
+        uint32_t impostorType = 0;
+        int32_t impostorLayer = -1;
+        // What the impostor is a picture of: the full detail mesh, drawn as this instance type
+        uint32_t impostorSourceType = 0;
+    };
+
+    // One entry of the static batch, with everything already looked up so drawing it is just the draw call
+    struct StaticDraw {
+        MeshArena::MeshId mesh;
+        MeshArena::MeshInstance instance;
+    };
+
+    // A mesh queued for the opaque pass, and its instance in this frame's instance data
+    struct QueuedDraw {
+        MeshArena::MeshId mesh;
+        uint32_t instance;
+    };
+
+    // The passes of a frame, which are timed separately on the CPU and GPU
+    enum RenderPass : size_t {
+        GroundPass,
+        OpaquePass,
+        SkyboxPass,
+        RenderPassCount
     };
 
 
-    std::unordered_map<std::string, Mesh> meshes;
+    // Every mesh lives in the arena, and is known here by its id there
+    std::unique_ptr<MeshArena> arena;
+    std::unordered_map<std::string, MeshArena::MeshId> meshes;
     std::unordered_map<std::string, Shader> shaders;
     std::unordered_map<std::string, Texture> textures;
 
-    // The list of draw commands for the last complete frame, and the currently being built frame
-    // They are separate to ensure it never draws a half frame
-    std::vector<DrawCommand> lastFrame;
-    std::vector<DrawCommand> curFrame;
+    // The locations of the uniforms set every frame, looked up once the shaders are built, so drawing never
+    // looks a name up (which builds a std::string, and allocates for the longer ones). -1 if a shader lacks one
+    struct TexturedUniforms {
+        int vp = -1;
+        int view = -1;
+        int lightPos = -1;
+        int ambient = -1;
+        int typeMaterials = -1;
+        int firstImpostorType = -1;
+    };
+
+    struct GroundUniforms {
+        int grassDensity = -1;
+        int grassScale = -1;
+        int mvp = -1;
+        int model = -1;
+        int view = -1;
+        int projection = -1;
+        int color = -1;
+    };
+
+    TexturedUniforms texturedUniforms;
+    GroundUniforms groundUniforms;
+    int skyboxVp = -1;
+
+    // The textures of everything drawn in the opaque pass, packed into the layers of one texture array,
+    // and which layer each texture (by name) ended up in
+    std::unique_ptr<Texture> materials;
+    std::unordered_map<std::string, int32_t> materialLayers;
+
+    // The color (rgb) and materials layer (w) of each InstanceType, for the typeMaterials uniform
+    std::vector<glm::vec4> typeMaterials;
+
+    // The levels of detail of each mesh that has them, by the id of its full detail mesh
+    std::unordered_map<MeshArena::MeshId, LodChain> lodChains;
+
+    // Where the camera is this frame, and how many pixels tall something one unit across appears one
+    // unit in front of it, for judging each object's size on screen
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float pixelsPerUnit = 1.0f;
+
+    // The size of what's drawn, from the last resizeGL, for rebuilding the projection
+    int viewportWidth = 0;
+    int viewportHeight = 0;
+
+    // The draw commands for the frame being built (write), and the last complete one being drawn (read).
+    // They are separate to ensure it never draws a half frame, and are swapped rather than copied, so
+    // the frame can be built on another thread while paintGL draws
+    TripleBuffer<std::vector<DrawCommand>> frames;
+
+    // Obstacles never move, so they're collected once per level instead of every tick. The commands are
+    // kept until the GL assets are loaded, then resolved into the batch (sorted by mesh)
+    std::vector<DrawCommand> staticCommands;
+    std::vector<StaticDraw> staticBatch;
+    bool staticBatchDirty = false;
+
+    // The opaque pass's draw list, rebuilt every frame. The vectors keep their capacity between frames
+    std::vector<QueuedDraw> queuedDraws;
+    std::vector<MeshArena::MeshInstance> instances;
+    std::vector<MeshArena::DrawElementsIndirectCommand> indirectCommands;
+
+    // Counted while painting, and copied to lastFrameStats when the paint finishes
+    FrameStats frameStats;
+    FrameStats lastFrameStats;
+
+    // Times each pass on the GPU, created once the context exists
+    std::unique_ptr<GpuTimer> gpuTimer;
+    std::chrono::steady_clock::time_point passStart;
+
+    // The Profiler slots the CPU timings are recorded in, and the GPU frame time is read from
+    std::array<Profiler::TimingSlot, RenderPassCount> cpuPassTimings;
+    Profiler::TimingSlot cpuFrameTiming;
+    Profiler::TimingSlot cpuCaptureTiming;
+    Profiler::TimingSlot gpuFrameTiming;
+
+    // Whether to draw the timings over the frame
+    bool showStatsOverlay = false;
+
+    // The quality tiers, the one being drawn at, and the governor that picks it when it's automatic
+    QualitySettings qualitySettings;
+    size_t qualityTier = 0;
+    std::unique_ptr<QualityGovernor> governor;
+
+    // The capture asked for by startCapture. It's started and stopped by paintGL, which has the context
+    bool captureRequested = false;
+    std::filesystem::path captureFolder;
+    FrameCapture::Format captureFormat = FrameCapture::Format::PngSequence;
+    std::unique_ptr<FrameCapture> capture;
 
     CameraMode camMode;
     float cameraTime;
@@ -65,6 +220,9 @@ protected:
     glm::mat4 view;
     glm::mat4 projection;
 
+    // Whether paintGL has run yet, used to mark the end of startup
+    bool drawnFirstFrame = false;
+
 
     /**
      * @brief a utility function to check if a texture is known to the renderer
@@ -73,6 +231,62 @@ protected:
      */
     bool textureExists(const char* name);
 
+    /**
+     * Look up a texture's layer in the materials texture array
+     * @param name The texture to look for
+     * @return its layer, or noMaterial if there's no such texture
+     */
+    int32_t materialLayer(const std::string& name) const;
+
+    /** Fills in typeMaterials, once the textures have been loaded */
+    void buildTypeMaterials();
+
+    /**
+     * Link each mesh to its levels of detail, and give each obstacle's mesh an impostor quad
+     * @param levels The ids of every level of detail past the first, by mesh name
+     * @param firstImpostorLayer The materials layer the first impostor is rendered into, or -1 for
+     *                           no impostors
+     * @return how many impostors need a layer
+     */
+    int32_t buildLodChains(const std::unordered_map<std::string, std::array<MeshArena::MeshId, MeshOptimizer::lodCount>>& levels, int32_t firstImpostorLayer);
+
+    /** Render each impostor's picture into its materials layer. Needs the shaders, meshes and materials */
+    void buildImpostors();
+
+    /**
+     * Pick which level of detail to draw a mesh at, by how big it is on screen. If it's an impostor,
+     * the instance is turned to face the camera, and its type changed to the impostor's
+     * @param mesh The full detail mesh
+     * @param instance Where it's drawn
+     * @return the mesh to actually draw
+     */
+    MeshArena::MeshId selectLod(MeshArena::MeshId mesh, MeshArena::MeshInstance& instance) const;
+
+    /**
+     * @param cmd A draw command
+     * @return the InstanceType its object draws as
+     */
+    static uint32_t instanceType(const DrawCommand& cmd);
+
+    /**
+     * @param cmd A draw command
+     * @return the instance data that draws it
+     */
+    static MeshArena::MeshInstance instanceFor(const DrawCommand& cmd);
+
+    /**
+     * @param cmd A draw command
+     * @return the unit vector its object faces
+     */
+    static glm::vec3 forward(const DrawCommand& cmd);
+
+    /**
+     * Look up a mesh by name
+     * @param name The mesh to look for
+     * @return its id in the arena, or MeshArena::invalidMesh if there's no such mesh
+     */
+    MeshArena::MeshId meshId(const std::string& name) const;
+
     /**
      * @brief a utility function to check if a texture is known to the renderer
      * @param name The texture to look for
@@ -104,10 +318,36 @@ protected:
     void drawProjectile(const DrawCommand& cmd);
 
     /**
-     * Executes a draw command to draw an obstacle
-     * @param cmd the command to execute
+     * Fill in a draw command's type, position and yaw from a game object
+     * @param object The object to draw
+     * @param cmd The command to fill in
+     * @return false if the object can't be drawn
      */
-    void drawObstacle(const DrawCommand& cmd);
+    bool buildCommand(const GameObject* object, DrawCommand& cmd);
+
+    /** Looks up the mesh and texture for each static command, and sorts them into the static batch */
+    void resolveStaticBatch();
+
+    /** Queues every obstacle in the static batch */
+    void drawStaticBatch();
+
+    /** Starts, stops or restarts the frame capture to match what was last asked for */
+    void updateCapture();
+
+    /**
+     * Draw at a quality tier from the next frame on
+     * @param tier The tier's index in qualitySettings
+     */
+    void applyQualityTier(size_t tier);
+
+    /** @return the tier being drawn at */
+    const QualityTier& quality() const;
+
+    /** Rebuilds the projection for the viewport's size and the tier's field of view */
+    void updateProjection();
+
+    /** Draws everything queued by drawMesh this frame, with a single multi-draw */
+    void flushQueuedDraws();
 
     /**  Draws the ground plane */
     void drawGround();
@@ -121,13 +361,36 @@ protected:
     void frameSetCamera();
 
     /**
-     * @brief Handles binding the shader/mesh and executing the draw call
+     * @brief Queues a mesh to be drawn in the opaque pass
      * @param mesh The mesh to display
-     * @param mvp The model-view-projection matrix for the the draw
-     * @param texture The texture, if available, or 0 (the GL id for no texture) if not
-     * @param color an array of three floats for RGB, of nullptr if not available
+     * @param instance Where to draw it, and its type (which picks its color and texture)
+     */
+    void drawMesh(MeshArena::MeshId mesh, const MeshArena::MeshInstance& instance);
+
+    /** Sets the GL state the renderer expects, at startup and again after QPainter has changed it */
+    void setGLState();
+
+    /**
+     * Start timing a pass, on both the CPU and the GPU
+     * @param pass The pass starting
+     */
+    void beginPass(RenderPass pass);
+
+    /**
+     * Stop timing a pass, and record its CPU time
+     * @param pass The pass finishing
+     */
+    void endPass(RenderPass pass);
+
+    /** Draws the frame timings and counters in the corner of the frame */
+    void drawStatsOverlay();
+
+    /**
+     * Draw a single mesh right away, counting it in the frame stats. Used for the ground and skybox,
+     * which have shaders of their own; everything else goes through drawMesh
+     * @param mesh The mesh to draw, with its shader already bound
      */
-    void drawMesh(Mesh& mesh, const glm::mat4& mvp, Texture* texture = nullptr, float* color = nullptr);
+    void submitDraw(MeshArena::MeshId mesh);
 
     /**
      * @brief Handles any special case adjustments that some draw calls may require (such as nudging some meshes)
@@ -135,10 +398,25 @@ protected:
      */
     void specialCaseAdjusment(DrawCommand& cmd);
 
-    // The following are configuration parameters that can be easily tweaked
+    // The layer instances without a texture use, which the shader draws in their flat color instead
+    static const int32_t constexpr noMaterial = -1;
 
-    // The field of view of the camera, in degrees
-    static const float constexpr cameraFOVDegrees = 45.0f;
+    // How many draws each per-frame list has room for before it has to grow
+    static const size_t constexpr initialDrawCapacity = 1024;
+
+    // The size of the shader's typeMaterials array, which every InstanceType must fit in
+    static const uint32_t constexpr maxInstanceTypes = 16;
+
+    // How tall, in pixels, a mesh's bounding sphere has to be on screen for each level of detail to
+    // be used. Anything smaller than the last is drawn as an impostor, if it has one
+    static const float constexpr lodPixelThresholds[MeshOptimizer::lodCount] = {160.0f, 60.0f, 20.0f};
+
+    // Impostors are upright billboards, which vanish edge-on when looked down on, so they're only
+    // used when the camera is less than this steeply above them (the sine of the angle)
+    static const float constexpr impostorMaxElevation = 0.5f;
+
+    // The following are configuration parameters that can be easily tweaked. The ones that trade
+    // looks for speed are in the quality tiers instead, see quality.h
 
     // The color of the window's background (visible when nothing is drawn)
     static const float constexpr backgroundRed = 0.0f;
@@ -164,20 +442,12 @@ protected:
     static const float constexpr groundScale = 25.0f;
     static const float constexpr groundHeight = -0.5f;
 
-    // How large and dense the grass is
-    static const int constexpr grassShells = 16;
-    static const float constexpr grassShellHeightStep = 0.04f;
-    static const float constexpr grassShellDensityStep = 0.15f;
-    static const float constexpr grassScale = 400.0f;
-
-    // How large the skybox mesh is
-    static const float constexpr skyboxSize = 200.0f;
-
     // Where the scene's light source is, and how bright unlit surfaces are (the ambient light intensity)
     static const glm::vec3 constexpr lightPos = glm::vec3(10, 5, 7);
     static const float constexpr ambientLightIntensity = 0.2;
 public:
 
+    Renderer();
     ~Renderer() override;
 
     /**
@@ -186,9 +456,20 @@ public:
      */
     void drawObject(const GameObject* object);
 
-    /** Called when all objects for the frame have been drawn */
+    /**
+     * Called when all objects for the frame have been drawn. drawObject and doneWithFrame may be
+     * called from a thread other than the GUI thread, as long as it's always the same one
+     */
     void doneWithFrame();
 
+    /**
+     * Collect the scene's static objects (obstacles) into a batch that is drawn every frame without
+     * being resubmitted. Call this once when a level starts, after it has loaded. From then on,
+     * drawObject ignores obstacles.
+     * @param scene The scene to take the obstacles from
+     */
+    void buildStaticBatch(const Scene* scene);
+
     /**
      * Set the renderer's camera mode. Note that cameras currently are not deltatime synced,
      * and so are frame-rate dependent.
@@ -196,6 +477,49 @@ public:
      */
     void setCameraMode(CameraMode mode);
 
+    /** @return the draw calls and triangles submitted by the most recent paint */
+    const FrameStats& getFrameStats() const;
+
+    /** Show or hide the overlay with the CPU and GPU time of each pass */
+    void toggleStatsOverlay();
+
+    /**
+     * Pick the quality tier to draw at, or let the renderer pick one to hold the target frame rate
+     * @param name A tier's name from assets/quality.json, or "auto"
+     * @return false if there's no such tier
+     */
+    bool setQualityTier(const std::string& name);
+
+    /** Step to the next tier up. From the top tier, switch to picking automatically */
+    void cycleQualityTier();
+
+    /** @return the name of the tier being drawn at */
+    const std::string& getQualityTierName() const;
+
+    /** @return whether the tier is being picked automatically */
+    bool isQualityAutomatic() const;
+
+    /**
+     * Record every frame from the next one on, until stopCapture. Reading the frames back and writing
+     * them happens in the background, so the frame rate isn't affected. Starting a capture while one
+     * is running finishes the old one and starts anew
+     * @param folder Where to write the frames
+     * @param format Whether to write a PNG sequence or a raw video file
+     */
+    void startCapture(const std::filesystem::path& folder, FrameCapture::Format format = FrameCapture::Format::PngSequence);
+
+    /** Stop recording frames. The frames still being read back and written are finished first */
+    void stopCapture();
+
+    /** @return whether frames are being recorded */
+    bool isCapturing() const;
+
+    /**
+     * Wait for the GPU to finish every frame drawn so far, and record their pass timings in the
+     * Profiler. This stalls, so it's only meant for tools like tanks_render_bench
+     */
+    void flushGpuTimings();
+
 
     void initializeGL() override;
     void paintGL() override;
@@ -3,57 +3,107 @@
 //
 
 #include "sfxmanager.h"
-#include <iostream>
-
+#include "audioengine.h"
+
+#include <glm/geometric.hpp>
+
+#include <iterator>
+
+/** How each of the Sounds is played */
+struct SoundSettings {
+    // The file in assets/sfx, without the extension
+    const char* file;
+    float volume;
+    bool loop;
+    // Which sounds keep a voice when there are too many, higher first. Explosions and collisions are
+    // rare and matter most; there are always plenty of treads
+    int priority;
+    // Whether it's a loop shared with every other object playing it, through an emitter
+    bool shared;
+};
+
+// In the order of SFXManager::Sounds
+static const SoundSettings SOUND_SETTINGS[] = {
+    {"explosion", 0.5f,  false, 3, false},
+    {"tankFire",  0.5f,  false, 1, false},
+    {"tankTread", 1.0f,  true,  1, false},
+    {"tankTread", 1.0f,  true,  0, true},
+    {"collide",   0.25f, false, 2, false},
+};
+
+static_assert(std::size(SOUND_SETTINGS) == (size_t)SFXManager::Sounds::Count, "Every sound needs its settings");
 
 SFXManager::SFXManager() {
-    sounds = {
-        {Sounds::Explosion, new QSoundEffect()},
-        {Sounds::Firing, new QSoundEffect()},
-        {Sounds::PlayerTreads, new QSoundEffect()},
-        {Sounds::EnemyTreads, new QSoundEffect()},
-        {Sounds::Collision, new QSoundEffect}
-    };
-
-    sounds[Sounds::Explosion]->setSource(QUrl::fromLocalFile("./assets/sfx/explosion.wav"));
-    sounds[Sounds::Explosion]->setVolume(0.5f);
+    // Load the bank now rather than at the first sound, which would be in the middle of the game
+    AudioEngine::getInstance();
+}
 
-    sounds[Sounds::Firing]->setSource(QUrl::fromLocalFile("./assets/sfx/tankFire.wav"));
-    sounds[Sounds::Firing]->setVolume(0.5f);
+void SFXManager::playSound(SFXManager::Sounds sound) {
+    AudioEngine* engine = AudioEngine::getInstance();
+    AudioMixer::VoiceId& voice = voices[(size_t)sound];
+    const SoundSettings& settings = SOUND_SETTINGS[(size_t)sound];
 
-    sounds[Sounds::PlayerTreads]->setSource(QUrl::fromLocalFile("./assets/sfx/tankTread.wav"));
-    sounds[Sounds::PlayerTreads]->setLoopCount(QSoundEffect::Infinite);
-    sounds[Sounds::PlayerTreads]->setVolume(1.0f);
+    if (settings.shared) {
+        uint32_t& emitter = emitters[(size_t)sound];
 
-    sounds[Sounds::EnemyTreads]->setSource(QUrl::fromLocalFile("./assets/sfx/tankTread.wav"));
-    sounds[Sounds::EnemyTreads]->setLoopCount(QSoundEffect::Infinite);
-    sounds[Sounds::EnemyTreads]->setVolume(1.0f);
+        if (emitter == AudioEngine::invalidEmitter) {
+            emitter = engine->startEmitter(engine->findSample(settings.file), settings.volume, settings.priority, position);
+        }
 
-    sounds[Sounds::Collision]->setSource(QUrl::fromLocalFile("./assets/sfx/collide.wav"));
-    sounds[Sounds::Collision]->setVolume(0.25f);
+        return;
+    }
 
-}
+    if (engine->isPlaying(voice)) {
+        return;
+    }
 
-void SFXManager::playSound(SFXManager::Sounds sound) {
-    QSoundEffect* sfx = sounds.at(sound);
+    voice = engine->play(engine->findSample(settings.file), settings.volume, settings.loop, settings.priority, position);
 
-    if (!sfx->isPlaying()) {
-        sfx->play();
+    if (settings.loop) {
+        sentPosition = position;
     }
 }
 
 void SFXManager::stopSound(SFXManager::Sounds sound) {
-    QSoundEffect* sfx = sounds.at(sound);
+    AudioMixer::VoiceId& voice = voices[(size_t)sound];
+    uint32_t& emitter = emitters[(size_t)sound];
 
-    if (sfx->isPlaying()) {
-        sfx->stop();
-    }
+    AudioEngine::getInstance()->stop(voice);
+    AudioEngine::getInstance()->stopEmitter(emitter);
+    voice = AudioMixer::invalidVoice;
+    emitter = AudioEngine::invalidEmitter;
 }
 
-SFXManager::~SFXManager() {
-    for(auto& pair : sounds) { delete pair.second; }
-    sounds.clear();
-}
+void SFXManager::setPosition(const glm::vec3& newPosition) {
+    position = newPosition;
+    AudioEngine* engine = AudioEngine::getInstance();
 
+    // Emitters are just numbers until the engine's update, so they always move
+    for(size_t i = 0; i < emitters.size(); i++) {
+        if (emitters[i] != AudioEngine::invalidEmitter) {
+            engine->moveEmitter(emitters[i], position);
+        }
+    }
+
+    if (glm::distance(position, sentPosition) < positionTolerance) {
+        return;
+    }
+
+    // One-shots are short, so they stay where they started
+
+    for(size_t i = 0; i < voices.size(); i++) {
+        if (SOUND_SETTINGS[i].loop && voices[i] != AudioMixer::invalidVoice) {
+            engine->setPosition(voices[i], position);
+        }
+    }
 
+    sentPosition = position;
+}
 
+SFXManager::~SFXManager() {
+    for(size_t i = 0; i < voices.size(); i++) {
+        if (SOUND_SETTINGS[i].loop) {
+            stopSound((Sounds)i);
+        }
+    }
+}
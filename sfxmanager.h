@@ -5,9 +5,23 @@
 #ifndef CS4488_TANKS_TEAM_SFX_MANAGER_H
 #define CS4488_TANKS_TEAM_SFX_MANAGER_H
 
-#include <QSoundEffect>
-#include <QObject>
+#include "audiomixer.h"
 
+#include <glm/vec3.hpp>
+
+#include <array>
+
+/**
+ * The sounds one game object makes. Each tank has its own, so it can start and stop its own treads,
+ * but the sounds themselves are decoded once and mixed by the shared AudioEngine, so an SFXManager
+ * is only a handful of voice ids.
+ *
+ * Sounds are played from wherever the object last said it was, with setPosition.
+ *
+ * Loops that every object of a kind plays (enemy treads) are shared: instead of a voice each, they're
+ * an AudioEngine emitter each, all mixed as one voice, so their cost doesn't grow with the number of
+ * tanks.
+ */
 class SFXManager  {
 
 public:
@@ -16,17 +30,50 @@ public:
         Firing,
         PlayerTreads,
         EnemyTreads,
-        Collision
+        Collision,
+        Count
     };
 private:
-    std::unordered_map<Sounds, QSoundEffect*> sounds;
+    // The voice each sound last played on, to stop it or to not restart it while it's playing
+    std::array<AudioMixer::VoiceId, (size_t)Sounds::Count> voices{};
+
+    // The emitter each shared loop is playing through, for the sounds that use one
+    std::array<uint32_t, (size_t)Sounds::Count> emitters{};
+
+    // Where the object is, and where its loops were last told it was
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 sentPosition = glm::vec3(0.0f);
+
+    // Loops are only moved once the object has gone this far, to keep the audio thread's queue short
+    // with a lot of tanks. It's well under what changes how anything sounds
+    static const float constexpr positionTolerance = 0.25f;
 public:
 
     SFXManager();
+
+    /** Stops any looping sounds, so a destroyed tank's treads don't keep playing */
     ~SFXManager();
 
+    SFXManager(const SFXManager& other) = delete;
+    SFXManager& operator=(const SFXManager& other) = delete;
+
+    /**
+     * Play a sound. If this object's last play of it is still going, it isn't started again
+     * @param sound The sound
+     */
     void playSound(Sounds sound);
+
+    /**
+     * Stop this object's sound, if it's playing
+     * @param sound The sound
+     */
     void stopSound(Sounds sound);
+
+    /**
+     * Say where the object is, for its sounds to come from. Call every update
+     * @param newPosition Its position
+     */
+    void setPosition(const glm::vec3& newPosition);
 };
 
 
@@ -1,7 +1,28 @@
 #include "shader.h"
 
+#include <QFile>
+#include <QSaveFile>
+
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iostream>
 #include <sstream>
+#include <string>
+
+#include "diskcache.h"
+#include "profiler.h"
+
+static const char SHADER_CACHE_MAGIC[4] = {'T', 'S', 'H', 'D'};
+
+// The fixed size start of every program binary cache file, followed by the binary itself
+struct ShaderCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
 
 Shader::Shader(): program(0) {
     QOpenGLExtraFunctions::initializeOpenGLFunctions();
@@ -46,7 +67,150 @@ bool Shader::hasUniform(const char* name) const {
     return uniforms.find(name) != uniforms.end();
 }
 
-void Shader::compile(const char* vertex, const char* fragment) {
+void Shader::compile(const char* vertex, const char* fragment, const std::string& name) {
+    // Drivers may support no binary formats at all, in which case there's nothing to cache
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    if (formats <= 0) {
+        Profiler::Scope scope("compile shader " + name, "startup");
+        compileSource(vertex, fragment);
+        readUniforms();
+        return;
+    }
+
+    uint64_t key = cacheKey(vertex, fragment);
+
+    char keyName[32];
+    std::snprintf(keyName, sizeof(keyName), "%016llx.bin", (unsigned long long)key);
+    std::filesystem::path blob = DiskCache::directory("shaders") / keyName;
+
+    bool cached;
+
+    {
+        Profiler::Scope scope("load cached shader " + name, "startup");
+        cached = loadBinary(blob, key);
+    }
+
+    if (!cached) {
+        Profiler::Scope scope("compile shader " + name, "startup");
+        compileSource(vertex, fragment);
+
+        if (!saveBinary(blob, key)) {
+            std::cerr << "Shader: Failed to write program binary cache entry " << blob << "\n";
+        }
+    }
+
+    readUniforms();
+}
+
+uint64_t Shader::cacheKey(const char* vertex, const char* fragment) {
+    uint64_t key = DiskCache::hash(&binaryCacheVersion, sizeof(binaryCacheVersion));
+
+    // Hashing the terminators too keeps ("ab", "c") and ("a", "bc") apart
+    key = DiskCache::hash(vertex, std::strlen(vertex) + 1, key);
+    key = DiskCache::hash(fragment, std::strlen(fragment) + 1, key);
+
+    for(GLenum property : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const char* value = reinterpret_cast<const char*>(glGetString(property));
+
+        if (value) {
+            key = DiskCache::hash(value, std::strlen(value) + 1, key);
+        }
+    }
+
+    return key;
+}
+
+bool Shader::loadBinary(const std::filesystem::path& blob, uint64_t key) {
+    QFile file(QString::fromStdString(blob.string()));
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray bytes = file.readAll();
+    file.close();
+
+    ShaderCacheHeader header{};
+
+    if ((size_t)bytes.size() < sizeof(header)) {
+        return false;
+    }
+
+    std::memcpy(&header, bytes.constData(), sizeof(header));
+
+    bool valid =
+        std::memcmp(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == binaryCacheVersion &&
+        header.key == key &&
+        (size_t)bytes.size() == sizeof(header) + header.binaryLength;
+
+    if (!valid) {
+        return false;
+    }
+
+    program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, bytes.constData() + sizeof(header), (GLsizei)header.binaryLength);
+
+    // The driver can refuse a binary even when the key matches, e.g. after an update that kept its
+    // version string. Then it's compiled from source, and the entry is overwritten afterwards
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    if (!success) {
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    return true;
+}
+
+bool Shader::saveBinary(const std::filesystem::path& blob, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if (length <= 0) {
+        return false;
+    }
+
+    ShaderCacheHeader header{};
+    std::memcpy(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic));
+    header.version = binaryCacheVersion;
+    header.key = key;
+
+    QByteArray bytes(sizeof(header) + length, 0);
+
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &written, &format, bytes.data() + sizeof(header));
+
+    if (written <= 0) {
+        return false;
+    }
+
+    header.binaryFormat = format;
+    header.binaryLength = (uint32_t)written;
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    bytes.resize(sizeof(header) + written);
+
+    // As with the mesh cache, QSaveFile means a crash mid-write never leaves a torn entry behind
+    QSaveFile file(QString::fromStdString(blob.string()));
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    if (file.write(bytes) != bytes.size()) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+void Shader::compileSource(const char* vertex, const char* fragment) {
     // Create the two shader modules
     unsigned int vshader = glCreateShader(GL_VERTEX_SHADER);
     unsigned int fshader = glCreateShader(GL_FRAGMENT_SHADER);
@@ -95,6 +259,9 @@ void Shader::compile(const char* vertex, const char* fragment) {
     glAttachShader(program, vshader);
     glAttachShader(program, fshader);
 
+    // Ask the driver to keep the linked binary around, so it can be read back for the cache
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     glLinkProgram(program);
 
     // Ensure it linked correctly
@@ -109,6 +276,7 @@ void Shader::compile(const char* vertex, const char* fragment) {
         glDeleteShader(vshader);
         glDeleteShader(fshader);
         glDeleteProgram(program);
+        program = 0;
 
         throw std::runtime_error(message);
     }
@@ -116,10 +284,10 @@ void Shader::compile(const char* vertex, const char* fragment) {
     // The shader modules are no longer required
     glDeleteShader(vshader);
     glDeleteShader(fshader);
+}
 
-
+void Shader::readUniforms() {
     // Read out all the uniforms (variables we can set on the shader)
-
     GLint numUniforms = 0;
     glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numUniforms);
 
@@ -136,9 +304,9 @@ void Shader::compile(const char* vertex, const char* fragment) {
     }
 }
 
-Shader Shader::fromSource(const char* vertex, const char* fragment) {
+Shader Shader::fromSource(const char* vertex, const char* fragment, const std::string& name) {
     Shader returnval;
-    returnval.compile(vertex, fragment);
+    returnval.compile(vertex, fragment, name);
     return returnval;
 }
 
@@ -169,7 +337,7 @@ Shader Shader::fromFolder(const std::filesystem::path& path) {
     vertstream.close();
     fragstream.close();
 
-    return fromSource(vertSrc.c_str(), fragSrc.c_str());
+    return fromSource(vertSrc.c_str(), fragSrc.c_str(), path.filename().string());
 }
 
 unsigned int Shader::location(const char* name) const {
@@ -183,6 +351,11 @@ unsigned int Shader::location(const char* name) const {
     }
 }
 
+int Shader::findLocation(const char* name) const {
+    auto it = uniforms.find(name);
+    return it != uniforms.end() ? (int)it->second : -1;
+}
+
 void Shader::bindTexture(const char* name, int location, Texture* texture) {
     if (!texture) { return; }
 
@@ -6,6 +6,7 @@
 
 #include <unordered_map>
 #include <filesystem>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -35,13 +36,62 @@ class Shader : private QOpenGLExtraFunctions {
     unsigned int program;
     std::unordered_map<std::string, unsigned int> uniforms;
 
-    void compile(const char* vertex, const char* fragment);
+    /**
+     * Build the program, from the program binary cache if possible, otherwise by compiling and linking
+     * @param vertex The vertex shader's source
+     * @param fragment The fragment shader's source
+     * @param name What to call the shader in the startup trace
+     */
+    void compile(const char* vertex, const char* fragment, const std::string& name);
+
+    /** Compile and link the sources into the program, throwing std::runtime_error with the log on failure */
+    void compileSource(const char* vertex, const char* fragment);
+
+    /**
+     * Try to create the program from a cached program binary
+     * @param blob The cache file
+     * @param key The cache key the file must have been written with
+     * @return false if there's no usable binary, in which case the program is left empty
+     */
+    bool loadBinary(const std::filesystem::path& blob, uint64_t key);
+
+    /**
+     * Write the linked program's binary to the cache
+     * @param blob The cache file
+     * @param key The cache key to store with it
+     * @return whether it was written
+     */
+    bool saveBinary(const std::filesystem::path& blob, uint64_t key);
+
+    /**
+     * The cache key for a pair of sources on the current driver. Program binaries only load on the exact
+     * driver that produced them, so the GL vendor, renderer and version strings are part of it
+     * @param vertex The vertex shader's source
+     * @param fragment The fragment shader's source
+     * @return the key
+     */
+    uint64_t cacheKey(const char* vertex, const char* fragment);
+
+    /** Look up every active uniform's location */
+    void readUniforms();
+
+    // Bumped whenever the layout of the cache files changes
+    static const uint32_t constexpr binaryCacheVersion = 1;
 public:
     Shader();
     Shader(unsigned int prog);
     Shader(Shader&& other);
 
-    static Shader fromSource(const char* vertex, const char* fragment);
+    /**
+     * Create a shader program from GLSL source. Linked programs are cached on disk as program binaries,
+     * so later launches on the same driver skip compiling. If a cached binary is stale or rejected by the
+     * driver, the shader is compiled from source as usual and the cache entry replaced
+     * @param vertex The vertex shader's source
+     * @param fragment The fragment shader's source
+     * @param name What to call the shader in the startup trace
+     * @throws std::runtime_error if the source doesn't compile or link
+     */
+    static Shader fromSource(const char* vertex, const char* fragment, const std::string& name = "shader");
     static Shader fromFolder(const std::filesystem::path& path);
 
     ~Shader();
@@ -66,6 +116,14 @@ public:
      */
     unsigned int location(const char* name) const;
 
+    /**
+     * Get the location of a uniform variable, if it has one, so it can be set each frame without looking its
+     * name up again
+     * @param name The name of the uniform
+     * @return the numeric location of the uniform, or -1 if there's no such uniform (setting -1 does nothing)
+     */
+    int findLocation(const char* name) const;
+
     /**
      * Bind a texture, so that the shader will use that texture on the next draw call
      * @param name The name of the sampler uniform to bind to
@@ -99,11 +157,11 @@ public:
     /**
      * Set the value of a uniform
      * @tparam T The type of the value passed in - should be automatically deduced
-     * @param name The name of the uniform to set
+     * @param location The location of the uniform to set, from findLocation
      * @param value The value to set the uniform to
      */
     template<typename T>
-    void setUniform(const char* name, T&& value) {
+    void setUniform(int location, T&& value) {
 
         /* This is a piece of template metaprogramming. We want to check what type value is, so we
          * can call the right GL function for it. The problem is that in C++, these are technically
@@ -124,20 +182,33 @@ public:
          *
          * the other branches of the constexpr if don't even end up in the final compiled function
          * */
-        if constexpr (std::is_same_v<realtype, float>) { glUniform1f(uniforms.at(name), value); }
-        else if constexpr (std::is_same_v<realtype, int>) { glUniform1i(uniforms.at(name), value); }
-        else if constexpr (std::is_same_v<realtype, unsigned int>) { glUniform1ui(uniforms.at(name), value); }
-        else if constexpr (std::is_same_v<realtype, glm::vec2>) { glUniform2fv(uniforms.at(name), 1, glm::value_ptr(value)); }
-        else if constexpr (std::is_same_v<realtype, glm::vec3>) { glUniform3fv(uniforms.at(name), 1, glm::value_ptr(value)); }
-        else if constexpr (std::is_same_v<realtype, glm::vec4>) { glUniform4fv(uniforms.at(name), 1, glm::value_ptr(value)); }
-        else if constexpr (std::is_same_v<realtype, glm::mat2>) { glUniformMatrix2fv(uniforms.at(name), 1, GL_FALSE, glm::value_ptr(value)); }
-        else if constexpr (std::is_same_v<realtype, glm::mat3>) { glUniformMatrix3fv(uniforms.at(name), 1, GL_FALSE, glm::value_ptr(value)); }
-        else if constexpr (std::is_same_v<realtype, glm::mat4>) { glUniformMatrix4fv(uniforms.at(name), 1, GL_FALSE, glm::value_ptr(value)); }
+        if constexpr (std::is_same_v<realtype, float>) { glUniform1f(location, value); }
+        else if constexpr (std::is_same_v<realtype, int>) { glUniform1i(location, value); }
+        else if constexpr (std::is_same_v<realtype, unsigned int>) { glUniform1ui(location, value); }
+        else if constexpr (std::is_same_v<realtype, glm::vec2>) { glUniform2fv(location, 1, glm::value_ptr(value)); }
+        else if constexpr (std::is_same_v<realtype, glm::vec3>) { glUniform3fv(location, 1, glm::value_ptr(value)); }
+        else if constexpr (std::is_same_v<realtype, glm::vec4>) { glUniform4fv(location, 1, glm::value_ptr(value)); }
+        else if constexpr (std::is_same_v<realtype, glm::mat2>) { glUniformMatrix2fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+        else if constexpr (std::is_same_v<realtype, glm::mat3>) { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+        else if constexpr (std::is_same_v<realtype, glm::mat4>) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+        // Arrays are set through their first element, i.e. "name[0]"
+        else if constexpr (std::is_same_v<realtype, std::vector<glm::vec4>>) { glUniform4fv(location, (GLsizei)value.size(), glm::value_ptr(value[0])); }
         else {
             throw std::logic_error("Invalid shader uniform type");
         }
     }
 
+    /**
+     * Set the value of a uniform by name
+     * @tparam T The type of the value passed in - should be automatically deduced
+     * @param name The name of the uniform to set
+     * @param value The value to set the uniform to
+     */
+    template<typename T>
+    void setUniform(const char* name, T&& value) {
+        setUniform((int)uniforms.at(name), std::forward<T>(value));
+    }
+
     template<typename T>
     void setUniformIf(const char* name, T&& value) {
         if (hasUniform(name)) {
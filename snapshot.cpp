@@ -0,0 +1,417 @@
+#include "snapshot.h"
+#include "scene.h"
+#include "bitstream.h"
+
+#include <algorithm>
+#include <cstring>
+
+// The bits an object's type takes, enough for every GameObjectType
+static const int constexpr TYPE_BITS = 3;
+
+// The largest count or id difference a delta can hold, which keeps a bad delta from asking for a
+// huge allocation
+static const uint32_t constexpr MAX_COUNT = 1 << 20;
+
+static void writeU32(std::vector<uint8_t>& out, uint32_t value) {
+    for(int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)(value >> (i * 8)));
+    }
+}
+
+static void writeF32(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeU32(out, bits);
+}
+
+/** Reads a delta, failing (and staying failed) instead of reading past its end */
+struct DeltaReader {
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    bool failed = false;
+
+    uint8_t readU8() {
+        if (position + 1 > size) { failed = true; return 0; }
+        return data[position++];
+    }
+
+    uint32_t readU32() {
+        if (position + 4 > size) { failed = true; return 0; }
+
+        uint32_t value = 0;
+        for(int i = 0; i < 4; i++) {
+            value |= (uint32_t)data[position++] << (i * 8);
+        }
+        return value;
+    }
+
+    float readF32() {
+        uint32_t bits = readU32();
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+void Snapshot::capture(const Scene& scene, uint32_t tick, const Quantization& quantization, Snapshot& out) {
+    out.tick = tick;
+    out.entities.clear();
+    out.quantization = quantization;
+
+    for(const GameObject* object : scene) {
+        // Gone at the start of the next update, so already gone as far as clients are concerned
+        if (object->isQueuedForDestruction()) {
+            continue;
+        }
+
+        out.entities.push_back({object->getEntityID(), object->getType(), object->getPosition(), object->getDirection()});
+        quantization.round(out.entities.back());
+    }
+
+    // Objects are added with increasing ids, so this is usually sorted already
+    std::sort(out.entities.begin(), out.entities.end(), [](const EntityState& a, const EntityState& b) {
+        return a.id < b.id;
+    });
+}
+
+const EntityState* Snapshot::find(uint32_t id) const {
+    auto it = std::lower_bound(entities.begin(), entities.end(), id, [](const EntityState& state, uint32_t id) {
+        return state.id < id;
+    });
+
+    return it != entities.end() && it->id == id ? &*it : nullptr;
+}
+
+// What a delta carries of an object
+enum ChangeBits : uint8_t {
+    POSITION_CHANGED = 1 << 0,
+    DIRECTION_CHANGED = 1 << 1,
+    NEW_ENTITY = 1 << 2,
+};
+
+/**
+ * @param state An object's current state
+ * @param old Its state in the baseline, or nullptr if it's new
+ * @return what a delta needs to carry of it
+ */
+static uint8_t changeMask(const EntityState& state, const EntityState* old) {
+    if (!old) {
+        return NEW_ENTITY | POSITION_CHANGED | DIRECTION_CHANGED;
+    }
+
+    uint8_t mask = 0;
+
+    // Bit for bit, so a -0 or a NaN that changed still counts
+    if (std::memcmp(&state.position, &old->position, sizeof(state.position)) != 0) { mask |= POSITION_CHANGED; }
+    if (std::memcmp(&state.direction, &old->direction, sizeof(state.direction)) != 0) { mask |= DIRECTION_CHANGED; }
+
+    return mask;
+}
+
+/**
+ * @param bits Where to write
+ * @param value A vector, as three floats
+ */
+static void writeExact(BitWriter& bits, const glm::vec3& value) {
+    bits.writeF32(value.x);
+    bits.writeF32(value.y);
+    bits.writeF32(value.z);
+}
+
+static glm::vec3 readExact(BitReader& bits) {
+    float x = bits.readF32();
+    float y = bits.readF32();
+    float z = bits.readF32();
+    return glm::vec3(x, y, z);
+}
+
+/**
+ * Walk two snapshots' objects together by id, which works since both are sorted by it
+ * @param from The snapshot whose objects are visited
+ * @param other The snapshot to find each of them in
+ * @param visit Called with each object, and the same object in other or nullptr
+ */
+template<typename Visit>
+static void matchEntities(const Snapshot& from, const Snapshot& other, Visit visit) {
+    size_t o = 0;
+
+    for(const EntityState& state : from.entities) {
+        while (o < other.entities.size() && other.entities[o].id < state.id) { o++; }
+
+        visit(state, o < other.entities.size() && other.entities[o].id == state.id ? &other.entities[o] : nullptr);
+    }
+}
+
+void Snapshot::writeDelta(const Snapshot* baseline, const Snapshot& current, std::vector<uint8_t>& out) {
+    static const Snapshot empty;
+
+    // Fixed point at another precision means nothing to build on
+    if (baseline && !(baseline->quantization == current.quantization)) {
+        baseline = nullptr;
+    }
+
+    const Snapshot& base = baseline ? *baseline : empty;
+    const Quantization& quantization = current.quantization;
+
+    out.clear();
+    writeU32(out, current.tick);
+    writeU32(out, baseline ? baseline->tick : 0);
+
+    if (!baseline) {
+        writeF32(out, quantization.xLength);
+        writeF32(out, quantization.zLength);
+        out.push_back(quantization.positionBits);
+        out.push_back(quantization.yawBits);
+    }
+
+    BitWriter bits(out);
+
+    // Removed objects are in the baseline but not the current snapshot. Each list is walked twice, once
+    // to count it and once to write it, so nothing needs to be held on to in between
+    uint32_t removedCount = 0;
+    matchEntities(base, current, [&](const EntityState&, const EntityState* now) {
+        if (!now) { removedCount++; }
+    });
+
+    bits.writeVarint(removedCount);
+    uint32_t lastId = 0;
+
+    matchEntities(base, current, [&](const EntityState& state, const EntityState* now) {
+        if (!now) {
+            bits.writeVarint(state.id - lastId);
+            lastId = state.id;
+        }
+    });
+
+    uint32_t changedCount = 0;
+    matchEntities(current, base, [&](const EntityState& state, const EntityState* old) {
+        if (changeMask(state, old) != 0) { changedCount++; }
+    });
+
+    bits.writeVarint(changedCount);
+    lastId = 0;
+
+    matchEntities(current, base, [&](const EntityState& state, const EntityState* old) {
+        uint8_t mask = changeMask(state, old);
+
+        if (mask == 0) {
+            return;
+        }
+
+        bits.writeVarint(state.id - lastId);
+        lastId = state.id;
+        bits.writeBool(mask & NEW_ENTITY);
+
+        if (mask & NEW_ENTITY) {
+            bits.writeBits((uint32_t)state.type, TYPE_BITS);
+        } else {
+            bits.writeBool(mask & POSITION_CHANGED);
+            bits.writeBool(mask & DIRECTION_CHANGED);
+        }
+
+        if (mask & POSITION_CHANGED) {
+            bool exact = !quantization.fitsGrid(state.position);
+            bits.writeBool(exact);
+
+            if (exact) {
+                writeExact(bits, state.position);
+            } else {
+                bits.writeBits(quantization.quantizeX(state.position.x), quantization.positionBits);
+                bits.writeBits(quantization.quantizeZ(state.position.z), quantization.positionBits);
+            }
+        }
+
+        if (mask & DIRECTION_CHANGED) {
+            bool exact = !Quantization::isFlat(state.direction);
+            bits.writeBool(exact);
+
+            if (exact) {
+                writeExact(bits, state.direction);
+            } else {
+                bits.writeBits(quantization.quantizeYaw(state.direction), quantization.yawBits);
+            }
+        }
+    });
+
+    bits.finish();
+}
+
+uint32_t Snapshot::readBaselineTick(const uint8_t* data, size_t size) {
+    DeltaReader reader{data, size};
+    reader.readU32();
+    uint32_t baseline = reader.readU32();
+    return reader.failed ? 0 : baseline;
+}
+
+bool Snapshot::readDelta(const Snapshot* baseline, const uint8_t* data, size_t size, Snapshot& out) {
+    DeltaReader reader{data, size};
+
+    out.tick = reader.readU32();
+    uint32_t baselineTick = reader.readU32();
+
+    if (reader.failed || out.tick == 0 || baselineTick != (baseline ? baseline->tick : 0)) {
+        return false;
+    }
+
+    if (baseline) {
+        out.quantization = baseline->quantization;
+    } else {
+        out.quantization.xLength = reader.readF32();
+        out.quantization.zLength = reader.readF32();
+        out.quantization.positionBits = reader.readU8();
+        out.quantization.yawBits = reader.readU8();
+
+        if (reader.failed || !out.quantization.isValid()) {
+            return false;
+        }
+    }
+
+    const Quantization& quantization = out.quantization;
+    BitReader bits(data + reader.position, size - reader.position);
+
+    // Start from the baseline, less whatever was removed
+    out.entities.clear();
+    uint32_t removedCount = bits.readVarint();
+
+    if (bits.hasFailed() || removedCount > MAX_COUNT) {
+        return false;
+    }
+
+    size_t b = 0;
+    uint32_t id = 0;
+
+    for(uint32_t i = 0; i < removedCount; i++) {
+        id += bits.readVarint();
+
+        if (!baseline || bits.hasFailed()) {
+            return false;
+        }
+
+        while (b < baseline->entities.size() && baseline->entities[b].id < id) {
+            out.entities.push_back(baseline->entities[b++]);
+        }
+
+        if (b == baseline->entities.size() || baseline->entities[b].id != id) {
+            return false;
+        }
+
+        b++;
+    }
+
+    if (baseline) {
+        out.entities.insert(out.entities.end(), baseline->entities.begin() + b, baseline->entities.end());
+    }
+
+    // Then change or add the rest, merging the new objects in by id
+    uint32_t changedCount = bits.readVarint();
+
+    if (bits.hasFailed() || changedCount > MAX_COUNT) {
+        return false;
+    }
+
+    size_t kept = out.entities.size();
+    size_t e = 0;
+    id = 0;
+
+    for(uint32_t i = 0; i < changedCount; i++) {
+        uint32_t difference = bits.readVarint();
+
+        // Ids go up, except that the first may be 0
+        if (i > 0 && difference == 0) {
+            return false;
+        }
+
+        id += difference;
+
+        while (e < kept && out.entities[e].id < id) { e++; }
+        bool exists = e < kept && out.entities[e].id == id;
+
+        EntityState state{id, GameObjectType::None, glm::vec3(0.0f), glm::vec3(0.0f)};
+        uint8_t mask;
+
+        if (bits.readBool()) {
+            uint32_t type = bits.readBits(TYPE_BITS);
+
+            if (exists || type > (uint32_t)GameObjectType::None) {
+                return false;
+            }
+
+            state.type = (GameObjectType)type;
+            mask = NEW_ENTITY | POSITION_CHANGED | DIRECTION_CHANGED;
+        }
+        else if (exists) {
+            state = out.entities[e];
+            mask = bits.readBool() ? POSITION_CHANGED : 0;
+            mask |= bits.readBool() ? DIRECTION_CHANGED : 0;
+        }
+        else {
+            return false;
+        }
+
+        if (mask & POSITION_CHANGED) {
+            if (bits.readBool()) {
+                state.position = readExact(bits);
+            } else {
+                float x = quantization.dequantizeX(bits.readBits(quantization.positionBits));
+                float z = quantization.dequantizeZ(bits.readBits(quantization.positionBits));
+                state.position = glm::vec3(x, 0.0f, z);
+            }
+        }
+
+        if (mask & DIRECTION_CHANGED) {
+            state.direction = bits.readBool() ? readExact(bits) : quantization.dequantizeYaw(bits.readBits(quantization.yawBits));
+        }
+
+        if (bits.hasFailed()) {
+            return false;
+        }
+
+        if (exists) {
+            out.entities[e] = state;
+        }
+        else {
+            out.entities.push_back(state);
+        }
+    }
+
+    // New objects went on the end. They're in order among themselves, so one merge puts everything back in order
+    std::inplace_merge(out.entities.begin(), out.entities.begin() + kept, out.entities.end(),
+                       [](const EntityState& a, const EntityState& b) { return a.id < b.id; });
+
+    return bits.isAtEnd();
+}
+
+bool operator==(const EntityState& a, const EntityState& b) {
+    return a.id == b.id && a.type == b.type && a.position == b.position && a.direction == b.direction;
+}
+
+bool operator==(const Snapshot& a, const Snapshot& b) {
+    return a.tick == b.tick && a.quantization == b.quantization && a.entities == b.entities;
+}
+
+Snapshot& SnapshotHistory::add(uint32_t tick) {
+    Snapshot& snapshot = snapshots[tick % capacity];
+    snapshot.tick = tick;
+    snapshot.entities.clear();
+    newest = tick;
+    return snapshot;
+}
+
+const Snapshot* SnapshotHistory::find(uint32_t tick) const {
+    const Snapshot& snapshot = snapshots[tick % capacity];
+    return tick != 0 && snapshot.tick == tick ? &snapshot : nullptr;
+}
+
+const Snapshot* SnapshotHistory::latest() const {
+    return find(newest);
+}
+
+void SnapshotHistory::clear() {
+    for(Snapshot& snapshot : snapshots) {
+        snapshot.tick = 0;
+        snapshot.entities.clear();
+    }
+
+    newest = 0;
+}
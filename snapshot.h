@@ -0,0 +1,139 @@
+#ifndef TANKS_SNAPSHOT_H
+#define TANKS_SNAPSHOT_H
+
+#include "gameobjecttype.h"
+#include "quantization.h"
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Scene;
+
+/** What a client needs to know about one GameObject to draw it */
+struct EntityState {
+    uint32_t id;
+    GameObjectType type;
+    glm::vec3 position;
+    glm::vec3 direction;
+};
+
+/**
+ * The state of every GameObject in the Scene at the end of one server tick, as sent to clients.
+ *
+ * Snapshots are sent as deltas against one the client has already acknowledged (its baseline), so
+ * they only carry what changed since: the ids of objects that are gone, and for objects that are new
+ * or have changed, only the fields that differ. Obstacles never change, so once a client has them they
+ * cost nothing, and an idle tank costs nothing either. A client without a baseline (it has just joined,
+ * or fell too far behind for the server to still have its last acknowledged snapshot) gets the whole
+ * snapshot, as a delta against nothing.
+ *
+ * Positions and directions are sent quantised (see Quantization), at a precision the whole snapshot
+ * carries, and later deltas take from their baseline. A delta is a few whole bytes, then bits packed
+ * with no padding between them (see BitWriter), the last byte padded with zeros:
+ *
+ *  [tick, u32] [baseline tick, u32, 0 for none]
+ *  [if there's no baseline: map x length, f32] [map z length, f32] [position bits, u8] [yaw bits, u8]
+ *  then bits:
+ *  [removed count, varint] then each removed id, as a varint difference from the last
+ *  [changed count, varint] then each changed object:
+ *      [id difference from the last, varint] [new, 1] then if it's new [type, 3],
+ *      otherwise [position changed, 1] [direction changed, 1]
+ *      if its position is new or changed: [exact, 1] then [x, z, position bits each] or [x, y, z, f32]
+ *      if its direction is new or changed: [exact, 1] then [yaw, yaw bits] or [x, y, z, f32]
+ *
+ * A varint here is 4 bits at a time, each followed by a bit saying whether there's more, so the usual
+ * id difference takes 5 bits, and a tank that's moved takes about 5 bytes. Fields are compared exactly,
+ * which works because the server's simulation only writes the ones that move, and it rounds what it
+ * captures to what it can send. Numbers are little endian.
+ */
+struct Snapshot {
+    // Which server tick it's from. Ticks start at 1, so 0 means no snapshot
+    uint32_t tick = 0;
+    // Sorted by id
+    std::vector<EntityState> entities;
+    // How precisely it's sent
+    Quantization quantization;
+
+    /**
+     * Record the state of every object in a scene, rounded to what can be sent
+     * @param scene The scene
+     * @param tick The tick it's at
+     * @param quantization How precisely to send it
+     * @param out The snapshot to fill, whose memory is reused
+     */
+    static void capture(const Scene& scene, uint32_t tick, const Quantization& quantization, Snapshot& out);
+
+    /**
+     * @param id An object's entity id
+     * @return its state, or nullptr if it isn't in this snapshot
+     */
+    const EntityState* find(uint32_t id) const;
+
+    /**
+     * Encode the difference between two snapshots
+     * @param baseline What the receiver already has, or nullptr if it has nothing. One at another precision
+     *                 can't be built on, so it's the same as nothing
+     * @param current The snapshot to send
+     * @param out Where to write the delta. It's cleared first, and its memory reused
+     */
+    static void writeDelta(const Snapshot* baseline, const Snapshot& current, std::vector<uint8_t>& out);
+
+    /**
+     * @param data A delta
+     * @param size Its size
+     * @return the tick of the baseline it needs, 0 for none, or 0 if it's too short to say
+     */
+    static uint32_t readBaselineTick(const uint8_t* data, size_t size);
+
+    /**
+     * Apply a delta to its baseline
+     * @param baseline The snapshot named by readBaselineTick, or nullptr if that's 0
+     * @param data The delta
+     * @param size Its size
+     * @param out The snapshot it describes
+     * @return false if the delta is malformed, in which case out is unspecified
+     */
+    static bool readDelta(const Snapshot* baseline, const uint8_t* data, size_t size, Snapshot& out);
+};
+
+bool operator==(const EntityState& a, const EntityState& b);
+bool operator==(const Snapshot& a, const Snapshot& b);
+
+/**
+ * The last few snapshots, by tick: the ones the server sent, for finding a client's baseline, or the ones a
+ * client received, for applying the deltas built on them. Old ones are overwritten, so nothing is
+ * allocated once it has filled up.
+ */
+class SnapshotHistory {
+public:
+    /**
+     * Make room for the next snapshot, overwriting the oldest
+     * @param tick The new snapshot's tick, which must be higher than any before it
+     * @return the snapshot to fill in
+     */
+    Snapshot& add(uint32_t tick);
+
+    /**
+     * @param tick A tick
+     * @return the snapshot from it, or nullptr if there isn't one (any more)
+     */
+    const Snapshot* find(uint32_t tick) const;
+
+    /** @return the newest snapshot, or nullptr if there are none */
+    const Snapshot* latest() const;
+
+    /** Forget every snapshot */
+    void clear();
+
+    // About a second of ticks. A client that hasn't acknowledged anything in that long gets a whole snapshot
+    static const size_t constexpr capacity = 64;
+
+private:
+    Snapshot snapshots[capacity];
+    uint32_t newest = 0;
+};
+
+#endif //TANKS_SNAPSHOT_H
@@ -0,0 +1,82 @@
+#include "spatialgrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+void SpatialGrid::build(float xLength, float zLength, float cellSize, const std::vector<EntityState>& entities) {
+    this->entities = &entities;
+    this->cellSize = std::max(cellSize, 1e-3f);
+    minX = -0.5f * xLength;
+    minZ = -0.5f * zLength;
+    columns = std::max(1, (int)std::ceil(xLength / this->cellSize));
+    rows = std::max(1, (int)std::ceil(zLength / this->cellSize));
+
+    size_t cells = getCellCount();
+    cellStart.assign(cells + 1, 0);
+    cellOf.resize(entities.size());
+    items.resize(entities.size());
+
+    // Count what's in each cell, one along so the running sum below leaves each cell's start in place
+    for(size_t i = 0; i < entities.size(); i++) {
+        const glm::vec3& position = entities[i].position;
+        cellOf[i] = (uint32_t)(rowOf(position.z) * columns + columnOf(position.x));
+        cellStart[cellOf[i] + 1]++;
+    }
+
+    for(size_t cell = 0; cell < cells; cell++) {
+        cellStart[cell + 1] += cellStart[cell];
+    }
+
+    // Then place them, using the start of the next cell as each cell's cursor and winding it back after
+    for(size_t i = 0; i < entities.size(); i++) {
+        items[cellStart[cellOf[i]]++] = (uint32_t)i;
+    }
+
+    for(size_t cell = cells; cell > 0; cell--) {
+        cellStart[cell] = cellStart[cell - 1];
+    }
+
+    cellStart[0] = 0;
+}
+
+void SpatialGrid::query(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+    out.clear();
+
+    if (!entities) {
+        return;
+    }
+
+    int firstColumn = columnOf(center.x - radius);
+    int lastColumn = columnOf(center.x + radius);
+    int firstRow = rowOf(center.z - radius);
+    int lastRow = rowOf(center.z + radius);
+    float radiusSquared = radius * radius;
+
+    for(int row = firstRow; row <= lastRow; row++) {
+        for(int column = firstColumn; column <= lastColumn; column++) {
+            size_t cell = (size_t)row * columns + column;
+
+            for(uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+                const glm::vec3& position = (*entities)[items[i]].position;
+                float dx = position.x - center.x;
+                float dz = position.z - center.z;
+
+                if (dx * dx + dz * dz <= radiusSquared) {
+                    out.push_back(items[i]);
+                }
+            }
+        }
+    }
+
+    // Cells come out in grid order, so put them back in the snapshot's
+    std::sort(out.begin(), out.end());
+}
+
+int SpatialGrid::columnOf(float x) const {
+    // Clamped before converting, since a float far past the map doesn't fit in an int
+    return (int)std::clamp(std::floor((x - minX) / cellSize), 0.0f, (float)(columns - 1));
+}
+
+int SpatialGrid::rowOf(float z) const {
+    return (int)std::clamp(std::floor((z - minZ) / cellSize), 0.0f, (float)(rows - 1));
+}
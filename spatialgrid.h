@@ -0,0 +1,70 @@
+#ifndef TANKS_SPATIALGRID_H
+#define TANKS_SPATIALGRID_H
+
+#include "snapshot.h"
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A uniform grid over the map's XZ plane, for finding what's near a point without looking at everything.
+ * The map is centred on the origin, Scene::getXLength by Scene::getZLength, and split into square cells.
+ * Anything past the edge counts as being in the nearest edge cell, so nothing is ever lost.
+ *
+ * It's rebuilt from scratch from each snapshot, which is a counting sort: one pass to count what's in
+ * each cell, one to place it. Its arrays are kept, so once they've grown rebuilding allocates nothing.
+ */
+class SpatialGrid {
+public:
+    /**
+     * Sort a snapshot's entities into cells
+     * @param xLength The map's size along x
+     * @param zLength The map's size along z
+     * @param cellSize The side of each cell
+     * @param entities The entities. They have to outlive any query, which returns indices into them
+     */
+    void build(float xLength, float zLength, float cellSize, const std::vector<EntityState>& entities);
+
+    /**
+     * Find every entity within a distance of a point, on the XZ plane
+     * @param center The point
+     * @param radius The distance
+     * @param out Set to their indices in the entities the grid was built from, in increasing order, so
+     *            in order of id for a snapshot's. It's cleared first
+     */
+    void query(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+
+    /** @return how many cells there are */
+    size_t getCellCount() const { return (size_t)columns * rows; }
+
+private:
+    /**
+     * @param x A position's x
+     * @return the column it's in, clamped to the grid
+     */
+    int columnOf(float x) const;
+
+    /**
+     * @param z A position's z
+     * @return the row it's in, clamped to the grid
+     */
+    int rowOf(float z) const;
+
+    const std::vector<EntityState>* entities = nullptr;
+    float minX = 0.0f;
+    float minZ = 0.0f;
+    float cellSize = 1.0f;
+    int columns = 0;
+    int rows = 0;
+
+    // Cell i's entities are items[cellStart[i]] up to items[cellStart[i + 1]]
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> items;
+    // Each entity's cell, from the counting pass
+    std::vector<uint32_t> cellOf;
+};
+
+#endif //TANKS_SPATIALGRID_H
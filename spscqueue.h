@@ -0,0 +1,67 @@
+#ifndef TANKS_SPSCQUEUE_H
+#define TANKS_SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * A fixed size first-in first-out queue between one producer thread and one consumer thread, with
+ * no locks, no waiting and no allocation. Pushing to a full queue fails rather than blocking, so the
+ * producer decides what to do about it.
+ *
+ * The producer only writes the tail and the consumer only writes the head, each on its own cache
+ * line, so the two threads don't slow each other down by sharing one.
+ *
+ *  // producer                         // consumer
+ *  queue.push(command);                while (queue.pop(command)) { ... }
+ *
+ * @tparam T What's queued. It's copied in and out, so keep it small
+ * @tparam Capacity The most items it can hold. A power of two, so positions wrap with a mask
+ */
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue's capacity must be a power of two");
+
+    std::array<T, Capacity> items;
+
+    // How many items have ever been pushed and popped. Their difference is how many are queued
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> head{0};
+public:
+    /**
+     * Add an item. Only call from the producer thread
+     * @param item The item
+     * @return false if the queue is full, in which case the item isn't added
+     */
+    bool push(const T& item) {
+        size_t position = tail.load(std::memory_order_relaxed);
+
+        if (position - head.load(std::memory_order_acquire) >= Capacity) {
+            return false;
+        }
+
+        items[position & (Capacity - 1)] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Take the oldest item. Only call from the consumer thread
+     * @param item Where to put it
+     * @return false if the queue is empty
+     */
+    bool pop(T& item) {
+        size_t position = head.load(std::memory_order_relaxed);
+
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = items[position & (Capacity - 1)];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif //TANKS_SPSCQUEUE_H
@@ -0,0 +1,34 @@
+#include "tankmotion.h"
+
+#include <cmath>
+
+glm::vec3 TankMotion::facing(float angle) {
+    return glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+}
+
+float TankMotion::headingOf(const glm::vec3& direction) {
+    return std::atan2(direction.z, direction.x);
+}
+
+TankMotion TankMotion::step(const TankMotion& motion, const TankInput& input, float speed, float deltaTime) {
+    TankMotion next = motion;
+    glm::vec3 dir = facing(motion.angle);
+
+    if (input.forward) {
+        next.position += dir * speed * deltaTime;
+    }
+
+    if (input.back) {
+        next.position -= dir * speed * deltaTime;
+    }
+
+    if (input.left) {
+        next.angle -= speed * deltaTime;
+    }
+
+    if (input.right) {
+        next.angle += speed * deltaTime;
+    }
+
+    return next;
+}
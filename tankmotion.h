@@ -0,0 +1,53 @@
+#ifndef TANKS_TANKMOTION_H
+#define TANKS_TANKMOTION_H
+
+#include <glm/vec3.hpp>
+
+/**
+ * What a player is asking their tank to do this update, from the keyboard or from a client over the network
+ */
+struct TankInput {
+    bool forward = false;
+    bool back = false;
+    bool left = false;
+    bool right = false;
+    bool fire = false;
+};
+
+/**
+ * Where a player's tank is and which way it's heading: everything its controls change from one update to the
+ * next. PlayerTank::doUpdate moves with step, and so does a client predicting its own tank ahead of the server
+ * (TankPredictor), so the two come out the same for the same controls.
+ *
+ * step touches nothing but its arguments, so it can be run again and again from an old state, as prediction
+ * does whenever the server corrects it.
+ */
+struct TankMotion {
+    glm::vec3 position = glm::vec3(0.0f);
+    // Around the y axis, from the x axis towards z
+    float angle = 0.0f;
+
+    /**
+     * @param angle A heading
+     * @return the unit vector pointing along it
+     */
+    static glm::vec3 facing(float angle);
+
+    /**
+     * @param direction Which way something points, along the ground
+     * @return its heading
+     */
+    static float headingOf(const glm::vec3& direction);
+
+    /**
+     * Move a tank by one update: along its heading, forward or back, then turn
+     * @param motion Where it starts
+     * @param input The controls held down
+     * @param speed The tank's speed, which both moves and turns it
+     * @param deltaTime The update's length
+     * @return where it ends up
+     */
+    static TankMotion step(const TankMotion& motion, const TankInput& input, float speed, float deltaTime);
+};
+
+#endif //TANKS_TANKMOTION_H
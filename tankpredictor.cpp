@@ -0,0 +1,107 @@
+#include "tankpredictor.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+
+/**
+ * @param angle An angle
+ * @return the same angle, between -pi and pi
+ */
+static float wrapAngle(float angle) {
+    return std::remainder(angle, glm::two_pi<float>());
+}
+
+TankPredictor::TankPredictor(float speed, float deltaTime) : speed(speed), deltaTime(deltaTime) {}
+
+void TankPredictor::predict(uint32_t sequence, const TankInput& input) {
+    Entry& entry = history[sequence % capacity];
+    entry.sequence = sequence;
+    entry.input = input;
+
+    if (active) {
+        current = TankMotion::step(current, input, speed, deltaTime);
+    }
+
+    entry.motion = current;
+    newest = sequence;
+}
+
+int TankPredictor::reconcile(const EntityState& state, uint32_t lastApplied) {
+    const Entry* applied = find(lastApplied);
+
+    // The snapshot's direction is the heading the tank started its last update with, before that update's
+    // input turned it, so turn it the same way
+    TankMotion base;
+    base.position = state.position;
+    base.angle = TankMotion::headingOf(state.direction);
+
+    if (applied) {
+        base.angle = TankMotion::step(base, applied->input, speed, deltaTime).angle;
+    }
+
+    // The server agrees with what was predicted for that input, so everything since still holds
+    if (active && applied && glm::length(applied->motion.position - base.position) <= matchTolerance &&
+        std::abs(wrapAngle(applied->motion.angle - base.angle)) <= matchTolerance) {
+        lastCorrection = 0.0f;
+        return 0;
+    }
+
+    TankMotion replayed = base;
+    int replays = 0;
+
+    // Inputs the server had dropped can't be replayed, so start again from where it has the tank
+    if (applied) {
+        for(uint32_t sequence = lastApplied + 1; sequence <= newest; sequence++) {
+            Entry& entry = history[sequence % capacity];
+            replayed = TankMotion::step(replayed, entry.input, speed, deltaTime);
+            entry.motion = replayed;
+            replays++;
+        }
+    }
+
+    // A new tank starts where it is. Otherwise draw it where it was, and let the difference fade
+    if (!active) {
+        offset = TankMotion();
+        lastCorrection = 0.0f;
+    } else {
+        offset.position += current.position - replayed.position;
+        offset.angle = wrapAngle(offset.angle + current.angle - replayed.angle);
+        lastCorrection = glm::length(current.position - replayed.position);
+    }
+
+    current = replayed;
+    active = true;
+
+    if (glm::length(offset.position) > snapDistance) {
+        offset = TankMotion();
+    }
+
+    return replays;
+}
+
+void TankPredictor::smooth(float seconds) {
+    float remaining = std::exp2(-seconds / smoothingHalfLife);
+    offset.position *= remaining;
+    offset.angle *= remaining;
+}
+
+void TankPredictor::stop() {
+    active = false;
+    offset = TankMotion();
+}
+
+TankMotion TankPredictor::getMotion() const {
+    return TankMotion{current.position + offset.position, current.angle + offset.angle};
+}
+
+const TankPredictor::Entry* TankPredictor::find(uint32_t sequence) const {
+    // Older than what's kept, or newer than anything predicted
+    if (sequence == 0 || newest - sequence >= capacity || sequence > newest) {
+        return nullptr;
+    }
+
+    const Entry& entry = history[sequence % capacity];
+    return entry.sequence == sequence ? &entry : nullptr;
+}
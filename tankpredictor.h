@@ -0,0 +1,113 @@
+#ifndef TANKS_TANKPREDICTOR_H
+#define TANKS_TANKPREDICTOR_H
+
+#include "snapshot.h"
+#include "tankmotion.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Predicts a client's own tank ahead of the server, so it moves the moment a key is pressed instead of a
+ * round trip later.
+ *
+ * Every client tick, the controls are numbered, kept, and applied to the predicted tank with the same
+ * TankMotion::step the server's PlayerTank uses, and where it left the tank is kept with it. When a snapshot
+ * arrives, it says where the server has the tank, and which numbered input it applied last. If that's where
+ * the prediction had it after the same input, which is the usual case, there's nothing to do. Otherwise the
+ * prediction rewinds to the server's state and replays every input since, which is usually a round trip's
+ * worth of ticks, and a few dozen at worst.
+ *
+ * Whatever the replay changes (from a collision the client didn't see, a lost input, or the server repeating
+ * an input that arrived late) becomes an offset on what's drawn, which fades out over a tenth of a second or
+ * so, instead of the tank jumping. A correction too big to hide is taken at once.
+ *
+ * Collisions and shots aren't predicted: the tank only moves and turns here, and the server has the last word.
+ */
+class TankPredictor {
+public:
+    /**
+     * @param speed The tank's speed
+     * @param deltaTime How far each tick moves the game on, the same as the server's
+     */
+    TankPredictor(float speed, float deltaTime);
+
+    /**
+     * Keep the controls for one tick, and move the predicted tank by them
+     * @param sequence The input's number, one more than the last
+     * @param input The controls held down
+     */
+    void predict(uint32_t sequence, const TankInput& input);
+
+    /**
+     * Rewind to where the server has the tank, and replay the inputs it hasn't applied yet
+     * @param state The tank, in the server's newest snapshot
+     * @param lastApplied The number of the last input the server applied, or 0 for none
+     * @return how many inputs were replayed, 0 if the prediction was right
+     */
+    int reconcile(const EntityState& state, uint32_t lastApplied);
+
+    /**
+     * Fade the correction offset out
+     * @param seconds How much real time has passed
+     */
+    void smooth(float seconds);
+
+    /** Forget the tank, for when it's destroyed. The next reconcile starts again from the server's state */
+    void stop();
+
+    /** @return whether there's a tank being predicted */
+    bool isActive() const { return active; }
+
+    /** @return where the tank should be drawn: the prediction, plus what's left of the correction offset */
+    TankMotion getMotion() const;
+
+    /** @return where the newest input puts the tank, without the offset */
+    const TankMotion& getPredicted() const { return current; }
+
+    /** @return how far the last reconcile moved the prediction, 0 if it agreed */
+    float getLastCorrection() const { return lastCorrection; }
+
+    // How many inputs are kept. Any more unacknowledged than this, about two seconds' worth, and the
+    // prediction just starts again from the server's state
+    static const size_t constexpr capacity = 128;
+
+    // How long the correction offset takes to halve, in seconds
+    static const float constexpr smoothingHalfLife = 0.05f;
+
+    // How close the server's state has to be to the prediction to count as the same, in units and radians. Floats
+    // rounding differently on the two ends drift apart by about a ten thousandth over a few seconds, and
+    // snapshots round positions to within a quarter of that (see Quantization)
+    static const float constexpr matchTolerance = 1e-3f;
+
+    // A correction further than this is taken at once, since sliding across the map would look worse
+    static const float constexpr snapDistance = 2.0f;
+
+private:
+    /** One tick's input, and where the prediction had the tank after it */
+    struct Entry {
+        uint32_t sequence = 0;
+        TankInput input;
+        TankMotion motion;
+    };
+
+    /**
+     * @param sequence An input's number
+     * @return it, or nullptr if it's no longer (or not yet) kept
+     */
+    const Entry* find(uint32_t sequence) const;
+
+    float speed;
+    float deltaTime;
+
+    std::array<Entry, capacity> history;
+    uint32_t newest = 0;
+
+    bool active = false;
+    TankMotion current;
+    TankMotion offset;
+    float lastCorrection = 0.0f;
+};
+
+#endif //TANKS_TANKPREDICTOR_H
@@ -5,7 +5,11 @@
 #include <QJsonObject>
 #include <QFile>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <unordered_map>
 
 Texture::Texture() : texture(0) {
     QOpenGLExtraFunctions::initializeOpenGLFunctions();
@@ -39,20 +43,41 @@ unsigned int Texture::handle() {
 }
 
 Texture Texture::fromFile(const std::filesystem::path& path) {
+    return fromImage(decodeImage(path));
+}
+
+Texture Texture::cubemapFromFolder(const std::filesystem::path& path) {
+    std::vector<QImage> images;
+
+    for(const auto& face : cubemapFaces(path)) {
+        images.push_back(decodeImage(face.path, face.flipHorizontal, face.flipVertical));
+    }
+
+    return cubemapFromImages(images);
+}
+
+Texture Texture::fromImage(const QImage& image) {
     Texture t;
     t.textype = GL_TEXTURE_2D;
-    t.loadTex(path);
+    t.loadTex(image);
     return t;
 }
 
-Texture Texture::cubemapFromFolder(const std::filesystem::path& path) {
+Texture Texture::cubemapFromImages(const std::vector<QImage>& faces) {
     Texture t;
     t.textype = GL_TEXTURE_CUBE_MAP;
-    t.loadCubemap(path);
+    t.loadCubemap(faces);
+    return t;
+}
+
+Texture Texture::arrayFromImages(const std::vector<QImage>& layers, int extraLayers) {
+    Texture t;
+    t.textype = GL_TEXTURE_2D_ARRAY;
+    t.loadArray(layers, extraLayers);
     return t;
 }
 
-void Texture::loadTex(const std::filesystem::path& path) {
+QImage Texture::decodeImage(const std::filesystem::path& path, bool flipHorizontal, bool flipVertical) {
     // Use QT to load the image
     QImage image(QString::fromStdString(path.string()));
     if (image.isNull()) {
@@ -62,8 +87,10 @@ void Texture::loadTex(const std::filesystem::path& path) {
     }
 
     // OpenGL requires specific data formatting
-    QImage glImage = image.mirrored().convertToFormat(QImage::Format_RGBA8888);
+    return image.mirrored(flipHorizontal, flipVertical).convertToFormat(QImage::Format_RGBA8888);
+}
 
+void Texture::loadTex(const QImage& glImage) {
     // Generate a texture
     glGenTextures(1, &texture);
     glBindTexture(textype, texture);
@@ -114,13 +141,11 @@ bool cubmapFaceCompare(const std::filesystem::path& a, const std::filesystem::pa
     return cubemapFaceOrder(a) < cubemapFaceOrder(b);
 }
 
-void Texture::loadCubemap(const std::filesystem::path& path) {
+std::vector<Texture::CubemapFace> Texture::cubemapFaces(const std::filesystem::path& path) {
     if (!is_directory(path)) {
         throw std::runtime_error("Cubemaps must be a directory containing exactly six images and one optional meta.json file");
     }
 
-    QFile* metafile = nullptr;
-    QByteArray metabytes;
     QJsonDocument meta;
     std::vector<std::filesystem::path> images;
 
@@ -129,16 +154,14 @@ void Texture::loadCubemap(const std::filesystem::path& path) {
             auto imgpath = entry.path();
 
             if (imgpath.extension() == ".json") {
-                metafile = new QFile(imgpath);
+                QFile metafile(QString::fromStdString(imgpath.string()));
 
-                if (!metafile->open(QIODevice::ReadOnly | QIODevice::Text)) {
-                    delete metafile;
+                if (!metafile.open(QIODevice::ReadOnly | QIODevice::Text)) {
                     std::cerr << "Renderer: failed to open cubemap json metafile: " << imgpath << "\n";
                     continue;
                 }
 
-                metabytes = metafile->readAll();
-                meta = QJsonDocument::fromJson(metabytes);
+                meta = QJsonDocument::fromJson(metafile.readAll());
             }
             else {
                 images.push_back(entry.path());
@@ -152,34 +175,18 @@ void Texture::loadCubemap(const std::filesystem::path& path) {
 
     std::sort(images.begin(), images.end(), cubmapFaceCompare);
 
-    // Generate a texture
-    glGenTextures(1, &texture);
-    glBindTexture(textype, texture);
+    std::vector<CubemapFace> faces;
 
-    for(size_t i = 0; i < images.size(); i++) {
-        const auto& imgpath = images[i];
-
-        // Use QT to load the image
-        QImage image(QString::fromStdString(imgpath.string()));
-        if (image.isNull()) {
-            std::string msg = "Renderer: Failed to load cubemap image ";
-            msg += ": ";
-            msg += imgpath.string();
-
-            glDeleteTextures(1, &texture);
-
-            throw std::runtime_error(msg);
-        }
-
-
-        bool flipHorizontal = true;
-        bool flipVertical = false;
+    for(const auto& imgpath : images) {
+        CubemapFace face;
+        face.path = imgpath;
 
         if (meta.isObject()) {
             auto mainobj = meta.object();
+            QString stem = QString::fromStdString(imgpath.stem().string());
 
-            if (mainobj.contains(imgpath.stem().c_str())) {
-                auto faceobjvalue = mainobj.value(imgpath.stem().c_str());
+            if (mainobj.contains(stem)) {
+                auto faceobjvalue = mainobj.value(stem);
 
                 if (faceobjvalue.isObject()) {
                     auto faceobj = faceobjvalue.toObject();
@@ -187,14 +194,29 @@ void Texture::loadCubemap(const std::filesystem::path& path) {
                     auto fh = faceobj.value("flipHorizontal");
                     auto fv = faceobj.value("flipVertical");
 
-                    if (fh.isBool()) { flipHorizontal = fh.toBool(); }
-                    if (fv.isBool()) { flipVertical = fv.toBool(); }
+                    if (fh.isBool()) { face.flipHorizontal = fh.toBool(); }
+                    if (fv.isBool()) { face.flipVertical = fv.toBool(); }
                 }
             }
         }
 
-        // OpenGL requires specific data formatting
-        QImage glImage = image.mirrored(flipHorizontal, flipVertical).convertToFormat(QImage::Format_RGBA8888);
+        faces.push_back(face);
+    }
+
+    return faces;
+}
+
+void Texture::loadCubemap(const std::vector<QImage>& faces) {
+    if (faces.size() != 6) {
+        throw std::runtime_error("Cubemaps must have exactly six faces");
+    }
+
+    // Generate a texture
+    glGenTextures(1, &texture);
+    glBindTexture(textype, texture);
+
+    for(size_t i = 0; i < faces.size(); i++) {
+        const QImage& glImage = faces[i];
 
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, glImage.width(), glImage.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, glImage.bits());
     }
@@ -204,8 +226,55 @@ void Texture::loadCubemap(const std::filesystem::path& path) {
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    delete metafile;
 }
 
+void Texture::loadArray(const std::vector<QImage>& layers, int extraLayers) {
+    if (layers.empty()) {
+        throw std::runtime_error("Texture arrays must have at least one layer");
+    }
+
+    // Use the most common size, so the fewest images need scaling. Ties go to the larger size
+    std::map<std::pair<int, int>, int> sizeCounts;
+    for(const auto& layer : layers) {
+        sizeCounts[{layer.width(), layer.height()}]++;
+    }
+
+    auto size = std::max_element(sizeCounts.begin(), sizeCounts.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second < b.second : a.first < b.first;
+    })->first;
+
+    int width = size.first;
+    int height = size.second;
+    int levels = 1 + (int)std::floor(std::log2(std::max(width, height)));
 
+    // Generate a texture
+    glGenTextures(1, &texture);
+    glBindTexture(textype, texture);
+
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, width, height, (GLsizei)layers.size() + extraLayers);
+
+    for(size_t i = 0; i < layers.size(); i++) {
+        const QImage* glImage = &layers[i];
+        QImage scaled;
+
+        if (glImage->width() != width || glImage->height() != height) {
+            std::cerr << "Renderer: scaling a " << glImage->width() << "x" << glImage->height()
+                      << " texture to " << width << "x" << height << " to fit the texture array\n";
+
+            scaled = glImage->scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                             .convertToFormat(QImage::Format_RGBA8888);
+            glImage = &scaled;
+        }
+
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, glImage->constBits());
+    }
+
+    // Unlike a regular texture, the mipmaps are actually used: arrays hold the impostors of distant
+    // objects, which would shimmer badly sampled from the full size image
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
@@ -2,11 +2,13 @@
 #define TANKS_TEXTURE_H
 
 #include <QOpenGLExtraFunctions>
+#include <QImage>
 
 #include <filesystem>
+#include <vector>
 
 /**
- * Handles loading a 2D texture or cubemap from disk, storing its
+ * Handles loading a 2D texture, cubemap or 2D texture array from disk, storing its
  * type and GPU resource handles, and cleaning them up when destroyed.
  * The class is not copyable, but it is movable with std::move
  *
@@ -16,9 +18,17 @@ class Texture : private QOpenGLExtraFunctions {
     GLenum textype;
     unsigned int texture;
 
-    void loadTex(const std::filesystem::path& path);
-    void loadCubemap(const std::filesystem::path& path);
+    void loadTex(const QImage& image);
+    void loadCubemap(const std::vector<QImage>& faces);
+    void loadArray(const std::vector<QImage>& layers, int extraLayers);
 public:
+    /** One face of a cubemap: which image it is, and how it needs flipping */
+    struct CubemapFace {
+        std::filesystem::path path;
+        bool flipHorizontal = true;
+        bool flipVertical = false;
+    };
+
     Texture();
     Texture(const Texture& other) = delete;
     Texture(Texture&& other);
@@ -37,6 +47,44 @@ public:
 
     /** Load a cubemap from a folder containing exactly 6 images, and up to one optional json metadata file */
     static Texture cubemapFromFolder(const std::filesystem::path& path);
+
+    /**
+     * Decode an image file and convert it into the layout OpenGL expects. This does no GL work,
+     * so it is safe to call from any thread
+     * @param path The image to load
+     * @param flipHorizontal Whether to mirror the image left to right
+     * @param flipVertical Whether to mirror the image top to bottom (GL's origin is the bottom left)
+     * @return the decoded RGBA8888 image
+     * @throws std::runtime_error if the image can't be loaded
+     */
+    static QImage decodeImage(const std::filesystem::path& path, bool flipHorizontal = false, bool flipVertical = true);
+
+    /**
+     * Work out which images make up a cubemap, sorted into GL's face order, and how each one
+     * needs flipping (from the optional meta.json). Does no decoding or GL work
+     * @param path The cubemap's folder
+     * @return the six faces
+     * @throws std::runtime_error if the folder isn't a valid cubemap
+     */
+    static std::vector<CubemapFace> cubemapFaces(const std::filesystem::path& path);
+
+    /** Upload an image that has already been through decodeImage as a regular texture */
+    static Texture fromImage(const QImage& image);
+
+    /** Upload six images that have already been through decodeImage as a cubemap, in GL's face order */
+    static Texture cubemapFromImages(const std::vector<QImage>& faces);
+
+    /**
+     * Pack images that have already been through decodeImage into the layers of one GL_TEXTURE_2D_ARRAY,
+     * so that everything drawn with any of them can share a single texture binding. Every layer of an
+     * array has the same size, so the layers take the most common size among the images and any image
+     * of a different size is scaled to fit
+     * @param layers The images, in layer order
+     * @param extraLayers How many more layers to leave empty after the images, to be rendered into later
+     * @return the texture array
+     * @throws std::runtime_error if there are no images
+     */
+    static Texture arrayFromImages(const std::vector<QImage>& layers, int extraLayers = 0);
 };
 
 #endif //TANKS_TEXTURE_H
@@ -0,0 +1,87 @@
+// tanks_meshopt: runs every model through the mesh optimization pipeline offline, and reports what it
+// saves, for each level of detail the game loads of it. With --bake it also writes the results into the
+// mesh cache, so the game's first launch is warm.
+//
+// Usage: tanks_meshopt [--bake] [models folder, default assets/models]
+
+#include <QCoreApplication>
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "meshcache.h"
+#include "meshdata.h"
+#include "meshoptimizer.h"
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    bool bake = false;
+    std::filesystem::path folder = "assets/models";
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--bake") { bake = true; }
+        else { folder = arg; }
+    }
+
+    if (!std::filesystem::is_directory(folder)) {
+        std::cerr << "tanks_meshopt: No such folder: " << folder << "\n";
+        return 1;
+    }
+
+    std::printf("%-16s %4s %7s %9s %9s %9s %9s %8s %8s %6s %6s\n",
+                "model", "lod", "tris", "verts", "verts'", "bytes", "bytes'", "vs", "vs'", "acmr", "acmr'");
+
+    size_t totalBefore = 0;
+    size_t totalAfter = 0;
+    int failures = 0;
+
+    for(const auto& entry : std::filesystem::directory_iterator(folder)) {
+        if (!entry.is_regular_file()) { continue; }
+
+        const auto& path = entry.path();
+
+        try {
+            // Imported once, and every level made from that. Only the levels the game loads are made
+            MeshData imported = MeshData::fromFile(path);
+            uint32_t levels = MeshOptimizer::levelCountFor(path.stem().string());
+
+            for(uint32_t lod = 0; lod < levels; lod++) {
+                MeshOptimizationReport report;
+                PackedMesh packed = MeshCache::bake(imported, lod, &report);
+
+                std::printf("%-16s %4u %7u %9u %9u %9zu %9zu %8u %8u %6.2f %6.2f\n",
+                            path.stem().string().c_str(), lod, report.triangles,
+                            report.verticesBefore, report.verticesAfter,
+                            report.bytesBefore, report.bytesAfter,
+                            report.invocationsBefore, report.invocationsAfter,
+                            report.acmrBefore(), report.acmrAfter());
+
+                // Only the full detail mesh counts towards the totals, since that's what the pipeline saves on
+                if (lod == 0) {
+                    totalBefore += report.bytesBefore;
+                    totalAfter += report.bytesAfter;
+                }
+
+                if (bake && !MeshCache::write(packed.view(), path, MeshCache::blobPath(path, lod))) {
+                    std::cerr << "tanks_meshopt: Failed to bake " << path << " lod " << lod << "\n";
+                    failures++;
+                }
+            }
+        }
+        catch (std::exception& ex) {
+            std::cerr << "tanks_meshopt: " << ex.what() << "\n";
+            failures++;
+        }
+    }
+
+    // Packing can grow a model that was already tight, so this can come out negative
+    long long saved = (long long)totalBefore - (long long)totalAfter;
+    std::printf("\nTotal: %zu bytes -> %zu bytes (saved %lld)\n", totalBefore, totalAfter, saved);
+
+    return failures == 0 ? 0 : 1;
+}
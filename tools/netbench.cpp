@@ -0,0 +1,216 @@
+// tanks_net_bench: measures how many messages a second get through the game's network framing. First the
+// MessageParser on its own, splitting messages out of a stream fed to it from memory in TCP segment sized
+// chunks, which is the framing's own cost. Then two NetworkManagers over a loopback TCP connection, which
+// adds the sockets and the event loop.
+//
+// Every message carries its sequence number and a pattern filling the rest, which the receiving end checks,
+// so a framing bug shows up as a failure rather than a fast number.
+//
+// Usage: tanks_net_bench [--messages n] [--size bytes] [--chunk bytes]
+//
+// Exits with 1 if any message arrives damaged, out of order or not at all.
+
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTimer>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "NetworkManager.h"
+#include "messageframe.h"
+#include "toolhelpers.h"
+
+// The type every benchmark message is sent as
+static const uint8_t constexpr benchMessageType = 1;
+
+// How long the loopback run may take before it's given up on, in milliseconds
+static const int constexpr loopbackTimeout = 60000;
+
+/**
+ * @param message A received message
+ * @param sequence The sequence number it should have
+ * @param size The size it should be
+ * @return whether it's the message that was sent
+ */
+static bool checkMessage(const MessageView& message, uint32_t sequence, size_t size) {
+    if (message.type != benchMessageType || message.size != size) {
+        return false;
+    }
+
+    uint32_t received;
+    std::memcpy(&received, message.data, sizeof(received));
+
+    if (received != sequence) {
+        return false;
+    }
+
+    for(size_t i = sizeof(sequence); i < size; i++) {
+        if (message.data[i] != (uint8_t)(sequence + i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Print a run's throughput
+ * @param name What was measured
+ * @param messages How many messages got through
+ * @param bytes How many bytes they took on the wire
+ * @param seconds How long it took
+ */
+static void report(const char* name, size_t messages, size_t bytes, double seconds) {
+    std::printf("%-10s %10zu %10.3f %14.0f %10.1f\n", name, messages, seconds * 1000.0,
+                messages / seconds, bytes / seconds / (1024.0 * 1024.0));
+}
+
+/**
+ * Parse a stream of messages from memory
+ * @param stream The framed messages
+ * @param messages How many there are
+ * @param size Each one's payload size
+ * @param chunk How many bytes to feed the parser at once
+ * @return false if any message didn't come out as it went in
+ */
+static bool benchParser(const std::vector<uint8_t>& stream, size_t messages, size_t size, size_t chunk) {
+    MessageParser parser;
+    uint32_t sequence = 0;
+    bool intact = true;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(size_t position = 0; position < stream.size(); position += chunk) {
+        size_t bytes = std::min(chunk, stream.size() - position);
+        std::memcpy(parser.prepare(bytes), stream.data() + position, bytes);
+        parser.commit(bytes);
+
+        MessageView message;
+        while (parser.next(message)) {
+            intact = checkMessage(message, sequence++, size) && intact;
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    report("parser", sequence, stream.size(), std::chrono::duration<double>(end - start).count());
+    return intact && sequence == messages && !parser.failed();
+}
+
+/**
+ * Send messages from one NetworkManager to another, over loopback
+ * @param app The application, whose event loop runs the connection
+ * @param stream The framed messages, for counting the bytes sent
+ * @param payloads Each message's payload
+ * @return false if any message didn't arrive as it was sent
+ */
+static bool benchLoopback(QCoreApplication& app, const std::vector<uint8_t>& stream,
+                          const std::vector<std::vector<uint8_t>>& payloads) {
+    QTcpServer server;
+
+    if (!server.listen(QHostAddress::LocalHost, 0)) {
+        std::cerr << "tanks_net_bench: Failed to listen on loopback: " << server.errorString().toStdString() << "\n";
+        return false;
+    }
+
+    NetworkManager sender;
+    NetworkManager* receiver = nullptr;
+    uint32_t sequence = 0;
+    bool intact = true;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start;
+
+    QObject::connect(&server, &QTcpServer::newConnection, [&]() {
+        receiver = new NetworkManager(server.nextPendingConnection(), &server);
+
+        QObject::connect(receiver, &NetworkManager::messageReceived, [&](const MessageView& message) {
+            intact = checkMessage(message, sequence, payloads[0].size()) && intact;
+
+            if (++sequence == payloads.size()) {
+                end = std::chrono::steady_clock::now();
+                app.quit();
+            }
+        });
+
+        QObject::connect(receiver, &NetworkManager::errorOccurred, [&](const QString& error) {
+            std::cerr << "tanks_net_bench: Receiver: " << error.toStdString() << "\n";
+            app.quit();
+        });
+    });
+
+    QObject::connect(&sender, &NetworkManager::connected, [&]() {
+        start = std::chrono::steady_clock::now();
+
+        for(const auto& payload : payloads) {
+            sender.send(benchMessageType, payload.data(), payload.size());
+        }
+    });
+
+    QObject::connect(&sender, &NetworkManager::errorOccurred, [&](const QString& error) {
+        std::cerr << "tanks_net_bench: Sender: " << error.toStdString() << "\n";
+        app.quit();
+    });
+
+    QTimer::singleShot(loopbackTimeout, &app, [&]() {
+        std::cerr << "tanks_net_bench: Timed out with " << sequence << " of " << payloads.size() << " messages received\n";
+        app.quit();
+    });
+
+    sender.connectToServer(QStringLiteral("127.0.0.1"), server.serverPort());
+    app.exec();
+
+    if (sequence == payloads.size()) {
+        report("loopback", sequence, stream.size(), std::chrono::duration<double>(end - start).count());
+    }
+
+    return intact && sequence == payloads.size();
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    size_t messages = 200000;
+    size_t size = 64;
+    // About one TCP segment on ethernet
+    size_t chunk = 1460;
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--messages" && hasValue) { messages = std::max(1, std::stoi(argv[++i])); }
+        else if (arg == "--size" && hasValue) { size = std::clamp<size_t>(std::stoul(argv[++i]), 4, MessageFrame::maxMessageSize); }
+        else if (arg == "--chunk" && hasValue) { chunk = std::max(1, std::stoi(argv[++i])); }
+        else {
+            std::cerr << "Usage: tanks_net_bench [--messages n] [--size bytes] [--chunk bytes]\n";
+            return 1;
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> payloads(messages, std::vector<uint8_t>(size));
+    std::vector<uint8_t> stream;
+
+    for(size_t i = 0; i < messages; i++) {
+        fillPayload(payloads[i], (uint32_t)i);
+        MessageFrame::append(stream, benchMessageType, payloads[i].data(), size);
+    }
+
+    std::printf("%zu messages of %zu bytes, %zu bytes framed\n\n", messages, size, stream.size());
+    std::printf("%-10s %10s %10s %14s %10s\n", "run", "messages", "ms", "messages/s", "MiB/s");
+
+    bool passed = benchParser(stream, messages, size, chunk);
+    passed = benchLoopback(app, stream, payloads) && passed;
+
+    if (!passed) {
+        std::printf("\nFAILED: messages were lost or damaged\n");
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,335 @@
+// tanks_render_bench: renders a level without a window, on a QOffscreenSurface and a framebuffer object,
+// so renderer performance can be measured on machines with no display or GPU (Mesa's llvmpipe works).
+// It replays a fixed camera path through every camera mode, and reports CPU frame time, GPU time
+// (per pass, from the renderer's own timer queries), draw calls and triangles for each.
+//
+// The last frame of each mode is hashed and compared against a golden image, so optimization work
+// can't silently change what's drawn. Golden images are only comparable on the driver that made
+// them, so regenerate them with --update-golden when moving to a different machine or Mesa version.
+//
+// The quality tier is fixed (to "high" unless --quality says otherwise), since the governor changing it
+// part way through would make both the timings and the golden images meaningless.
+//
+// With --capture, every frame is also recorded through the renderer's frame capture, into one folder
+// per mode, so the capture's cost shows up in the timings (and its output can be checked headless).
+//
+// Usage: tanks_render_bench [--level name] [--frames n] [--size WxH] [--golden folder] [--update-golden]
+//                           [--capture folder] [--quality tier]
+//
+// Exits with 1 if any frame doesn't match its golden image, or has none (unless --update-golden made it).
+
+#include <QApplication>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "diskcache.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "scene.h"
+#include "toolhelpers.h"
+
+struct BenchMode {
+    Renderer::CameraMode mode;
+    const char* name;
+};
+
+static const BenchMode benchModes[] = {
+    {Renderer::CameraMode::Static, "static"},
+    {Renderer::CameraMode::Orbiting, "orbiting"},
+    {Renderer::CameraMode::Chasing, "chasing"},
+    {Renderer::CameraMode::Periscope, "periscope"},
+};
+
+/** The timings and counters collected for one camera mode */
+struct ModeResult {
+    std::vector<double> cpuMilliseconds;
+    Renderer::FrameStats stats;
+};
+
+/**
+ * @param values The samples
+ * @return their average
+ */
+static double average(const std::vector<double>& values) {
+    if (values.empty()) { return 0.0; }
+
+    double sum = 0.0;
+    for(double value : values) { sum += value; }
+    return sum / values.size();
+}
+
+/**
+ * @param image The frame, in RGBA8888
+ * @return a hash of its pixels
+ */
+static uint64_t hashImage(const QImage& image) {
+    uint64_t hash = DiskCache::hashSeed;
+
+    // Hash row by row, since rows may be padded
+    for(int y = 0; y < image.height(); y++) {
+        hash = DiskCache::hash(image.constScanLine(y), (size_t)image.width() * 4, hash);
+    }
+
+    return hash;
+}
+
+/**
+ * Compare a frame against its golden image, or replace the golden image
+ * @param frame The rendered frame
+ * @param path The golden image's file
+ * @param update Whether to write the frame as the new golden image instead of comparing
+ * @return false if the frame doesn't match, or there's no golden image to match
+ */
+static bool checkGolden(const QImage& frame, const std::filesystem::path& path, bool update) {
+    uint64_t frameHash = hashImage(frame);
+
+    if (update) {
+        std::filesystem::create_directories(path.parent_path());
+
+        if (!frame.save(QString::fromStdString(path.string()))) {
+            std::cerr << "tanks_render_bench: Failed to write " << path << "\n";
+            return false;
+        }
+
+        std::printf("  wrote %s (%016llx)\n", path.string().c_str(), (unsigned long long)frameHash);
+        return true;
+    }
+
+    QImage golden(QString::fromStdString(path.string()));
+
+    if (golden.isNull()) {
+        std::printf("  MISSING %s (%016llx): run with --update-golden to create it\n",
+                    path.string().c_str(), (unsigned long long)frameHash);
+        return false;
+    }
+
+    golden = golden.convertToFormat(QImage::Format_RGBA8888);
+    uint64_t goldenHash = hashImage(golden);
+
+    if (golden.size() == frame.size() && goldenHash == frameHash) {
+        std::printf("  matches %s (%016llx)\n", path.string().c_str(), (unsigned long long)frameHash);
+        return true;
+    }
+
+    if (golden.size() != frame.size()) {
+        std::printf("  MISMATCH %s: golden is %dx%d, frame is %dx%d\n", path.string().c_str(),
+                    golden.width(), golden.height(), frame.width(), frame.height());
+        return false;
+    }
+
+    // Say how far off it is, to tell a broken frame from a rounding difference
+    size_t differentPixels = 0;
+    int largestDifference = 0;
+
+    for(int y = 0; y < frame.height(); y++) {
+        const uchar* a = frame.constScanLine(y);
+        const uchar* b = golden.constScanLine(y);
+
+        for(int x = 0; x < frame.width(); x++) {
+            int difference = 0;
+
+            for(int c = 0; c < 4; c++) {
+                difference = std::max(difference, std::abs(a[x * 4 + c] - b[x * 4 + c]));
+            }
+
+            if (difference > 0) { differentPixels++; }
+            largestDifference = std::max(largestDifference, difference);
+        }
+    }
+
+    std::printf("  MISMATCH %s (%016llx, golden %016llx): %zu pixels differ, by up to %d\n",
+                path.string().c_str(), (unsigned long long)frameHash, (unsigned long long)goldenHash,
+                differentPixels, largestDifference);
+    return false;
+}
+
+int main(int argc, char** argv) {
+    // There's no display on the build farm, so default to Qt's offscreen platform
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    std::string level = "level_0";
+    int framesPerMode = 120;
+    int width = 1280;
+    int height = 720;
+    std::filesystem::path goldenFolder = "golden";
+    bool updateGolden = false;
+    std::filesystem::path captureFolder;
+    std::string quality = "high";
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--level" && hasValue) { level = argv[++i]; }
+        else if (arg == "--frames" && hasValue) { framesPerMode = std::max(1, std::stoi(argv[++i])); }
+        else if (arg == "--size" && hasValue && std::sscanf(argv[++i], "%dx%d", &width, &height) == 2) {}
+        else if (arg == "--golden" && hasValue) { goldenFolder = argv[++i]; }
+        else if (arg == "--update-golden") { updateGolden = true; }
+        else if (arg == "--capture" && hasValue) { captureFolder = argv[++i]; }
+        else if (arg == "--quality" && hasValue) { quality = argv[++i]; }
+        else {
+            std::cerr << "Usage: tanks_render_bench [--level name] [--frames n] [--size WxH] [--golden folder] [--update-golden] [--capture folder] [--quality tier]\n";
+            return 1;
+        }
+    }
+
+    // The renderer's shaders are GLSL 4.50
+    QSurfaceFormat format;
+    format.setVersion(4, 5);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setDepthBufferSize(24);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+
+    if (!context.create()) {
+        std::cerr << "tanks_render_bench: Failed to create a GL 4.5 context\n";
+        return 1;
+    }
+
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+
+    if (!context.makeCurrent(&surface)) {
+        std::cerr << "tanks_render_bench: Failed to make the GL context current\n";
+        return 1;
+    }
+
+    QOpenGLExtraFunctions* gl = context.extraFunctions();
+
+    std::printf("GL: %s, %s\n", (const char*)gl->glGetString(GL_RENDERER), (const char*)gl->glGetString(GL_VERSION));
+    std::printf("Quality: %s\n", quality.c_str());
+
+    bool passed = true;
+
+    {
+        QOpenGLFramebufferObject fbo(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+        fbo.bind();
+        gl->glViewport(0, 0, width, height);
+
+        Scene* scene = Scene::getInstance();
+        scene->reset();
+        scene->load(level);
+        scene->start();
+
+        // The renderer is never shown; its GL entry points are called directly with our context current
+        auto renderer = std::make_unique<Renderer>();
+
+        if (!renderer->setQualityTier(quality)) {
+            std::cerr << "tanks_render_bench: No quality tier named " << quality << "\n";
+            return 1;
+        }
+
+        renderer->initializeGL();
+        renderer->resizeGL(width, height);
+        renderer->buildStaticBatch(scene);
+
+        GameObject* player = scene->getGameObject(GameObjectType::PlayerTank);
+
+        std::printf("\n%-10s %8s %8s %8s %8s %8s %8s %8s %8s %7s %7s %9s\n",
+                    "mode", "cpu avg", "cpu p50", "cpu p95", "cpu max",
+                    "gpu avg", "ground", "opaque", "skybox", "draws", "cmds", "tris");
+
+        std::vector<std::pair<std::string, QImage>> finalFrames;
+
+        for(const auto& benchMode : benchModes) {
+            renderer->setCameraMode(benchMode.mode);
+
+            if (!captureFolder.empty()) {
+                renderer->startCapture(captureFolder / benchMode.name);
+            }
+
+            Profiler::getInstance()->resetTimings();
+            ModeResult result;
+
+            for(int frame = 0; frame < framesPerMode; frame++) {
+                // The camera path: the orbiting camera moves on its own, and turning the player
+                // through a full circle sweeps the chasing and periscope cameras around the level
+                if (player) {
+                    float angle = glm::two_pi<float>() * (float)frame / (float)framesPerMode;
+                    player->setDirection(glm::vec3(std::sin(angle), 0.0f, -std::cos(angle)));
+                }
+
+                auto start = std::chrono::steady_clock::now();
+
+                for(const GameObject* object : *scene) {
+                    renderer->drawObject(object);
+                }
+
+                renderer->doneWithFrame();
+                renderer->paintGL();
+
+                auto end = std::chrono::steady_clock::now();
+
+                result.cpuMilliseconds.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+                result.stats = renderer->getFrameStats();
+            }
+
+            // The GPU timings arrive a few frames late, so wait for the rest before reading them
+            renderer->flushGpuTimings();
+            auto timings = Profiler::getInstance()->getTimings();
+
+            std::printf("%-10s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %7zu %7zu %9zu\n", benchMode.name,
+                        average(result.cpuMilliseconds),
+                        percentile(result.cpuMilliseconds, 0.5),
+                        percentile(result.cpuMilliseconds, 0.95),
+                        percentile(result.cpuMilliseconds, 1.0),
+                        timings["gpu frame"].mean(),
+                        timings["gpu ground"].mean(),
+                        timings["gpu opaque"].mean(),
+                        timings["gpu skybox"].mean(),
+                        result.stats.drawCalls,
+                        result.stats.commands,
+                        result.stats.triangles);
+
+            finalFrames.emplace_back(benchMode.name, fbo.toImage().convertToFormat(QImage::Format_RGBA8888));
+
+            // The capture only stops at the start of a paint, so do one more, untimed, to finish this
+            // mode's recording outside the next mode's timings
+            if (!captureFolder.empty()) {
+                renderer->stopCapture();
+                renderer->paintGL();
+            }
+        }
+
+        std::printf("\n");
+
+        for(const auto& [name, image] : finalFrames) {
+            // Each tier draws differently, so has golden images of its own. "high" keeps the original names
+            std::string tier = quality == "high" ? "" : "_" + quality;
+            auto path = goldenFolder / (level + "_" + name + tier + ".png");
+            passed = checkGolden(image, path, updateGolden) && passed;
+        }
+
+        // The renderer's GL objects have to go while the context is still current
+        renderer.reset();
+        scene->reset();
+        fbo.release();
+    }
+
+    context.doneCurrent();
+
+    return passed ? 0 : 1;
+}
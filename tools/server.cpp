@@ -0,0 +1,42 @@
+// tanks_server: the dedicated game server. It runs a level headless, with no window, audio or GPU, and
+// plays it for every client that connects, sending each of them snapshots of what happens (see GameServer).
+//
+// Usage: tanks_server [--level name] [--port n]
+
+#include <QCoreApplication>
+
+#include <iostream>
+#include <string>
+
+#include "gameserver.h"
+#include "netprotocol.h"
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    std::string level = "level_0";
+    int port = NetProtocol::defaultPort;
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--level" && hasValue) { level = argv[++i]; }
+        else if (arg == "--port" && hasValue) { port = std::stoi(argv[++i]); }
+        else {
+            std::cerr << "Usage: tanks_server [--level name] [--port n]\n";
+            return 1;
+        }
+    }
+
+    GameServer server;
+
+    if (!server.start(level, (quint16)port)) {
+        return 1;
+    }
+
+    std::cout << "tanks_server: Running " << level << " on port " << server.getPort()
+              << " at " << GameServer::tickRate << " ticks a second" << std::endl;
+
+    return app.exec();
+}
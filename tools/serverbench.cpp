@@ -0,0 +1,251 @@
+// tanks_server_bench: runs a GameServer and a crowd of bot clients in one process, over loopback, and
+// reports what the server costs at each player count: CPU time per tick, and the snapshot bandwidth each
+// client receives, next to how many objects there are and how many of them each client is sent (see
+// InterestSet). The bots drive around and fire at random, from a fixed seed.
+//
+// It also reports how well the bots predicted their own tanks: the share of snapshots that disagreed with
+// the prediction, how many inputs each of those replayed, and how far the prediction moved on average.
+//
+// Every snapshot a bot decodes is compared against the view the server picked for it, so a bug in the delta
+// encoding shows up as a failure rather than as a small number.
+//
+// Before any of that it checks that every spawn point, the ones past half way round the circle included,
+// starts its tank facing the middle of the map, the way the server points them.
+//
+// Usage: tanks_server_bench [--level name] [--players n,n,...] [--seconds s]
+//
+// Exits with 1 if any bot decoded a snapshot differently from the server, or never got one, or a tank
+// spawned facing the wrong way.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "audioengine.h"
+#include "gameclient.h"
+#include "gameserver.h"
+#include "toolhelpers.h"
+
+// How long every bot has to connect and receive its first snapshot, in milliseconds
+static const int constexpr connectTimeout = 10000;
+
+// The chance a bot changes what it's doing on any one tick, so they hold their controls for about half a second
+static const double constexpr changeChance = 1.0 / 30.0;
+
+/** One simulated player */
+struct Bot {
+    std::unique_ptr<GameClient> client;
+    std::mt19937 random;
+    quint64 bytesAtStart = 0;
+    quint64 snapshotsAtStart = 0;
+    GameClient::PredictionStats predictionAtStart;
+};
+
+/**
+ * Put a tank at every spawn point, facing the middle the way GameServer::spawn does, and check it still
+ * faces there once it has updated from its heading
+ * @return false, after printing which, if any spawn point's tank faced elsewhere
+ */
+static bool checkSpawnHeadings() {
+    bool passed = true;
+
+    for(size_t slot = 0; slot < GameServer::maxClients; slot++) {
+        glm::vec3 position = GameServer::spawnPoint(slot);
+        glm::vec3 middle = glm::normalize(-position);
+
+        PlayerTank tank(0, position, middle);
+        tank.doUpdate(0.0f);
+
+        if (glm::dot(tank.getDirection(), middle) < 0.999f) {
+            std::cerr << "tanks_server_bench: The tank at spawn point " << slot << " doesn't face the middle\n";
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+/**
+ * Pick a bot's next controls at random, mostly driving forward
+ * @param random The bot's random numbers
+ * @return the controls
+ */
+static TankInput randomInput(std::mt19937& random) {
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    TankInput input;
+
+    input.forward = chance(random) < 0.7;
+    input.back = !input.forward && chance(random) < 0.3;
+    input.left = chance(random) < 0.3;
+    input.right = !input.left && chance(random) < 0.3;
+    input.fire = chance(random) < 0.3;
+    return input;
+}
+
+/**
+ * Play one player count, and print a row of results
+ * @param level The level to play
+ * @param players How many bots
+ * @param seconds How long to measure for, after they've all joined
+ * @return false if a bot decoded a wrong snapshot, or never got one
+ */
+static bool benchPlayers(const std::string& level, int players, double seconds) {
+    GameServer server;
+
+    if (!server.start(level, 0)) {
+        return false;
+    }
+
+    std::vector<double> tickMilliseconds;
+    bool measuring = false;
+
+    QObject::connect(&server, &GameServer::ticked, [&](quint32, double milliseconds) {
+        if (measuring) { tickMilliseconds.push_back(milliseconds); }
+    });
+
+    std::vector<Bot> bots(players);
+    size_t mismatches = 0;
+
+    for(int i = 0; i < players; i++) {
+        Bot& bot = bots[i];
+        bot.client = std::make_unique<GameClient>();
+        bot.random.seed(i + 1);
+
+        GameClient* client = bot.client.get();
+        std::mt19937* random = &bot.random;
+
+        QObject::connect(client, &GameClient::snapshotReceived, [&server, &mismatches, client, random](const Snapshot& snapshot) {
+            // The server still has it unless the bot is more than a second behind
+            if (const Snapshot* sent = server.findView(client->getClientId(), snapshot.tick)) {
+                if (!(*sent == snapshot)) { mismatches++; }
+            }
+
+            if (std::uniform_real_distribution<double>(0.0, 1.0)(*random) < changeChance) {
+                client->setInput(randomInput(*random));
+            }
+        });
+
+        client->connectToServer(QStringLiteral("127.0.0.1"), server.getPort());
+    }
+
+    bool joined = runUntil([&]() {
+        return std::all_of(bots.begin(), bots.end(), [](const Bot& bot) { return bot.client->getSnapshot() != nullptr; });
+    }, connectTimeout);
+
+    if (!joined) {
+        std::cerr << "tanks_server_bench: Not every bot received a snapshot within " << connectTimeout << " ms\n";
+        return false;
+    }
+
+    for(Bot& bot : bots) {
+        bot.bytesAtStart = bot.client->getSnapshotBytesReceived();
+        bot.snapshotsAtStart = bot.client->getSnapshotsReceived();
+        bot.predictionAtStart = bot.client->getPredictionStats();
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    measuring = true;
+
+    runUntil([]() { return false; }, (int)(seconds * 1000.0));
+
+    measuring = false;
+    double measured = elapsed.elapsed() / 1000.0;
+
+    quint64 bytes = 0;
+    quint64 snapshots = 0;
+    GameClient::PredictionStats prediction;
+
+    for(const Bot& bot : bots) {
+        bytes += bot.client->getSnapshotBytesReceived() - bot.bytesAtStart;
+        snapshots += bot.client->getSnapshotsReceived() - bot.snapshotsAtStart;
+
+        const GameClient::PredictionStats& stats = bot.client->getPredictionStats();
+        prediction.reconciles += stats.reconciles - bot.predictionAtStart.reconciles;
+        prediction.mispredictions += stats.mispredictions - bot.predictionAtStart.mispredictions;
+        prediction.replayed += stats.replayed - bot.predictionAtStart.replayed;
+        prediction.correction += stats.correction - bot.predictionAtStart.correction;
+    }
+
+    double mispredicted = prediction.reconciles > 0 ? 100.0 * prediction.mispredictions / prediction.reconciles : 0.0;
+    double replays = prediction.mispredictions > 0 ? (double)prediction.replayed / prediction.mispredictions : 0.0;
+    double correction = prediction.mispredictions > 0 ? prediction.correction / prediction.mispredictions : 0.0;
+
+    double kilobytesPerClient = bytes / 1024.0 / players / measured;
+    double bytesPerSnapshot = snapshots > 0 ? (double)bytes / snapshots : 0.0;
+    double tickAverage = 0.0;
+
+    for(double milliseconds : tickMilliseconds) { tickAverage += milliseconds; }
+    if (!tickMilliseconds.empty()) { tickAverage /= tickMilliseconds.size(); }
+
+    size_t objects = server.getHistory().latest() ? server.getHistory().latest()->entities.size() : 0;
+    double inView = 0.0;
+
+    for(const Bot& bot : bots) { inView += bot.client->getSnapshot()->entities.size(); }
+    inView /= players;
+
+    std::printf("%7d %7zu %7.1f %7zu %9.3f %9.3f %9.3f %11.2f %10.1f %9.1f%% %8.1f %8.3f %10zu\n", players, objects,
+                inView, tickMilliseconds.size(), tickAverage, percentile(tickMilliseconds, 0.95), percentile(tickMilliseconds, 1.0),
+                kilobytesPerClient, bytesPerSnapshot, mispredicted, replays, correction, mismatches);
+
+    // Let the bots go before the server, so it sees them leave
+    bots.clear();
+    runUntil([]() { return false; }, 100);
+    server.stop();
+
+    return mismatches == 0;
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    std::string level = "level_0";
+    std::vector<int> playerCounts = {2, 8, 32};
+    double seconds = 10.0;
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--level" && hasValue) { level = argv[++i]; }
+        else if (arg == "--seconds" && hasValue) { seconds = std::max(0.1, std::stod(argv[++i])); }
+        else if (arg == "--players" && hasValue) {
+            playerCounts.clear();
+            std::stringstream list(argv[++i]);
+            std::string count;
+
+            while (std::getline(list, count, ',')) {
+                playerCounts.push_back(std::clamp(std::stoi(count), 1, (int)GameServer::maxClients));
+            }
+        }
+        else {
+            std::cerr << "Usage: tanks_server_bench [--level name] [--players n,n,...] [--seconds s]\n";
+            return 1;
+        }
+    }
+
+    // Nobody's listening, and the tanks have sound effects
+    AudioEngine::disableOutput();
+    bool passed = checkSpawnHeadings();
+
+    std::printf("Level %s, %d ticks a second, %.1f s per player count\n\n", level.c_str(), GameServer::tickRate, seconds);
+    std::printf("%7s %7s %7s %7s %9s %9s %9s %11s %10s %10s %8s %8s %10s\n", "players", "objects", "in view", "ticks",
+                "tick avg", "tick p95", "tick max", "KiB/s each", "B/snap", "mispred", "replays", "corr", "mismatches");
+
+    for(int players : playerCounts) {
+        passed = benchPlayers(level, players, seconds) && passed;
+    }
+
+    return passed ? 0 : 1;
+}
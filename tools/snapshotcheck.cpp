@@ -0,0 +1,313 @@
+// tanks_snapshot_check: round trips made up snapshots through the quantised, bit packed delta encoding
+// (snapshot.h, quantization.h), at several precisions, and checks:
+//
+// - a whole snapshot of unrounded states decodes to within the precision's error bounds: half a step of
+//   fixed point for x and z, half a step of yaw for directions, and exactly for anything sent as floats
+// - rounding a state twice changes nothing, so what the server keeps is what it sends
+// - a delta of rounded states, with some objects moved, turned, added and removed, decodes exactly
+// - every truncated delta is rejected, rather than read past its end
+//
+// and reports the bytes each object costs: new in a whole snapshot, and moved and turned in a delta.
+// Most objects are on the map and flat on it, like the game's; the rest are off it, the way projectiles
+// fly past the edge, so the exact fallback is covered too.
+//
+// Usage: tanks_snapshot_check [--objects n] [--map x,z] [--seed n]
+//
+// Exits with 1 if any of that doesn't hold.
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "snapshot.h"
+
+// The precisions to try: position bits, then yaw bits. The game's default is the third
+static const int constexpr precisions[][2] = {{8, 8}, {12, 10}, {16, 16}, {20, 20}, {Quantization::maxBits, Quantization::maxBits}};
+
+// The share of objects off the map, or off the plane, which go as floats
+static const double constexpr offMapShare = 0.1;
+
+// The share of objects the second delta moves and turns, and adds and removes a quarter as many
+static const double constexpr changeShare = 0.3;
+
+/** What one precision did */
+struct Result {
+    float positionError = 0.0f;
+    float yawError = 0.0f;
+    double wholeBytes = 0.0;
+    double movedBytes = 0.0;
+    size_t failures = 0;
+};
+
+/**
+ * @param magnitude The size of a value
+ * @return how far from exact float rounding alone can leave a value that size, on top of the precision's bound
+ */
+static float floatSlack(float magnitude) {
+    return 2.0f * magnitude * FLT_EPSILON;
+}
+
+/**
+ * @param direction A flat direction
+ * @return its yaw
+ */
+static float yawOf(const glm::vec3& direction) {
+    return std::atan2(direction.z, direction.x);
+}
+
+/**
+ * @param random Random numbers
+ * @param quantization The map's size
+ * @param id Its entity id
+ * @return a made up object, usually on the map and flat on it
+ */
+static EntityState randomState(std::mt19937& random, const Quantization& quantization, uint32_t id) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(-glm::pi<float>(), glm::pi<float>());
+
+    EntityState state;
+    state.id = id;
+    state.type = (GameObjectType)(random() % NUM_GAME_OBJECT_TYPES);
+    state.position = glm::vec3((unit(random) - 0.5f) * quantization.xLength, 0.0f, (unit(random) - 0.5f) * quantization.zLength);
+
+    float yaw = angle(random);
+    state.direction = glm::vec3(std::cos(yaw), 0.0f, std::sin(yaw));
+
+    if (unit(random) < offMapShare) {
+        state.position.x += quantization.xLength * (unit(random) < 0.5f ? 1.0f : -1.0f);
+    }
+
+    if (unit(random) < offMapShare) {
+        state.position.y = unit(random);
+        state.direction = glm::normalize(state.direction + glm::vec3(0.0f, 0.5f, 0.0f));
+    }
+
+    return state;
+}
+
+/**
+ * Check a decoded object against the one sent, within the precision
+ * @param sent The object sent
+ * @param decoded What came out
+ * @param quantization The precision
+ * @param result Where to keep the worst errors, and count failures
+ */
+static void checkBounds(const EntityState& sent, const EntityState& decoded, const Quantization& quantization, Result& result) {
+    if (sent.id != decoded.id || sent.type != decoded.type) {
+        result.failures++;
+        return;
+    }
+
+    if (quantization.fitsGrid(sent.position)) {
+        float error = std::max(std::abs(sent.position.x - decoded.position.x), std::abs(sent.position.z - decoded.position.z));
+        result.positionError = std::max(result.positionError, error);
+        float slack = floatSlack(0.5f * std::max(quantization.xLength, quantization.zLength));
+        if (error > quantization.getPositionError() + slack || decoded.position.y != 0.0f) { result.failures++; }
+    } else if (sent.position != decoded.position) {
+        result.failures++;
+    }
+
+    if (Quantization::isFlat(sent.direction)) {
+        float error = std::abs(std::remainder(yawOf(sent.direction) - yawOf(decoded.direction), glm::two_pi<float>()));
+        result.yawError = std::max(result.yawError, error);
+        if (error > quantization.getYawError() + floatSlack(glm::pi<float>()) || !Quantization::isFlat(decoded.direction)) { result.failures++; }
+    } else if (sent.direction != decoded.direction) {
+        result.failures++;
+    }
+}
+
+/**
+ * @param delta A delta
+ * @param baseline What it builds on
+ * @return how many of its truncations readDelta accepted, which should be none
+ */
+static size_t acceptedTruncations(const std::vector<uint8_t>& delta, const Snapshot* baseline) {
+    Snapshot decoded;
+    size_t accepted = 0;
+
+    for(size_t size = 0; size < delta.size(); size++) {
+        if (Snapshot::readDelta(baseline, delta.data(), size, decoded)) { accepted++; }
+    }
+
+    return accepted;
+}
+
+/**
+ * @param random Random numbers
+ * @param state An object, rounded
+ * @param quantization The precision
+ * @return it moved a little and turned a little, and rounded again
+ */
+static EntityState nudged(std::mt19937& random, const EntityState& state, const Quantization& quantization) {
+    std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+    EntityState next = state;
+
+    next.position.x += offset(random);
+    next.position.z += offset(random);
+
+    float yaw = yawOf(next.direction) + offset(random);
+    next.direction = glm::normalize(glm::vec3(std::cos(yaw), next.direction.y, std::sin(yaw)));
+
+    quantization.round(next);
+    return next;
+}
+
+/**
+ * Check a delta between rounded snapshots comes back exactly, and can't be read truncated
+ * @param baseline What it builds on
+ * @param current What it says
+ * @param delta Where to write it
+ * @param result Where to count failures
+ */
+static void checkDelta(const Snapshot& baseline, const Snapshot& current, std::vector<uint8_t>& delta, Result& result) {
+    Snapshot decoded;
+    Snapshot::writeDelta(&baseline, current, delta);
+
+    if (!Snapshot::readDelta(&baseline, delta.data(), delta.size(), decoded) || !(decoded == current)) {
+        result.failures++;
+    }
+
+    result.failures += acceptedTruncations(delta, &baseline);
+}
+
+/**
+ * Round trip snapshots at one precision
+ * @param quantization The precision, and the map's size
+ * @param objects How many objects
+ * @param seed The random numbers' seed
+ * @return what happened
+ */
+static Result check(const Quantization& quantization, size_t objects, unsigned seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    Result result;
+
+    Snapshot sent;
+    sent.tick = 1;
+    sent.quantization = quantization;
+
+    for(size_t i = 0; i < objects; i++) {
+        sent.entities.push_back(randomState(random, quantization, (uint32_t)(i * 2 + 1)));
+    }
+
+    // A whole snapshot, unrounded, comes back within the bounds
+    std::vector<uint8_t> delta;
+    Snapshot decoded;
+    Snapshot::writeDelta(nullptr, sent, delta);
+    result.wholeBytes = (double)delta.size() / objects;
+
+    if (!Snapshot::readDelta(nullptr, delta.data(), delta.size(), decoded) || decoded.entities.size() != objects ||
+        !(decoded.quantization == quantization)) {
+        result.failures++;
+        return result;
+    }
+
+    for(size_t i = 0; i < objects; i++) {
+        checkBounds(sent.entities[i], decoded.entities[i], quantization, result);
+    }
+
+    result.failures += acceptedTruncations(delta, nullptr);
+
+    // Rounding is stable, as the server relies on
+    Snapshot baseline = sent;
+
+    for(EntityState& state : baseline.entities) {
+        quantization.round(state);
+        EntityState again = state;
+        quantization.round(again);
+        if (!(again == state)) { result.failures++; }
+    }
+
+    // Move and turn everything, and the delta comes back exactly
+    Snapshot current;
+    current.tick = 2;
+    current.quantization = quantization;
+
+    for(const EntityState& state : baseline.entities) {
+        current.entities.push_back(nudged(random, state, quantization));
+    }
+
+    checkDelta(baseline, current, delta, result);
+    result.movedBytes = (double)delta.size() / objects;
+
+    // Then change some, and add and remove others
+    current.entities.clear();
+    uint32_t nextId = (uint32_t)(objects * 2 + 1);
+
+    for(const EntityState& state : baseline.entities) {
+        double roll = unit(random);
+
+        if (roll < changeShare / 4) {
+            continue;
+        }
+
+        current.entities.push_back(roll < changeShare ? nudged(random, state, quantization) : state);
+    }
+
+    for(size_t i = 0; i < objects * changeShare / 4; i++) {
+        current.entities.push_back(randomState(random, quantization, nextId++));
+        quantization.round(current.entities.back());
+    }
+
+    checkDelta(baseline, current, delta, result);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    size_t objects = 1000;
+    Quantization map = Quantization::forMap(30.0, 30.0);
+    unsigned seed = 1;
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--objects" && hasValue) { objects = std::clamp<size_t>(std::stoul(argv[++i]), 1, 100000); }
+        else if (arg == "--seed" && hasValue) { seed = (unsigned)std::stoul(argv[++i]); }
+        else if (arg == "--map" && hasValue) {
+            std::string lengths = argv[++i];
+            size_t comma = lengths.find(',');
+            map.xLength = std::max(0.1f, std::stof(lengths.substr(0, comma)));
+            map.zLength = comma == std::string::npos ? map.xLength : std::max(0.1f, std::stof(lengths.substr(comma + 1)));
+        }
+        else {
+            std::cerr << "Usage: tanks_snapshot_check [--objects n] [--map x,z] [--seed n]\n";
+            return 1;
+        }
+    }
+
+    std::printf("%zu objects on a %.1f by %.1f map, %.0f%% of them off it\n\n", objects, map.xLength, map.zLength,
+                offMapShare * 100.0);
+    std::printf("%9s %9s %12s %12s %12s %12s %10s %10s %9s\n", "pos bits", "yaw bits", "pos error", "pos bound",
+                "yaw error", "yaw bound", "B/new", "B/moved", "failures");
+
+    bool passed = true;
+
+    for(const auto& precision : precisions) {
+        Quantization quantization = map;
+        quantization.positionBits = (uint8_t)precision[0];
+        quantization.yawBits = (uint8_t)precision[1];
+
+        Result result = check(quantization, objects, seed);
+
+        std::printf("%9d %9d %12.3g %12.3g %12.3g %12.3g %10.2f %10.2f %9zu\n", precision[0], precision[1],
+                    result.positionError, quantization.getPositionError(), result.yawError, quantization.getYawError(),
+                    result.wholeBytes, result.movedBytes, result.failures);
+
+        passed = passed && result.failures == 0;
+    }
+
+    if (!passed) {
+        std::printf("\nFAILED: a snapshot decoded outside its bounds, differently, or from a truncated delta\n");
+    }
+
+    return passed ? 0 : 1;
+}
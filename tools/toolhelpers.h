@@ -0,0 +1,65 @@
+#ifndef TANKS_TOOLHELPERS_H
+#define TANKS_TOOLHELPERS_H
+
+// Small helpers shared by the benchmark and check tools in tools/. Header only, since each tool is a
+// single file built on its own
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+/**
+ * @param values The samples, which get sorted
+ * @param fraction Which percentile, from 0 to 1
+ * @return the sample at that percentile
+ */
+inline double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) { return 0.0; }
+
+    std::sort(values.begin(), values.end());
+    auto index = (size_t)std::min<double>(values.size() - 1, std::round(fraction * (values.size() - 1)));
+    return values[index];
+}
+
+/**
+ * Run the event loop until something's true, or for too long. It sleeps until the next event, so
+ * something has to be due soon, like a timer, for the time limit to be noticed
+ * @param done Whether to stop
+ * @param milliseconds The longest to wait
+ * @return whether done came true
+ */
+inline bool runUntil(const std::function<bool()>& done, int milliseconds) {
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    while (!done()) {
+        if (elapsed.elapsed() >= milliseconds) {
+            return false;
+        }
+
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    return true;
+}
+
+/**
+ * Fill a message's payload: its sequence number, then bytes that depend on it
+ * @param payload The payload, at least 4 bytes
+ * @param sequence The message's sequence number
+ */
+inline void fillPayload(std::vector<uint8_t>& payload, uint32_t sequence) {
+    std::memcpy(payload.data(), &sequence, sizeof(sequence));
+
+    for(size_t i = sizeof(sequence); i < payload.size(); i++) {
+        payload[i] = (uint8_t)(sequence + i);
+    }
+}
+
+#endif //TANKS_TOOLHELPERS_H
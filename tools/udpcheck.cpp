@@ -0,0 +1,227 @@
+// tanks_udp_check: runs two UdpTransports against each other over 127.0.0.1, one as a server and one as a
+// client, with a share of the packets each way thrown away on purpose, and checks what GameServer and
+// GameClient rely on from it:
+//
+// - every reliable message arrives, exactly once and in the order it was sent, in both directions
+// - an unreliable message never arrives after a newer one, and never damaged
+//
+// The server sends a snapshot sized unreliable message and a reliable one every tick, like GameServer with
+// its events, and the client answers each tick with a reliable one, like GameClient's inputs. Once the
+// sending stops, the reliable channel has a few seconds to deliver what's still outstanding.
+//
+// Usage: tanks_udp_check [--seconds s] [--loss fraction] [--size bytes]
+//
+// Exits with 1 if any of that doesn't hold.
+
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "toolhelpers.h"
+#include "udptransport.h"
+
+// The type the unreliable, snapshot like messages are sent as
+static const uint8_t constexpr unreliableType = 1;
+
+// The type the reliable messages are sent as
+static const uint8_t constexpr reliableType = 2;
+
+// How many ticks a second, the same as the server's
+static const int constexpr tickRate = 60;
+
+// How long connecting, and delivering what's outstanding at the end, may each take, in milliseconds
+static const int constexpr settleTimeout = 10000;
+
+/** What one end has received, and whether it was right */
+struct Received {
+    uint32_t reliable = 0;
+    uint32_t unreliable = 0;
+    uint32_t newestUnreliable = 0;
+    size_t outOfOrder = 0;
+    size_t backwards = 0;
+    size_t damaged = 0;
+};
+
+/**
+ * @param message A received message
+ * @param sequence Set to its sequence number
+ * @return whether the rest of it is the pattern fillPayload wrote
+ */
+static bool readPayload(const MessageView& message, uint32_t& sequence) {
+    if (message.size < sizeof(sequence)) {
+        return false;
+    }
+
+    std::memcpy(&sequence, message.data, sizeof(sequence));
+
+    for(size_t i = sizeof(sequence); i < message.size; i++) {
+        if (message.data[i] != (uint8_t)(sequence + i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Check a received message against what should have come before it
+ * @param received What the receiving end has had so far
+ * @param message The message
+ * @param reliable Whether it came on the reliable channel
+ */
+static void receive(Received& received, const MessageView& message, bool reliable) {
+    uint32_t sequence;
+
+    if (!readPayload(message, sequence) || message.type != (reliable ? reliableType : unreliableType)) {
+        received.damaged++;
+        return;
+    }
+
+    if (reliable) {
+        if (sequence != received.reliable) { received.outOfOrder++; }
+        received.reliable++;
+        return;
+    }
+
+    if (sequence <= received.newestUnreliable) { received.backwards++; }
+    received.newestUnreliable = sequence;
+    received.unreliable++;
+}
+
+/**
+ * Print one direction's results
+ * @param name Which direction
+ * @param reliableSent How many reliable messages were sent that way
+ * @param unreliableSent How many unreliable ones
+ * @param received What arrived
+ * @param sender The sending end's connection
+ */
+static void report(const char* name, uint32_t reliableSent, uint32_t unreliableSent, const Received& received,
+                   const UdpConnection& sender) {
+    double delivered = unreliableSent > 0 ? 100.0 * received.unreliable / unreliableSent : 0.0;
+
+    std::printf("%-16s %9u/%-9u %9u/%-9u %7.1f%% %9llu %9.2f %7zu %7zu %7zu\n", name,
+                received.reliable, reliableSent, received.unreliable, unreliableSent, delivered,
+                (unsigned long long)sender.getStats().reliableResent, sender.getRoundTripTime() * 1000.0,
+                received.outOfOrder, received.backwards, received.damaged);
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    double seconds = 5.0;
+    double loss = 0.2;
+    size_t size = 200;
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--seconds" && hasValue) { seconds = std::max(0.1, std::stod(argv[++i])); }
+        else if (arg == "--loss" && hasValue) { loss = std::clamp(std::stod(argv[++i]), 0.0, 0.9); }
+        else if (arg == "--size" && hasValue) { size = std::clamp<size_t>(std::stoul(argv[++i]), 4, UdpConnection::maxPacketSize / 2); }
+        else {
+            std::cerr << "Usage: tanks_udp_check [--seconds s] [--loss fraction] [--size bytes]\n";
+            return 1;
+        }
+    }
+
+    UdpTransport server;
+    UdpTransport client;
+
+    if (!server.listen(0)) {
+        return 1;
+    }
+
+    server.setSimulatedLoss(loss);
+    client.setSimulatedLoss(loss);
+
+    UdpTransport::PeerId clientPeer = UdpTransport::noPeer;
+    Received atServer;
+    Received atClient;
+
+    QObject::connect(&server, &UdpTransport::connected, [&](UdpTransport::PeerId peer) { clientPeer = peer; });
+    QObject::connect(&server, &UdpTransport::messageReceived, [&](UdpTransport::PeerId, const MessageView& message, bool reliable) {
+        receive(atServer, message, reliable);
+    });
+    QObject::connect(&client, &UdpTransport::messageReceived, [&](UdpTransport::PeerId, const MessageView& message, bool reliable) {
+        receive(atClient, message, reliable);
+    });
+
+    UdpTransport::PeerId serverPeer = client.connectTo(QHostAddress::LocalHost, server.getPort());
+
+    if (serverPeer == UdpTransport::noPeer || !runUntil([&]() { return clientPeer != UdpTransport::noPeer; }, settleTimeout)) {
+        std::cerr << "tanks_udp_check: The client never reached the server\n";
+        return 1;
+    }
+
+    uint32_t ticks = 0;
+    uint32_t serverReliable = 0;
+    uint32_t clientReliable = 0;
+    std::vector<uint8_t> snapshot(size);
+    std::vector<uint8_t> small(16);
+    bool windowFull = false;
+
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(1000 / tickRate);
+
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        ticks++;
+        fillPayload(snapshot, ticks);
+        server.sendUnreliable(clientPeer, unreliableType, snapshot.data(), snapshot.size());
+
+        fillPayload(small, serverReliable);
+        if (server.sendReliable(clientPeer, reliableType, small.data(), small.size())) { serverReliable++; }
+        else { windowFull = true; }
+
+        fillPayload(small, clientReliable);
+        if (client.sendReliable(serverPeer, reliableType, small.data(), small.size())) { clientReliable++; }
+        else { windowFull = true; }
+
+        server.flush();
+        client.flush();
+    });
+
+    std::printf("%.1f s at %d ticks a second, %.0f%% of packets lost each way, %zu byte snapshots\n\n",
+                seconds, tickRate, loss * 100.0, size);
+
+    ticker.start();
+    runUntil([]() { return false; }, (int)(seconds * 1000.0));
+    ticker.stop();
+
+    bool drained = runUntil([&]() {
+        return atClient.reliable >= serverReliable && atServer.reliable >= clientReliable;
+    }, settleTimeout);
+
+    std::printf("%-16s %19s %19s %8s %9s %9s %7s %7s %7s\n", "direction", "reliable", "unreliable", "arrived",
+                "resent", "rtt ms", "order", "back", "damaged");
+
+    const UdpConnection* toClient = server.getConnection(clientPeer);
+    const UdpConnection* toServer = client.getConnection(serverPeer);
+
+    if (toClient && toServer) {
+        report("server to client", serverReliable, ticks, atClient, *toClient);
+        report("client to server", clientReliable, 0, atServer, *toServer);
+    }
+
+    bool passed = drained && toClient && toServer && !windowFull &&
+                  atClient.outOfOrder + atClient.backwards + atClient.damaged == 0 &&
+                  atServer.outOfOrder + atServer.backwards + atServer.damaged == 0 &&
+                  atClient.reliable == serverReliable && atServer.reliable == clientReliable;
+
+    if (!passed) {
+        std::printf("\nFAILED: %s\n", !drained ? "reliable messages never arrived" :
+                                      windowFull ? "too many reliable messages went unacknowledged" :
+                                      "messages arrived out of order, twice, backwards or damaged");
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#ifndef TANKS_TRIPLEBUFFER_H
+#define TANKS_TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Three copies of a value, handed between one producer and one consumer without copying, locking
+ * or waiting. The producer fills its copy and publishes it by swapping it with the spare; the
+ * consumer takes the newest published copy by swapping its own with the spare. Nothing is ever
+ * copied, so a vector in here keeps its capacity from frame to frame.
+ *
+ * If the producer publishes twice before the consumer looks, the older copy is simply reused as the
+ * producer's next one, so the consumer always sees the latest. If it publishes nothing new, the
+ * consumer keeps what it has.
+ *
+ * Safe for one producer thread and one consumer thread, which may be the same thread.
+ *
+ *  // producer                         // consumer
+ *  buffer.write().push_back(x);        buffer.acquire();
+ *  buffer.publish();                   for(auto& x : buffer.read()) { ... }
+ *  buffer.write().clear();
+ */
+template<typename T>
+class TripleBuffer {
+    std::array<T, 3> buffers;
+
+    // The spare copy's index, with freshBit set if the producer has published it and the consumer
+    // hasn't taken it yet
+    std::atomic<uint32_t> spare{2};
+
+    // Only ever touched by the producer and the consumer respectively
+    uint32_t writing = 0;
+    uint32_t reading = 1;
+
+    static const uint32_t constexpr indexMask = 3;
+    static const uint32_t constexpr freshBit = 4;
+public:
+    /** @return the producer's copy, which it can change freely until the next publish */
+    T& write() { return buffers[writing]; }
+
+    /**
+     * Hand the producer's copy to the consumer. The producer gets an old copy back in its place,
+     * with whatever it held before, so it will usually want clearing
+     */
+    void publish() {
+        writing = spare.exchange(writing | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    /**
+     * Take the newest published copy, if there is one the consumer hasn't seen
+     * @return whether read() changed
+     */
+    bool acquire() {
+        if ((spare.load(std::memory_order_relaxed) & freshBit) == 0) {
+            return false;
+        }
+
+        reading = spare.exchange(reading, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    /** @return the consumer's copy, which stays the same until the next acquire */
+    const T& read() const { return buffers[reading]; }
+
+    /**
+     * Run something on all three copies, e.g. to reserve their capacity up front. Only safe while
+     * neither the producer nor the consumer is using the buffer
+     * @param function Called with each copy
+     */
+    template<typename Function>
+    void forEach(Function&& function) {
+        for(auto& buffer : buffers) {
+            function(buffer);
+        }
+    }
+};
+
+#endif //TANKS_TRIPLEBUFFER_H
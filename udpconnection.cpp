@@ -0,0 +1,389 @@
+#include "udpconnection.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Packet header flags
+enum PacketFlags : uint8_t {
+    // The other end is going away. Nothing else in the packet means anything
+    DISCONNECT_FLAG = 1 << 0,
+    // The ack fields are real. Until a packet has arrived there's nothing to acknowledge
+    ACK_FLAG = 1 << 1,
+};
+
+static void writeU16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t readU16(const uint8_t* data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static void writeU32(uint8_t* out, uint32_t value) {
+    for(int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static uint32_t readU32(const uint8_t* data) {
+    uint32_t value = 0;
+    for(int i = 0; i < 4; i++) {
+        value |= (uint32_t)data[i] << (i * 8);
+    }
+    return value;
+}
+
+/**
+ * Read one message framed as in MessageFrame, from a packet that's all there, so unlike MessageParser
+ * a message running off the end means the packet is malformed
+ * @param data Where the message starts
+ * @param available How much of the packet is left
+ * @param message Set to the message
+ * @return how many bytes it took, or 0 if it's malformed
+ */
+static size_t readFrame(const uint8_t* data, size_t available, MessageView& message) {
+    size_t size = 0;
+    size_t position = 0;
+
+    for(int shift = 0; ; shift += 7) {
+        if (position == available || position == MessageFrame::maxHeaderSize - 1) {
+            return 0;
+        }
+
+        uint8_t byte = data[position++];
+        size |= (size_t)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+
+    if (available - position < 1 + size) {
+        return 0;
+    }
+
+    message.type = data[position];
+    message.data = data + position + 1;
+    message.size = size;
+    return position + 1 + size;
+}
+
+UdpConnection::UdpConnection() {
+    reset(0.0);
+}
+
+void UdpConnection::reset(double now) {
+    nextSequence = 0;
+    sentPackets.fill(SentPacket());
+
+    for (ReliableMessage& message : outgoing) {
+        message.inUse = false;
+        message.data.clear();
+    }
+
+    nextReliableId = 0;
+    oldestUnacked = 0;
+    unreliable.clear();
+    unreliableStarts.clear();
+
+    receivedAny = false;
+    remoteSequence = 0;
+    receivedSequences.fill(-1);
+
+    for (ReliableMessage& message : incoming) {
+        message.inUse = false;
+        message.data.clear();
+    }
+
+    nextIncomingId = 0;
+
+    disconnected = false;
+    lastReceiveTime = now;
+    lastSendTime = now;
+    roundTripTime = 0.0;
+    stats = Stats();
+}
+
+bool UdpConnection::sendReliable(uint8_t type, const void* data, size_t size) {
+    if (getReliablePending() >= reliableWindow || size > maxReliableSize) {
+        return false;
+    }
+
+    ReliableMessage& message = outgoing[nextReliableId % reliableWindow];
+    message.id = nextReliableId;
+    message.inUse = true;
+    message.type = type;
+    message.lastSent = -1.0;
+    message.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+
+    nextReliableId++;
+    return true;
+}
+
+void UdpConnection::sendUnreliable(uint8_t type, const void* data, size_t size) {
+    unreliableStarts.push_back(unreliable.size());
+    MessageFrame::append(unreliable, type, data, size);
+}
+
+bool UdpConnection::writePacket(std::vector<uint8_t>& out, double now, bool force) {
+    out.assign(headerSize, 0);
+
+    SentPacket& record = sentPackets[nextSequence % sentPackets.size()];
+    record.sequence = nextSequence;
+    record.inUse = true;
+    record.acked = false;
+    record.sentTime = now;
+    record.reliableCount = 0;
+
+    // Reliable messages first, oldest first, so a long queue can't starve the one everything else waits on
+    double resendDelay = std::max(minResendDelay, 2.0 * roundTripTime);
+
+    for(uint16_t id = oldestUnacked; id != nextReliableId && record.reliableCount < record.reliableIds.size(); id++) {
+        ReliableMessage& message = outgoing[id % reliableWindow];
+
+        if (!message.inUse || (message.lastSent >= 0.0 && now - message.lastSent < resendDelay)) {
+            continue;
+        }
+
+        size_t payloadSize = 2 + message.data.size();
+        uint8_t header[MessageFrame::maxHeaderSize];
+        size_t frameHeaderSize = MessageFrame::writeHeader(header, message.type | reliableBit, payloadSize);
+
+        if (out.size() + frameHeaderSize + payloadSize > targetPacketSize) {
+            break;
+        }
+
+        uint8_t idBytes[2];
+        writeU16(idBytes, id);
+        out.insert(out.end(), header, header + frameHeaderSize);
+        out.insert(out.end(), idBytes, idBytes + 2);
+        out.insert(out.end(), message.data.begin(), message.data.end());
+
+        if (message.lastSent >= 0.0) {
+            stats.reliableResent++;
+        }
+
+        message.lastSent = now;
+        record.reliableIds[record.reliableCount++] = id;
+    }
+
+    // Then as many unreliable messages as fit. One too big for any normal packet gets one of its own
+    size_t taken = 0;
+
+    for(; taken < unreliableStarts.size(); taken++) {
+        size_t start = unreliableStarts[taken];
+        size_t end = taken + 1 < unreliableStarts.size() ? unreliableStarts[taken + 1] : unreliable.size();
+        bool alone = out.size() == headerSize;
+
+        if (out.size() + (end - start) > targetPacketSize && !(alone && headerSize + (end - start) <= maxPacketSize)) {
+            if (alone) {
+                // Too big for even a packet of its own, which sendUnreliable says not to do
+                continue;
+            }
+            break;
+        }
+
+        out.insert(out.end(), unreliable.begin() + start, unreliable.begin() + end);
+    }
+
+    if (taken == unreliableStarts.size()) {
+        unreliable.clear();
+        unreliableStarts.clear();
+    } else if (taken > 0) {
+        size_t consumed = unreliableStarts[taken];
+        unreliable.erase(unreliable.begin(), unreliable.begin() + consumed);
+        unreliableStarts.erase(unreliableStarts.begin(), unreliableStarts.begin() + taken);
+
+        for (size_t& start : unreliableStarts) { start -= consumed; }
+    }
+
+    if (out.size() == headerSize && !force) {
+        record.inUse = false;
+        out.clear();
+        return false;
+    }
+
+    // The newest packet received, and which of the 32 before it arrived
+    uint32_t ackBits = 0;
+
+    for(uint16_t i = 0; i < 32; i++) {
+        uint16_t sequence = remoteSequence - 1 - i;
+        if (receivedSequences[sequence % receivedSequences.size()] == sequence) {
+            ackBits |= 1u << i;
+        }
+    }
+
+    writeU16(out.data(), magic);
+    out[2] = receivedAny ? ACK_FLAG : 0;
+    writeU16(out.data() + 3, nextSequence);
+    writeU16(out.data() + 5, remoteSequence);
+    writeU32(out.data() + 7, ackBits);
+
+    nextSequence++;
+    lastSendTime = now;
+    stats.packetsSent++;
+    stats.bytesSent += out.size();
+    return true;
+}
+
+void UdpConnection::writeDisconnect(std::vector<uint8_t>& out) {
+    out.assign(headerSize, 0);
+    writeU16(out.data(), magic);
+    out[2] = DISCONNECT_FLAG;
+    writeU16(out.data() + 3, nextSequence);
+}
+
+bool UdpConnection::readPacket(const uint8_t* data, size_t size, double now, const Handler& handler) {
+    if (size < headerSize || readU16(data) != magic) {
+        return false;
+    }
+
+    uint8_t flags = data[2];
+
+    if (flags & DISCONNECT_FLAG) {
+        disconnected = true;
+        lastReceiveTime = now;
+        return true;
+    }
+
+    uint16_t sequence = readU16(data + 3);
+    size_t slot = sequence % receivedSequences.size();
+
+    // Already had it, or so old it's fallen out of what we can tell apart
+    if (receivedSequences[slot] == sequence) {
+        return false;
+    }
+
+    if (receivedAny && newer(remoteSequence, sequence) && (uint16_t)(remoteSequence - sequence) >= receivedSequences.size()) {
+        return false;
+    }
+
+    // Check every message is whole before acting on any, so a malformed packet is ignored rather than half read
+    MessageView message;
+
+    for(size_t position = headerSize; position < size; ) {
+        size_t length = readFrame(data + position, size - position, message);
+
+        if (length == 0 || ((message.type & reliableBit) && message.size < 2)) {
+            return false;
+        }
+
+        position += length;
+    }
+
+    stats.packetsReceived++;
+    stats.bytesReceived += size;
+    lastReceiveTime = now;
+
+    if (flags & ACK_FLAG) {
+        uint16_t acked = readU16(data + 5);
+        uint32_t ackBits = readU32(data + 7);
+
+        ack(acked, now);
+
+        for(uint16_t i = 0; i < 32; i++) {
+            if (ackBits & (1u << i)) {
+                ack(acked - 1 - i, now);
+            }
+        }
+    }
+
+    // Anything older than what's already arrived is out of date
+    bool stale = receivedAny && newer(remoteSequence, sequence);
+
+    if (!receivedAny || newer(sequence, remoteSequence)) {
+        // Forget the sequence numbers the window has moved past, so they aren't mistaken for duplicates when
+        // the numbers wrap around
+        uint16_t gap = receivedAny ? (uint16_t)(sequence - remoteSequence) : (uint16_t)receivedSequences.size();
+
+        if (gap >= receivedSequences.size()) {
+            receivedSequences.fill(-1);
+        } else {
+            for(uint16_t skipped = remoteSequence + 1; skipped != sequence; skipped++) {
+                receivedSequences[skipped % receivedSequences.size()] = -1;
+            }
+        }
+
+        remoteSequence = sequence;
+        receivedAny = true;
+    }
+
+    receivedSequences[slot] = sequence;
+
+    for(size_t position = headerSize; position < size; ) {
+        position += readFrame(data + position, size - position, message);
+
+        if (message.type & reliableBit) {
+            receiveReliable(message.type & ~reliableBit, message.data, message.size, handler);
+        } else if (stale) {
+            stats.staleDropped++;
+        } else {
+            handler(message, false);
+        }
+    }
+
+    return true;
+}
+
+void UdpConnection::ack(uint16_t sequence, double now) {
+    SentPacket& packet = sentPackets[sequence % sentPackets.size()];
+
+    if (!packet.inUse || packet.sequence != sequence || packet.acked) {
+        return;
+    }
+
+    packet.acked = true;
+    stats.packetsAcked++;
+
+    double sample = now - packet.sentTime;
+    roundTripTime = stats.packetsAcked == 1 ? sample : roundTripTime + 0.1 * (sample - roundTripTime);
+
+    for(uint8_t i = 0; i < packet.reliableCount; i++) {
+        ReliableMessage& message = outgoing[packet.reliableIds[i] % reliableWindow];
+
+        if (message.inUse && message.id == packet.reliableIds[i]) {
+            message.inUse = false;
+            message.data.clear();
+        }
+    }
+
+    while (oldestUnacked != nextReliableId && !outgoing[oldestUnacked % reliableWindow].inUse) {
+        oldestUnacked++;
+    }
+}
+
+void UdpConnection::receiveReliable(uint8_t type, const uint8_t* data, size_t size, const Handler& handler) {
+    uint16_t id = readU16(data);
+    uint16_t ahead = id - nextIncomingId;
+
+    // Delivered already, or further ahead than the sender is allowed to get
+    if (!newer(id, nextIncomingId - 1) || ahead >= reliableWindow) {
+        return;
+    }
+
+    if (ahead > 0) {
+        ReliableMessage& waiting = incoming[id % reliableWindow];
+
+        if (!waiting.inUse) {
+            waiting.id = id;
+            waiting.inUse = true;
+            waiting.type = type;
+            waiting.data.assign(data + 2, data + size);
+        }
+
+        return;
+    }
+
+    handler(MessageView{type, data + 2, size - 2}, true);
+    nextIncomingId++;
+
+    // And whatever was waiting on it
+    for(ReliableMessage* waiting = &incoming[nextIncomingId % reliableWindow];
+        waiting->inUse && waiting->id == nextIncomingId;
+        waiting = &incoming[nextIncomingId % reliableWindow]) {
+        waiting->inUse = false;
+        handler(MessageView{waiting->type, waiting->data.data(), waiting->data.size()}, true);
+        nextIncomingId++;
+    }
+}
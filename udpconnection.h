@@ -0,0 +1,219 @@
+#ifndef TANKS_UDPCONNECTION_H
+#define TANKS_UDPCONNECTION_H
+
+#include "messageframe.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * The state of one UDP connection, with no sockets: what's been sent and received, what needs acknowledging,
+ * and what needs sending again. UdpTransport owns one per peer and does the actual sending.
+ *
+ * Every packet has a 16 bit sequence number, and acknowledges the newest packet received from the other end
+ * along with a bitfield of the 32 before it. Acks ride on every packet, so as long as both ends keep talking
+ * (and UdpTransport sends a keep-alive when they don't), every packet is acknowledged several times over, and
+ * a lost ack almost never matters.
+ *
+ * On top of that there are two kinds of message:
+ *
+ * - Unreliable messages (snapshots) are sent once, and newest wins: a packet older than one already received
+ *   has its unreliable messages thrown away, so a late packet can never take the receiver back in time. A lost
+ *   one isn't sent again, since the next tick's will replace it anyway.
+ * - Reliable messages (inputs, and events like shots, deaths and level changes) each get a 16 bit id, and go
+ *   in every packet until one carrying them is acknowledged, at most every resend delay. The receiver
+ *   delivers them in id order, exactly once, holding back any that arrive ahead of a missing one. So one
+ *   lost packet only delays the reliable messages after it, never the snapshots.
+ *
+ * A packet is:
+ *
+ *  [magic, u16] [flags, u8] [sequence, u16] [ack, u16] [ack bits, u32]
+ *  then messages, framed as in MessageFrame. A reliable message's type has reliableBit set, and its payload
+ *  starts with its id, as a u16
+ *
+ * Numbers are little endian. Packets are filled up to targetPacketSize, which fits any network's MTU, but a
+ * single message bigger than that (a whole snapshot of a big battle) gets a packet of its own, up to
+ * maxPacketSize, and relies on IP fragmentation.
+ *
+ * Not thread safe. Times are in seconds, from any clock, as long as it's the same one throughout.
+ */
+class UdpConnection {
+public:
+    /**
+     * Called with each message received, in the order it should be handled
+     * @param message The message, with reliableBit cleared from its type. It points into the packet (or the
+     * connection's own buffer), so it's only valid during the call
+     * @param reliable Whether it came on the reliable channel
+     */
+    using Handler = std::function<void(const MessageView& message, bool reliable)>;
+
+    UdpConnection();
+
+    /**
+     * Queue a reliable message
+     * @param type Its type, below reliableBit
+     * @param data Its payload
+     * @param size Its size, at most maxReliableSize
+     * @return false if too many reliable messages are still unacknowledged, so it wasn't queued
+     */
+    bool sendReliable(uint8_t type, const void* data, size_t size);
+
+    /**
+     * Queue an unreliable message for the next packet
+     * @param type Its type, below reliableBit
+     * @param data Its payload
+     * @param size Its size, at most maxPacketSize less a header
+     */
+    void sendUnreliable(uint8_t type, const void* data, size_t size);
+
+    /**
+     * Write the next packet to send, with the queued unreliable messages and the reliable ones that are due
+     * @param out The packet, cleared first
+     * @param now The time
+     * @param force Whether to write a packet even with nothing in it but acks, as a keep-alive
+     * @return false if there was nothing to send (and force wasn't set), so out is empty
+     */
+    bool writePacket(std::vector<uint8_t>& out, double now, bool force);
+
+    /**
+     * Write a packet that tells the other end this one is going away
+     * @param out The packet, cleared first
+     */
+    void writeDisconnect(std::vector<uint8_t>& out);
+
+    /**
+     * Take in a received packet
+     * @param data The packet
+     * @param size Its size
+     * @param now The time
+     * @param handler Called with each message it delivers
+     * @return false if it isn't one of our packets, or it's a duplicate, so it was ignored
+     */
+    bool readPacket(const uint8_t* data, size_t size, double now, const Handler& handler);
+
+    /** @return whether the other end has said it's going away */
+    bool isDisconnected() const { return disconnected; }
+
+    /** @return when the last packet arrived, or when the connection was made */
+    double getLastReceiveTime() const { return lastReceiveTime; }
+
+    /** @return when the last packet was written */
+    double getLastSendTime() const { return lastSendTime; }
+
+    /** @return the smoothed round trip time, in seconds */
+    double getRoundTripTime() const { return roundTripTime; }
+
+    /** @return how many reliable messages are waiting to be acknowledged */
+    size_t getReliablePending() const { return (uint16_t)(nextReliableId - oldestUnacked); }
+
+    /**
+     * Start from scratch, for a new connection
+     * @param now The time
+     */
+    void reset(double now);
+
+    /** Counts of what's gone through the connection, for benchmarks */
+    struct Stats {
+        uint64_t packetsSent = 0;
+        uint64_t packetsReceived = 0;
+        uint64_t packetsAcked = 0;
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t reliableResent = 0;
+        // Unreliable messages thrown away for arriving after something newer
+        uint64_t staleDropped = 0;
+    };
+
+    const Stats& getStats() const { return stats; }
+
+    // Identifies our packets, so stray datagrams are ignored
+    static const uint16_t constexpr magic = 0x4b54;
+
+    // Packets are filled up to this, which fits inside any real network's MTU
+    static const size_t constexpr targetPacketSize = 1200;
+
+    // The largest packet, for a message too big for targetPacketSize
+    static const size_t constexpr maxPacketSize = 32 * 1024;
+
+    static const size_t constexpr headerSize = 11;
+
+    // Reliable messages have to fit in a normal packet, with their id
+    static const size_t constexpr maxReliableSize = targetPacketSize - headerSize - MessageFrame::maxHeaderSize - 2;
+
+    // Set in a message's type when it's reliable
+    static const uint8_t constexpr reliableBit = 0x80;
+
+    // How many reliable messages can be unacknowledged at once
+    static const size_t constexpr reliableWindow = 256;
+
+    // The shortest wait before a reliable message is sent again. It's also at least twice the round trip time
+    static const double constexpr minResendDelay = 0.1;
+
+private:
+    /** A packet we sent, and the reliable messages it carried, to mark them delivered when it's acknowledged */
+    struct SentPacket {
+        uint16_t sequence = 0;
+        bool inUse = false;
+        bool acked = false;
+        double sentTime = 0.0;
+        uint8_t reliableCount = 0;
+        std::array<uint16_t, 32> reliableIds{};
+    };
+
+    /** A reliable message, waiting for an ack on the way out, or for its turn on the way in */
+    struct ReliableMessage {
+        uint16_t id = 0;
+        bool inUse = false;
+        uint8_t type = 0;
+        double lastSent = -1.0;
+        std::vector<uint8_t> data;
+    };
+
+    /**
+     * Mark a packet we sent as delivered, and the reliable messages it carried
+     * @param sequence The packet's sequence number
+     * @param now The time
+     */
+    void ack(uint16_t sequence, double now);
+
+    /**
+     * Take in one reliable message, and deliver it and any it was holding back, if it's next. Duplicates
+     * are dropped
+     * @param type Its type, without reliableBit
+     * @param data Its payload, starting with its id
+     * @param size The payload's size, at least 2
+     * @param handler Called with each message delivered
+     */
+    void receiveReliable(uint8_t type, const uint8_t* data, size_t size, const Handler& handler);
+
+    /** @return whether sequence number a is newer than b, allowing for them wrapping around */
+    static bool newer(uint16_t a, uint16_t b) { return (int16_t)(a - b) > 0; }
+
+    // Sending
+    uint16_t nextSequence = 0;
+    std::array<SentPacket, 1024> sentPackets;
+    std::array<ReliableMessage, reliableWindow> outgoing;
+    uint16_t nextReliableId = 0;
+    uint16_t oldestUnacked = 0;
+    // Queued unreliable messages, already framed, and where each one starts
+    std::vector<uint8_t> unreliable;
+    std::vector<size_t> unreliableStarts;
+
+    // Receiving
+    bool receivedAny = false;
+    uint16_t remoteSequence = 0;
+    std::array<int32_t, 1024> receivedSequences;
+    std::array<ReliableMessage, reliableWindow> incoming;
+    uint16_t nextIncomingId = 0;
+
+    bool disconnected = false;
+    double lastReceiveTime = 0.0;
+    double lastSendTime = 0.0;
+    double roundTripTime = 0.0;
+    Stats stats;
+};
+
+#endif //TANKS_UDPCONNECTION_H
@@ -0,0 +1,260 @@
+#include "udptransport.h"
+
+#include <algorithm>
+#include <iostream>
+
+UdpTransport::UdpTransport(QObject *parent) : QObject(parent), lossRandom(1) {
+    timer.setInterval(serviceInterval);
+    clock.start();
+
+    connect(&socket, &QUdpSocket::readyRead, this, &UdpTransport::onReadyRead);
+    connect(&timer, &QTimer::timeout, this, &UdpTransport::onTimer);
+}
+
+UdpTransport::~UdpTransport() {
+    close();
+}
+
+bool UdpTransport::listen(quint16 port) {
+    close();
+
+    if (!socket.bind(QHostAddress::Any, port)) {
+        std::cerr << "UdpTransport: Failed to bind to port " << port << ": " << socket.errorString().toStdString() << "\n";
+        return false;
+    }
+
+    accepting = true;
+    timer.start();
+    return true;
+}
+
+UdpTransport::PeerId UdpTransport::connectTo(const QHostAddress &address, quint16 port) {
+    close();
+
+    QHostAddress any = address.protocol() == QAbstractSocket::IPv6Protocol ? QHostAddress::AnyIPv6 : QHostAddress::AnyIPv4;
+
+    if (!socket.bind(any, 0)) {
+        std::cerr << "UdpTransport: Failed to bind a socket: " << socket.errorString().toStdString() << "\n";
+        return noPeer;
+    }
+
+    PeerId id = nextPeerId++;
+    auto peer = std::make_unique<Peer>();
+    peer->address = address;
+    peer->port = port;
+    peer->connection.reset(now());
+
+    // Say hello, so the server knows we're here
+    flushPeer(*peer, true);
+    peers[id] = std::move(peer);
+
+    timer.start();
+    return id;
+}
+
+void UdpTransport::close() {
+    for (auto &[id, peer] : peers) {
+        if (!peer->closing) {
+            peer->connection.writeDisconnect(sendBuffer);
+            sendDatagram(*peer, sendBuffer);
+            peer->closing = true;
+        }
+    }
+
+    if (!dispatching) {
+        removeClosing();
+    }
+
+    timer.stop();
+    socket.close();
+    accepting = false;
+}
+
+bool UdpTransport::sendReliable(PeerId peer, quint8 type, const void *data, size_t size) {
+    auto it = peers.find(peer);
+
+    if (it == peers.end() || it->second->closing) {
+        return false;
+    }
+
+    return it->second->connection.sendReliable(type, data, size);
+}
+
+void UdpTransport::sendUnreliable(PeerId peer, quint8 type, const void *data, size_t size) {
+    auto it = peers.find(peer);
+
+    if (it != peers.end() && !it->second->closing) {
+        it->second->connection.sendUnreliable(type, data, size);
+    }
+}
+
+void UdpTransport::flush() {
+    for (auto &[id, peer] : peers) {
+        if (!peer->closing) {
+            flushPeer(*peer, false);
+        }
+    }
+}
+
+void UdpTransport::disconnectPeer(PeerId peer) {
+    auto it = peers.find(peer);
+
+    if (it == peers.end() || it->second->closing) {
+        return;
+    }
+
+    it->second->connection.writeDisconnect(sendBuffer);
+    sendDatagram(*it->second, sendBuffer);
+    it->second->closing = true;
+
+    if (!dispatching) {
+        removeClosing();
+    }
+}
+
+const UdpConnection *UdpTransport::getConnection(PeerId peer) const {
+    auto it = peers.find(peer);
+    return it == peers.end() || it->second->closing ? nullptr : &it->second->connection;
+}
+
+quint16 UdpTransport::getPort() const {
+    return socket.localPort();
+}
+
+void UdpTransport::setSimulatedLoss(double fraction) {
+    simulatedLoss = std::clamp(fraction, 0.0, 1.0);
+}
+
+void UdpTransport::onReadyRead() {
+    dispatching = true;
+
+    while (socket.hasPendingDatagrams()) {
+        qint64 size = socket.pendingDatagramSize();
+        receiveBuffer.resize(std::max<size_t>(receiveBuffer.size(), (size_t)std::max<qint64>(size, 1)));
+
+        QHostAddress address;
+        quint16 port = 0;
+        qint64 received = socket.readDatagram((char *)receiveBuffer.data(), (qint64)receiveBuffer.size(), &address, &port);
+
+        if (received <= 0) {
+            continue;
+        }
+
+        PeerId id = findPeer(address, port);
+        bool fresh = id == noPeer;
+
+        if (fresh) {
+            if (!accepting) {
+                continue;
+            }
+
+            id = nextPeerId++;
+            auto peer = std::make_unique<Peer>();
+            peer->address = address;
+            peer->port = port;
+            peer->connection.reset(now());
+            peers[id] = std::move(peer);
+        }
+
+        Peer &peer = *peers[id];
+
+        if (peer.closing) {
+            continue;
+        }
+
+        bool accepted = peer.connection.readPacket(receiveBuffer.data(), (size_t)received, now(),
+                                                   [this, id, &peer](const MessageView &message, bool reliable) {
+            // A message is the first sign of them, so they have to be connected before it's handled
+            if (!peer.heard) {
+                peer.heard = true;
+                emit connected(id);
+            }
+
+            if (!peer.closing) {
+                emit messageReceived(id, message, reliable);
+            }
+        });
+
+        // Anything that isn't one of our packets doesn't make anyone a peer
+        if (fresh && !accepted) {
+            peers.erase(id);
+            continue;
+        }
+
+        if (accepted && !peer.heard && !peer.connection.isDisconnected()) {
+            peer.heard = true;
+            emit connected(id);
+        }
+
+        if (peer.connection.isDisconnected() && !peer.closing) {
+            peer.closing = true;
+            if (peer.heard) { emit disconnected(id); }
+        }
+    }
+
+    dispatching = false;
+    removeClosing();
+}
+
+void UdpTransport::onTimer() {
+    double time = now();
+    dispatching = true;
+
+    for (auto &[id, peer] : peers) {
+        if (peer->closing) {
+            continue;
+        }
+
+        if (time - peer->connection.getLastReceiveTime() > timeout) {
+            peer->closing = true;
+            emit disconnected(id);
+            continue;
+        }
+
+        flushPeer(*peer, time - peer->connection.getLastSendTime() >= keepAliveInterval);
+    }
+
+    dispatching = false;
+    removeClosing();
+}
+
+void UdpTransport::flushPeer(Peer &peer, bool force) {
+    double time = now();
+
+    while (peer.connection.writePacket(sendBuffer, time, force)) {
+        sendDatagram(peer, sendBuffer);
+        force = false;
+    }
+}
+
+void UdpTransport::sendDatagram(const Peer &peer, const std::vector<uint8_t> &data) {
+    if (simulatedLoss > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(lossRandom) < simulatedLoss) {
+        return;
+    }
+
+    socket.writeDatagram((const char *)data.data(), (qint64)data.size(), peer.address, peer.port);
+}
+
+void UdpTransport::removeClosing() {
+    for (auto it = peers.begin(); it != peers.end(); ) {
+        if (it->second->closing) {
+            it = peers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+double UdpTransport::now() const {
+    return clock.nsecsElapsed() / 1e9;
+}
+
+UdpTransport::PeerId UdpTransport::findPeer(const QHostAddress &address, quint16 port) const {
+    for (const auto &[id, peer] : peers) {
+        if (peer->port == port && peer->address.isEqual(address, QHostAddress::TolerantConversion)) {
+            return id;
+        }
+    }
+
+    return noPeer;
+}
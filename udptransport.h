@@ -0,0 +1,185 @@
+#ifndef TANKS_UDPTRANSPORT_H
+#define TANKS_UDPTRANSPORT_H
+
+#include "udpconnection.h"
+
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QObject>
+#include <QTimer>
+#include <QUdpSocket>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Messages over UDP, to any number of peers, on one QUdpSocket. Unlike TCP (NetworkManager), a lost
+ * packet only holds up what's in it: snapshots go unreliably and the newest wins, and inputs and events
+ * go on a reliable, ordered channel on top. UdpConnection has the details.
+ *
+ * A server listens on a port, and anyone who sends it one of our packets becomes a peer. A client
+ * connects to one address, and becomes connected when the first packet comes back. There's no handshake
+ * beyond that: a peer that hasn't been heard from for timeout seconds is dropped, and one going away
+ * says so.
+ *
+ * Messages are queued, and go out together on flush, which the owner calls once it's queued a tick's
+ * worth. Anything else that's due (resending reliable messages, keep-alives so acks keep flowing, timeouts)
+ * is handled by a timer of its own.
+ */
+class UdpTransport : public QObject {
+    Q_OBJECT
+public:
+    using PeerId = uint32_t;
+
+    explicit UdpTransport(QObject *parent = nullptr);
+    ~UdpTransport() override;
+
+    /**
+     * Accept peers on a port, as a server
+     * @param port The port, or 0 for any free one
+     * @return false if it couldn't bind to it
+     */
+    bool listen(quint16 port);
+
+    /**
+     * Start talking to a server, as a client. connected is emitted once it answers
+     * @param address Its address
+     * @param port Its port
+     * @return the server's peer id, or noPeer if there's no socket to send from
+     */
+    PeerId connectTo(const QHostAddress &address, quint16 port);
+
+    /** Tell every peer we're going, forget them, and close the socket */
+    void close();
+
+    /**
+     * Queue a message on the reliable channel
+     * @param peer Who to
+     * @param type Its type, below UdpConnection::reliableBit
+     * @param data Its payload
+     * @param size Its size, at most UdpConnection::maxReliableSize
+     * @return false if there's no such peer, or too much is unacknowledged, so it was dropped
+     */
+    bool sendReliable(PeerId peer, quint8 type, const void *data, size_t size);
+
+    /**
+     * Queue a message to go once, unreliably
+     * @param peer Who to
+     * @param type Its type, below UdpConnection::reliableBit
+     * @param data Its payload
+     * @param size Its size
+     */
+    void sendUnreliable(PeerId peer, quint8 type, const void *data, size_t size);
+
+    /** Send everything queued, to every peer */
+    void flush();
+
+    /**
+     * Tell a peer we're going, and forget them. Safe to call from a signal about them
+     * @param peer Who
+     */
+    void disconnectPeer(PeerId peer);
+
+    /**
+     * @param peer A peer
+     * @return their connection's state, or nullptr if there's no such peer
+     */
+    const UdpConnection *getConnection(PeerId peer) const;
+
+    /** @return the port the socket is bound to */
+    quint16 getPort() const;
+
+    /**
+     * Drop a share of the packets sent, to try things over a bad network without one
+     * @param fraction From 0, none, to 1, all of them
+     */
+    void setSimulatedLoss(double fraction);
+
+    // Dropped after this long without hearing from them, in seconds
+    static const double constexpr timeout = 5.0;
+
+    // Something goes to every peer at least this often, in seconds, so acks keep flowing both ways
+    static const double constexpr keepAliveInterval = 0.1;
+
+    // How often the timer checks for resends, keep-alives and timeouts, in milliseconds
+    static const int constexpr serviceInterval = 20;
+
+    static const PeerId constexpr noPeer = 0;
+
+signals:
+    //Emitted when a peer is first heard from
+    void connected(UdpTransport::PeerId peer);
+
+    //Emitted when a peer says it's going, or times out. Not when it's disconnected from this end
+    void disconnected(UdpTransport::PeerId peer);
+
+    //Emitted for each message received. It points into the packet, so it's only valid during the call
+    void messageReceived(UdpTransport::PeerId peer, const MessageView &message, bool reliable);
+
+private slots:
+    /** Read and handle every waiting datagram */
+    void onReadyRead();
+
+    /** Resend what's due, keep quiet peers alive, and drop the silent ones */
+    void onTimer();
+
+private:
+    /** Someone we're talking to */
+    struct Peer {
+        QHostAddress address;
+        quint16 port = 0;
+        UdpConnection connection;
+        // Whether they've been heard from, and so connected has been emitted
+        bool heard = false;
+        // Whether they're going, and just waiting to be forgotten outside of any signal about them
+        bool closing = false;
+    };
+
+    /**
+     * Send everything queued for a peer
+     * @param peer The peer
+     * @param force Whether to send a keep-alive if there's nothing else
+     */
+    void flushPeer(Peer &peer, bool force);
+
+    /**
+     * Send a datagram, or pretend to if it's simulated as lost
+     * @param peer Who to
+     * @param data The datagram
+     */
+    void sendDatagram(const Peer &peer, const std::vector<uint8_t> &data);
+
+    /** Forget the peers that are closing. Not while dispatching, since a signal's receiver may be holding one */
+    void removeClosing();
+
+    /** @return seconds since the transport was made */
+    double now() const;
+
+    /**
+     * @param address An address
+     * @param port A port
+     * @return the peer at it, or noPeer
+     */
+    PeerId findPeer(const QHostAddress &address, quint16 port) const;
+
+    QUdpSocket socket;
+    QTimer timer;
+    QElapsedTimer clock;
+    bool accepting = false;
+    // Whether signals are being emitted from inside a loop over the peers, so none can be removed yet
+    bool dispatching = false;
+
+    std::map<PeerId, std::unique_ptr<Peer>> peers;
+    PeerId nextPeerId = 1;
+
+    // Reused for every datagram, in and out
+    std::vector<uint8_t> receiveBuffer;
+    std::vector<uint8_t> sendBuffer;
+
+    double simulatedLoss = 0.0;
+    std::mt19937 lossRandom;
+};
+
+#endif //TANKS_UDPTRANSPORT_H